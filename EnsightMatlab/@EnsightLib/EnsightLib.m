@@ -312,10 +312,19 @@ classdef EnsightLib < handle
     varargout = getVariableBounds(this, name, timestep);
 
     % Create |EnsightSubdivTree| for this object and save class handle
-    createSubdivTree(this, maxDepth, maxElements, sizeOffset);
+    createSubdivTree(this, maxDepth, maxElements, sizeOffset, type);
+
+    % Write the |EnsightSubdivTree| of timestep 0 to a file
+    saveSubdivTree(this, filename);
+
+    % Create |EnsightSubdivTree| from a file written by saveSubdivTree
+    ok = loadSubdivTree(this, filename, maxDepth, maxElements, sizeOffset, type);
 
     % Print all information about this |EnsightObject|
     print(this);
+
+    % Return the bytes used, broken down by part, timestep, cells, variables and subdivision tree
+    usage = getMemoryUsage(this);
     
     
     %----------------------------------------------------------------------------------------------------------
@@ -347,12 +356,21 @@ classdef EnsightLib < handle
     %----------------------------------------------------------------------------------------------------------
     % ######################################### Interpolation methods #########################################
     %----------------------------------------------------------------------------------------------------------
-    [result,ok] = interpolateVariable(this, position, variableName);
+    [result,ok] = interpolateVariable(this, position, variableName, timestep);
+
+    [result,distance] = interpolateNearest(this, position, variableName, timestep);
 
-    cellList = search(this, lineSegments, options);
+    [partIds,vertices,distances] = findNearestVertices(this, position, k, timestep);
+
+    cellList = search(this, lineSegments, options, timestep);
     
     %cells = getCells(this);
   end
+
+  methods (Static)
+    % Set the number of threads used by all objects (1: serial, 0: default)
+    setNumThreads(numThreads);
+  end
     
 end
 
@@ -1,30 +1,39 @@
-%% createSubdivTree(object, maxDepth, maxElements, sizeOffset)
-% Creates new |EnsightSubdivTree| and inserts all existing |EnsightParts|
+%% createSubdivTree(object, maxDepth, maxElements, sizeOffset, type)
+% Creates new |EnsightSubdivTree| and inserts all existing |EnsightParts|.
+% For transient objects each timestep gets its own tree, built on the first
+% query of that timestep.
 %
 % INPUT
 %  object       : |EnsightObj| object
-%  maxDepth     : (integer) maximum number of levels
+%  maxDepth     : (integer) maximum number of levels, ignored for 'bvh'
 %  maxElements  : (integer) maximum number of elements in a node before it
 %                 gets split (unless maxDepth is reached)
 %  sizeOffset   : (double) bounding box offset (optional, default: 0.0)
+%  type         : (string) 'octree' for an octree or quadtree, 'bvh' for a
+%                 bounding volume hierarchy storing each cell once, e.g. for
+%                 strongly graded meshes (optional, default: 'octree')
 %
 % OUTPUT
 %  none
 %
 % USAGE
-%  object.createSubdivTree(maxDepth, maxElements, (sizeOffset))
+%  object.createSubdivTree(maxDepth, maxElements, (sizeOffset), (type))
 %
 
 %%
-function createSubdivTree(this, maxDepth, maxElements, sizeOffset)
-  assert(~this.isTransient(),'EnsightLib::createSubdivTree - Transient data is not supported yet.');
+function createSubdivTree(this, maxDepth, maxElements, sizeOffset, type)
   assert(~this.EnsightSubdivTree.created,'EnsightLib::createSubdivTree - There already exists a subdivision tree of this EnsightObject.');
   if nargin<4
     sizeOffset = 0;
   end
+  if nargin<5
+    type = 'octree';
+  end
+  typeId = find(strcmpi(type, {'octree', 'bvh'})) - 1;
+  assert(~isempty(typeId),'EnsightLib::createSubdivTree - Unknown type, expected ''octree'' or ''bvh''.');
 
-  valueArray = [4, 0, 5, 0, 0, 0];
-  EnsightLib_interface('obj', 'createSubdivTree', valueArray, this.getObjectHandle(), maxDepth, maxElements, sizeOffset);
+  valueArray = [5, 0, 5, 0, 0, 0, 0];
+  EnsightLib_interface('obj', 'createSubdivTree', valueArray, this.getObjectHandle(), maxDepth, maxElements, sizeOffset, typeId);
   this.EnsightSubdivTree = struct('created',true,'maxLevel',maxDepth,'maxElements',maxElements,'offset',sizeOffset,'bounds',[0 0; 0 0; 0 0]);
   
   valueArray = [1, 1, 5];
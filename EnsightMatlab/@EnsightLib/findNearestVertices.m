@@ -0,0 +1,34 @@
+%% findNearestVertices(object, position, k, timestep)
+% Finds the k vertices closest to one or many points, using a KD-tree over
+% the vertices of the parts in the subdivision tree. Many points are
+% processed in parallel.
+%
+% INPUT
+%  object   : |EnsightLib| object
+%  position : (matrix,3xN) query positions
+%  k        : (int) number of vertices per position
+%  timestep : (integer) timestep (optional, default: 0)
+%
+% OUTPUT
+%  partIds   : (int,kxN) part id of each vertex, -1 if there are less than k vertices
+%  vertices  : (int,kxN) index of each vertex in its part, see getVertices
+%  distances : (matrix,kxN) distance of each vertex, sorted ascending
+%
+% USAGE
+%  [partIds, vertices, distances] = object.findNearestVertices(position, k)
+%  [partIds, vertices, distances] = object.findNearestVertices(position, k, timestep)
+%
+
+%%
+function [partIds,vertices,distances] = findNearestVertices(this, position, k, timestep)
+    assert(nargin==3 || nargin==4,'EnsightLib::findNearestVertices - Invalid number of input arguments. Type `help EnsightLib.findNearestVertices` for detailed information.');
+    assert(size(position,1)==3,'EnsightLib::findNearestVertices - Invalid input (wrong dimensions). Call `help EnsightLib.findNearestVertices` for further information.');
+
+    if nargin < 4
+        timestep = 0;
+    end
+    assert(this.verifyTimestep(timestep),'EnsightLib::findNearestVertices - Invalid timestep.');
+
+    valueArray = [4, 3, 5, 0, 0, 0];
+    [partIds,vertices,distances] = EnsightLib_interface('obj', 'findNearestVertices', valueArray, this.getObjectHandle(), position, k, timestep);
+end
@@ -0,0 +1,33 @@
+%% getMemoryUsage(object)
+% Get the bytes used by this object, e.g. to size batch jobs
+%
+% INPUT
+%  object : |EnsightLib| object
+%
+% OUTPUT
+%  usage  : (struct) with fields
+%           total        : bytes of stored arrays, topology and subdivision tree
+%           arrays       : bytes of all vertex, cell and variable arrays
+%           storedArrays : bytes of the arrays actually stored (identical arrays are shared)
+%           deduplicated : bytes saved by sharing identical arrays
+%           peakArrays   : highest number of bytes of stored arrays, e.g. while reading
+%           topology     : bytes of the computed cell neighbors and boundaries,
+%                          vertex incidence, face connectivity and mesh views
+%           subdivTree   : bytes of the subdivision tree
+%           readPeak     : peak resident memory of the process while reading
+%                          the case, above the memory before reading
+%           entries      : (struct array) breakdown with fields part, timestep,
+%                          category, name, bytes and shared. Shared entries are
+%                          counted by an earlier entry.
+%
+% USAGE
+%  usage = object.getMemoryUsage()
+%
+
+%%
+function usage = getMemoryUsage(this)
+    assert(nargin==1,'EnsightLib::getMemoryUsage - Invalid number of input arguments. Type `help EnsightLib.getMemoryUsage` for detailed information.');
+
+    valueArray = [1, 1, 5];
+    usage = EnsightLib_interface('obj', 'getMemoryUsage', valueArray, this.getObjectHandle());
+end
@@ -0,0 +1,37 @@
+%% interpolateNearest(object, position, variableName, timestep)
+% Queries an interpolation of a variable for one or many points like
+% interpolateVariable, but points outside of all cells get the value at the
+% closest point of the nearest cell instead of failing. This also finds
+% point and bar cells, which contain no volume. Many points are
+% interpolated in parallel.
+%
+% INPUT
+%  object        : |EnsightObj| object
+%  position      : (matrix,3xN) interpolation positions
+%  variableNames : (string) interpolation variable
+%  timestep      : (integer) timestep (optional, default: 0)
+%
+% OUTPUT
+%  result   : (matrix,dimxN) interpolation results
+%  distance : (matrix,1xN) distance of each position to its cell, 0 inside
+%             of a cell
+%
+% USAGE
+%  [result, distance] = object.interpolateNearest(position, variableName)
+%  [result, distance] = object.interpolateNearest(position, variableName, timestep)
+%
+
+%%
+function [result,distance] = interpolateNearest(this, position, variableName, timestep)
+
+    if(size(position,1)~=3)
+        error('Position has wrong dimensions. 3xN needed.');
+    end
+    if nargin < 4
+        timestep = 0;
+    end
+    assert(this.verifyTimestep(timestep),'EnsightLib::interpolateNearest - Invalid timestep.');
+
+    valueArray = [4, 2, 5, 0, 1, 0];
+    [result,distance] = EnsightLib_interface('obj', 'interpolateNearest', valueArray, this.getObjectHandle(), position, variableName, timestep);
+end
@@ -1,30 +1,37 @@
-%% interpolateVariable(object, position, variableName)
-% Queries an interpolation of a variable for a single point
+%% interpolateVariable(object, position, variableName, timestep)
+% Queries an interpolation of a variable for one or many points. Many points
+% are interpolated in parallel.
 %
 % INPUT
 %  object        : |EnsightObj| object
-%  position      : (vector,3x1) interpolation position
+%  position      : (matrix,3xN) interpolation positions
 %  variableNames : (string) interpolation variable
+%  timestep      : (integer) timestep (optional, default: 0)
 %
 % OUTPUT
-%  result   : (double/vector) interpolation result
-%  ok       : (bool) interpolation success
+%  result   : (matrix,dimxN) interpolation results, 0 for failed points
+%  ok       : (bool,1xN) interpolation success
 %
 % USAGE
 %  [result, ok] = object.interpolateVariable(position, variableName)
+%  [result, ok] = object.interpolateVariable(position, variableName, timestep)
 %
 
 %%
-function [result,ok] = interpolateVariable(this, position, variableName)
+function [result,ok] = interpolateVariable(this, position, variableName, timestep)
 
-    if(~all(size(position)==[3,1]))
-        error('Position has wrong dimensions. 3x1 needed.');
+    if(size(position,1)~=3)
+        error('Position has wrong dimensions. 3xN needed.');
     end
+    if nargin < 4
+        timestep = 0;
+    end
+    assert(this.verifyTimestep(timestep),'EnsightLib::interpolateVariable - Invalid timestep.');
     
-    valueArray = [3, 2, 5, 0, 1];
-    [tmp_result,tmp_ok] = EnsightLib_interface('obj', 'interpolate', valueArray, this.getObjectHandle(), position, variableName);
+    valueArray = [4, 2, 5, 0, 1, 0];
+    [tmp_result,tmp_ok] = EnsightLib_interface('obj', 'interpolate', valueArray, this.getObjectHandle(), position, variableName, timestep);
     
-    if(tmp_ok==false)
+    if(~all(tmp_ok))
         warning('EnsightLib::interpolateVariable: Interpolation failed. Point outside bounds.');
     end
     
@@ -0,0 +1,44 @@
+%% loadSubdivTree(object, filename, maxDepth, maxElements, sizeOffset, type)
+% Creates the |EnsightSubdivTree| like createSubdivTree, but loads the tree
+% of timestep 0 from a file written by saveSubdivTree instead of building it.
+% The trees of other timesteps are built on their first query.
+%
+% INPUT
+%  object       : |EnsightObj| object
+%  filename     : (string) name of the tree file
+%  maxDepth     : (integer) see createSubdivTree
+%  maxElements  : (integer) see createSubdivTree
+%  sizeOffset   : (double) see createSubdivTree (optional, default: 0.0)
+%  type         : (string) see createSubdivTree (optional, default: 'octree')
+%
+% OUTPUT
+%  ok           : (bool) false if the file can't be read or was written for
+%                 other geometry or parameters. Then no tree is created, call
+%                 createSubdivTree and saveSubdivTree instead.
+%
+% USAGE
+%  ok = object.loadSubdivTree(filename, maxDepth, maxElements, (sizeOffset), (type))
+%
+
+%%
+function ok = loadSubdivTree(this, filename, maxDepth, maxElements, sizeOffset, type)
+  assert(~this.EnsightSubdivTree.created,'EnsightLib::loadSubdivTree - There already exists a subdivision tree of this EnsightObject.');
+  if nargin<5
+    sizeOffset = 0;
+  end
+  if nargin<6
+    type = 'octree';
+  end
+  typeId = find(strcmpi(type, {'octree', 'bvh'})) - 1;
+  assert(~isempty(typeId),'EnsightLib::loadSubdivTree - Unknown type, expected ''octree'' or ''bvh''.');
+
+  valueArray = [6, 1, 5, 1, 0, 0, 0, 0];
+  ok = EnsightLib_interface('obj', 'loadSubdivTree', valueArray, this.getObjectHandle(), filename, maxDepth, maxElements, sizeOffset, typeId);
+  if ~ok
+    return;
+  end
+  this.EnsightSubdivTree = struct('created',true,'maxLevel',maxDepth,'maxElements',maxElements,'offset',sizeOffset,'bounds',[0 0; 0 0; 0 0]);
+
+  valueArray = [1, 1, 5];
+  this.EnsightSubdivTree.bounds = EnsightLib_interface('obj', 'getSubdivTreeBounds', valueArray, this.getObjectHandle());
+end
\ No newline at end of file
@@ -59,5 +59,16 @@ function print(this)
     fprintf('%4d \t \t %s \n',this.EnsightPartList{i,1},this.EnsightPartList{i,2});
   end
   fprintf('\n\n');
+
+  fprintf('\t MEMORY (BYTES)\n');
+  disp('------------------------------------------------');
+  usage = this.getMemoryUsage();
+  fprintf('%18s \t %d \n','total',usage.total);
+  fprintf('%18s \t %d \n','stored arrays',usage.storedArrays);
+  fprintf('%18s \t %d \n','deduplicated',usage.deduplicated);
+  fprintf('%18s \t %d \n','peak arrays',usage.peakArrays);
+  fprintf('%18s \t %d \n','topology',usage.topology);
+  fprintf('%18s \t %d \n','subdivision tree',usage.subdivTree);
+  fprintf('\n\n');
   disp('================================================');
 end
\ No newline at end of file
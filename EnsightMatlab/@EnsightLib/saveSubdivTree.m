@@ -0,0 +1,23 @@
+%% saveSubdivTree(object, filename)
+% Writes the |EnsightSubdivTree| of timestep 0 to a binary file, so that
+% later sessions can load it with loadSubdivTree instead of building it.
+% The trees of other timesteps are not written.
+%
+% INPUT
+%  object   : |EnsightObj| object
+%  filename : (string) name of the tree file
+%
+% OUTPUT
+%  none
+%
+% USAGE
+%  object.saveSubdivTree(filename)
+%
+
+%%
+function saveSubdivTree(this, filename)
+  assert(this.EnsightSubdivTree.created,'EnsightLib::saveSubdivTree - There is no subdivision tree, call createSubdivTree first.');
+
+  valueArray = [2, 0, 5, 1];
+  EnsightLib_interface('obj', 'saveSubdivTree', valueArray, this.getObjectHandle(), filename);
+end
\ No newline at end of file
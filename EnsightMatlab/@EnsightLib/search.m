@@ -1,10 +1,11 @@
-%% search(object, lineSegments)
+%% search(object, lineSegments, options, timestep)
 % Returns the vertices of an |EnsightPart| for multiple timesteps
 %
 % INPUT
 %  object       : |EnsightLib| object
 %  lineSegments : (numeric, 3xN matrix) A set of 3-dimensional points
 %  options      : (string, optional) 'c' for centroid, 'v' for volume,'vc'for both
+%  timestep     : (integer, optional) timestep, default: 0
 % OUTPUT
 %  cellList     : (int, 3xN) set of triplets [cell_id;celltype_id;part_id]
 %                 If the search was not successful, the corresponding triplet is set to [-1;-1;-1]
@@ -13,20 +14,25 @@
 % USAGE
 %  cellList     = object.search(lineSegments)
 %  cellList     = object.search(lineSegments,options)
+%  cellList     = object.search(lineSegments,options,timestep)
 
 %%
-function cellList = search(this, lineSegments, options)
-    assert(nargin==2 || nargin==3,'EnsightLib::search - Invalid input. Call `help EnsightLib.search` for further information.');
+function cellList = search(this, lineSegments, options, timestep)
+    assert(nargin>=2 && nargin<=4,'EnsightLib::search - Invalid input. Call `help EnsightLib.search` for further information.');
     assert(size(lineSegments,1)==3,'EnsightLib::search - Invalid input (wrong dimensions). Call `help EnsightLib.search` for further information.');
     assert(size(lineSegments,2)>0,'EnsightLib::search - Invalid input (wrong dimensions). Call `help EnsightLib.search` for further information.');
     
-    if(nargin == 2 )
+    if(nargin == 2 || isempty(options))
         options = '0';
     else
         options = [num2str(length(options)),lower(options)];
     end
+    if(nargin < 4)
+        timestep = 0;
+    end
+    assert(this.verifyTimestep(timestep),'EnsightLib::search - Invalid timestep.');
     
-    valueArray = [3, 1, 5, 0, 1];
-    buffer = EnsightLib_interface('obj', 'findCell', valueArray, this.getObjectHandle(), lineSegments, options);
+    valueArray = [4, 1, 5, 0, 1, 0];
+    buffer = EnsightLib_interface('obj', 'findCell', valueArray, this.getObjectHandle(), lineSegments, options, timestep);
     cellList = buffer;
 end
\ No newline at end of file
@@ -4,7 +4,8 @@
 % INPUT
 %  object   : |EnsightLib| object
 %  part     : (int|string) part_idetifier
-%  cells    : (int,matrix) pointer to local coordinates
+%  cells    : (int,matrix) pointer to local coordinates, int32 cells
+%             are used without copying
 %  celltype : (int|string) celltype identifier
 %  timestep : (int) timestep_index (transient objects only)
 %
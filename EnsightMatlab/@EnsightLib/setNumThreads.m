@@ -0,0 +1,25 @@
+%% setNumThreads(numThreads)
+% Set the number of threads used by all EnsightLib objects for reading,
+% writing, topology and subdivision tree computations.
+% MATLAB runs everything on the calling thread unless this is called or the
+% environment variable ENSIGHT_NUM_THREADS is set before the first call of
+% EnsightLib. The worker threads are stopped when the MEX file is cleared.
+%
+% INPUT
+%  numThreads : (int) 1 runs everything on the calling thread,
+%               0 uses ENSIGHT_NUM_THREADS or the number of cores
+%
+% OUTPUT
+%  none
+%
+% USAGE
+%  EnsightLib.setNumThreads(0)
+%
+
+%%
+function setNumThreads(numThreads)
+    assert(nargin==1,'EnsightLib::setNumThreads - Invalid number of input arguments. Type `help EnsightLib.setNumThreads` for detailed information.');
+
+    valueArray = [1, 0, 0];
+    EnsightLib_interface('interface', 'setNumThreads', valueArray, numThreads);
+end
@@ -23,11 +23,96 @@
 
 #include "EnsightLib_interface.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include <QStringList>
 
+namespace
+{
+
+// Arrays sharing their data with buffers that were released since, see
+// MexTools::getDoubleBuffer(). Buffers may be released by worker threads,
+// but the MATLAB API must only be called from the MATLAB thread, so the
+// arrays are destroyed by destroyReleasedArrays(). The list is never
+// destroyed, as buffers of objects not deleted by MATLAB are released after
+// the static destructors ran.
+struct ReleasedArrays
+{
+    std::mutex mutex;
+    std::vector<mxArray*> arrays;
+};
+
+ReleasedArrays& releasedArrays()
+{
+    static ReleasedArrays* released = new ReleasedArrays();
+    return *released;
+}
+
+// Destroys the released arrays, called from the MATLAB thread
+void destroyReleasedArrays()
+{
+    std::vector<mxArray*> arrays;
+    {
+        ReleasedArrays& released = releasedArrays();
+        std::lock_guard<std::mutex> lock(released.mutex);
+        arrays.swap(released.arrays);
+    }
+    for (mxArray* array : arrays)
+        mxDestroyArray(array);
+}
+
+// Joins the worker threads and destroys the released arrays before MATLAB
+// unloads the MEX file
+void exitMex()
+{
+    Ensight::Parallel::shutdown();
+    destroyReleasedArrays();
+}
+
+// MATLAB sessions run serially unless the user opts in with
+// EnsightLib.setNumThreads or the environment variable ENSIGHT_NUM_THREADS
+void initializeThreads()
+{
+    static bool initialized = false;
+    if (initialized)
+        return;
+    initialized = true;
+
+    if (!std::getenv("ENSIGHT_NUM_THREADS"))
+        Ensight::Parallel::setNumThreads(1);
+    mexAtExit(exitMex);
+}
+
+// Get the SubdivTree of a timestep, creating the trees with default
+// parameters if they don't exist
+EnsightSubdivTree* requireSubdivTree(EnsightObj* object, int timestep)
+{
+    if (timestep < 0 || timestep >= std::max(object->getNumberOfTimesteps(), 1))
+        throw std::runtime_error("Invalid timestep.");
+
+    if (object->getSubdivTree() == 0)
+    {
+        QStringList partsToExclude;
+        object->createSubdivTree(7, 50, partsToExclude, 0.0);
+    }
+    EnsightSubdivTree* subdivTree = object->getSubdivTree(timestep);
+    if (subdivTree == 0)
+        throw std::runtime_error("Could not create SubdivTree.");
+    return subdivTree;
+}
+
+}
+
 // ********** EnSight-MATLAB interface function ****//
 void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
 {
+    initializeThreads();
+    destroyReleasedArrays();
 
     try
     {
@@ -53,6 +138,8 @@ void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
                 EnsightMatlab::deleteEnsight(prhs);
             else if (strcmp(command, "read") == 0)
                 EnsightMatlab::readEnsight(prhs, plhs);
+            else if (strcmp(command, "setNumThreads") == 0)
+                EnsightMatlab::setNumThreads(prhs);
             else
                 throw std::runtime_error("Unknown method.");
         }
@@ -85,12 +172,22 @@ void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[])
                 EnsightMatlab::getVariableBounds(object, prhs, plhs);
             else if (strcmp(command, "createSubdivTree") == 0)
                 EnsightMatlab::createSubdivTree(object, prhs);
+            else if (strcmp(command, "saveSubdivTree") == 0)
+                EnsightMatlab::saveSubdivTree(object, prhs);
+            else if (strcmp(command, "loadSubdivTree") == 0)
+                EnsightMatlab::loadSubdivTree(object, prhs, plhs);
             else if (strcmp(command, "interpolate") == 0)
                 EnsightMatlab::interpolate(object, prhs, plhs);
+            else if (strcmp(command, "interpolateNearest") == 0)
+                EnsightMatlab::interpolateNearest(object, prhs, plhs);
             else if (strcmp(command, "findCell") == 0)
                 EnsightMatlab::findCell(object, prhs, plhs);
+            else if (strcmp(command, "findNearestVertices") == 0)
+                EnsightMatlab::findNearestVertices(object, prhs, plhs);
             else if (strcmp(command, "getSubdivTreeBounds") == 0)
                 EnsightMatlab::getSubdivTreeBounds(object, plhs);
+            else if (strcmp(command, "getMemoryUsage") == 0)
+                EnsightMatlab::getMemoryUsage(object, plhs);
             else
                 throw std::runtime_error("Unknown method for EnsightObj.");
         }
@@ -289,6 +386,63 @@ const Matx MexTools::getDoubleMatrix(const mxArray* prhs[], int slot)
     return matrix;
 }
 
+#ifdef ENSIGHT_MEX_SHARED_DATA
+// Creates an array sharing the data of another one. MATLAB copies the data on
+// write, so the shared data stays valid and unchanged while the copy exists.
+// This function is not documented and not declared by the MATLAB headers, it
+// may change or be missing in other MATLAB releases. It is only used when
+// compiled with ENSIGHT_MEX_SHARED_DATA, see runmex.
+extern "C" mxArray* mxCreateSharedDataCopy(const mxArray* array);
+
+namespace
+{
+// Keeps a persistent shared data copy of the input array alive as long as
+// a buffer refers to its data. The copy is destroyed on the MATLAB thread,
+// see destroyReleasedArrays().
+template <typename Scalar>
+std::shared_ptr<const Scalar> shareArrayData(const mxArray* input)
+{
+    mxArray* shared = mxCreateSharedDataCopy(input);
+    mexMakeArrayPersistent(shared);
+    const Scalar* data = static_cast<const Scalar*>(mxGetData(shared));
+    return std::shared_ptr<const Scalar>(data, [shared](const Scalar*) {
+        ReleasedArrays& released = releasedArrays();
+        std::lock_guard<std::mutex> lock(released.mutex);
+        released.arrays.push_back(shared);
+    });
+}
+}
+#endif
+
+MatxBuffer MexTools::getDoubleBuffer(const mxArray* prhs[], int slot)
+{
+    const mxArray* input = prhs[slot];
+    if (!mxIsDouble(input) || mxIsComplex(input) || mxIsSparse(input) || mxIsEmpty(input))
+        return MatxBuffer(getDoubleMatrix(prhs, slot));
+
+    const mwSize* dim = mxGetDimensions(input);
+#ifdef ENSIGHT_MEX_SHARED_DATA
+    return MatxBuffer(shareArrayData<double>(input), dim[0], dim[1]);
+#else
+    return MatxBuffer(Matx(Eigen::Map<const Matx>(mxGetPr(input), dim[0], dim[1])));
+#endif
+}
+
+MatiBuffer MexTools::getIntegerBuffer(const mxArray* prhs[], int slot)
+{
+    const mxArray* input = prhs[slot];
+    if (!mxIsInt32(input) || mxIsComplex(input) || mxIsEmpty(input))
+        return MatiBuffer(getIntegerMatrix(prhs, slot));
+
+    const mwSize* dim = mxGetDimensions(input);
+#ifdef ENSIGHT_MEX_SHARED_DATA
+    return MatiBuffer(shareArrayData<int>(input), dim[0], dim[1]);
+#else
+    const int* data = static_cast<const int*>(mxGetData(input));
+    return MatiBuffer(Mati(Eigen::Map<const Mati>(data, dim[0], dim[1])));
+#endif
+}
+
 const Vecx MexTools::getDoubleVector(const mxArray* prhs[], int slot)
 {
     const mwSize* dim = mxGetDimensions(prhs[slot]);
@@ -446,8 +600,8 @@ void EnsightMatlab::readEnsight(const mxArray* prhs[], mxArray* plhs[])
 
     EnsightObj* object = EnsightLib::readEnsight(QString(filename));
     if (object == 0)
-        throw std::runtime_error(std::string("Could not read file. EnsightObj::ERROR_STR='")
-        + EnsightObj::ERROR_STR.toStdString() + "'");
+        throw std::runtime_error(std::string("Could not read file. EnsightObj::errorString()='")
+        + EnsightObj::errorString().toStdString() + "'");
 
     int NTstep = object->getNumberOfTimesteps();
     int NVar = object->getNumberOfVariables();
@@ -554,6 +708,12 @@ void EnsightMatlab::readEnsight(const mxArray* prhs[], mxArray* plhs[])
     }
 }
 
+void EnsightMatlab::setNumThreads(const mxArray* prhs[])
+{
+    const int numThreads = MexTools::getIntegerScalar(prhs, 3);
+    Ensight::Parallel::setNumThreads(numThreads);
+}
+
 void EnsightMatlab::writeEnsight(EnsightObj* object, const mxArray* prhs[])
 {
     char filename[2048];
@@ -567,7 +727,7 @@ void EnsightMatlab::writeEnsight(EnsightObj* object, const mxArray* prhs[])
     bool success = EnsightLib::writeEnsight(object, QString(filename), mode, timestep);
 
     if (!success)
-        throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
 }
 
 
@@ -581,7 +741,7 @@ void EnsightMatlab::endEdit(EnsightObj* object)
 {
     bool success = object->endEdit();
     if (!success)
-        throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
 }
 
 void EnsightMatlab::createEnsightPart(EnsightObj* object, const mxArray* prhs[])
@@ -595,14 +755,14 @@ void EnsightMatlab::createEnsightPart(EnsightObj* object, const mxArray* prhs[])
     bool success = object->createEnsightPart(QString(partname), id);
 
     if (!success)
-        throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
 }
 
 void EnsightMatlab::setStatic(EnsightObj* object)
 {
     bool success = object->setStatic();
     if (!success)
-        throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
 }
 
 void EnsightMatlab::setTransient(EnsightObj* object, const mxArray* prhs[])
@@ -612,7 +772,7 @@ void EnsightMatlab::setTransient(EnsightObj* object, const mxArray* prhs[])
 
     bool success = object->setTransient(timesteps);
     if (!success)
-        throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
 }
 
 void EnsightMatlab::cleanObject(EnsightObj* object, const mxArray* prhs[])
@@ -648,7 +808,7 @@ void EnsightMatlab::createVariable(EnsightObj* object, const mxArray* prhs[])
 
     bool success = object->createVariable(QString(name), Ensight::VarTypes(type));
     if (!success)
-        throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
 }
 
 void EnsightMatlab::addConstant(EnsightObj* object, const mxArray* prhs[])
@@ -661,7 +821,7 @@ void EnsightMatlab::addConstant(EnsightObj* object, const mxArray* prhs[])
     const QString qName(name);
     bool success = object->addConstant(qName, value);
     if (!success)
-        throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
 }
 
 
@@ -687,7 +847,7 @@ void EnsightMatlab::replaceConstants(EnsightObj* object, const mxArray* prhs[])
             bool success = object->removeConstant(qName);
             success &= object->addConstant(qName, value);
             if (!success)
-                throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+                throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
         }
         else
         {
@@ -729,6 +889,53 @@ void EnsightMatlab::getSubdivTreeBounds(EnsightObj* object, mxArray* plhs[])
     MexTools::mexAllocateAndCopyMatrix(output, plhs, 0);
 }
 
+void EnsightMatlab::getMemoryUsage(EnsightObj* object, mxArray* plhs[])
+{
+    EnsightMemoryReport report = object->getMemoryReport();
+
+    // Struct with the totals and a struct-array breakdown in field 'entries'
+    const char* field_names[] = {"total",
+                                 "arrays",
+                                 "storedArrays",
+                                 "deduplicated",
+                                 "peakArrays",
+                                 "topology",
+                                 "subdivTree",
+                                 "readPeak",
+                                 "entries"};
+    mwSize dims[2] = {1, 1};
+    plhs[0] = mxCreateStructArray(2, dims, 9, field_names);
+
+    mxSetFieldByNumber(plhs[0], 0, 0, mxCreateDoubleScalar(static_cast<double>(report.getTotalBytes())));
+    mxSetFieldByNumber(plhs[0], 0, 1, mxCreateDoubleScalar(static_cast<double>(report.arrayBytes)));
+    mxSetFieldByNumber(plhs[0], 0, 2, mxCreateDoubleScalar(static_cast<double>(report.storedArrayBytes)));
+    mxSetFieldByNumber(plhs[0], 0, 3, mxCreateDoubleScalar(static_cast<double>(report.getDeduplicatedBytes())));
+    mxSetFieldByNumber(plhs[0], 0, 4, mxCreateDoubleScalar(static_cast<double>(report.peakArrayBytes)));
+    mxSetFieldByNumber(plhs[0], 0, 5, mxCreateDoubleScalar(static_cast<double>(report.topologyBytes)));
+    mxSetFieldByNumber(plhs[0], 0, 6, mxCreateDoubleScalar(static_cast<double>(report.subdivTreeBytes)));
+    mxSetFieldByNumber(plhs[0], 0, 7, mxCreateDoubleScalar(static_cast<double>(report.readPeakBytes)));
+
+    const char* entry_names[] = {"part",
+                                 "timestep",
+                                 "category",
+                                 "name",
+                                 "bytes",
+                                 "shared"};
+    mwSize entryDims[2] = {static_cast<mwSize>(report.entries.size()), 1};
+    mxArray* entries = mxCreateStructArray(2, entryDims, 6, entry_names);
+    for (size_t i = 0; i < report.entries.size(); i++)
+    {
+        const EnsightMemoryReport::Entry& entry = report.entries[i];
+        mxSetFieldByNumber(entries, i, 0, mxCreateString(entry.part.c_str()));
+        mxSetFieldByNumber(entries, i, 1, mxCreateDoubleScalar(entry.timestep));
+        mxSetFieldByNumber(entries, i, 2, mxCreateString(entry.category.c_str()));
+        mxSetFieldByNumber(entries, i, 3, mxCreateString(entry.name.c_str()));
+        mxSetFieldByNumber(entries, i, 4, mxCreateDoubleScalar(static_cast<double>(entry.bytes)));
+        mxSetFieldByNumber(entries, i, 5, mxCreateLogicalScalar(entry.shared));
+    }
+    mxSetFieldByNumber(plhs[0], 0, 8, entries);
+}
+
 // *************** EnsightPart methods ******************* //
 
 void EnsightMatlab::cleanPart(EnsightPart* part, const mxArray* prhs[])
@@ -755,10 +962,10 @@ void EnsightMatlab::getPartGeometryBounds(EnsightPart* part, const mxArray* prhs
 void EnsightMatlab::setVerticesOfPart(EnsightPart* part, const mxArray* prhs[])
 {
     // Access parameters
-    const Matx vertices = MexTools::getDoubleMatrix(prhs, 5);
+    MatxBuffer vertices = MexTools::getDoubleBuffer(prhs, 5);
     const int timestep = MexTools::getIntegerScalar(prhs, 6);
 
-    part->setVertices( vertices, timestep);
+    part->setVertices(vertices, timestep);
 }
 
 void EnsightMatlab::getVerticesOfPart(EnsightPart* part, const mxArray* prhs[], mxArray* plhs[])
@@ -783,7 +990,7 @@ void EnsightMatlab::partHasCelltype(EnsightPart* part, const mxArray* prhs[], mx
 void EnsightMatlab::setCellsOfPart(EnsightPart* part, const mxArray* prhs[])
 {
     // Access parameters
-    const Mati nodes = MexTools::getIntegerMatrix(prhs, 5);
+    MatiBuffer nodes = MexTools::getIntegerBuffer(prhs, 5);
     const int timestep = MexTools::getIntegerScalar(prhs, 6);
     const int celltype = MexTools::getIntegerScalar(prhs, 7);
 
@@ -844,7 +1051,7 @@ void EnsightMatlab::getVertexCountOfPart(EnsightPart* part, const mxArray* prhs[
 void EnsightMatlab::setVariableForPart(EnsightPart* part, const mxArray* prhs[], mxArray* plhs[])
 {
     // Access parameters
-    const Matx variableValues = MexTools::getDoubleMatrix(prhs, 6);
+    MatxBuffer variableValues = MexTools::getDoubleBuffer(prhs, 6);
     char variableName[64];
     mxGetString(prhs[5], variableName, sizeof(variableName));
     const int variableType = MexTools::getIntegerScalar(prhs, 7);
@@ -896,51 +1103,151 @@ void EnsightMatlab::createSubdivTree(EnsightObj* object, const mxArray* prhs[])
     const int maxDepth = MexTools::getIntegerScalar(prhs, 4);
     const int maxElements = MexTools::getIntegerScalar(prhs, 5);
     const double sizeOffset = MexTools::getDoubleScalar(prhs, 6);
+    const int type = MexTools::getIntegerScalar(prhs, 7);
 
     QStringList partsToExclude;
     bool success = object->createSubdivTree(maxDepth, maxElements,
-                                            partsToExclude, sizeOffset);
+                                            partsToExclude, sizeOffset,
+                                            Ensight::SubdivTreeType(type));
     if (!success)
-        throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
+}
+
+void EnsightMatlab::saveSubdivTree(EnsightObj* object, const mxArray* prhs[])
+{
+    char filename[2048];
+    if (mxGetString(prhs[4], filename, sizeof(filename)))
+        throw std::runtime_error("Second input (filename) should be a string less than 2048 characters long.");
+
+    if (!object->saveSubdivTree(QString(filename)))
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
+}
+
+void EnsightMatlab::loadSubdivTree(EnsightObj* object, const mxArray* prhs[], mxArray* plhs[])
+{
+    char filename[2048];
+    if (mxGetString(prhs[4], filename, sizeof(filename)))
+        throw std::runtime_error("Second input (filename) should be a string less than 2048 characters long.");
+    const int maxDepth = MexTools::getIntegerScalar(prhs, 5);
+    const int maxElements = MexTools::getIntegerScalar(prhs, 6);
+    const double sizeOffset = MexTools::getDoubleScalar(prhs, 7);
+    const int type = MexTools::getIntegerScalar(prhs, 8);
+
+    // A file written for other geometry or parameters is not an error, the
+    // caller creates the tree then
+    QStringList partsToExclude;
+    bool success = object->loadSubdivTree(QString(filename), maxDepth, maxElements,
+                                          partsToExclude, sizeOffset,
+                                          Ensight::SubdivTreeType(type));
+    plhs[0] = mxCreateLogicalScalar(success);
 }
 
 void EnsightMatlab::interpolate(EnsightObj* object, const mxArray* prhs[], mxArray* plhs[])
 {
     char variableName[64];
     mxGetString(prhs[5], variableName, sizeof(variableName));
-    const Vec3 pos = MexTools::getDoubleVector(prhs, 4);
+    const Matx positions = MexTools::getDoubleMatrix(prhs, 4);
+    if (positions.rows() != 3)
+        throw std::runtime_error("Positions must be a 3xN matrix.");
     if (!object->hasVariable(QString(variableName)))
         throw std::runtime_error("Variable does not exist.");
+    const int timestep = MexTools::getIntegerScalar(prhs, 6);
+    requireSubdivTree(object, timestep);
 
-    if (object->getSubdivTree() == 0)
+    // Search SubdivTree for all positions at once
+    QVector<EnsightBarycentricCoordinates> barycoords;
+    QVector<EnsightCellIdentifier*> cells = object->interpolate(positions, barycoords, timestep);
+
+    const int handle = object->getVariableHandle(QString(variableName));
+    const int dim = object->getVariable(QString(variableName)).getDim();
+    Matx result = Matx::Zero(dim, positions.cols());
+    plhs[1] = mxCreateLogicalMatrix(1, positions.cols());
+    mxLogical* ok = mxGetLogicals(plhs[1]);
+    try
     {
-        QStringList partsToExclude;
-        object->createSubdivTree(7, 50, partsToExclude, 0.0);
+        for (int i = 0; i < cells.size(); i++)
+        {
+            if (cells[i] == NULL)
+                continue;
+            result.col(i) = barycoords[i].evaluate(cells[i]->getValues(handle));
+            ok[i] = true;
+        }
     }
-
-    // Search SubdivTree
-    EnsightBarycentricCoordinates barycoords;
-    EnsightCellIdentifier* cell = object->interpolate(pos, barycoords);
-    if (cell == NULL)
+    catch (...)
     {
-        plhs[0] = mxCreateDoubleScalar(0.0);
-        plhs[1] = mxCreateLogicalScalar(false);
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
     }
-    else
+    MexTools::mexAllocateAndCopyMatrix(result, plhs, 0);
+}
+
+void EnsightMatlab::interpolateNearest(EnsightObj* object, const mxArray* prhs[], mxArray* plhs[])
+{
+    char variableName[64];
+    mxGetString(prhs[5], variableName, sizeof(variableName));
+    const Matx positions = MexTools::getDoubleMatrix(prhs, 4);
+    if (positions.rows() != 3)
+        throw std::runtime_error("Positions must be a 3xN matrix.");
+    if (!object->hasVariable(QString(variableName)))
+        throw std::runtime_error("Variable does not exist.");
+    const int timestep = MexTools::getIntegerScalar(prhs, 6);
+    requireSubdivTree(object, timestep);
+
+    // Positions outside of all cells use the closest point of the nearest cell
+    QVector<EnsightBarycentricCoordinates> barycoords;
+    QVector<double> distances;
+    QVector<EnsightCellIdentifier*> cells = object->findNearestCell(positions, barycoords, distances, timestep);
+
+    const int handle = object->getVariableHandle(QString(variableName));
+    const int dim = object->getVariable(QString(variableName)).getDim();
+    Matx result = Matx::Zero(dim, positions.cols());
+    Matx distance(1, positions.cols());
+    try
     {
-        try
+        for (int i = 0; i < cells.size(); i++)
         {
-            const Eigen::MatrixXd values = cell->getValues(QString(variableName));
-            Eigen::VectorXd result = barycoords.evaluate(values);
-
-            MexTools::mexAllocateAndCopyMatrix(result, plhs, 0);
-            plhs[1] = mxCreateLogicalScalar(true);
+            distance(0, i) = distances[i];
+            if (cells[i] != NULL)
+                result.col(i) = barycoords[i].evaluate(cells[i]->getValues(handle));
         }
-        catch (...)
+    }
+    catch (...)
+    {
+        throw std::runtime_error(EnsightObj::errorString().toLatin1().data());
+    }
+    MexTools::mexAllocateAndCopyMatrix(result, plhs, 0);
+    MexTools::mexAllocateAndCopyMatrix(distance, plhs, 1);
+}
+
+void EnsightMatlab::findNearestVertices(EnsightObj* object, const mxArray* prhs[], mxArray* plhs[])
+{
+    const Matx positions = MexTools::getDoubleMatrix(prhs, 4);
+    const int k = MexTools::getIntegerScalar(prhs, 5);
+    if (positions.rows() != 3)
+        throw std::runtime_error("Positions must be a 3xN matrix.");
+    if (k < 1)
+        throw std::runtime_error("The number of vertices must be positive.");
+    const int timestep = MexTools::getIntegerScalar(prhs, 6);
+    const EnsightKdTree* vertexTree = &requireSubdivTree(object, timestep)->getVertexTree();
+
+    QVector<QVector<EnsightKdTree::Neighbor>> neighbors;
+    vertexTree->findNearest(positions, k, neighbors);
+
+    // Convention: Set (-1, -1, Inf) if there are less than k vertices
+    Matx partIds = Matx::Constant(k, positions.cols(), -1);
+    Matx vertices = Matx::Constant(k, positions.cols(), -1);
+    Matx distances = Matx::Constant(k, positions.cols(), std::numeric_limits<double>::infinity());
+    for (int i = 0; i < neighbors.size(); i++)
+    {
+        for (int j = 0; j < neighbors[i].size(); j++)
         {
-            throw std::runtime_error(object->ERROR_STR.toLatin1().data());
+            partIds(j, i) = neighbors[i][j].part->getId();
+            vertices(j, i) = neighbors[i][j].vertex;
+            distances(j, i) = neighbors[i][j].distance;
         }
     }
+    MexTools::mexAllocateAndCopyMatrix(partIds, plhs, 0);
+    MexTools::mexAllocateAndCopyMatrix(vertices, plhs, 1);
+    MexTools::mexAllocateAndCopyMatrix(distances, plhs, 2);
 }
 
 void EnsightMatlab::findCell(EnsightObj* object, const mxArray* prhs[], mxArray* plhs[])
@@ -948,16 +1255,11 @@ void EnsightMatlab::findCell(EnsightObj* object, const mxArray* prhs[], mxArray*
     int optLength = 0;
     bool ok_volume = false, ok_centroid = false;
 
-    if (object->getSubdivTree() == 0)
-    {
-        QStringList partsToExclude;
-        object->createSubdivTree(7, 50, partsToExclude, 0.0);
-    }
-
     // Access parameters
     const Matx lineSegments = MexTools::getDoubleMatrix(prhs, 4);
     char options[64];
     mxGetString(prhs[5], options, sizeof(options));
+    const int timestep = MexTools::getIntegerScalar(prhs, 6);
 
     // Specify further options
     optLength = options[0] - '0';
@@ -969,15 +1271,7 @@ void EnsightMatlab::findCell(EnsightObj* object, const mxArray* prhs[], mxArray*
 
 
     // Get pointer to EnsightSubdivTree
-    EnsightSubdivTree* subdivTree = object->getSubdivTree();
-    if (subdivTree == 0)
-    {
-        mexWarnMsgTxt("SubdivTree has not been created. Attempting to create it.");
-        QStringList partsToExclude;
-        bool success = object->createSubdivTree(7, 50, partsToExclude, 0.0);
-        if (!success)
-            throw std::runtime_error("Could not create SubdivTree.");
-    }
+    EnsightSubdivTree* subdivTree = requireSubdivTree(object, timestep);
 
     EnsightBarycentricCoordinates bary;
     int numberOfPoints = lineSegments.cols();
@@ -32,6 +32,7 @@
 #include "ensightconstant.h"
 #include "ensightvariable.h"
 #include "ensightbarycentriccoordinates.h"
+#include "ensightparallel.h"
 
 #include <Eigen/Dense>
 
@@ -46,6 +47,7 @@
 #include "../../../libs/ensight_lib/include/ensightconstant.h"
 #include "../../../libs/ensight_lib/include/ensightvariable.h"
 #include "../../../libs/ensight_lib/include/ensightbarycentriccoordinates.h"
+#include "../../../libs/ensight_lib/include/ensightparallel.h"
 #include <QString>
 
 #include "/m/soft/Mathworks/matlab/R2015b/extern/include/mex.h"
@@ -68,6 +70,7 @@ EnsightPart* getEnsightPart   ( EnsightObj* object, const mxArray* prhs[] );
 void createEnsight ( mxArray* plhs[] );
 void deleteEnsight ( const mxArray* prhs[] );
 void readEnsight   ( const mxArray* prhs[], mxArray* plhs[] );
+void setNumThreads ( const mxArray* prhs[] );
 
 /* EnsightObject class methods */
 void writeEnsight            ( EnsightObj* object, const mxArray* prhs[] );
@@ -101,9 +104,16 @@ void getCellListOfPart       ( EnsightPart* part, const mxArray* prhs[], mxArray
 
 /* Interpolation and search method */
 void createSubdivTree    ( EnsightObj* object, const mxArray* prhs[]);
+void saveSubdivTree      ( EnsightObj* object, const mxArray* prhs[]);
+void loadSubdivTree      ( EnsightObj* object, const mxArray* prhs[], mxArray* plhs[] );
 void interpolate         ( EnsightObj* object, const mxArray* prhs[], mxArray* plhs[] );
+void interpolateNearest  ( EnsightObj* object, const mxArray* prhs[], mxArray* plhs[] );
 void findCell            ( EnsightObj* object, const mxArray* prhs[], mxArray* plhs[] );
+void findNearestVertices ( EnsightObj* object, const mxArray* prhs[], mxArray* plhs[] );
 void getSubdivTreeBounds ( EnsightObj* object, mxArray* plhs[] );
+
+/* Memory usage */
+void getMemoryUsage      ( EnsightObj* object, mxArray* plhs[] );
 }
 
 namespace MexTools
@@ -135,6 +145,11 @@ void checkInputParam ( const mxArray* prhs[], int nrhs, int nlhs );
 const Mati getIntegerMatrix ( const mxArray* prhs[], int slot );
 const Matx getDoubleMatrix  ( const mxArray* prhs[], int slot );
 const Vecx getDoubleVector  ( const mxArray* prhs[], int slot );
+
+// Buffer of a real double (int32) matrix, sharing its data if compiled with
+// ENSIGHT_MEX_SHARED_DATA and copying it otherwise; other classes are converted
+MatxBuffer getDoubleBuffer  ( const mxArray* prhs[], int slot );
+MatiBuffer getIntegerBuffer ( const mxArray* prhs[], int slot );
 const Veci getIntegerVector ( const mxArray* prhs[], int slot );
 const double getDoubleScalar( const mxArray* prhs[], int slot );
 const int  getIntegerScalar ( const mxArray* prhs[], int slot );
@@ -5,7 +5,12 @@
 %
 % Make sure to run SETUP before you call this function for the first time.
 %
-function runmex()
+% runmex(true) lets vertex, cell and variable arrays share their data with
+% MATLAB instead of copying it. This uses the undocumented function
+% mxCreateSharedDataCopy, which may be missing in some MATLAB releases; the
+% MEX file then fails to load and should be compiled with runmex() again.
+%
+function runmex(shareArrays)
     if exist('EnsightLib_interface.mexa64','file')==3 && mislocked('EnsightLib_interface')==1
         error('EnsightLib_interface is still locked. Use "munlock()" before re-compiling');
     end
@@ -18,6 +23,9 @@ function runmex()
              'ENSIGHT_LIB_PATH','-mat');
          
         OPTS = '-DMEX_INCLUDE -cxx -compatibleArrayDims -v ';
+        if nargin > 0 && shareArrays
+            OPTS = [OPTS '-DENSIGHT_MEX_SHARED_DATA '];
+        end
         mex_str = ['mex ',OPTS,...
                    'CXXFLAGS="\$CXXFLAGS -std=c++11"', ...
                    ' -I',QT_INCLUDE_PATH,' -I',QT_INCLUDE_PATH,'/QtCore',...
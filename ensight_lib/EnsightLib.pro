@@ -40,6 +40,9 @@ unix {
 win32{
     CONFIG   += shared static
     #CONFIG  += dll
+
+    # GetProcessMemoryInfo() for EnsightMemoryReport
+    LIBS += -lpsapi
 }
 
 DESTDIR = lib
@@ -66,7 +69,18 @@ SOURCES += \
     src/ensightconstant.cpp \
     src/ensightdef.cpp \
     src/ensightbarycentriccoordinates.cpp \
-    src/ensightsubdivtreeimpl.cpp
+    src/ensightsubdivtreeimpl.cpp \
+    src/ensightbvh.cpp \
+    src/ensightcellrecords.cpp \
+    src/ensightleafbounds.cpp \
+    src/ensightkdtree.cpp \
+    src/ensightbuffer.cpp \
+    src/ensightparallel.cpp \
+    src/ensightincidence.cpp \
+    src/ensightfaceconnectivity.cpp \
+    src/ensightmeshview.cpp \
+    src/ensightbufferstore.cpp \
+    src/ensightmemoryreport.cpp
 
 HEADERS += \
     include/ensightlib.h \
@@ -86,4 +100,16 @@ HEADERS += \
     include/ensightbarycentriccoordinates.h \
     include/eigentypes.h \
     include/ensightsubdivtree.h \
-    include/ensightsubdivtreeimpl.h
+    include/ensightsubdivtreeimpl.h \
+    include/ensightbvh.h \
+    include/ensightcellrecords.h \
+    include/ensightleafbounds.h \
+    include/ensightkdtree.h \
+    include/ensightbuffer.h \
+    include/ensightparallel.h \
+    include/ensightlazy.h \
+    include/ensightincidence.h \
+    include/ensightfaceconnectivity.h \
+    include/ensightmeshview.h \
+    include/ensightbufferstore.h \
+    include/ensightmemoryreport.h
@@ -290,7 +290,7 @@ void GLWidget::drawBounds(const Vec3 &mi, const Vec3 &ma)
     glEnd();
 }
 
-void GLWidget::drawPointCloud(const Matx &points)
+void GLWidget::drawPointCloud(const MatxView& points)
 {
     glBegin(GL_POINTS);
     for(int i=0;i<points.cols();i++)
@@ -298,7 +298,7 @@ void GLWidget::drawPointCloud(const Matx &points)
     glEnd();
 }
 
-void GLWidget::drawCells(const Matx &points, const Mati &cells)
+void GLWidget::drawCells(const MatxView& points, const MatiView& cells)
 {
     if(cells.rows()==2)
         glBegin(GL_LINES);
@@ -317,7 +317,7 @@ void GLWidget::drawCells(const Matx &points, const Mati &cells)
 }
 
 
-void GLWidget::drawCells(const Matx & points, const Mati & cells, const Vecx & var, double min, double max)
+void GLWidget::drawCells(const MatxView& points, const MatiView& cells, const Vecx & var, double min, double max)
 {
     if(cells.rows()==2)
         glBegin(GL_LINES);
@@ -182,7 +182,7 @@ public:
      * @brief drawPointCloud  Draw a list of 3d points
      * @param points a 3xN matrix containing N 3d vertices
      */
-    void drawPointCloud(const Matx & points);
+    void drawPointCloud(const MatxView& points);
 
 
 
@@ -191,10 +191,10 @@ public:
      * @param points 3xN matrix containing N 3d vertices
      * @param cells (2/3/4)xM matrix containing M cells, either bar2 tria3 or quad4
      */
-    void drawCells(const Matx & points, const Mati & cells);
+    void drawCells(const MatxView& points, const MatiView& cells);
 
 
-    void drawCells(const Matx & points, const Mati & cells, const Vecx &var, double min,
+    void drawCells(const MatxView& points, const MatiView& cells, const Vecx &var, double min,
                    double max);
 
     /**
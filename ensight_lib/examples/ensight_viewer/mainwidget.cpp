@@ -87,7 +87,7 @@ void MainWidget::loadEnsightFile(const QString& filename, int timeStep)
 
     if (!ensight)
     {
-        QMessageBox::critical(this, "Error", EnsightObj::ERROR_STR);
+        QMessageBox::critical(this, "Error", EnsightObj::errorString());
         return;
     }
 
@@ -388,39 +388,22 @@ void MainWidget::draw()
         auto tree = ensight->getSubdivTree();
         auto octree = dynamic_cast<const EnsightOctree*>(tree);
         auto quadtree = dynamic_cast<const EnsightQuadtree*>(tree);
+        auto bvh = dynamic_cast<const EnsightBvh*>(tree);
         if (octree)
-            drawOctree(octree->getRoot());
+            drawTree(octree->getLeafBounds());
         else if (quadtree)
-            drawQuadtree(quadtree->getRoot());
+            drawTree(quadtree->getLeafBounds());
+        else if (bvh)
+            drawTree(bvh->getLeafBounds());
     }
 }
 
-template <typename N>
-void drawTree(Viewer* viewer, const N& node)
+void MainWidget::drawTree(const QVector<Bbox>& leafBounds)
 {
-    const auto& children = node.getChildren();
-    if (!children)
-    {
-        glLineWidth(1);
-        glColor3d(0, 0, 1);
-        viewer->gl->drawBounds(node.getBounds().minCorner(),
-                               node.getBounds().maxCorner());
-    }
-    else
-    {
-        for (const auto& child : *children)
-            drawTree(viewer, child);
-    }
-}
-
-void MainWidget::drawOctree(const OctreeNode& node)
-{
-    drawTree(viewer.get(), node);
-}
-
-void MainWidget::drawQuadtree(const QuadtreeNode& node)
-{
-    drawTree(viewer.get(), node);
+    glLineWidth(1);
+    glColor3d(0, 0, 1);
+    for (const Bbox& bounds : leafBounds)
+        viewer->gl->drawBounds(bounds.minCorner(), bounds.maxCorner());
 }
 
 void MainWidget::key(int k)
@@ -492,7 +475,7 @@ int MainWidget::selectTimeStep(const QString& fileName, bool& cancel)
     EnsightCase caseFile(fileName);
     if (!caseFile.readCaseFile())
     {
-        QMessageBox::critical(this, "Error", EnsightObj::ERROR_STR);
+        QMessageBox::critical(this, "Error", EnsightObj::errorString());
         cancel = true;
         return -1;
     }
@@ -30,6 +30,7 @@
 #include <QMessageBox>
 #include <QStringList>
 #include <QTime>
+#include "ensightbvh.h"
 #include "ensightobj.h"
 #include "ensightsubdivtreeimpl.h"
 #include "viewer.h"
@@ -53,8 +54,7 @@ private:
     void fillTable();
     void closeEvent(QCloseEvent*) override;
 
-    void drawOctree(const OctreeNode& node);
-    void drawQuadtree(const QuadtreeNode& node);
+    void drawTree(const QVector<Bbox>& leafBounds);
 
     int selectTimeStep(const QString& fileName, bool& cancel);
     void openFile(bool singleTimeStep);
@@ -67,6 +67,12 @@ public:
      */
     bool intersects(const Bbox& other) const;
 
+    /**
+     * @brief Returns the squared distance of a point to the Bbox, 0 if the
+     * point is inside
+     */
+    double squaredDistance(const Vec3& pos) const;
+
     /**
      * @brief Returns the center of the Bbox = (min + max)/2
      */
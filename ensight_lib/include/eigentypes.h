@@ -42,5 +42,9 @@ using Vec2 = Eigen::Vector2d;
 using Vec2i = Eigen::Vector2i;
 using Vec3i = Eigen::Vector3i;
 
+// Read-only views onto matrix data that may be owned by someone else.
+using MatxView = Eigen::Map<const Matx>;
+using MatiView = Eigen::Map<const Mati>;
+
 
 #endif // EIGENTYPES_H
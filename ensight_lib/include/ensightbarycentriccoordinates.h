@@ -65,6 +65,28 @@ public:
     bool compute(const Vec3& pos, const EnsightCellIdentifier* cell,
                  bool ignore2dCells = true);
 
+    /**
+     * @brief Sets coordinates computed elsewhere, e.g. the weights of the
+     * point of a cell closest to a position. The object is valid afterwards.
+     * @param[in] coords Barycentric coordinates, one per vertex of the cell
+     * @param[in] pos Position interpolated by the coordinates
+     * @param[in] cell Cell Identifier
+     */
+    void set(const Vecx& coords, const Vec3& pos, const EnsightCellIdentifier* cell);
+
+    /**
+     * @brief Replaces the cell identifier by another identifier of the same
+     * cell, e.g. a persistent one for a temporary identifier passed to
+     * compute(). The coordinates are kept.
+     * @param[in] cell Cell Identifier
+     */
+    void setCell(const EnsightCellIdentifier* cell);
+
+    /**
+     * @brief Resets to an invalid object which does not refer to any cell.
+     */
+    void reset();
+
 
     /**
      * @brief Checks if object is a valid barycentric coordinate.
@@ -80,13 +102,21 @@ public:
     Vecx evaluate(const QString& name) const;
     Vecx evaluate(const std::string& name) const;
 
+    /**
+     * @brief Barycentric interpolation of data
+     * @param[in] handle Variable handle, see EnsightObj::getVariableHandle()
+     * @return Vector of length m interpolating the data
+     */
+    Vecx evaluate(int handle) const;
+
 
     /**
      * @brief Barycentric interpolation of data
-     * @param data Mxn matrix where n is equal to the number of vertices of the part corresponding to the cell_
+     * @param data Mxn matrix where n is equal to the number of vertices of the part corresponding to the cell_.
+     * Accepts a Matx as well as a view returned by EnsightCellIdentifier::getValues() without copying.
      * @return Vector of length m interpolating the data
      */
-    Vecx evaluate(const Matx& data) const;
+    Vecx evaluate(const Eigen::Ref<const Matx>& data) const;
 
 
     /**
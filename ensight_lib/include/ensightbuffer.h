@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef ENSIGHTBUFFER_H
+#define ENSIGHTBUFFER_H
+
+#include <memory>
+
+#include "eigentypes.h"
+
+/**
+ * @brief The EnsightBuffer class holds the data of a column-major matrix which
+ * is either owned by the library or adopted from the caller without copying.
+ *
+ * Copies of a buffer share the same immutable data. The data is released when
+ * the last buffer referring to it is destroyed, either by deleting the matrix
+ * handed over to the buffer or by calling the deleter of an adopted shared_ptr.
+ *
+ * Buffers are implicitly constructible from matrices, so existing code passing
+ * a Matx or Mati keeps working. Passing an rvalue matrix moves its storage into
+ * the buffer instead of copying it.
+ */
+template <typename Scalar>
+class EnsightBuffer
+{
+public:
+    using Matrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+    using View = Eigen::Map<const Matrix>;
+
+    /**
+     * @brief Creates an empty 0x0 buffer.
+     */
+    EnsightBuffer();
+
+    /**
+     * @brief Creates a buffer holding a copy of the given matrix.
+     */
+    EnsightBuffer(const Matrix& values);
+
+    /**
+     * @brief Creates a buffer taking over the storage of the given matrix.
+     */
+    EnsightBuffer(Matrix&& values);
+
+    /**
+     * @brief Adopts externally owned column-major data without copying.
+     *
+     * The data must stay valid and unmodified as long as any buffer refers to
+     * it. Use the deleter of the shared_ptr to get notified when the library
+     * releases the data.
+     * @param[in] data Pointer to rows*cols values in column-major order
+     * @param[in] rows Number of rows
+     * @param[in] cols Number of columns
+     */
+    EnsightBuffer(std::shared_ptr<const Scalar> data, Eigen::Index rows, Eigen::Index cols);
+
+    /**
+     * @brief Wraps externally owned data without taking ownership.
+     *
+     * The caller is responsible for keeping the data alive as long as the
+     * library uses it, e.g. until the owning EnsightObj is destroyed.
+     */
+    static EnsightBuffer wrap(const Scalar* data, Eigen::Index rows, Eigen::Index cols);
+
+    /**
+     * @brief Get a read-only view onto the data.
+     */
+    View view() const;
+
+    const Scalar* data() const;
+    Eigen::Index rows() const;
+    Eigen::Index cols() const;
+    bool isEmpty() const;
+
+    /**
+     * @brief Checks if the data was allocated by the library, i.e. the buffer was
+     * created from a matrix. Adopted and wrapped data is owned by the caller.
+     */
+    bool isOwned() const;
+
+    /**
+     * @brief Checks if both buffers refer to the same memory.
+     */
+    bool sharesDataWith(const EnsightBuffer& other) const;
+
+    /**
+     * @brief Get the shared pointer owning the data.
+     */
+    const std::shared_ptr<const Scalar>& sharedData() const;
+
+    /**
+     * @brief Get a buffer of the same size and ownership referring to other data.
+     *
+     * Used by EnsightBufferStore to replace owned data by identical shared data.
+     * @param[in] data Pointer to rows()*cols() values identical to those of this buffer
+     */
+    EnsightBuffer withSharedData(std::shared_ptr<const Scalar> data) const;
+
+private:
+    std::shared_ptr<const Scalar> data_;
+    Eigen::Index rows_;
+    Eigen::Index cols_;
+    bool owned_;
+};
+
+using MatxBuffer = EnsightBuffer<double>;
+using MatiBuffer = EnsightBuffer<int>;
+
+#endif // ENSIGHTBUFFER_H
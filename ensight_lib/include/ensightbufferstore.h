@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#ifndef ENSIGHTBUFFERSTORE_H
+#define ENSIGHTBUFFERSTORE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "ensightbuffer.h"
+
+/**
+ * @brief The EnsightBufferStore class deduplicates buffers by their content.
+ *
+ * intern() hashes the data of a buffer and returns an earlier interned buffer
+ * with identical size and content if one is still alive, so both refer to the
+ * same memory. Only data owned by the library is interned, see
+ * EnsightBuffer::isOwned(); adopted and wrapped buffers are returned unchanged,
+ * so they stay zero-copy and are never shared with other buffers. Buffers are immutable, setting new values replaces a buffer
+ * instead of modifying the shared data, i.e. sharing is copy-on-write.
+ *
+ * The store only keeps weak references, it does not extend the lifetime of
+ * any data. All parts of an EnsightObj share one store, so identical vertices,
+ * cells and variables are stored once across timesteps and parts.
+ * It counts the bytes of the interned blocks that are alive, and the peak of it.
+ * The methods are thread-safe.
+ */
+class EnsightBufferStore
+{
+public:
+    EnsightBufferStore();
+
+    /**
+     * @brief Get a buffer with the same content, sharing the data of an equal buffer if possible.
+     * @param[in] buffer Buffer to deduplicate
+     */
+    MatxBuffer intern(const MatxBuffer& buffer);
+    MatiBuffer intern(const MatiBuffer& buffer);
+
+    /**
+     * @brief Hashes a block of memory word by word, as used to find equal buffers.
+     *
+     * Large blocks are split into chunks which are hashed in parallel.
+     */
+    static uint64_t hashBytes(const void* data, size_t size);
+
+    /**
+     * @brief Get the bytes of all interned blocks still alive.
+     */
+    int64_t getBytes() const;
+
+    /**
+     * @brief Get the highest value getBytes() had so far.
+     */
+    int64_t getPeakBytes() const;
+
+private:
+    template <typename Scalar>
+    EnsightBuffer<Scalar> internImpl(const EnsightBuffer<Scalar>& buffer, int typeId);
+
+    /**
+     * @brief A weak reference to an interned block of data.
+     */
+    struct Entry
+    {
+        std::weak_ptr<const void> data;
+        int typeId;
+        Eigen::Index rows;
+        Eigen::Index cols;
+    };
+
+    /**
+     * @brief Bytes of the live blocks. Shared with the deleters of the blocks,
+     * which may outlive the store.
+     */
+    struct Usage
+    {
+        std::atomic<int64_t> bytes{0};
+        std::atomic<int64_t> peakBytes{0};
+    };
+
+    /**
+     * @brief usage Bytes of the interned blocks
+     */
+    std::shared_ptr<Usage> usage_;
+
+    /**
+     * @brief entries Interned blocks by the hash of their content
+     */
+    std::unordered_multimap<uint64_t, Entry> entries_;
+
+    /**
+     * @brief purgeSize Number of entries at which expired entries are removed next
+     */
+    size_t purgeSize_;
+
+    std::mutex mutex_;
+};
+
+#endif // ENSIGHTBUFFERSTORE_H
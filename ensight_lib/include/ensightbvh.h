@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef ENSIGHTBVH_H
+#define ENSIGHTBVH_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <QList>
+#include <QVector>
+
+#include "bbox.h"
+#include "ensightcellrecords.h"
+#include "ensightlazy.h"
+#include "ensightleafbounds.h"
+#include "ensightsubdivtree.h"
+
+class EnsightCellIdentifier;
+class EnsightBarycentricCoordinates;
+class EnsightPart;
+
+
+/**
+ * @brief The EnsightBvh class implements EnsightSubdivTree as a bounding
+ * volume hierarchy over the cell bounding boxes.
+ *
+ * In contrast to EnsightOctree, every cell is stored in exactly one leaf, so
+ * strongly graded meshes do not lead to duplicated cell indices and deep
+ * trees. The hierarchy is a binary tree built with a binned surface area
+ * heuristic. The nodes are stored in one array in depth-first order: the left
+ * child of a node directly follows it, the right child is referenced by index.
+ * The cell indices are reordered so that each leaf refers to a contiguous
+ * range, the quantized cell bounding boxes are stored in the same order.
+ *
+ * insert() only collects the cells, the hierarchy is built by build() or on
+ * the first query after an insert. refit() keeps the nodes and cell order of
+ * another hierarchy and only recomputes the bounds.
+ */
+class EnsightBvh : public EnsightSubdivTree
+{
+public:
+    /**
+     * @brief Creates an empty hierarchy.
+     * @param bounds The bounds of the cells to insert
+     * @param maxCells Maximum number of cells per leaf
+     * @param ignore2dCells Ignore triangles and quadrangles in search(), as
+     * EnsightOctree does for 3D data sets
+     */
+    EnsightBvh(Bbox bounds, int maxCells, bool ignore2dCells);
+    ~EnsightBvh();
+
+    using EnsightSubdivTree::search;
+    /**
+     * @brief Find the cell containing a given spatial position. If the
+     * position is on a face shared by several cells, any of them is returned.
+     */
+    EnsightCellIdentifier* search(const Vec3& pos,
+                                  EnsightBarycentricCoordinates& baryCoordOut) const override;
+
+    QList<EnsightCellIdentifier*> searchAll(const Vec3& pos) const override;
+
+    void insert(EnsightPart* part, int timestep, double sizeOffset = 0.0) override;
+    void build() override;
+    bool refit(const EnsightSubdivTree& base) override;
+    std::shared_ptr<EnsightSubdivTree> share(int timestep) const override;
+    bool write(std::ostream& out) const override;
+    bool read(std::istream& in) override;
+
+    Bbox getBounds() const override;
+    void addMemoryUsage(EnsightMemoryReport& report) const override;
+
+    /**
+     * @brief Get the number of nodes, including inner nodes.
+     */
+    int getNumberOfNodes() const;
+    /**
+     * @brief Get the bounds of all leaves, e.g. to display the hierarchy.
+     */
+    QVector<Bbox> getLeafBounds() const;
+
+private:
+    using Index = EnsightCellRecords::Index;
+
+    static const Index InnerNode = std::numeric_limits<Index>::max();
+    static const int MaxDepth = 64;
+
+    /**
+     * @brief A node of the hierarchy. Inner nodes store the index of their
+     * right child and count == InnerNode, leaves store the range
+     * [first, first+count) in Layout::cells.
+     */
+    struct BvhNode
+    {
+        Bbox bounds;
+        Index first;
+        Index count;
+    };
+
+    struct Layout
+    {
+        std::vector<BvhNode> nodes;
+        std::vector<Index> cells;
+        EnsightLeafBounds leafBounds;
+    };
+
+    void findNearestCell(const Vec3& pos, double& minDistance, Index& nearest) const override;
+
+    const Layout& getLayout() const;
+    Layout buildLayout() const;
+    Layout refitLayout(const Layout& base) const;
+    void quantizeLeafBounds(Layout& layout) const;
+
+    Bbox bounds_;
+    EnsightLazy<Layout> layout_;
+    int maxCells_;
+};
+
+#endif // ENSIGHTBVH_H
@@ -24,15 +24,18 @@
 #ifndef ENSIGHTCELL_H
 #define ENSIGHTCELL_H
 
+#include <cstdint>
 #include <iosfwd>
+#include <memory>
 #include <string>
 
-#include <QPair>
 #include <QString>
 
 #include "bbox.h"
 #include "eigentypes.h"
+#include "ensightbuffer.h"
 #include "ensightdef.h"
+#include "ensightlazy.h"
 
 
 // Forward declarations
@@ -50,17 +53,18 @@ public:
     /**
      * @brief Creates an EnsightCellList based on the given parameters.
      *
-     * This method will also create a matrix which contains the cell neighbor indices for each cell.
-     * Additionally, there will be a matrix which contains all boundary faces.
+     * The cell neighbor indices, boundary faces and boundary vertices are computed
+     * on first access by getNeighbors(), getBoundary() or getBoundaryVertices().
      *
      * For additional information on Cell Types have a look at Ensight::Cell.
      *
      * @param[in] type Cell type
-     * @param[in] values MxN matrix, with N cells each consisting of M vertices
+     * @param[in] values MxN matrix, with N cells each consisting of M vertices.
+     * The data is shared, not copied.
      * @param[in] partName Parent part name
      */
-    EnsightCellList(Ensight::Cell type, const Mati& values, const QString& partName);
-    EnsightCellList(Ensight::Cell type, const Mati& values, const std::string& partName);
+    EnsightCellList(Ensight::Cell type, const MatiBuffer& values, const QString& partName);
+    EnsightCellList(Ensight::Cell type, const MatiBuffer& values, const std::string& partName);
 
     /**
      * @brief Get cell type of the elements in the CellList.
@@ -70,7 +74,7 @@ public:
     /**
      * @brief Get the matrix which contains all cell vertices.
      */
-    const Mati& getValues() const;
+    MatiView getValues() const;
 
     /**
      * @brief Get the matrix representing neighborhood information between the cells.
@@ -86,6 +90,9 @@ public:
      *
      * It returns a 2xK matrix where K is the number of boundary faces of the boundary cells.
      * In each column, the first entry stores the cell index, the second one stores the boundary face of this cell.
+     *
+     * Only the cells of this list are considered, faces shared with cells of another type
+     * are boundary faces here. Use EnsightPart::getFaceConnectivity() for the boundary of a part.
      */
     const Mati& getBoundary() const;
 
@@ -95,14 +102,46 @@ public:
     const QString& getPartName() const;
 
     /**
-     * @brief Get a 1xL matrix with L indices to boundary vertices.
+     * @brief Get a 1xL matrix with L indices to boundary vertices in ascending order.
      */
     const Mati& getBoundaryVertices() const;
 
+    /**
+     * @brief Uses the neighbors and boundary of another cell list.
+     *
+     * This succeeds if both lists have the same cell type and identical cell vertices,
+     * e.g. the same cells at different timesteps. The topology is then computed at
+     * most once for both lists. Unless both lists share their data, the cached
+     * content hashes are compared before the cell vertices.
+     * @param[in] other Cell list to share the topology with
+     * @return true if the topology is shared
+     */
+    bool shareTopology(const EnsightCellList& other);
+
+    /**
+     * @brief Checks if neighbors, boundary faces and boundary vertices have already been computed.
+     */
+    bool isTopologyComputed() const;
+
 private:
-    bool doFacesMatch(const QPair<int, int>& oldFace, const QPair<int, int>& newFace);
+    struct Topology;
+
+    /**
+     * @brief Get the topology, computing it on the first call.
+     *
+     * Thread-safe, concurrent first calls compute the topology only once.
+     */
+    const Topology& getTopology() const;
+
+    /**
+     * @brief Computes neighbors, boundary faces and boundary vertices, see EnsightFaceConnectivity.
+     */
+    void computeTopology(Topology& topology) const;
 
-    int getFaceHash(const Ensight::Cell& type, const QPair<int, int>& face);
+    /**
+     * @brief Get the hash of the cell vertices, computing it on the first call.
+     */
+    uint64_t getValuesHash() const;
 
 public:
     Matx normals;
@@ -122,28 +161,18 @@ private:
     /**
      * @brief values  All cells in this list, represented as MxN matrix, with N cells each consisting of M vertices
      */
-    Mati values_;
-
-    /**
-     * @brief Matrix representing neighborhood information between the cells. For N cells this is
-     * a MxN matrix, where M is the number of faces per cell.
-     * In neighbors(i,j) an index is stored that references the cell which is neighbor face i of cell j or -1 if
-     * this is a boundary cell
-     */
-    Mati neighbors_;
+    MatiBuffer values_;
 
     /**
-     * @brief This is a 2xK matrix where K is the number of boundary faces of these cells.
-     * Each column stores first the index of the boundary cell and then the index of the boundary face of this cell
+     * @brief topology_ Lazily computed neighbors, boundary faces and boundary vertices,
+     * possibly shared with cell lists of other timesteps
      */
-    Mati boundary_;
-
+    std::shared_ptr<Topology> topology_;
 
     /**
-     * @brief 1xL matrix with L indices to boundary vertices.
+     * @brief valuesHash_ Lazily computed hash of values_, see EnsightBufferStore::hashBytes()
      */
-    Mati boundaryVertices_;
-
+    EnsightLazy<uint64_t> valuesHash_;
 };
 
 
@@ -178,8 +207,13 @@ public:
      * @brief Get the part values of a variable.
      * @param name Variable name
      */
-    const Matx& getValues(const QString& name) const;
-    const Matx& getValues(const std::string& name) const;
+    MatxView getValues(const QString& name) const;
+    MatxView getValues(const std::string& name) const;
+    /**
+     * @brief Get the part values of a variable by its handle.
+     * @param handle Variable handle, see EnsightObj::getVariableHandle()
+     */
+    MatxView getValues(int handle) const;
 
     /**
      * @brief Get the cell type.
@@ -200,6 +234,11 @@ public:
      */
     int getIndex() const;
 
+    /**
+     * @brief Get the timestep whose vertices and variables the cell refers to.
+     */
+    int getTimestep() const;
+
     /**
      * @brief Print representation to given stream
      */
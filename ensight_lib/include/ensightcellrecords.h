@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef ENSIGHTCELLRECORDS_H
+#define ENSIGHTCELLRECORDS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bbox.h"
+
+class EnsightBarycentricCoordinates;
+class EnsightCellIdentifier;
+class EnsightCellList;
+class EnsightPart;
+
+
+/**
+ * @brief The EnsightCellRecords class stores the cells of a subdivision tree
+ * in a compact struct-of-arrays layout.
+ *
+ * Each cell is referenced by its index in the order of insertion. Only the
+ * bounding boxes are stored per cell, the part, cell list and cell list index
+ * are derived from the range of cells appended for each cell list. The
+ * bounding boxes are stored in single precision, rounded outwards, so they
+ * still contain the cell. The exact containment test is done on the cell.
+ * Records of another timestep with the same geometry share the bounding boxes,
+ * see share().
+ * EnsightCellIdentifier objects are created on demand for cells returned by
+ * a query and are owned by the records.
+ */
+class EnsightCellRecords
+{
+public:
+    using Index = uint32_t;
+
+    EnsightCellRecords();
+    ~EnsightCellRecords();
+
+    EnsightCellRecords(const EnsightCellRecords&) = delete;
+    EnsightCellRecords& operator=(const EnsightCellRecords&) = delete;
+
+    /**
+     * @brief Appends all cells of a part. The bounding boxes are computed in
+     * parallel and increased by sizeOffset.
+     */
+    void append(EnsightPart* part, int timestep, double sizeOffset = 0.0);
+    /**
+     * @brief Makes these empty records hold the cells of other at another
+     * timestep of their parts, which must have the same vertices and cells.
+     * The bounding boxes are shared, the identifiers are created separately
+     * and refer to timestep.
+     */
+    void share(const EnsightCellRecords& other, int timestep);
+
+    /**
+     * @brief Get the number of cells.
+     */
+    Index size() const;
+
+    /**
+     * @brief Checks if the bounding box of a cell contains a position, see
+     * Bbox::contains.
+     */
+    bool boundsContain(Index cell, const Vec3& pos) const;
+    /**
+     * @brief Checks if the bounding box of a cell intersects bounds, see
+     * Bbox::intersects.
+     */
+    bool boundsIntersect(Index cell, const Bbox& bounds) const;
+    /**
+     * @brief Get the squared distance of a position to the bounding box of a
+     * cell, see Bbox::squaredDistance.
+     */
+    double boundsSquaredDistance(Index cell, const Vec3& pos) const;
+    /**
+     * @brief Get the bounding box of a cell, which may be slightly larger than
+     * the box of its vertices, see the class description.
+     */
+    Bbox getBounds(Index cell) const;
+    /**
+     * @brief Get the minimum or maximum coordinate d of the bounding boxes of
+     * all cells.
+     */
+    const float* getMinCoordinates(int d) const;
+    const float* getMaxCoordinates(int d) const;
+
+    /**
+     * @brief Checks if a cell contains a position, see
+     * EnsightCellIdentifier::contains. The identifier of the cell is only
+     * created if it contains the position, baryCoordOut then refers to it.
+     * Otherwise baryCoordOut is invalid and does not refer to any cell.
+     */
+    bool contains(Index cell, const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut,
+                  bool ignore2dCells) const;
+    /**
+     * @brief Checks if a cell is a triangle or quadrangle, which contains()
+     * ignores for 3D data sets.
+     */
+    bool is2dCell(Index cell) const;
+
+    /**
+     * @brief Get the identifier of a cell, created on the first call. This is
+     * thread-safe, the identifier is valid as long as the records exist.
+     */
+    EnsightCellIdentifier* getIdentifier(Index cell) const;
+    /**
+     * @brief Finds the cell of an identifier.
+     * @param[in] identifier An identifier, e.g. returned by getIdentifier()
+     * @param[out] cell The index of the cell
+     * @return false if the cell is not contained in the records
+     */
+    bool find(const EnsightCellIdentifier* identifier, Index& cell) const;
+    /**
+     * @brief Finds a cell of a part.
+     * @param[in] part The part
+     * @param[in] listIndex The index of the cell list in EnsightPart::getCells()
+     * at the timestep the part was appended with
+     * @param[in] index The index of the cell in its cell list
+     * @param[out] cell The index of the cell
+     * @return false if the cell is not contained in the records
+     */
+    bool find(const EnsightPart* part, int listIndex, int index, Index& cell) const;
+
+    /**
+     * @brief Computes the point of a cell closest to a position.
+     *
+     * The closest point is searched on the cell itself for points, bars,
+     * triangles and quadrangles and on the faces of volume cells, quadrangles
+     * are split into two triangles. baryCoordOut refers to the identifier of
+     * the cell and interpolates the closest point, the weights are those of
+     * the triangle or bar containing it.
+     * @return The distance of pos to the closest point
+     */
+    double project(Index cell, const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut) const;
+    /**
+     * @brief Get the distance of a position to a cell, see project(). The
+     * identifier of the cell is not created.
+     */
+    double getDistance(Index cell, const Vec3& pos) const;
+
+    /**
+     * @brief Finds the face neighbor of a cell in the direction of a position.
+     *
+     * The face is the one whose plane pos lies farthest outside of, the
+     * neighbor may belong to another cell list of the same part, see
+     * EnsightPart::getFaceConnectivity().
+     * @param[in] cell The index of the cell
+     * @param[in] pos The position
+     * @param[out] neighbor The index of the neighbor
+     * @return false if pos is inside of all face planes or the face is on the
+     * boundary of the part
+     */
+    bool findNeighborTowards(Index cell, const Vec3& pos, Index& neighbor) const;
+
+    /**
+     * @brief Get the bytes used by the cell records.
+     */
+    int64_t getRecordBytes() const;
+    /**
+     * @brief Get the bytes used by the identifiers created so far.
+     */
+    int64_t getIdentifierBytes() const;
+
+private:
+    static const int BlockBits = 10;
+    static const Index BlockSize = 1 << BlockBits;
+
+    /**
+     * @brief A range of cells [first, first + count of cellList) appended for
+     * one cell list.
+     */
+    struct CellListRange
+    {
+        Index first;
+        EnsightPart* part;
+        EnsightCellList* cellList;
+        int timestep;
+        int listIndex;  // index of cellList in EnsightPart::getCells(timestep)
+    };
+
+    /**
+     * @brief The identifiers of BlockSize consecutive cells, allocated when
+     * the first of them is requested.
+     */
+    struct IdentifierBlock
+    {
+        IdentifierBlock();
+        ~IdentifierBlock();
+        std::atomic<EnsightCellIdentifier*> cells[BlockSize];
+    };
+
+    /**
+     * @brief The bounding boxes of all cells, shared by the records of
+     * timesteps with the same geometry.
+     */
+    struct Bounds
+    {
+        std::array<std::vector<float>, 3> min;
+        std::array<std::vector<float>, 3> max;
+    };
+
+    const CellListRange& findRange(Index cell) const;
+    /**
+     * @brief Grows the table of identifier blocks to numCells cells, keeping
+     * the existing blocks.
+     */
+    void reserveIdentifiers(size_t numCells);
+    /**
+     * @brief Computes the closest point of a cell, see project().
+     * @param[out] weights The weights of the cell vertices interpolating it
+     * @return The squared distance of pos to the closest point
+     */
+    double computeClosestPoint(Index cell, const Vec3& pos, Vecx& weights, Vec3& closest) const;
+
+    std::shared_ptr<Bounds> bounds_;
+    std::vector<CellListRange> ranges_;
+
+    std::unique_ptr<std::atomic<IdentifierBlock*>[]> blocks_;
+    size_t numBlocks_;
+};
+
+
+// **** inline functions ****
+inline EnsightCellRecords::Index EnsightCellRecords::size() const
+{
+    return static_cast<Index>(bounds_->min[0].size());
+}
+
+inline const float* EnsightCellRecords::getMinCoordinates(int d) const
+{
+    return bounds_->min[d].data();
+}
+
+inline const float* EnsightCellRecords::getMaxCoordinates(int d) const
+{
+    return bounds_->max[d].data();
+}
+
+inline bool EnsightCellRecords::boundsContain(Index cell, const Vec3& pos) const
+{
+    return pos[0] >= bounds_->min[0][cell] &&
+           pos[1] >= bounds_->min[1][cell] &&
+           pos[2] >= bounds_->min[2][cell] &&
+           pos[0] <= bounds_->max[0][cell] &&
+           pos[1] <= bounds_->max[1][cell] &&
+           pos[2] <= bounds_->max[2][cell];
+}
+
+inline bool EnsightCellRecords::boundsIntersect(Index cell, const Bbox& bounds) const
+{
+    return bounds_->min[0][cell] <= bounds.maxCorner()[0] &&
+           bounds_->max[0][cell] >= bounds.minCorner()[0] &&
+           bounds_->min[1][cell] <= bounds.maxCorner()[1] &&
+           bounds_->max[1][cell] >= bounds.minCorner()[1] &&
+           bounds_->min[2][cell] <= bounds.maxCorner()[2] &&
+           bounds_->max[2][cell] >= bounds.minCorner()[2];
+}
+
+inline double EnsightCellRecords::boundsSquaredDistance(Index cell, const Vec3& pos) const
+{
+    double distSq = 0.0;
+    for (int d = 0; d < 3; d++)
+    {
+        const double diff = std::max(bounds_->min[d][cell] - pos[d], pos[d] - bounds_->max[d][cell]);
+        if (diff > 0.0)
+            distSq += diff * diff;
+    }
+    return distSq;
+}
+
+#endif // ENSIGHTCELLRECORDS_H
@@ -67,6 +67,13 @@ extern const char *strVarTypes[];
 extern const int varTypeDims[];
 const int numVarTypes = LAST_VAR_TYPE;
 
+/**
+ * @brief The SubdivTreeType enum selects the index created by EnsightObj::createSubdivTree():
+ * - a spatial subdivision, i.e. EnsightOctree for 3D or EnsightQuadtree for 2D data sets,
+ * - a bounding volume hierarchy, i.e. EnsightBvh.
+ */
+enum SubdivTreeType { SpatialSubdivision=0, BoundingVolumeHierarchy };
+
 } // namespace Ensight
 
 #endif // ENSIGHTDEF_H
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#ifndef ENSIGHTFACECONNECTIVITY_H
+#define ENSIGHTFACECONNECTIVITY_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QList>
+
+#include "eigentypes.h"
+
+
+// Forward declarations
+class EnsightCellList;
+
+/**
+ * @brief The EnsightFaceConnectivity class matches the faces of the cells of several cell lists.
+ *
+ * Two faces are neighbors if they consist of the same vertices, so faces of
+ * different cell types are matched as well, e.g. the quadrilateral face of a
+ * wedge with a hexahedron face or its triangle face with a tetrahedron face.
+ * Faces without a neighbor are boundary faces.
+ *
+ * Cell lists are referenced by their index in the list passed to the constructor.
+ * Use EnsightPart::getFaceConnectivity() to get the connectivity of all cells of a part.
+ */
+class EnsightFaceConnectivity
+{
+public:
+    /**
+     * @brief Matches the faces of all cells of the given cell lists.
+     *
+     * Faces are bucketed by their smallest vertex index with a counting sort and
+     * matched by their sorted vertex indices within each bucket in parallel.
+     * Faces with a vertex index outside of [0, numVertices) are ignored, they have
+     * no neighbor and are no boundary faces.
+     * @param[in] cellLists Cell lists, e.g. EnsightPart::getCells()
+     * @param[in] numVertices Number of vertices, e.g. EnsightPart::getVertexCount()
+     */
+    EnsightFaceConnectivity(const QList<const EnsightCellList*>& cellLists, int numVertices);
+
+    /**
+     * @brief Get the number of cell lists.
+     */
+    int getNumberOfCellLists() const;
+
+    /**
+     * @brief Get the neighboring cells of a cell list.
+     *
+     * For N cells this is a MxN matrix, where M is the number of faces per cell.
+     * In neighbors(i,j) the index of the cell adjacent to face i of cell j is stored
+     * or -1 if this is a boundary face. The cell list of the neighbor is given by getNeighborList().
+     * @param[in] cellList Cell list index
+     */
+    const Mati& getNeighbors(int cellList) const;
+
+    /**
+     * @brief Get the cell list index of the cell adjacent to a face, or -1 for boundary faces.
+     * @param[in] cellList Cell list index
+     * @param[in] face Face index
+     * @param[in] cell Cell index
+     */
+    int getNeighborList(int cellList, int face, int cell) const;
+
+    /**
+     * @brief Get the boundary faces.
+     *
+     * It returns a 3xK matrix where K is the number of boundary faces. In each column
+     * the cell list index, the cell index and the face index are stored. The faces are
+     * ordered by cell list, cell and face.
+     */
+    const Mati& getBoundary() const;
+
+    /**
+     * @brief Get a 1xL matrix with L indices to boundary vertices in ascending order.
+     */
+    const Mati& getBoundaryVertices() const;
+
+    /**
+     * @brief Get the bytes of the neighbors, boundary faces and boundary vertices.
+     */
+    int64_t getBytes() const;
+
+private:
+    /**
+     * @brief neighbors For each cell list the indices of the neighboring cells
+     */
+    std::vector<Mati> neighbors_;
+
+    /**
+     * @brief neighborLists For each cell list the cell list indices of the neighboring cells.
+     * Empty for a single cell list.
+     */
+    std::vector<Mati> neighborLists_;
+
+    /**
+     * @brief boundary 3xK matrix of boundary faces
+     */
+    Mati boundary_;
+
+    /**
+     * @brief boundaryVertices 1xL matrix of boundary vertex indices
+     */
+    Mati boundaryVertices_;
+};
+
+#endif // ENSIGHTFACECONNECTIVITY_H
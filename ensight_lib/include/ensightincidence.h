@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#ifndef ENSIGHTINCIDENCE_H
+#define ENSIGHTINCIDENCE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QList>
+
+
+// Forward declarations
+class EnsightCellList;
+
+/**
+ * @brief The EnsightVertexIncidence class stores for each vertex of a part the cells containing it.
+ *
+ * The cells of all cell lists of one timestep are stored in compressed sparse row format:
+ * the cells of vertex v are getEntries()[getOffsets()[v]] to getEntries()[getOffsets()[v + 1] - 1],
+ * sorted by cell list and cell index. Cells referencing a vertex several times are stored once.
+ *
+ * Use EnsightPart::getVertexIncidence() to get the incidence of a part.
+ */
+class EnsightVertexIncidence
+{
+public:
+    /**
+     * @brief A cell, given by the index of its cell list and its index in this list.
+     */
+    struct Entry
+    {
+        int cellList;
+        int cell;
+    };
+
+    /**
+     * @brief Creates the incidence of the given cells.
+     *
+     * Indices outside of [0, numVertices) are ignored.
+     * @param[in] cellLists Cell lists, e.g. EnsightPart::getCells()
+     * @param[in] numVertices Number of vertices
+     */
+    EnsightVertexIncidence(const QList<EnsightCellList*>& cellLists, int numVertices);
+
+    /**
+     * @brief Get the number of vertices.
+     */
+    int getNumberOfVertices() const;
+
+    /**
+     * @brief Get the number of cells containing a vertex.
+     * @param[in] vertex Vertex index
+     */
+    int getCellCount(int vertex) const;
+
+    /**
+     * @brief Get the cells containing a vertex.
+     * @param[in] vertex Vertex index
+     * @return pointer to the first of getCellCount(vertex) entries
+     */
+    const Entry* getCells(int vertex) const;
+
+    /**
+     * @brief Get the cell list an entry refers to.
+     * @param[in] cellList Index of the cell list, see Entry::cellList
+     */
+    EnsightCellList* getCellList(int cellList) const;
+
+    /**
+     * @brief Get the N+1 row offsets for N vertices.
+     */
+    const std::vector<int>& getOffsets() const;
+
+    /**
+     * @brief Get the entries of all vertices.
+     */
+    const std::vector<Entry>& getEntries() const;
+
+    /**
+     * @brief Get the bytes of the offsets and entries.
+     */
+    int64_t getBytes() const;
+
+private:
+    /**
+     * @brief cellLists The cell lists referenced by the entries
+     */
+    QList<EnsightCellList*> cellLists_;
+
+    /**
+     * @brief offsets Offset of the first entry of each vertex, followed by the total number of entries
+     */
+    std::vector<int> offsets_;
+
+    /**
+     * @brief entries Cells of all vertices
+     */
+    std::vector<Entry> entries_;
+};
+
+#endif // ENSIGHTINCIDENCE_H
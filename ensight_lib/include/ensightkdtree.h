@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef ENSIGHTKDTREE_H
+#define ENSIGHTKDTREE_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <QVector>
+
+#include "eigentypes.h"
+#include "ensightlazy.h"
+
+class EnsightPart;
+
+
+/**
+ * @brief The EnsightKdTree class implements a KD-tree over the vertices of
+ * parts for nearest neighbor and radius queries.
+ *
+ * The tree splits at the median of the largest extent until at most LeafSize
+ * vertices remain. The nodes are stored in depth-first order, the left child
+ * of a node directly follows it. The vertex coordinates are copied in leaf
+ * order, so that each leaf refers to a contiguous range.
+ *
+ * insert() only records the parts, the tree is built by build() or on the
+ * first query after an insert. The nodes of each level are split in parallel.
+ * Queries are thread-safe, the batch queries run in parallel.
+ */
+class EnsightKdTree
+{
+public:
+    /**
+     * @brief A vertex found by a query.
+     */
+    struct Neighbor
+    {
+        EnsightPart* part;
+        int timestep;
+        int vertex;  // column in EnsightPart::getVertices(timestep)
+        double distance;
+    };
+
+    EnsightKdTree();
+
+    /**
+     * @brief Insert the vertices of a part at a timestep.
+     */
+    void insert(EnsightPart* part, int timestep);
+    /**
+     * @brief Makes this empty tree hold the vertices of other at another
+     * timestep of their parts with the same vertices. The nodes are shared,
+     * the neighbors found refer to timestep.
+     */
+    void share(const EnsightKdTree& other, int timestep);
+    /**
+     * @brief Build the tree from all inserted vertices. Otherwise, the tree
+     * is built on the first query after insert().
+     */
+    void build();
+
+    /**
+     * @brief Get the number of inserted vertices.
+     */
+    int size() const;
+
+    /**
+     * @brief Find the k vertices closest to a position.
+     * @return At most k vertices sorted by distance, ties by insertion order
+     */
+    QVector<Neighbor> findNearest(const Vec3& pos, int k) const;
+    /**
+     * @brief Find the k vertices closest to each of many positions, in
+     * parallel.
+     * @param[in] positions The positions as 3xN matrix
+     * @param[out] neighborsOut The vertices found for each position
+     */
+    void findNearest(const Eigen::Ref<const Matx>& positions, int k,
+                     QVector<QVector<Neighbor>>& neighborsOut) const;
+
+    /**
+     * @brief Find all vertices within a distance of a position.
+     * @return The vertices sorted by distance, ties by insertion order
+     */
+    QVector<Neighbor> findWithinRadius(const Vec3& pos, double radius) const;
+    /**
+     * @brief Find all vertices within a distance of each of many positions,
+     * in parallel.
+     * @param[in] positions The positions as 3xN matrix
+     * @param[out] neighborsOut The vertices found for each position
+     */
+    void findWithinRadius(const Eigen::Ref<const Matx>& positions, double radius,
+                          QVector<QVector<Neighbor>>& neighborsOut) const;
+
+    /**
+     * @brief Get the bytes used by the nodes and vertex copies, 0 if the tree
+     * was not built yet.
+     */
+    int64_t getBytes() const;
+
+private:
+    using Index = uint32_t;
+
+    static const Index InnerNode = std::numeric_limits<Index>::max();
+    static const int LeafSize = 16;
+    static const int MaxDepth = 64;
+
+    /**
+     * @brief A node of the tree. Inner nodes store the index of their right
+     * child, the split coordinate and count == InnerNode, leaves store the
+     * range [first, first+count) in Layout::coords.
+     */
+    struct KdNode
+    {
+        double split;
+        Index first;
+        Index count;
+        int axis;
+    };
+
+    /**
+     * @brief The vertices of one inserted part, with global indices starting
+     * at first.
+     */
+    struct Source
+    {
+        Index first;
+        EnsightPart* part;
+        int timestep;
+    };
+
+    struct Layout
+    {
+        std::vector<KdNode> nodes;
+        std::array<std::vector<double>, 3> coords;
+        std::vector<Index> vertices;  // global index of each coordinate
+    };
+
+    /**
+     * @brief A vertex of a query result, by squared distance and global index.
+     */
+    using Candidate = std::pair<double, Index>;
+
+    const Layout& getLayout() const;
+    Layout buildLayout() const;
+
+    /**
+     * @brief Visits the vertices of all leaves closer than maxDistSq in the
+     * order of increasing distance bound. visit may decrease maxDistSq.
+     */
+    template <typename Visit>
+    void traverse(const Layout& layout, const Vec3& pos, double& maxDistSq, Visit&& visit) const;
+    QVector<Neighbor> toNeighbors(std::vector<Candidate>& candidates) const;
+
+    std::vector<Source> sources_;
+    Index size_;
+    EnsightLazy<Layout> layout_;
+};
+
+#endif // ENSIGHTKDTREE_H
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#ifndef ENSIGHTLAZY_H
+#define ENSIGHTLAZY_H
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+
+/**
+ * @brief The EnsightLazy class holds a value that is computed on first access.
+ *
+ * Concurrent calls of get() compute the value only once. reset() discards the
+ * value so that the next call of get() computes it again. reset() is not
+ * thread-safe: it must only be called while no other thread calls get() or
+ * uses a returned reference, i.e. from the editing methods of the owner.
+ * Debug builds assert that no get() is running during reset().
+ *
+ * share() makes two objects hold the same value, computed once by the first
+ * call of get() on either. reset() detaches an object from the shared value.
+ */
+template <typename T>
+class EnsightLazy
+{
+public:
+    EnsightLazy() : state_(std::make_shared<State>()) {}
+
+    /**
+     * @brief Get the value, computing it by calling factory() if necessary.
+     * @param[in] factory Function returning the value
+     */
+    template <typename Factory>
+    const T& get(Factory&& factory) const
+    {
+        State& state = *state_;
+#ifndef NDEBUG
+        ActiveGet active(state);
+#endif
+        std::call_once(state.computed, [&state, &factory]() {
+            state.value.reset(new T(factory()));
+            state.isComputed.store(true, std::memory_order_release);
+        });
+        return *state.value;
+    }
+
+    /**
+     * @brief Checks if the value was computed, without computing it.
+     */
+    bool isComputed() const
+    {
+        return state_->isComputed.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Shares the value of other, discarding the own value. The
+     * factories passed to get() of both objects must compute the same value.
+     * Like reset(), this is not thread-safe.
+     */
+    void share(const EnsightLazy& other)
+    {
+        state_ = other.state_;
+    }
+
+    /**
+     * @brief Discards the value.
+     */
+    void reset()
+    {
+        assert(state_->activeGets.load(std::memory_order_acquire) == 0 &&
+               "EnsightLazy::reset() called concurrently with get()");
+        state_ = std::make_shared<State>();
+    }
+
+private:
+    struct State
+    {
+        std::once_flag computed;
+        std::atomic<bool> isComputed{false};
+        std::unique_ptr<T> value;
+#ifndef NDEBUG
+        std::atomic<int> activeGets{0};
+#endif
+    };
+
+#ifndef NDEBUG
+    /**
+     * @brief Counts a running get() for the check in reset().
+     */
+    struct ActiveGet
+    {
+        explicit ActiveGet(State& state) : state_(state)
+        {
+            state_.activeGets.fetch_add(1, std::memory_order_acq_rel);
+        }
+        ~ActiveGet() { state_.activeGets.fetch_sub(1, std::memory_order_acq_rel); }
+        State& state_;
+    };
+#endif
+
+    std::shared_ptr<State> state_;
+};
+
+#endif // ENSIGHTLAZY_H
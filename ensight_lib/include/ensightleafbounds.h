@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef ENSIGHTLEAFBOUNDS_H
+#define ENSIGHTLEAFBOUNDS_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "bbox.h"
+#include "ensightcellrecords.h"
+
+
+/**
+ * @brief The EnsightLeafBounds class stores the bounding boxes of the cells
+ * of all leaves of a subdivision tree in leaf order, quantized to 8 bits per
+ * coordinate relative to the bounds of their leaf.
+ *
+ * The quantized boxes are conservative: filter() selects every cell whose
+ * bounding box contains the position, and possibly a few cells close to it.
+ * The boxes of 16 cells are tested at once using SIMD instructions where
+ * available.
+ */
+class EnsightLeafBounds
+{
+public:
+    using Index = EnsightCellRecords::Index;
+
+    /**
+     * @brief The number of entries the trees pass to filter() at once.
+     */
+    static const int ChunkSize = 64;
+
+    EnsightLeafBounds();
+
+    /**
+     * @brief Resizes to numEntries entries, keeping existing entries.
+     */
+    void resize(size_t numEntries);
+    /**
+     * @brief Releases memory not needed to store the entries.
+     */
+    void squeeze();
+    /**
+     * @brief Sets the bounding boxes of the cells of a leaf.
+     * @param first The first entry of the leaf
+     * @param count The number of entries of the leaf
+     * @param leafBounds The bounds of the leaf, identical to the bounds passed
+     * to filter()
+     * @param cells The cell indices of the entries [first, first+count)
+     * @param records The records containing the cells
+     */
+    void set(size_t first, int count, const Bbox& leafBounds, const Index* cells,
+             const EnsightCellRecords& records);
+
+    /**
+     * @brief Selects the cells of a leaf whose quantized bounding box contains
+     * a position.
+     * @param[in] first The first entry of the leaf
+     * @param[in] count The number of entries of the leaf
+     * @param[in] leafBounds The bounds of the leaf
+     * @param[in] pos The position
+     * @param[in] cells The cell indices of the entries [first, first+count)
+     * @param[out] survivors The selected cell indices in the order of cells,
+     * must have room for count indices
+     * @return The number of selected cells
+     */
+    int filter(size_t first, int count, const Bbox& leafBounds, const Vec3& pos,
+               const Index* cells, Index* survivors) const;
+
+    /**
+     * @brief Get the bytes used by the quantized bounding boxes.
+     */
+    int64_t getBytes() const;
+
+private:
+    /**
+     * @brief Number of entries tested at once. The arrays are padded so that
+     * a full group can be loaded at the last entry.
+     */
+    static const int GroupSize = 16;
+
+    size_t size_;
+    std::array<std::vector<uint8_t>, 3> min_;
+    std::array<std::vector<uint8_t>, 3> max_;
+};
+
+#endif // ENSIGHTLEAFBOUNDS_H
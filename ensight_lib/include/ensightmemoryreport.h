@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#ifndef ENSIGHTMEMORYREPORT_H
+#define ENSIGHTMEMORYREPORT_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The EnsightMemoryReport struct summarizes the memory used by an EnsightObj.
+ *
+ * See EnsightObj::getMemoryReport().
+ */
+struct EnsightMemoryReport
+{
+    /**
+     * @brief Memory used by one array or data structure.
+     */
+    struct Entry
+    {
+        /**
+         * @brief Part name, empty for the subdivision tree
+         */
+        std::string part;
+
+        /**
+         * @brief Timestep, -1 for the subdivision tree
+         */
+        int timestep;
+
+        /**
+         * @brief One of "vertices", "cells", "neighbors", "boundary",
+         * "boundaryVertices", "variable", "incidence", "faceConnectivity",
+         * "meshView" and "subdivtree"
+         */
+        std::string category;
+
+        /**
+         * @brief Cell type, variable name or part of the subdivision tree
+         */
+        std::string name;
+
+        int64_t bytes;
+
+        /**
+         * @brief True if the memory is shared with an earlier entry and counted there
+         */
+        bool shared;
+    };
+
+    /**
+     * @brief Bytes of all vertex, cell and variable arrays if each was stored separately
+     */
+    int64_t arrayBytes = 0;
+
+    /**
+     * @brief Bytes of the vertex, cell and variable arrays actually stored.
+     * Arrays with identical content are stored once, see EnsightBufferStore.
+     */
+    int64_t storedArrayBytes = 0;
+
+    /**
+     * @brief Bytes of the neighbors, boundaries and boundary vertices of the cell lists
+     * and of the vertex incidence, face connectivity and mesh view of the parts
+     * computed so far. Topology shared by several cell lists is counted once.
+     */
+    int64_t topologyBytes = 0;
+
+    /**
+     * @brief Bytes of the subdivision tree: nodes, leaf index arrays and cell identifiers
+     */
+    int64_t subdivTreeBytes = 0;
+
+    /**
+     * @brief Highest number of bytes of stored arrays held at the same time,
+     * e.g. while reading
+     */
+    int64_t peakArrayBytes = 0;
+
+    /**
+     * @brief Peak resident memory of the process while reading the object from
+     * file, above the resident memory before reading.
+     *
+     * Measured from the peak resident memory reported by the operating system.
+     * If the process had a higher peak before reading, the resident memory
+     * sampled after each file is used instead, which misses short peaks within
+     * a file. 0 if the object was not read or the platform reports no memory usage.
+     *
+     * The memory is that of the whole process. If other objects are read or
+     * built by other threads at the same time, their memory is included.
+     */
+    int64_t readPeakBytes = 0;
+
+    /**
+     * @brief Memory used by each array, in the order of parts and timesteps
+     */
+    std::vector<Entry> entries;
+
+    /**
+     * @brief Get the bytes saved by sharing identical arrays.
+     */
+    int64_t getDeduplicatedBytes() const;
+
+    /**
+     * @brief Get the bytes of stored arrays, topology and subdivision tree.
+     */
+    int64_t getTotalBytes() const;
+
+    /**
+     * @brief Appends an entry to the breakdown.
+     */
+    void addEntry(const std::string& part, int timestep, const std::string& category,
+                  const std::string& name, int64_t bytes, bool shared);
+
+    /**
+     * @brief Print the report to the given stream
+     */
+    void print(std::ostream& out) const;
+
+    /**
+     * @brief Get the current resident memory of the process, 0 if unknown.
+     */
+    static int64_t getResidentBytes();
+
+    /**
+     * @brief Get the highest resident memory of the process so far, 0 if unknown.
+     */
+    static int64_t getPeakResidentBytes();
+};
+
+#endif // ENSIGHTMEMORYREPORT_H
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#ifndef ENSIGHTMESHVIEW_H
+#define ENSIGHTMESHVIEW_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QList>
+
+#include "eigentypes.h"
+#include "ensightdef.h"
+
+
+// Forward declarations
+class EnsightCellList;
+
+/**
+ * @brief The EnsightMeshView class is a read-only view onto all cells of a part at one timestep.
+ *
+ * The cells of all cell lists are stored in compressed sparse row format: cell i
+ * consists of the getCellSize(i) vertex indices starting at getConnectivity()[getOffsets()[i]]
+ * and has the type getCellType(i). The cells of cell list l are the cells
+ * getCellListOffsets()[l] to getCellListOffsets()[l + 1] - 1, in their order in the list.
+ *
+ * The compute methods process all cells in parallel.
+ * Use EnsightPart::getMeshView() to get the view of a part.
+ */
+class EnsightMeshView
+{
+public:
+    /**
+     * @brief Creates the view of the given cell lists.
+     * @param[in] cellLists Cell lists, e.g. EnsightPart::getCells()
+     */
+    explicit EnsightMeshView(const QList<const EnsightCellList*>& cellLists);
+
+    /**
+     * @brief Get the number of cells.
+     */
+    int getNumberOfCells() const;
+
+    /**
+     * @brief Get the type of a cell.
+     * @param[in] cell Cell index
+     */
+    Ensight::Cell getCellType(int cell) const;
+
+    /**
+     * @brief Get the number of vertices of a cell.
+     * @param[in] cell Cell index
+     */
+    int getCellSize(int cell) const;
+
+    /**
+     * @brief Get the vertex indices of a cell.
+     * @param[in] cell Cell index
+     * @return pointer to the first of getCellSize(cell) vertex indices
+     */
+    const int* getCell(int cell) const;
+
+    /**
+     * @brief Get the N+1 offsets into the connectivity for N cells.
+     */
+    const std::vector<int>& getOffsets() const;
+
+    /**
+     * @brief Get the vertex indices of all cells.
+     */
+    const std::vector<int>& getConnectivity() const;
+
+    /**
+     * @brief Get the cell type (see Ensight::Cell) of all cells.
+     */
+    const std::vector<int8_t>& getTypes() const;
+
+    /**
+     * @brief Get the index of the first cell of each cell list, followed by the number of cells.
+     */
+    const std::vector<int>& getCellListOffsets() const;
+
+    /**
+     * @brief Get the bytes of the offsets, connectivity and types.
+     */
+    int64_t getBytes() const;
+
+    /**
+     * @brief Computes the bounding boxes of all cells.
+     * @param[in] vertices Vertices of the part, see EnsightPart::getVertices()
+     * @return 6xN matrix with the minimum corner in the first three and the
+     * maximum corner in the last three rows.
+     */
+    Matx computeBounds(const MatxView& vertices) const;
+
+    /**
+     * @brief Computes the centroids, i.e. the mean of the vertices, of all cells.
+     * @param[in] vertices Vertices of the part, see EnsightPart::getVertices()
+     * @return 3xN matrix of centroids
+     */
+    Matx computeCentroids(const MatxView& vertices) const;
+
+    /**
+     * @brief Computes the volumes of all cells, see computeVolume().
+     * @param[in] vertices Vertices of the part, see EnsightPart::getVertices()
+     * @return N vector of volumes
+     */
+    Vecx computeVolumes(const MatxView& vertices) const;
+
+    /**
+     * @brief Computes the volume of one cell.
+     *
+     * For 2D cells the area and for bars the length is returned.
+     * @param[in] type Cell type
+     * @param[in] cell Vertex indices of the cell
+     * @param[in] vertices Vertices of the part
+     */
+    static double computeVolume(Ensight::Cell type, const int* cell, const MatxView& vertices);
+
+private:
+    /**
+     * @brief offsets Offset of the first vertex index of each cell, followed by the connectivity size
+     */
+    std::vector<int> offsets_;
+
+    /**
+     * @brief connectivity Vertex indices of all cells
+     */
+    std::vector<int> connectivity_;
+
+    /**
+     * @brief types Cell type of each cell
+     */
+    std::vector<int8_t> types_;
+
+    /**
+     * @brief cellListOffsets Index of the first cell of each cell list, followed by the number of cells
+     */
+    std::vector<int> cellListOffsets_;
+};
+
+#endif // ENSIGHTMESHVIEW_H
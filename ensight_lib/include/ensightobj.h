@@ -24,23 +24,33 @@
 #ifndef ENSIGHTOBJ_H
 #define ENSIGHTOBJ_H
 
+#include <cstdint>
 #include <iosfwd>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
 #include "eigentypes.h"
+#include "ensightbuffer.h"
 #include "ensightdef.h"
+#include "ensightlazy.h"
+#include "ensightmemoryreport.h"
 #include "bbox.h"
 
 class EnsightConstant;
 class EnsightCellIdentifier;
 class EnsightBarycentricCoordinates;
 class EnsightSubdivTree;
+class EnsightKdTree;
 class EnsightPart;
 class EnsightVariableIdentifier;
-class QString;
-class QStringList;
+class EnsightBufferStore;
+class EnsightVariableRegistry;
 
 
 /**
@@ -68,8 +78,9 @@ public:
 
     /**
      * @brief Enables editing
+     * @returns false if the object is frozen, see freeze().
      */
-    void beginEdit();
+    bool beginEdit();
 
     /**
      * @brief Disables editing and verifies all changes.
@@ -83,6 +94,9 @@ public:
      *
      * Verifies if all indices of all cells refer to a really defined vertex.
      *
+     * Only parts and timesteps modified since the last successful call are
+     * verified, see EnsightPart::isModified(). They are verified in parallel.
+     *
      * @returns false in case of any error or true if the definiton of the Ensight Object is correct.
      *
      */
@@ -93,6 +107,26 @@ public:
      */
     bool inEditMode();
 
+    /**
+     * @brief Makes the object immutable.
+     *
+     * A frozen object cannot be edited, cleaned or get a new subdivision tree
+     * anymore, so create the tree before freezing. Afterwards all query methods
+     * may be called from many threads concurrently: the const methods,
+     * interpolate(), getPart(), getSubdivTree() and its search methods, and the
+     * getters of the parts, cell lists and variables. Data computed on first
+     * access, e.g. neighbors or vertex incidence, is created exactly once.
+     * Modifying parts directly, e.g. by EnsightPart::setVariable(), is not allowed.
+     *
+     * @returns false if the object is in edit mode.
+     */
+    bool freeze();
+
+    /**
+     * @brief Checks if the object is frozen, see freeze().
+     */
+    bool isFrozen() const;
+
 
     /**
      * @brief Creates a new Ensight part
@@ -143,7 +177,8 @@ public:
 
     /**
      * @brief Defines that this Ensight Obj is transient, with the N timesteps defined
-     * in the Nx1 Vector values.
+     * in the Nx1 Vector values. Existing parts get N timesteps, keeping the
+     * data of the first timesteps.
      * @param[in] values Nx1 vector containing the N timesteps
      */
     bool setTransient(const Vecx & values);
@@ -181,20 +216,22 @@ public:
     /**
      * @brief Sets the vertices for a part and a timestep.
      * @param[in] part Ensight part
-     * @param[in] vertices A 3xN matrix
+     * @param[in] vertices A 3xN matrix. Use an EnsightBuffer to hand over
+     * externally owned data without copying.
      * @param[in] timestep Timestep
      */
-    bool setVertices(EnsightPart* part, const Matx& vertices, int timestep);
+    bool setVertices(EnsightPart* part, const MatxBuffer& vertices, int timestep);
 
     /**
      * @brief Sets the cells for a part and a time step
      * @param[in] part Ensight part
-     * @param[in] cells MxN matrix defining N cells with M vertices each
+     * @param[in] cells MxN matrix defining N cells with M vertices each. Use an
+     * EnsightBuffer to hand over externally owned data without copying.
      * @param[in] timestep Timestep
      * @param[in] e Cell Type
      * M and e must be consistent, i.e. if e==bar2,M=2
      */
-    bool setCells(EnsightPart* part, const Mati& cells, int timestep, Ensight::Cell e);
+    bool setCells(EnsightPart* part, const MatiBuffer& cells, int timestep, Ensight::Cell e);
 
     /**
      * @brief Get the geometric bounds of the EnsightObj for a given timestep.
@@ -247,20 +284,36 @@ public:
     bool hasVariable(const QString &name) const;
     bool hasVariable(const std::string &name) const;
 
+    /**
+     * @brief Get the handle of the variable with given name, -1 if not exists.
+     *
+     * Variable names are interned to integer handles by createVariable(). The
+     * handle of a variable is the same in all parts of this object and can be
+     * used instead of the name to access its values, e.g. with
+     * EnsightPart::getVariable(int, int) or EnsightCellIdentifier::getValues(int),
+     * without any string comparison or conversion.
+     * @param[in] name Variable name
+     */
+    int getVariableHandle(const QString& name) const;
+    int getVariableHandle(const std::string& name) const;
+
 
     /**
      * @brief Sets values for a variable for a timestep with a given name.
      *
      * The matrix values must match the defined vertices of the geometry and the dimension of the variable.
+     * Vector values may also be given as 4xN matrix containing x,y,z and the norm
+     * of (x,y,z). Scalar values and such 4xN matrices are stored without copying;
+     * a 4th row that is not the norm is recomputed.
      * @param[in] part Ensight Part
      * @param[in] name Variable name
      * @param[in] values Variable values
      * @param[in] type Variable type (See Ensight::VarTypes)
      * @param[in] timestep Timestep
      */
-    bool setVariable(EnsightPart* part, const QString& name, const Matx& values,
+    bool setVariable(EnsightPart* part, const QString& name, const MatxBuffer& values,
                      Ensight::VarTypes type, int timestep);
-    bool setVariable(EnsightPart* part, const std::string& name, const Matx& values,
+    bool setVariable(EnsightPart* part, const std::string& name, const MatxBuffer& values,
                      Ensight::VarTypes type, int timestep);
 
 
@@ -320,49 +373,175 @@ public:
      * If timestep=-1 the min and max value for all timesteps are calculated.
      * The result is a Nx2 matrix. In the first colums the min and in the second column the max value.
      * N is 1 for 1d variables and 4 for 3d variables. for 3d variables the 4 values are (x,y,z,norm(x,y,z))
+     *
+     * The bounds are cached and updated by setVariable(), clean() and endEdit().
+     * An empty matrix is returned if the variable is not defined.
      * @param[in] name Variable name
      * @param[in] timestep Timestep
      * @return Nx2 matrix
      */
-    Matx getVariableBounds(const QString& name, int timestep) const;
-    Matx getVariableBounds(const std::string& name, int timestep) const;
+    const Matx& getVariableBounds(const QString& name, int timestep) const;
+    const Matx& getVariableBounds(const std::string& name, int timestep) const;
 
 
     /**
      * @brief Creates the SubdivTree.
      *
      * If the input is in 2D a Quadtree is created. Otherwise, an Octree is created.
-     * @param[in] maxDepth Maximum depth of the SubdivTree
+     * With type BoundingVolumeHierarchy an EnsightBvh is created instead, which
+     * stores each cell only once and suits strongly graded meshes.
+     *
+     * Each timestep has its own tree, the tree of timestep 0 is built here and
+     * the others on first access by getSubdivTree() or interpolate(). A timestep
+     * with the same vertices and cells as the previous one shares the nodes
+     * and cell bounds of its tree, see EnsightSubdivTree::share(). The cell
+     * identifiers are not shared, they always refer to the queried timestep.
+     * If setTransient() or setStatic() change the number of timesteps later,
+     * the trees of the remaining timesteps are kept and those of added
+     * timesteps are built on first access.
+     * If only the vertices moved, the EnsightBvh of the first timestep with
+     * these cells is refit instead of building a new one.
+     * @param[in] maxDepth Maximum depth of the SubdivTree, ignored by the EnsightBvh
      * @param[in] maxElements Maximum number of SubdivTree elements
      * @param[in] partsToExclude The names of the parts to exclude
      * @param[in] sizeOffset Increases the cell boundaries.
+     * @param[in] type The kind of tree to create
+     * @returns false if the object is frozen, see freeze().
      */
     bool createSubdivTree(int maxDepth, int maxElements,
                           const QStringList& partsToExclude,
-                          double sizeOffset = 0.0);
+                          double sizeOffset = 0.0,
+                          Ensight::SubdivTreeType type = Ensight::SpatialSubdivision);
 
 
     /**
-     * @brief Get the SubdivTree.
+     * @brief Get the SubdivTree of a timestep, building it if necessary.
      *
-     * Returns NULL if SubdivTree doesn't exist.
+     * Returns NULL if SubdivTree doesn't exist or the timestep is out of range.
+     * The cells found by the tree, e.g. by interpolate(), refer to timestep and
+     * return its variable values, also if the tree shares its structure with
+     * another timestep.
+     * @param[in] timestep Timestep
      */
-    EnsightSubdivTree* getSubdivTree();
+    EnsightSubdivTree* getSubdivTree(int timestep = 0);
+
+
+    /**
+     * @brief Writes the SubdivTree of timestep 0 to a binary file, see
+     * loadSubdivTree().
+     *
+     * The file holds the tree structure as flat arrays aligned to 8 bytes, and
+     * a hash of the geometry and the parameters of createSubdivTree(). The
+     * cells themselves are not written. Only the tree of timestep 0 is
+     * written, the trees of other timesteps are built on first access after
+     * loadSubdivTree().
+     *
+     * The tree is written to filename.tmp, which is then renamed, so an
+     * existing file is only replaced by a complete one.
+     * @param[in] filename File name
+     * @returns false if the SubdivTree doesn't exist or the file can't be written
+     */
+    bool saveSubdivTree(const QString& filename);
+    bool saveSubdivTree(const std::string& filename);
+
+    /**
+     * @brief Creates the SubdivTree like createSubdivTree(), but loads the tree
+     * of timestep 0 from a file written by saveSubdivTree() instead of building it.
+     *
+     * Loading succeeds only if the file was written for the same vertices and
+     * cells of the parts at timestep 0 and the same parameters. Otherwise the
+     * current SubdivTree is kept, call createSubdivTree() and saveSubdivTree() then.
+     * @param[in] filename File name
+     * @param[in] maxDepth See createSubdivTree()
+     * @param[in] maxElements See createSubdivTree()
+     * @param[in] partsToExclude See createSubdivTree()
+     * @param[in] sizeOffset See createSubdivTree()
+     * @param[in] type See createSubdivTree()
+     * @returns false if the object is frozen, or the file can't be read or
+     * doesn't match the geometry or parameters
+     */
+    bool loadSubdivTree(const QString& filename, int maxDepth, int maxElements,
+                        const QStringList& partsToExclude, double sizeOffset = 0.0,
+                        Ensight::SubdivTreeType type = Ensight::SpatialSubdivision);
+    bool loadSubdivTree(const std::string& filename, int maxDepth, int maxElements,
+                        const QStringList& partsToExclude, double sizeOffset = 0.0,
+                        Ensight::SubdivTreeType type = Ensight::SpatialSubdivision);
 
 
     /**
      * @brief Interpolates CFD data
      * @param[in] pos Position
+     * @param[in] timestep Timestep, see getSubdivTree()
      */
-    EnsightCellIdentifier* interpolate(const Vec3 & pos);
+    EnsightCellIdentifier* interpolate(const Vec3 & pos, int timestep = 0);
 
 
     /**
      * @brief Interpolates CFD data
      * @param[in] pos Position
      * @param[out] baryCoordOut Barycentric coordinates are used to check if pos is inside cell and can be retrieved here.
+     * @param[in] timestep Timestep, see getSubdivTree()
+     */
+    EnsightCellIdentifier* interpolate(const Vec3& pos, EnsightBarycentricCoordinates &baryCoordOut,
+                                       int timestep = 0);
+
+    /**
+     * @brief Interpolates CFD data, starting the cell lookup at a cell close to
+     * pos, see EnsightSubdivTree::search(). This is faster for coherent
+     * queries, e.g. along particle paths.
+     * @param[in] pos Position
+     * @param[out] baryCoordOut Barycentric coordinates are used to check if pos is inside cell and can be retrieved here.
+     * @param[in] hint A cell returned by a previous call, or nullptr
+     * @param[in] timestep Timestep, see getSubdivTree()
+     */
+    EnsightCellIdentifier* interpolate(const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut,
+                                       const EnsightCellIdentifier* hint, int timestep = 0);
+
+    /**
+     * @brief Interpolates CFD data at many positions in parallel, see
+     * EnsightSubdivTree::search().
+     * @param[in] positions Positions as 3xN matrix
+     * @param[out] baryCoordsOut Barycentric coordinates of each position
+     * @param[in] timestep Timestep, see getSubdivTree()
+     * @return The cell containing each position, nullptr if no cell contains
+     * it or the SubdivTree doesn't exist.
+     */
+    QVector<EnsightCellIdentifier*> interpolate(const Eigen::Ref<const Matx>& positions,
+                                                QVector<EnsightBarycentricCoordinates>& baryCoordsOut,
+                                                int timestep = 0);
+
+    /**
+     * @brief Finds the cell closest to pos, also if pos lies outside of all
+     * cells, see EnsightSubdivTree::searchNearest(). Interpolating with the
+     * returned coordinates extends the data constantly beyond the boundary.
+     * @param[in] pos Position
+     * @param[out] baryCoordOut Barycentric coordinates of pos or its closest point in the cell
+     * @param[out] distanceOut Distance of pos to the cell, 0 if the cell contains it
+     * @param[in] timestep Timestep, see getSubdivTree()
+     * @return nullptr if the SubdivTree doesn't exist
      */
-    EnsightCellIdentifier* interpolate(const Vec3& pos, EnsightBarycentricCoordinates &baryCoordOut);
+    EnsightCellIdentifier* findNearestCell(const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut,
+                                           double& distanceOut, int timestep = 0);
+
+    /**
+     * @brief Finds the cells closest to many positions in parallel, see
+     * findNearestCell().
+     * @param[in] positions Positions as 3xN matrix
+     * @param[out] baryCoordsOut Barycentric coordinates of each position
+     * @param[out] distancesOut Distance of each position to its cell
+     * @param[in] timestep Timestep, see getSubdivTree()
+     */
+    QVector<EnsightCellIdentifier*> findNearestCell(const Eigen::Ref<const Matx>& positions,
+                                                    QVector<EnsightBarycentricCoordinates>& baryCoordsOut,
+                                                    QVector<double>& distancesOut, int timestep = 0);
+
+    /**
+     * @brief Get the KD-tree over the vertices of the parts in the SubdivTree
+     * of a timestep, for nearest vertex and radius queries, see EnsightKdTree.
+     * @param[in] timestep Timestep, see getSubdivTree()
+     * @return nullptr if the SubdivTree doesn't exist
+     */
+    const EnsightKdTree* getVertexTree(int timestep = 0);
 
     /**
      * @brief Prints the whole information defining this Ensight object to given
@@ -370,13 +549,89 @@ public:
      */
     void print(std::ostream& out) const;
 
+    /**
+     * @brief Get the memory used by this object.
+     *
+     * The report is broken down by part, timestep, cell list, variable and
+     * subdivision tree. Neighbors and boundaries of cell lists are included
+     * once they were computed. Arrays with identical content are shared by all
+     * parts and timesteps, the report includes the bytes saved by this and the
+     * peak memory of the arrays. For objects read from file it includes the
+     * peak memory measured while reading, see setReadPeakBytes().
+     */
+    EnsightMemoryReport getMemoryReport() const;
+
+    /**
+     * @brief Sets the peak memory measured while reading this object, see
+     * EnsightMemoryReport::readPeakBytes. Called by the reader.
+     * @param[in] bytes Peak resident bytes above those before reading
+     */
+    void setReadPeakBytes(int64_t bytes);
+
 
 public:
-    /** Whenever something goes wrong the error message is here. */
-    static QString ERROR_STR;
+    /** Whenever something goes wrong the error message is here.
+     *
+     * Each thread has its own message, so independent EnsightObj instances
+     * can be read, written and queried on different threads. Messages set
+     * by the worker threads of Ensight::Parallel::parallelFor() are passed
+     * to the calling thread. Assign to the returned string to set a message. */
+    static QString& errorString();
 
 
 private:
+    int variableIndex(int handle) const;
+
+    /**
+     * @brief Verifies the cells and variables of one part at one timestep.
+     * @return The error message or an empty string if the data is valid.
+     */
+    QString verifyTimestep(EnsightPart* part, int timestep,
+                           const std::vector<int>& variableHandles) const;
+
+    /**
+     * @brief Recomputes the cached variable bounds of the given timesteps from
+     * the parts and the combined bounds over all timesteps.
+     */
+    void updateVariableBounds(const std::vector<int>& timesteps);
+
+    /**
+     * @brief Sets the parameters of createSubdivTree() and loadSubdivTree().
+     */
+    void setSubdivTreeParams(int maxDepth, int maxElements, const QStringList& partsToExclude,
+                             double sizeOffset, Ensight::SubdivTreeType type);
+
+    /**
+     * @brief Creates the SubdivTree of a timestep and inserts the parts,
+     * without building it.
+     */
+    std::shared_ptr<EnsightSubdivTree> createEmptySubdivTree(int timestep);
+
+    /**
+     * @brief Creates the SubdivTree of a timestep with the parameters of
+     * createSubdivTree(), sharing or refitting the tree of an earlier timestep.
+     */
+    std::shared_ptr<EnsightSubdivTree> buildSubdivTree(int timestep);
+
+    /**
+     * @brief Resizes the SubdivTrees, if created, to the number of timesteps.
+     */
+    void resizeSubdivTrees();
+
+    /**
+     * @brief Hashes the vertices and cells of the parts in the SubdivTree at a
+     * timestep together with the parameters of createSubdivTree().
+     */
+    uint64_t getSubdivTreeKey(int timestep) const;
+
+    /**
+     * @brief Checks if the parts in the SubdivTrees have the same cells at
+     * two timesteps and, if compareVertices is set, the same vertices.
+     *
+     * Arrays are compared by their storage, which EnsightBufferStore shares
+     * for equal content.
+     */
+    bool hasSameSubdivGeometry(int timestep, int otherTimestep, bool compareVertices) const;
 
     /** The timesteps; If static this is 1x1
      *
@@ -386,17 +641,56 @@ private:
     /** Flag indicating edit mode; Adding parts, variables, etc is only possible in edit mode. */
     bool edit_;
 
+    /** Flag indicating that the object is immutable, see freeze() */
+    bool frozen_;
+
     /** List of parts */
     std::vector<std::unique_ptr<EnsightPart>> parts_;
 
+    /** Parts indexed by name and by id, kept consistent with parts_ */
+    QHash<QString, EnsightPart*> partsByName_;
+    QHash<int, EnsightPart*> partsById_;
+
     /** List of constants */
     std::vector<EnsightConstant> constants_;
 
+    /** For each constant name the index into constants_ */
+    QHash<QString, int> constantIndices_;
+
     /** List of Variables, variables are tuples <name, dim> */
     std::vector<EnsightVariableIdentifier> variables_;
 
-    /** Object representing the SubdivTree, see createSubdivTree() */
-    std::unique_ptr<EnsightSubdivTree> subdivTree_;
+    /** Registry interning variable names to handles, shared with all parts */
+    std::shared_ptr<EnsightVariableRegistry> variableRegistry_;
+
+    /** For each variable handle the index into variables_, or -1 */
+    std::vector<int> variableIndices_;
+
+    /** Variable bounds over all parts indexed by [timestep + 1][handle];
+     * index 0 holds the bounds over all timesteps. */
+    std::vector<std::vector<Matx>> variableBounds_;
+
+    /** Store deduplicating the arrays of all parts */
+    std::shared_ptr<EnsightBufferStore> bufferStore_;
+
+    /** Peak memory measured while reading, see setReadPeakBytes() */
+    int64_t readPeakBytes_;
+
+    /** Parameters of createSubdivTree(), used for the trees of all timesteps */
+    struct SubdivTreeParams
+    {
+        int maxDepth;
+        int maxElements;
+        QStringList partsToExclude;
+        double sizeOffset;
+        Ensight::SubdivTreeType type;
+        bool is2d;
+    };
+    SubdivTreeParams subdivTreeParams_;
+
+    /** For each timestep the SubdivTree, built on first access and possibly
+     * sharing its structure with other timesteps, see createSubdivTree() */
+    std::vector<EnsightLazy<std::shared_ptr<EnsightSubdivTree>>> subdivTrees_;
 };
 
 #endif // ENSIGHTOBJ_H
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef ENSIGHTPARALLEL_H
+#define ENSIGHTPARALLEL_H
+
+#include <cstdint>
+#include <functional>
+
+namespace Ensight
+{
+namespace Parallel
+{
+
+/**
+ * @brief Processes the index range [begin, end) in parallel.
+ *
+ * The range is split into chunks of grainSize indices which are distributed
+ * over the threads of a shared work-stealing pool, see setNumThreads(). Each
+ * thread processes its own chunks first and then steals chunks of others.
+ * For each chunk body(first, last) is called with the half-open subrange
+ * [first, last). The calling thread takes part and the call returns after all
+ * chunks have been processed.
+ *
+ * Ranges that fit into one chunk, calls in serial mode, nested calls from within
+ * body and calls while the pool is busy with another thread's range are
+ * processed on the calling thread.
+ *
+ * body is called concurrently and must only write to data owned by its chunk.
+ * If body sets EnsightObj::errorString() on a worker thread, the first such
+ * message is set on the calling thread when the call returns. If body throws,
+ * the remaining chunks are skipped and the first exception is rethrown on the
+ * calling thread after all threads have left the range.
+ * @param[in] begin First index
+ * @param[in] end One past the last index
+ * @param[in] grainSize Number of indices processed per call of body
+ * @param[in] body Function processing one chunk
+ */
+void parallelFor(int64_t begin, int64_t end, int64_t grainSize,
+                 const std::function<void(int64_t, int64_t)>& body);
+
+/**
+ * @brief Sets the number of threads used by parallelFor(), including the calling thread.
+ *
+ * 1 selects the serial mode, which never starts a worker thread, e.g. for
+ * MATLAB sessions and other embedded callers. numThreads <= 0 restores the
+ * default: the value of the environment variable ENSIGHT_NUM_THREADS if it is
+ * set, otherwise the number of hardware threads.
+ * Must not be called from within parallelFor().
+ * @param[in] numThreads Number of threads
+ */
+void setNumThreads(int numThreads);
+
+/**
+ * @brief Get the number of threads used by parallelFor(), see setNumThreads().
+ */
+int getNumThreads();
+
+/**
+ * @brief Stops and joins the worker threads.
+ *
+ * The workers are not joined at program exit, as that deadlocks while a DLL
+ * is unloaded on Windows. Call this before the library is unloaded, e.g. from
+ * the mexAtExit() handler of a MEX file. A later parallelFor() starts the
+ * workers again. Must not be called from within parallelFor().
+ */
+void shutdown();
+
+} // namespace Parallel
+} // namespace Ensight
+
+#endif // ENSIGHTPARALLEL_H
@@ -28,16 +28,25 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 #include <QString>
 #include <QVector>
 
 #include "eigentypes.h"
+#include "ensightbuffer.h"
 #include "ensightdef.h"
+#include "ensightfaceconnectivity.h"
+#include "ensightincidence.h"
+#include "ensightlazy.h"
+#include "ensightmeshview.h"
 
 class Bbox;
 class EnsightCell;
 class EnsightCellList;
+class EnsightBufferStore;
 class EnsightVariable;
+class EnsightVariableRegistry;
+struct EnsightMemoryReport;
 
 /**
  * @brief The EnsightPart class
@@ -45,8 +54,22 @@ class EnsightVariable;
 class EnsightPart
 {
 public:
-    EnsightPart(const QString& name, int id, int timesteps);
-    EnsightPart(const std::string& name, int id, int timesteps);
+    /**
+     * @brief Creates an EnsightPart.
+     * @param[in] name Part name
+     * @param[in] id Part id
+     * @param[in] timesteps Number of timesteps
+     * @param[in] registry Registry interning the variable names. Parts of the
+     * same EnsightObj share one registry. If null, the part uses its own.
+     * @param[in] store Store deduplicating vertex, cell and variable arrays.
+     * Parts of the same EnsightObj share one store. If null, the part uses its own.
+     */
+    EnsightPart(const QString& name, int id, int timesteps,
+                std::shared_ptr<EnsightVariableRegistry> registry = nullptr,
+                std::shared_ptr<EnsightBufferStore> store = nullptr);
+    EnsightPart(const std::string& name, int id, int timesteps,
+                std::shared_ptr<EnsightVariableRegistry> registry = nullptr,
+                std::shared_ptr<EnsightBufferStore> store = nullptr);
     ~EnsightPart();
 
 
@@ -67,12 +90,33 @@ public:
      * @brief Get the number of timesteps
      */
     int getNumberOfTimesteps() const;
+
+    /**
+     * @brief Checks if vertices, cells or variables of the given timestep were
+     * changed since the last call of resetModified().
+     *
+     * All timesteps of a new part count as modified.
+     * @param[in] timestep Timestep
+     */
+    bool isModified(int timestep) const;
+
+    /**
+     * @brief Marks all timesteps as unmodified.
+     *
+     * Called by EnsightObj::endEdit() after the part was verified.
+     */
+    void resetModified();
+
     /**
      * @brief Sets the vertices and boundaries at a given timestep
-     * @param[in] vertices A 3xN matrix containing N 3D vertices
+     *
+     * Vertices, cells and variables equal to arrays set before share their
+     * memory, see EnsightBufferStore.
+     * @param[in] vertices A 3xN matrix containing N 3D vertices. The data is
+     * shared, not copied.
      * @param[in] timestep Timestep
      */
-    void setVertices(const Matx& vertices, int timestep);
+    void setVertices(const MatxBuffer& vertices, int timestep);
 
     /**
      * @brief Print representation to given stream
@@ -86,9 +130,9 @@ public:
     /**
      * @brief Get all vertices at a given timestep
      * @param[in] timestep Timestep
-     * @return a 3xN matrix containing N 3D vertices.
+     * @return a view onto the 3xN matrix containing N 3D vertices.
      */
-    const Matx& getVertices(int timestep) const;
+    MatxView getVertices(int timestep) const;
 
     /**
      * @brief Get the geometric bounds of this part.
@@ -107,11 +151,14 @@ public:
     bool hasCellType(int timestep, Ensight::Cell c) const;
     /**
      * @brief Set cells of cell type 'type' at timestep
-     * @param[in] values Cell values
+     *
+     * If the cells equal the cells of the same type at an adjacent timestep, their
+     * neighbors and boundary are shared, see EnsightCellList::shareTopology().
+     * @param[in] values Cell values. The data is shared, not copied.
      * @param[in] timestep Timestep
      * @param[in] type Cell Type (See Ensight::Cell)
      */
-    void setCells(const Mati& values, int timestep, Ensight::Cell type);
+    void setCells(const MatiBuffer& values, int timestep, Ensight::Cell type);
     /**
      * @brief Get cells (of all types) at a given timestep
      * @param[in] timestep Timestep
@@ -125,6 +172,39 @@ public:
      * @return a EnsightCellList containing all cell of a certain cell type.
      */
     EnsightCellList* getCells(int timestep, Ensight::Cell type);
+    /**
+     * @brief Get the cells containing each vertex at a given timestep.
+     *
+     * The incidence covers all cell lists, in the order of getCells(). It is
+     * computed on first access and discarded when vertices or cells of the
+     * timestep change.
+     * @param[in] timestep Timestep
+     */
+    const EnsightVertexIncidence& getVertexIncidence(int timestep) const;
+    /**
+     * @brief Get the face neighbors and boundary of all cells at a given timestep.
+     *
+     * Unlike EnsightCellList::getNeighbors(), faces are matched across cell types.
+     * Cell lists are indexed in the order of getCells(). The connectivity is computed
+     * on first access and discarded when vertices or cells of the timestep change.
+     * @param[in] timestep Timestep
+     */
+    const EnsightFaceConnectivity& getFaceConnectivity(int timestep) const;
+    /**
+     * @brief Get a view onto all cells at a given timestep in one flat array.
+     *
+     * Cell lists appear in the order of getCells(). The view is created on first
+     * access and discarded when vertices or cells of the timestep change.
+     * @param[in] timestep Timestep
+     */
+    const EnsightMeshView& getMeshView(int timestep) const;
+    /**
+     * @brief Adds the memory of the vertex incidence, face connectivity and mesh view
+     * of a timestep to a report, if they have been computed.
+     * @param[in,out] report Report to extend, see EnsightObj::getMemoryReport()
+     * @param[in] timestep Timestep
+     */
+    void addMemoryUsage(EnsightMemoryReport& report, int timestep) const;
     /**
      * @brief Get the BBox of cell at a given timestep
      * @param[in] cell Cell
@@ -134,46 +214,82 @@ public:
     /**
      * @brief Sets the values of a variable at a given timestep
      * @param[in] name Variable name
-     * @param[in] values Value matrix
+     * @param[in] values Value matrix, see EnsightVariable::setValues()
      * @param[in] type Variable type (See Ensight::VarTypes)
      * @param[in] timestep Timestep
      */
-    void setVariable(const QString& name, const Matx& values, Ensight::VarTypes type, int timestep);
-    void setVariable(const std::string& name, const Matx& values, Ensight::VarTypes type, int timestep);
+    void setVariable(const QString& name, const MatxBuffer& values, Ensight::VarTypes type, int timestep);
+    void setVariable(const std::string& name, const MatxBuffer& values, Ensight::VarTypes type, int timestep);
     /**
-     * @brief Checks if the Ensight part contains a variable at a given timestep
+     * @brief Get the handle of a variable name, or -1 if the name is unknown.
+     *
+     * Handles are shared by all parts of an EnsightObj, see EnsightObj::getVariableHandle().
      * @param[in] name Variable name
+     */
+    int getVariableHandle(const QString& name) const;
+    int getVariableHandle(const std::string& name) const;
+    /**
+     * @brief Checks if the Ensight part contains a variable at a given timestep
+     *
+     * For timestep<0 all timesteps are checked.
+     * @param[in] name Variable name or handle
      * @param[in] timestep Timestep
      */
     bool hasVariable(const QString& name, int timestep) const;
     bool hasVariable(const std::string& name, int timestep) const;
+    bool hasVariable(int handle, int timestep) const;
     /**
      * @brief Get the value matrix of a variable at a given timestep
-     * @param[in] name Variable name
+     * @param[in] name Variable name or handle
      * @param[in] timestep Timestep
      */
-    const Matx& getVariableValues(const QString& name, int timestep);
-    const Matx& getVariableValues(const std::string& name, int timestep);
+    MatxView getVariableValues(const QString& name, int timestep) const;
+    MatxView getVariableValues(const std::string& name, int timestep) const;
+    MatxView getVariableValues(int handle, int timestep) const;
     /**
-     * @brief Get the EnsightVariable class of a variable by its name
-     * @param[in] name Variable name
+     * @brief Get the EnsightVariable class of a variable by its name or handle
+     *
+     * Returns NULL if the variable is not defined at the given timestep. The variable is read
+     * only, values are changed with setVariable() so that the part is marked modified.
+     * @param[in] name Variable name or handle
      * @param[in] timestep Timestep
      */
-    EnsightVariable* getVariable(const QString& name, int timestep);
-    EnsightVariable* getVariable(const std::string& name, int timestep);
+    const EnsightVariable* getVariable(const QString& name, int timestep) const;
+    const EnsightVariable* getVariable(const std::string& name, int timestep) const;
+    const EnsightVariable* getVariable(int handle, int timestep) const;
     /**
      * @brief Get the boundaries of a variable.
      *
      * If timestep is <0 the function will return the combined boundaries over
      * all timesteps.
      * By setting timestep to 0 or >0, you can get the boundaries of a certain timestep.
-     * @param[in] name Variable name
+     * The bounds are cached and updated by setVariable() and clean(). An empty
+     * matrix is returned if the variable is not defined.
+     * @param[in] name Variable name or handle
      * @param[in] timestep Timestep
      */
-    Matx getVariableBounds(const QString& name, int timestep);
-    Matx getVariableBounds(const std::string& name, int timestep);
+    const Matx& getVariableBounds(const QString& name, int timestep) const;
+    const Matx& getVariableBounds(const std::string& name, int timestep) const;
+    const Matx& getVariableBounds(int handle, int timestep) const;
 
 private:
+    EnsightVariable* variableAt(int handle, int timestep) const;
+
+    /**
+     * @brief Get the cell lists of a timestep in the order of getCells().
+     */
+    QList<const EnsightCellList*> getCellLists(int timestep) const;
+
+    /**
+     * @brief Discards all data derived from the vertices and cells of a timestep.
+     */
+    void invalidateTopology(int timestep);
+
+    /**
+     * @brief Recomputes the bounds of a variable over all timesteps.
+     */
+    void updateVariableBounds(int handle);
+
     /**
      * @brief name_ The name of this part, e.g. the name specified in *.case file
      */
@@ -189,6 +305,11 @@ private:
      */
     int timesteps_;
 
+    /**
+     * @brief modified For each timestep a flag if its data changed, see isModified()
+     */
+    QVector<bool> modified_;
+
     /**
      * @brief bounds For each timestep a axes aligned bounding box.
      */
@@ -197,19 +318,49 @@ private:
     /**
      * @brief vertices For each timestep i a 3xN_i matrix containing N_i 3d vertices
      */
-    QVector<Matx> vertices_;
+    QVector<MatxBuffer> vertices_;
 
     /**
-     * @brief variables Set of variables.
-     * For each timestep we store multiple variables
+     * @brief registry Interns variable names to the handles indexing variables_
      */
-    std::multimap<int, std::unique_ptr<EnsightVariable>> variables_;
+    std::shared_ptr<EnsightVariableRegistry> registry_;
+
+    /**
+     * @brief store Deduplicates the vertex, cell and variable arrays
+     */
+    std::shared_ptr<EnsightBufferStore> store_;
+
+    /**
+     * @brief variables Dense table of variables indexed by [timestep][handle].
+     * Entries are null where the variable is not defined.
+     */
+    std::vector<std::vector<std::unique_ptr<EnsightVariable>>> variables_;
+
+    /**
+     * @brief variableBounds For each variable handle the bounds over all timesteps
+     */
+    std::vector<Matx> variableBounds_;
 
     /**
      * @brief cells set of cells.
      * For each time step we store multiple cells.
      */
     std::multimap<int, std::unique_ptr<EnsightCellList>> cells_;
+
+    /**
+     * @brief incidence For each timestep the lazily computed vertex to cell incidence
+     */
+    std::vector<EnsightLazy<EnsightVertexIncidence>> incidence_;
+
+    /**
+     * @brief faceConnectivity For each timestep the lazily computed face connectivity of all cells
+     */
+    std::vector<EnsightLazy<EnsightFaceConnectivity>> faceConnectivity_;
+
+    /**
+     * @brief meshView For each timestep the lazily created view onto all cells
+     */
+    std::vector<EnsightLazy<EnsightMeshView>> meshView_;
 };
 
 #endif // ENSIGHTPART_H
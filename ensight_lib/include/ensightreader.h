@@ -122,7 +122,7 @@ namespace Reader
  * Then the referred geometry and variable files are also read and
  * an EnsightObj is returned;
  *
- * In case of any error NULL is returned. See EnsightObj::ERROR_STR for
+ * In case of any error NULL is returned. See EnsightObj::errorString() for
  * more details in this case.
  *
  * The reader has some limitations:
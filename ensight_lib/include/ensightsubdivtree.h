@@ -25,15 +25,21 @@
 #define ENSIGHTSUBDIVTREE_H
 
 #include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <iosfwd>
 #include <memory>
 #include <QList>
 #include <QVector>
 
 #include "bbox.h"
+#include "ensightcellrecords.h"
+#include "ensightkdtree.h"
 
 class EnsightCellIdentifier;
 class EnsightBarycentricCoordinates;
 class EnsightPart;
+struct EnsightMemoryReport;
 
 /**
  * @brief The EnsightSubdivTree class provides the interface to a spatial
@@ -47,7 +53,11 @@ class EnsightPart;
 class EnsightSubdivTree
 {
 public:
-    EnsightSubdivTree();
+    /**
+     * @param ignore2dCells Ignore triangles and quadrangles in search(), used
+     * for 3D data sets
+     */
+    explicit EnsightSubdivTree(bool ignore2dCells);
     virtual ~EnsightSubdivTree() = 0;
 
     /**
@@ -63,6 +73,74 @@ public:
      */
     virtual EnsightCellIdentifier* search(const Vec3& pos,
                                           EnsightBarycentricCoordinates& baryCoordout) const = 0;
+    /**
+     * @brief Find the cell containing a given spatial position, starting at a
+     * cell close to it.
+     *
+     * Starting at hint, e.g. the result of the previous query of a particle
+     * path, the search walks across the face neighbors of the cells towards
+     * pos. If no containing cell is found within maxSteps steps, the tree is
+     * searched instead. For positions close to a face shared by several cells,
+     * the result may differ from search(pos, baryCoordOut).
+     * @param[in] pos The position as 3D coordinates
+     * @param[out] baryCoordOut The barycentric coordinates of position pos with
+     * respect to the returned cell
+     * @param[in] hint A cell returned by this tree or nullptr
+     * @param[in] maxSteps The maximum number of neighbors visited
+     */
+    EnsightCellIdentifier* search(const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut,
+                                  const EnsightCellIdentifier* hint, int maxSteps = 16) const;
+    /**
+     * @brief Find the cells containing many spatial positions, in parallel.
+     *
+     * The positions are processed in Morton order, so that consecutive
+     * queries visit the same nodes and cells. The results are returned in
+     * the order of the positions.
+     * @param[in] positions The positions as 3xN matrix
+     * @param[out] baryCoordsOut The barycentric coordinates of each position
+     * with respect to the returned cell
+     * @return The cell containing each position, nullptr if no cell contains it
+     */
+    QVector<EnsightCellIdentifier*> search(const Eigen::Ref<const Matx>& positions,
+                                           QVector<EnsightBarycentricCoordinates>& baryCoordsOut) const;
+
+    /**
+     * @brief Find the cell closest to a spatial position, also if no cell
+     * contains it.
+     *
+     * If a cell contains pos, it is returned as by search() with distance 0.
+     * Otherwise the cells containing one of the 8 vertices closest to pos,
+     * see getVertexTree(), give an upper bound of the distance. The tree is
+     * then searched for all cells whose bounding box is closer, so that also
+     * large faces whose vertices are far away are found. The cell with the
+     * closest point is returned, see EnsightCellRecords::project(). The
+     * barycentric coordinates then interpolate that point, so that data is
+     * extended constantly beyond the boundary. Points and bars are found this
+     * way only, as they contain no volume.
+     * @param[in] pos The position as 3D coordinates
+     * @param[out] baryCoordOut The barycentric coordinates of pos or its
+     * closest point with respect to the returned cell
+     * @param[out] distanceOut The distance of pos to the returned cell
+     * @return nullptr if the tree contains no cells
+     */
+    EnsightCellIdentifier* searchNearest(const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut,
+                                         double& distanceOut) const;
+    /**
+     * @brief Find the cells closest to many spatial positions, in parallel.
+     * See searchNearest().
+     * @param[in] positions The positions as 3xN matrix
+     * @param[out] baryCoordsOut The barycentric coordinates of each position
+     * @param[out] distancesOut The distance of each position to its cell
+     */
+    QVector<EnsightCellIdentifier*> searchNearest(const Eigen::Ref<const Matx>& positions,
+                                                  QVector<EnsightBarycentricCoordinates>& baryCoordsOut,
+                                                  QVector<double>& distancesOut) const;
+
+    /**
+     * @brief Get the KD-tree over the vertices of the inserted parts, built
+     * on the first query.
+     */
+    const EnsightKdTree& getVertexTree() const;
 
     /**
      * @brief Find all cells whose bounding box contain the given position.
@@ -78,14 +156,114 @@ public:
      * searchAll.
      */
     virtual void insert(EnsightPart* part, int timestep, double sizeOffset = 0.0) = 0;
+    /**
+     * @brief Build the tree from all inserted cells. Otherwise, the tree is
+     * built on the first query after insert().
+     */
+    virtual void build() = 0;
+    /**
+     * @brief Build the tree from all inserted cells, reusing the structure of
+     * another tree of the same kind that holds the same cells at other
+     * positions, e.g. the tree of an earlier timestep of a moving mesh. Only
+     * the bounds are recomputed, which is faster than build() but the tree
+     * gets less efficient the farther the cells moved.
+     * @param base The tree to reuse the structure of
+     * @return false if this kind of tree can't be refit or base holds other
+     * cells. Call build() then.
+     */
+    virtual bool refit(const EnsightSubdivTree& base) = 0;
+    /**
+     * @brief Creates a tree of the same kind holding the same cells at
+     * another timestep with the same vertices and cells, e.g. of a static
+     * mesh. The nodes, cell bounds and vertex tree are shared and built once,
+     * the identifiers returned by the new tree refer to timestep.
+     * @param timestep The timestep of the new tree
+     */
+    virtual std::shared_ptr<EnsightSubdivTree> share(int timestep) const = 0;
+    /**
+     * @brief Writes the structure of the tree in a binary format, see read().
+     * The cells are not written, only their indices in insertion order.
+     * @return false if writing failed
+     */
+    virtual bool write(std::ostream& out) const = 0;
+    /**
+     * @brief Reads the structure written by write() instead of building the
+     * tree. The same cells must have been inserted in the same order, and the
+     * tree must be of the same kind and have the same parameters.
+     * @return false if the data is incomplete or doesn't match the inserted
+     * cells. The tree is then built on the next query.
+     */
+    virtual bool read(std::istream& in) = 0;
     /**
      * @brief get the bounding box of the cells contained in the tree.
      */
     virtual Bbox getBounds() const = 0;
+
+    /**
+     * @brief Adds the memory used by the nodes, leaf index arrays, cell
+     * records and cell identifiers of the tree to a report.
+     */
+    virtual void addMemoryUsage(EnsightMemoryReport& report) const = 0;
+
+protected:
+    /**
+     * @brief Writes an array and pads it to a multiple of 8 bytes, so that
+     * all arrays of a file are aligned.
+     */
+    static void writeBlock(std::ostream& out, const void* data, size_t bytes);
+    /**
+     * @brief Reads an array written by writeBlock().
+     */
+    static bool readBlock(std::istream& in, void* data, size_t bytes);
+    /**
+     * @brief Checks if the stream holds the given blocks written by
+     * writeBlock() after the current position, before memory is allocated for
+     * them. The sizes are in bytes, without padding.
+     */
+    static bool hasBlocks(std::istream& in, std::initializer_list<uint64_t> sizes);
+
+    /**
+     * @brief Finds the cell closest to a position among the cells whose
+     * bounding box is closer than minDistance, using testNearestCell().
+     * @param[in] pos The position
+     * @param[in,out] minDistance The distance of nearest, decreased if a
+     * closer cell is found
+     * @param[in,out] nearest The closest cell found so far
+     */
+    virtual void findNearestCell(const Vec3& pos, double& minDistance,
+                                 EnsightCellRecords::Index& nearest) const = 0;
+    /**
+     * @brief Replaces nearest by cell if it is closer than minDistance. The
+     * distance is only computed if the bounding box of the cell is closer.
+     */
+    void testNearestCell(EnsightCellRecords::Index cell, const Vec3& pos, double& minDistance,
+                         EnsightCellRecords::Index& nearest) const;
+
+    /**
+     * @brief The inserted cells, shared by all implementations
+     */
+    EnsightCellRecords cells_;
+
+    /**
+     * @brief The vertices of the inserted parts, used by searchNearest()
+     */
+    EnsightKdTree vertexTree_;
+
+    /**
+     * @brief Ignore triangles and quadrangles in search()
+     */
+    bool ignore2dCells_;
+
+    /**
+     * @brief Set for trees created by share(), whose shared structure is not
+     * counted by addMemoryUsage()
+     */
+    bool isShared_;
 };
 
 // forward declarations
 template <typename Node> class SubdivTreeImpl;
+class EnsightBvh;
 class QuadtreeNode;
 class OctreeNode;
 
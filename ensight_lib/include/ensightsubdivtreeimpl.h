@@ -25,11 +25,16 @@
 #define SUBDIVTREEIMPL_H
 
 #include <array>
+#include <limits>
 #include <memory>
+#include <vector>
 #include <QList>
 #include <QVector>
 
 #include "bbox.h"
+#include "ensightcellrecords.h"
+#include "ensightlazy.h"
+#include "ensightleafbounds.h"
 #include "ensightsubdivtree.h"
 
 class EnsightCellIdentifier;
@@ -38,32 +43,87 @@ class EnsightPart;
 
 
 // **** template class SubdivTreeImpl ****
+/**
+ * The tree is stored in a linearized layout: all nodes are kept in one array in
+ * breadth-first order, the children of an inner node are stored consecutively
+ * in Morton order (see Node::findChild), and the cell indices of all leaves are
+ * packed into a single array. The node bounds are not stored but recomputed
+ * while descending from the root. The cells are stored as EnsightCellRecords,
+ * identifiers are only created for the cells returned by a query. The cell
+ * bounding boxes are also stored quantized in leaf order, so that the cells of
+ * a leaf are rejected several at a time before the exact test.
+ *
+ * insert() only collects the cells, the layout is built in parallel by build()
+ * or on the first query after an insert.
+ */
 template <typename Node> class SubdivTreeImpl : public EnsightSubdivTree
 {
 public:
     SubdivTreeImpl(Bbox bounds, int maxLevel, int maxCells);
     ~SubdivTreeImpl();
 
+    using EnsightSubdivTree::search;
     EnsightCellIdentifier* search(const Vec3& pos,
                                   EnsightBarycentricCoordinates& baryCoordOut) const override;
 
     QList<EnsightCellIdentifier*> searchAll(const Vec3& pos) const override;
 
     void insert(EnsightPart* part, int timestep, double sizeOffset = 0.0) override;
+    void build() override;
+    /**
+     * @brief Cells that moved may belong to other nodes, the tree is not
+     * refit. Returns false.
+     */
+    bool refit(const EnsightSubdivTree& base) override;
+    std::shared_ptr<EnsightSubdivTree> share(int timestep) const override;
+    bool write(std::ostream& out) const override;
+    bool read(std::istream& in) override;
 
     Bbox getBounds() const override;
-    const Node& getRoot() const;
+    void addMemoryUsage(EnsightMemoryReport& report) const override;
+
+    /**
+     * @brief Get the number of nodes, including inner nodes.
+     */
+    int getNumberOfNodes() const;
+    /**
+     * @brief Get the bounds of all leaves, e.g. to display the tree.
+     */
+    QVector<Bbox> getLeafBounds() const;
 
 private:
-    using Index = uint32_t;
-    using IndexContainer = QVector<Index>;
-    using CellContainer = QVector<EnsightCellIdentifier*>;
-    //using Index = typename Node::Index;
-    //using IndexContainer = typename Node::IndexContainer;
-    //using CellContainer = typename Node::CellContainer;
-
-    std::unique_ptr<Node> root_;
-    CellContainer allCells_;
+    using Index = EnsightCellRecords::Index;
+    using IndexContainer = std::vector<Index>;
+
+    static const Index InnerNode = std::numeric_limits<Index>::max();
+
+    /**
+     * @brief A node of the linearized tree. Inner nodes store the index of their
+     * first child and count == InnerNode, leaves store the range
+     * [first, first+count) in Layout::leafCells.
+     */
+    struct LinearNode
+    {
+        Index first;
+        Index count;
+    };
+
+    struct Layout
+    {
+        std::vector<LinearNode> nodes;
+        IndexContainer leafCells;
+        EnsightLeafBounds leafBounds;
+    };
+
+    void findNearestCell(const Vec3& pos, double& minDistance, Index& nearest) const override;
+
+    const Layout& getLayout() const;
+    Layout buildLayout() const;
+    void quantizeLeafBounds(Layout& layout) const;
+    bool cellIntersects(Index cellIdx, const Bbox& bounds) const;
+
+    Bbox bounds_;
+    EnsightLazy<Layout> layout_;
     int maxLevel_;
     int maxCells_;
 
@@ -71,66 +131,27 @@ private:
 
 
 
-// **** template class NodeBase ****
-template <int N, typename Derived> class NodeBase
-{
-protected:
-    using Index = uint32_t;
-    using IndexContainer = QVector<Index>;
-    using CellContainer = QVector<EnsightCellIdentifier*>;
-
-public:
-
-    NodeBase();
-    NodeBase(Bbox bounds);
-
-    const Bbox& getBounds() const;
-    void setBounds(Bbox bounds);
-
-    using Children = std::unique_ptr<std::array<Derived, N>>;
-    bool hasChildren() const;
-    const Children& getChildren() const;
-
-    void insert(Index cellIdx, const CellContainer& cells, int maxLevel,
-                int maxCells, int level);
-
-    ptrdiff_t search(const Vec3& pos, EnsightBarycentricCoordinates &baryCoordOut,
-                     const CellContainer& cells) const;
-    QList<ptrdiff_t> searchAll(const Vec3& pos,
-                               const CellContainer& cells) const;
-
-private:
-    Bbox boundsForSubNode(int SubNode) const;
-    void allocateChildren();
-    void distributeCellsToChildren(const CellContainer& cells, int maxLevel,
-                                   int maxCells, int level);
-    bool cellIntersects(EnsightCellIdentifier* c) const;
-
-
-    Children children_;
-    IndexContainer cells_;
-    Bbox bounds_;
-};
-
 // **** Actual Quad-/OctreeNode classes
-class QuadtreeNode : public NodeBase<4, QuadtreeNode>
+/**
+ * The node classes describe how a node is subdivided, the nodes themselves are
+ * stored by SubdivTreeImpl.
+ */
+class QuadtreeNode
 {
 public:
-    QuadtreeNode() = default;
-    QuadtreeNode(Bbox bounds) : NodeBase<4, QuadtreeNode>(bounds) {}
-    const QuadtreeNode* findChild(const Vec3 &pos, const Vec3 &mid) const;
-    Bbox boundsForSubNode(int subNode) const;
+    static const int N = 4;
+    static int findChild(const Vec3& pos, const Vec3& mid);
+    static Bbox boundsForSubNode(const Bbox& bounds, int subNode);
 
     static const bool ignore2dCells = false;
 };
 
-class OctreeNode : public NodeBase<8, OctreeNode>
+class OctreeNode
 {
 public:
-    OctreeNode() = default;
-    OctreeNode(Bbox bounds) : NodeBase<8, OctreeNode>(bounds) {}
-    const OctreeNode* findChild(const Vec3 &pos, const Vec3 &mid) const;
-    Bbox boundsForSubNode(int SubNode) const;
+    static const int N = 8;
+    static int findChild(const Vec3& pos, const Vec3& mid);
+    static Bbox boundsForSubNode(const Bbox& bounds, int subNode);
 
     static const bool ignore2dCells = true;
 };
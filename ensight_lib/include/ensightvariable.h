@@ -24,13 +24,20 @@
 #ifndef ENSIGHTVARIABLE_H
 #define ENSIGHTVARIABLE_H
 
+#include <deque>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
+#include <QHash>
 #include <QString>
 
 #include "eigentypes.h"
+#include "ensightbuffer.h"
 #include "ensightdef.h"
 
+class EnsightBufferStore;
+
 /**
  * @brief Identifies a variable name with an variable type.
  */
@@ -85,24 +92,47 @@ public:
     /**
      * @brief Set the variable values.
      *
-     * For 3D variables the input is a 4xN matrix where N is the number of nodes.
-     * The four values are x,y,z and norm of (x,y,z).
-     * For 1D variables the input is a 1xN mattrix.
+     * For 3D variables the input is a 3xN matrix where N is the number of nodes.
+     * The values are stored as 4xN matrix with x,y,z and norm of (x,y,z).
+     * A 4xN matrix already in this layout is adopted without copying. If its
+     * 4th row is not the norm of (x,y,z), the norm is recomputed into a copy.
+     * For 1D variables the input is a 1xN mattrix, which is adopted without copying.
+     * The bounds are computed in the same pass over the values.
      * @param[in] newValues Value matrix
      */
-    void setValues(const Matx& newValues);
-    const Matx& getValues() const;
+    void setValues(const MatxBuffer& newValues);
+    /**
+     * @brief Replaces the values by an identical array of the store, if any, to share its memory.
+     * @param[in] store Store of the parent EnsightObj
+     */
+    void shareValues(EnsightBufferStore& store);
+    MatxView getValues() const;
     const Matx& getBounds() const;
 
+    /**
+     * @brief Extends bounds by other bounds, see getBounds().
+     *
+     * Empty bounds are ignored or replaced by the other bounds.
+     * @param[in,out] bounds Bounds to extend
+     * @param[in] other Bounds to merge
+     */
+    static void mergeBounds(Matx& bounds, const Matx& other);
+
 
 private:
+    /**
+     * @brief Stores x,y,z of the first three rows of input and their norm.
+     * @param[in] input 3xN or 4xN matrix of vector values
+     */
+    void setVectorValues(const Eigen::Ref<const Matx>& input);
+
     /**
      * @brief values for 3d variables this is a 4xN matrix, where N is the number of nodes in this part
      * The 4 values are x,y,z and norm of the vector((x,y,z))
      *
      * For 1d variables this is a 1xN matrix
      */
-    Matx values_;
+    MatxBuffer values_;
 
     /**
      * @brief minValue Either a 1x2 or a 4x2 vector, see definition of values.
@@ -112,4 +142,46 @@ private:
     Matx bounds_;
 };
 
+/**
+ * @brief The EnsightVariableRegistry class interns variable names to dense
+ * integer handles.
+ *
+ * An EnsightObj shares one registry with all of its parts, so a handle refers
+ * to the same variable in every part. Handles are assigned in the order names
+ * are first seen, starting at zero, and stay valid for the lifetime of the
+ * registry. All methods are thread-safe, so that different parts of an object
+ * can be filled from different threads.
+ */
+class EnsightVariableRegistry
+{
+public:
+    /**
+     * @brief Get the handle of a name, assigning a new handle if the name is unknown.
+     */
+    int intern(const QString& name);
+
+    /**
+     * @brief Get the handle of a name or -1 if the name is unknown.
+     */
+    int find(const QString& name) const;
+    int find(const std::string& name) const;
+
+    /**
+     * @brief Get the name for a handle. The reference stays valid when other
+     * names are interned.
+     */
+    const QString& getName(int handle) const;
+
+    /**
+     * @brief Get the number of interned names.
+     */
+    int size() const;
+
+private:
+    mutable std::mutex mutex_;
+    QHash<QString, int> handles_;
+    std::unordered_map<std::string, int> stdHandles_;
+    std::deque<QString> names_;
+};
+
 #endif // ENSIGHTVARIABLE_H
@@ -22,6 +22,7 @@
 
 
 #include "../include/bbox.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
@@ -64,6 +65,18 @@ bool Bbox::intersects(const Bbox& other) const
     return result;
 }
 
+double Bbox::squaredDistance(const Vec3& pos) const
+{
+    double distSq = 0.0;
+    for (int d = 0; d < 3; d++)
+    {
+        const double diff = std::max(min_[d] - pos[d], pos[d] - max_[d]);
+        if (diff > 0.0)
+            distSq += diff * diff;
+    }
+    return distSq;
+}
+
 const Vec3 Bbox::center() const
 {
     return (min_+max_)/2.;
@@ -22,6 +22,7 @@
 
 #include "../include/ensightasciireader.h"
 
+#include <utility>
 #include <QFile>
 
 #include "../include/ensightbinaryreader.h"
@@ -66,7 +67,7 @@ bool readAsciiGeometry(EnsightObj& ensight, const QString& filename, int timeste
     QFile file(filename);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
     {
-        EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readGeometry()] Cannot open file " + filename;
+        EnsightObj::errorString() = "In [EnsightAsciiReader::readGeometry()] Cannot open file " + filename;
         return false;
     }
 
@@ -110,7 +111,7 @@ bool readAsciiGeometryTimeStep(EnsightObj& ensight, QFile& file, int timestep)
 
     if (!parseAsciiHeader(file, nodeIdMode, elementIdMode))
     {
-        EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readGeometry()] Invalid file header.";
+        EnsightObj::errorString() = "In [EnsightAsciiReader::readGeometry()] Invalid file header.";
         return false;
     }
 
@@ -145,7 +146,7 @@ bool readAsciiGeometryTimeStep(EnsightObj& ensight, QFile& file, int timestep)
                 if (!part || part->getId() != part_id)
                 {
                     QString name = part ? part->getName() : part_name;
-                    EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readGeometry()] Mismatch between time steps and part name / id for part <" + name + ">.";
+                    EnsightObj::errorString() = "In [EnsightAsciiReader::readGeometry()] Mismatch between time steps and part name / id for part <" + name + ">.";
                     return false;
                 }
             }
@@ -160,7 +161,7 @@ bool readAsciiGeometryTimeStep(EnsightObj& ensight, QFile& file, int timestep)
         {
             if (!part)
             {
-                EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readGeometry()] at line <" + line + ">.";
+                EnsightObj::errorString() = "In [EnsightAsciiReader::readGeometry()] at line <" + line + ">.";
                 return false;
             }
             // read vertex  count
@@ -185,12 +186,12 @@ bool readAsciiGeometryTimeStep(EnsightObj& ensight, QFile& file, int timestep)
                     vertices(i, j) = bytes.toDouble(&conversionOk);
                     if (!conversionOk)
                     {
-                        EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readGeometry()] invalid value <" + bytes + ">.";
+                        EnsightObj::errorString() = "In [EnsightAsciiReader::readGeometry()] invalid value <" + bytes + ">.";
                         return false;
                     }
                 }
             }
-            part->setVertices(vertices, timestep);
+            part->setVertices(std::move(vertices), timestep);
         }
         else
         {
@@ -205,7 +206,7 @@ bool readAsciiGeometryTimeStep(EnsightObj& ensight, QFile& file, int timestep)
             }
             if (cellType == Ensight::Unknown)
             {
-                EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readGeometry()] at line <" + line + ">. Unknown cell type identifier";
+                EnsightObj::errorString() = "In [EnsightAsciiReader::readGeometry()] at line <" + line + ">. Unknown cell type identifier";
                 return false;
             }
 
@@ -233,12 +234,12 @@ bool readAsciiGeometryTimeStep(EnsightObj& ensight, QFile& file, int timestep)
                     cells(j, i) = bytes.toInt(&conversionOk) - 1;
                     if (!conversionOk)
                     {
-                        EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readGeometry()] invalid value <" + lineBytes + ">.";
+                        EnsightObj::errorString() = "In [EnsightAsciiReader::readGeometry()] invalid value <" + lineBytes + ">.";
                         return false;
                     }
                 }
             }
-            ensight.setCells(part, cells, timestep, cellType);
+            ensight.setCells(part, std::move(cells), timestep, cellType);
         }
     }
     return true;
@@ -253,7 +254,7 @@ bool readAsciiVariable(EnsightObj& ensight, const QString& filename,
     QFile file(filename);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
     {
-        EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readVariable()] Cannot open file " + filename;
+        EnsightObj::errorString() = "In [EnsightAsciiReader::readVariable()] Cannot open file " + filename;
         return false;
     }
 
@@ -311,7 +312,7 @@ bool readAsciiVariableTimeStep(EnsightObj& ensight, QFile& file,
             EnsightPart* part = ensight.getPartById(part_id);
             if (!part || part->getId() != part_id)
             {
-                EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readVariable()] Part with ID <" + QString::number(part_id) + "> not defined in geometry file.";
+                EnsightObj::errorString() = "In [EnsightAsciiReader::readVariable()] Part with ID <" + QString::number(part_id) + "> not defined in geometry file.";
                 return false;
             }
 
@@ -319,12 +320,12 @@ bool readAsciiVariableTimeStep(EnsightObj& ensight, QFile& file,
             line = file.readLine().trimmed();
             if (!line.startsWith("coordinates"))
             {
-                EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readVariable()] keyword >coordinates> expected at line<" + line + ">.";
+                EnsightObj::errorString() = "In [EnsightAsciiReader::readVariable()] keyword >coordinates> expected at line<" + line + ">.";
                 return false;
             }
             if (line.contains("undef") || line.contains("partial"))
             {
-                EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readVariable()] <undef> and <partial> variable values are not supported.";
+                EnsightObj::errorString() = "In [EnsightAsciiReader::readVariable()] <undef> and <partial> variable values are not supported.";
                 return false;
             }
 
@@ -341,12 +342,12 @@ bool readAsciiVariableTimeStep(EnsightObj& ensight, QFile& file,
                     values(i, j) = bytes.toDouble(&conversionOk);
                     if (!conversionOk)
                     {
-                        EnsightObj::ERROR_STR = "In [EnsightAsciiReader::readVariable()] invalid value <" + line + ">.";
+                        EnsightObj::errorString() = "In [EnsightAsciiReader::readVariable()] invalid value <" + line + ">.";
                         return false;
                     }
                 }
             }
-            ensight.setVariable(part, name, values, type, timestep);
+            ensight.setVariable(part, name, std::move(values), type, timestep);
         }
     }
     return true;
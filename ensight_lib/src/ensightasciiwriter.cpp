@@ -91,7 +91,7 @@ bool writeAsciiVar(EnsightObj* ensight, const QString& name, const QString& var,
     QFile file(filename);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "ERROR in [writeAsciiVar()] Unable to open file <" +
             file.fileName() + ">";
         return false;
@@ -110,7 +110,7 @@ bool writeAsciiVar(EnsightObj* ensight, const QString& name, const QString& var,
         out << QString("%0\n").arg(part->getId(), 10, 10, QLatin1Char(' '));
         out << "coordinates\n";
         // Write variable values for each node
-        Matx values = part->getVariableValues(var, timestep);
+        MatxView values = part->getVariableValues(var, timestep);
         for (int j = 0; j < dim; j++)
             for (int k = 0; k < values.cols(); k++)
                 out << QString("%0\n").arg(values(j, k), 12, 'e', 5, ' ');
@@ -135,7 +135,7 @@ bool writeAsciiGeo(EnsightObj* ensight, const QString& name,
     QFile file(filename);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "ERROR IN [writeAsciiGeo()] Unable to open file <" +
             file.fileName() + ">";
         return false;
@@ -161,7 +161,7 @@ bool writeAsciiGeo(EnsightObj* ensight, const QString& name,
             out << "coordinates\n";
 
             // Vertices
-            Matx vertices = part->getVertices(timestep);
+            MatxView vertices = part->getVertices(timestep);
 
             // Write number of vertices
             out << QString("%0\n").arg(vertices.cols(), 10, 10, QLatin1Char(' '));
@@ -176,7 +176,7 @@ bool writeAsciiGeo(EnsightObj* ensight, const QString& name,
             for (auto cell : cells)
             {
                 Ensight::Cell type = cell->getType();
-                Mati values = cell->getValues();
+                MatiView values = cell->getValues();
 
                 // Write cell type
                 out << Ensight::strCell[type] << "\n";
@@ -90,6 +90,28 @@ bool EnsightBarycentricCoordinates::compute(const Vec3& pos, const EnsightCellId
     return computeIsInside();
 }
 
+void EnsightBarycentricCoordinates::set(const Vecx& coords, const Vec3& pos,
+                                        const EnsightCellIdentifier* cell)
+{
+    baryCoords_ = coords;
+    pos_ = pos;
+    cell_ = cell;
+    isComputationSuccessful_ = true;
+}
+
+void EnsightBarycentricCoordinates::setCell(const EnsightCellIdentifier* cell)
+{
+    cell_ = cell;
+}
+
+void EnsightBarycentricCoordinates::reset()
+{
+    baryCoords_.resize(0);
+    pos_.setZero();
+    cell_ = nullptr;
+    isComputationSuccessful_ = false;
+}
+
 bool EnsightBarycentricCoordinates::computeIsInside()
 {
     for (int i = 0; i < baryCoords_.rows(); ++i)
@@ -111,19 +133,24 @@ Vecx EnsightBarycentricCoordinates::evaluate(const QString& name) const
 {
     if (!cell_)
         return Vecx();
-    const Matx& data = cell_->getValues(name);
-    return evaluate(data);
+    return evaluate(cell_->getValues(name));
 }
 
 Vecx EnsightBarycentricCoordinates::evaluate(const std::string& name) const
 {
     if (!cell_)
         return Vecx();
-    const Matx& data = cell_->getValues(QString::fromStdString(name));
-    return evaluate(data);
+    return evaluate(cell_->getValues(name));
+}
+
+Vecx EnsightBarycentricCoordinates::evaluate(int handle) const
+{
+    if (!cell_)
+        return Vecx();
+    return evaluate(cell_->getValues(handle));
 }
 
-Vecx EnsightBarycentricCoordinates::evaluate(const Matx &data) const
+Vecx EnsightBarycentricCoordinates::evaluate(const Eigen::Ref<const Matx>& data) const
 {
     Vecx value(data.rows());
     value.setZero();
@@ -27,8 +27,11 @@
 #include <cstdint>
 #include <fstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "../include/ensightobj.h"
+#include "../include/ensightparallel.h"
 #include "../include/ensightpart.h"
 #include "../include/ensightreader.h"
 
@@ -94,9 +97,37 @@ void readInt(std::istream& in, int32_t& value)
     in.read(reinterpret_cast<char*>(&value), sizeof(int32_t));
 }
 
-void readFloat(std::istream& in, float& value)
+/**
+ * @brief Reads a block of floats stored row by row, e.g. all x, then all y coordinates.
+ */
+void readFloatRows(std::istream& in, Matx& values)
+{
+    const Eigen::Index rows = values.rows();
+    const Eigen::Index cols = values.cols();
+    std::vector<float> buffer(rows * cols);
+    in.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(float));
+
+    Ensight::Parallel::parallelFor(0, cols, 16384, [&](int64_t first, int64_t last) {
+        for (Eigen::Index i = 0; i < rows; i++)
+            for (int64_t j = first; j < last; j++)
+                values(i, j) = buffer[i * cols + j];
+    });
+}
+
+/**
+ * @brief Reads a block of one based vertex indices stored cell by cell.
+ */
+void readIndices(std::istream& in, Mati& cells)
 {
-    in.read(reinterpret_cast<char*>(&value), sizeof(float));
+    static_assert(sizeof(int) == sizeof(int32_t), "int has the wrong size");
+    in.read(reinterpret_cast<char*>(cells.data()), cells.size() * sizeof(int32_t));
+
+    // convert to zero based index
+    int* indices = cells.data();
+    Ensight::Parallel::parallelFor(0, cells.size(), 65536, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            indices[i]--;
+    });
 }
 
 IdMode parseIdType(const char* line, const char* idTypePrefix)
@@ -165,7 +196,7 @@ bool readBinaryGeometry(EnsightObj& ensight, const QString& filename,
 
     if(!in.is_open())
     {
-        EnsightObj::ERROR_STR = "In [EnsightBinaryReader::readGeometry()] Cannot open file <" + filename + ">";
+        EnsightObj::errorString() = "In [EnsightBinaryReader::readGeometry()] Cannot open file <" + filename + ">";
         return false;
     }
 
@@ -173,7 +204,7 @@ bool readBinaryGeometry(EnsightObj& ensight, const QString& filename,
     // transient single files.
     if (!parseBinaryFormatHeader(in))
     {
-        EnsightObj::ERROR_STR =  "In [EnsightBinaryReader::readGeometry()] Invalid file header.";
+        EnsightObj::errorString() =  "In [EnsightBinaryReader::readGeometry()] Invalid file header.";
         return false;
     }
 
@@ -221,7 +252,7 @@ bool readBinaryGeometryTimeStep(EnsightObj& ensight, std::ifstream& in, int time
 
     if (!parseBinaryGeoHeader(in, nodeIdMode, elementIdMode))
     {
-        EnsightObj::ERROR_STR =  "In [EnsightBinaryReader::readGeometry()] Invalid file header.";
+        EnsightObj::errorString() =  "In [EnsightBinaryReader::readGeometry()] Invalid file header.";
         return false;
     }
 
@@ -254,7 +285,7 @@ bool readBinaryGeometryTimeStep(EnsightObj& ensight, std::ifstream& in, int time
                 if (!part || part->getId() != part_id)
                 {
                     QString name = part ? part->getName() : part_name;
-                    EnsightObj::ERROR_STR = "In [EnsightBinaryReader::readGeometry()] Mismatch between time steps and part name / id for part <" + name + ">.";
+                    EnsightObj::errorString() = "In [EnsightBinaryReader::readGeometry()] Mismatch between time steps and part name / id for part <" + name + ">.";
                     return false;
                 }
             }
@@ -267,7 +298,7 @@ bool readBinaryGeometryTimeStep(EnsightObj& ensight, std::ifstream& in, int time
         {
             if (!part)
             {
-                EnsightObj::ERROR_STR = "In [EnsightBinaryReader::readGeometry()] at line <" + QString(line) + ">.";
+                EnsightObj::errorString() = "In [EnsightBinaryReader::readGeometry()] at line <" + QString(line) + ">.";
                 return false;
             }
 
@@ -281,16 +312,8 @@ bool readBinaryGeometryTimeStep(EnsightObj& ensight, std::ifstream& in, int time
 
             // read coordinate values
             Matx vertices = Matx(3, num_coords);
-            for (int i = 0; i < 3; i++)
-            {
-                float value = 0;
-                for(int j = 0; j < num_coords; j++)
-                {
-                    readFloat(in, value);
-                    vertices(i, j) = value;
-                }
-            }
-            part->setVertices(vertices, timestep);
+            readFloatRows(in, vertices);
+            part->setVertices(std::move(vertices), timestep);
         }
         else
         {
@@ -306,7 +329,7 @@ bool readBinaryGeometryTimeStep(EnsightObj& ensight, std::ifstream& in, int time
 
             if (cellType == Ensight::Unknown)
             {
-                EnsightObj::ERROR_STR = "In [EnsightBinaryReader::readGeometry()] at line <" + QString(line)
+                EnsightObj::errorString() = "In [EnsightBinaryReader::readGeometry()] at line <" + QString(line)
                                         + ">. Cell type identifier not supported";
                 return false;
             }
@@ -322,16 +345,8 @@ bool readBinaryGeometryTimeStep(EnsightObj& ensight, std::ifstream& in, int time
             // read element indices
             int n_nodes = Ensight::numCellNodes[cellType];
             Mati cells = Mati(n_nodes, num_elements);
-            int32_t indexOneBased = -1;
-            for(int i = 0; i < num_elements; i++)
-            {
-                for(int j = 0; j < n_nodes; j++)
-                {
-                    readInt(in, indexOneBased);
-                    cells(j, i) = indexOneBased-1; // convert to zero based index
-                }
-            }
-            ensight.setCells(part, cells, timestep, cellType);
+            readIndices(in, cells);
+            ensight.setCells(part, std::move(cells), timestep, cellType);
         }
     }
     return true;
@@ -345,7 +360,7 @@ bool readBinaryVariable(EnsightObj& ensight, const QString& filename,
     std::ifstream in(filename.toStdString().c_str(), std::ios::binary);
     if(!in.is_open())
     {
-        EnsightObj::ERROR_STR = "In [EnsightBinaryReader::readVariable()] Cannot open file " + filename;
+        EnsightObj::errorString() = "In [EnsightBinaryReader::readVariable()] Cannot open file " + filename;
         return false;
     }
 
@@ -409,29 +424,21 @@ bool readBinaryVariableTimeStep(EnsightObj& ensight, std::ifstream& in,
             EnsightPart *part = ensight.getPartById(part_id);
             if (!part || part->getId() != part_id)
             {
-                EnsightObj::ERROR_STR =  "In [EnsightBinaryReader::readVariable()] Part with ID <" + QString::number(part_id) + "> not defined in geometry file.";
+                EnsightObj::errorString() =  "In [EnsightBinaryReader::readVariable()] Part with ID <" + QString::number(part_id) + "> not defined in geometry file.";
                 return false;
             }
 
             readLine(in, line);
             if (strcmp(line, "coordinates") != 0)
             {
-                EnsightObj::ERROR_STR =  "In [EnsightBinaryReader::readVariable()] keyword >coordinates> expected at line<" + QString(line) + ">.";
+                EnsightObj::errorString() =  "In [EnsightBinaryReader::readVariable()] keyword >coordinates> expected at line<" + QString(line) + ">.";
                 return false;
             }
 
             int n_vertices = part->getVertexCount(timestep);
             Matx values(dim, n_vertices);
-            float value;
-            for (int i = 0; i < dim; i++)
-            {
-                for (int j = 0; j < n_vertices; j++)
-                {
-                    readFloat(in, value);
-                    values(i, j) = value;
-                }
-            }
-            ensight.setVariable(part, name, values, type, timestep);
+            readFloatRows(in, values);
+            ensight.setVariable(part, name, std::move(values), type, timestep);
         }
     }
 
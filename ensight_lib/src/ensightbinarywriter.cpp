@@ -25,8 +25,10 @@
 
 #include <cstdint>
 #include <fstream>
+#include <vector>
 #include "../include/ensightobj.h"
 #include "../include/ensightcell.h"
+#include "../include/ensightparallel.h"
 #include "../include/ensightpart.h"
 #include "../include/ensightvariable.h"
 
@@ -54,9 +56,34 @@ void write_ensight_int(const int32_t val, std::ofstream& str)
     str.write(reinterpret_cast<const char*>(&val), sizeof(int32_t));
 }
 
-void write_ensight_float(const float val, std::ofstream& str)
+/**
+ * @brief Writes the first rows of the values as floats row by row, e.g. all x,
+ * then all y coordinates.
+ */
+void write_ensight_float_rows(const MatxView& values, Eigen::Index rows, std::ofstream& str)
+{
+    const Eigen::Index cols = values.cols();
+    std::vector<float> buffer(rows * cols);
+    Ensight::Parallel::parallelFor(0, cols, 16384, [&](int64_t first, int64_t last) {
+        for (Eigen::Index i = 0; i < rows; i++)
+            for (int64_t j = first; j < last; j++)
+                buffer[i * cols + j] = static_cast<float>(values(i, j));
+    });
+    str.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(float));
+}
+
+/**
+ * @brief Writes the vertex indices of the cells one based, cell by cell.
+ */
+void write_ensight_indices(const MatiView& cells, std::ofstream& str)
 {
-    str.write(reinterpret_cast<const char*>(&val), sizeof(float));
+    std::vector<int32_t> buffer(cells.size());
+    const int* indices = cells.data();
+    Ensight::Parallel::parallelFor(0, cells.size(), 65536, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            buffer[i] = indices[i] + 1;
+    });
+    str.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(int32_t));
 }
 
 bool writeBinary(EnsightObj* ensight, const QString& name, const QString& path,
@@ -112,7 +139,7 @@ bool writeBinaryVar(EnsightObj* ensight, const QString& name,
     file.open(filename.toStdString().c_str(), std::ios::binary | std::ios::out);
     if (!file.is_open())
     {
-        EnsightObj::ERROR_STR  = "In [writeBinaryVar()] Unable to open file <"
+        EnsightObj::errorString()  = "In [writeBinaryVar()] Unable to open file <"
                                  + filename + ">";
         return false;
     }
@@ -141,19 +168,15 @@ bool writeBinaryVar(EnsightObj* ensight, const QString& name,
         if (!part->hasVariable(var, timestep))
         {
             write_ensight_string("coordinates", file);
-            Matx vertices = part->getVertices(timestep);
-            for (int j = 0; j < dim; j++)
-                for (int k = 0; k < vertices.cols(); k++)
-                    write_ensight_float(0.0, file);
+            std::vector<float> zeros(dim * part->getVertexCount(timestep), 0.0f);
+            file.write(reinterpret_cast<const char*>(zeros.data()), zeros.size() * sizeof(float));
             continue;
         }
 
         write_ensight_string("coordinates", file);
         // Write variable values for each node
-        Matx values = part->getVariableValues(var, timestep);
-        for (int j = 0; j < dim; j++)
-            for (int k = 0; k < values.cols(); k++)
-                write_ensight_float(values(j, k), file);
+        MatxView values = part->getVariableValues(var, timestep);
+        write_ensight_float_rows(values, dim, file);
     }
     file.close();
     return true;
@@ -175,7 +198,7 @@ bool writeBinaryGeo(EnsightObj* ensight, const QString& name,
     file.open(filename.toStdString().c_str(), std::ios::binary | std::ios::out);
     if (!file.is_open())
     {
-        EnsightObj::ERROR_STR  = "ERROR IN [writeBinaryGeo()] Unable to open file <"
+        EnsightObj::errorString()  = "ERROR IN [writeBinaryGeo()] Unable to open file <"
                                  + filename + ">";
         return false;
     }
@@ -197,33 +220,28 @@ bool writeBinaryGeo(EnsightObj* ensight, const QString& name,
             write_ensight_string("coordinates", file);
 
             // Vertices
-            Matx vertices = part->getVertices(timestep);
+            MatxView vertices = part->getVertices(timestep);
 
             // Write number of vertices
             write_ensight_int(vertices.cols(), file);
 
 
             // Write vertices
-            for (int j = 0; j < vertices.rows(); j++)
-                for (int k = 0; k < vertices.cols(); k++)
-                    write_ensight_float(vertices(j, k), file);
+            write_ensight_float_rows(vertices, vertices.rows(), file);
 
             // Cells
             QList<EnsightCellList*> cells = part->getCells(timestep);
             for (auto cell : cells)
             {
                 Ensight::Cell type = cell->getType();
-                Mati values = cell->getValues();
+                MatiView values = cell->getValues();
 
                 // Write cell type
                 write_ensight_string(Ensight::strCell[type], file);
                 write_ensight_int(values.cols(), file);
-                for (int j = 0; j < values.cols(); j++)
-                {
-                    // Write vertex indices defining cells
-                    for (int k = 0; k < values.rows(); k++)
-                        write_ensight_int(values(k, j) + 1, file);
-                }
+
+                // Write vertex indices defining cells
+                write_ensight_indices(values, file);
             }
         }
     }
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "../include/ensightbuffer.h"
+
+#include <utility>
+
+
+template <typename Scalar>
+EnsightBuffer<Scalar>::EnsightBuffer() : data_(), rows_(0), cols_(0), owned_(true)
+{
+}
+
+template <typename Scalar>
+EnsightBuffer<Scalar>::EnsightBuffer(const Matrix& values) :
+    EnsightBuffer(Matrix(values))
+{
+}
+
+template <typename Scalar>
+EnsightBuffer<Scalar>::EnsightBuffer(Matrix&& values) :
+    rows_(values.rows()), cols_(values.cols()), owned_(true)
+{
+    // Keep the matrix alive and alias its storage, so the data is not copied.
+    std::shared_ptr<Matrix> owner = std::make_shared<Matrix>(std::move(values));
+    data_ = std::shared_ptr<const Scalar>(owner, owner->data());
+}
+
+template <typename Scalar>
+EnsightBuffer<Scalar>::EnsightBuffer(std::shared_ptr<const Scalar> data,
+                                     Eigen::Index rows, Eigen::Index cols) :
+    data_(std::move(data)), rows_(rows), cols_(cols), owned_(false)
+{
+}
+
+template <typename Scalar>
+EnsightBuffer<Scalar> EnsightBuffer<Scalar>::wrap(const Scalar* data,
+                                                  Eigen::Index rows, Eigen::Index cols)
+{
+    return EnsightBuffer(std::shared_ptr<const Scalar>(data, [](const Scalar*) {}), rows, cols);
+}
+
+template <typename Scalar>
+typename EnsightBuffer<Scalar>::View EnsightBuffer<Scalar>::view() const
+{
+    return View(data_.get(), rows_, cols_);
+}
+
+template <typename Scalar>
+const Scalar* EnsightBuffer<Scalar>::data() const
+{
+    return data_.get();
+}
+
+template <typename Scalar>
+Eigen::Index EnsightBuffer<Scalar>::rows() const
+{
+    return rows_;
+}
+
+template <typename Scalar>
+Eigen::Index EnsightBuffer<Scalar>::cols() const
+{
+    return cols_;
+}
+
+template <typename Scalar>
+bool EnsightBuffer<Scalar>::isEmpty() const
+{
+    return rows_ == 0 || cols_ == 0;
+}
+
+template <typename Scalar>
+bool EnsightBuffer<Scalar>::isOwned() const
+{
+    return owned_;
+}
+
+template <typename Scalar>
+bool EnsightBuffer<Scalar>::sharesDataWith(const EnsightBuffer& other) const
+{
+    return data_ && data_ == other.data_;
+}
+
+template <typename Scalar>
+const std::shared_ptr<const Scalar>& EnsightBuffer<Scalar>::sharedData() const
+{
+    return data_;
+}
+
+template <typename Scalar>
+EnsightBuffer<Scalar> EnsightBuffer<Scalar>::withSharedData(std::shared_ptr<const Scalar> data) const
+{
+    EnsightBuffer result(*this);
+    result.data_ = std::move(data);
+    return result;
+}
+
+
+// explicit template instantiations
+template class EnsightBuffer<double>;
+template class EnsightBuffer<int>;
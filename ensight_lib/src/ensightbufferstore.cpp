@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#include "../include/ensightbufferstore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include "../include/ensightparallel.h"
+
+
+namespace
+{
+
+/**
+ * @brief Hashes a block of memory word by word on the calling thread.
+ */
+uint64_t hashBlock(const unsigned char* bytes, size_t size)
+{
+    const uint64_t multiplier = 0x9e3779b97f4a7c15ull;
+
+    uint64_t hash = size * multiplier;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(uint64_t));
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * multiplier;
+    return hash;
+}
+
+} // namespace
+
+
+uint64_t EnsightBufferStore::hashBytes(const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    const size_t blockSize = size_t(1) << 18;
+    if (size <= blockSize)
+        return hashBlock(bytes, size);
+
+    // Hash blocks of 256 KiB in parallel, then the block hashes
+    const int64_t numBlocks = static_cast<int64_t>((size + blockSize - 1) / blockSize);
+    std::vector<uint64_t> blockHashes(numBlocks);
+    Ensight::Parallel::parallelFor(0, numBlocks, 1, [&](int64_t first, int64_t last) {
+        for (int64_t block = first; block < last; block++)
+        {
+            size_t offset = block * blockSize;
+            blockHashes[block] = hashBlock(bytes + offset, std::min(blockSize, size - offset));
+        }
+    });
+    return hashBlock(reinterpret_cast<const unsigned char*>(blockHashes.data()),
+                     blockHashes.size() * sizeof(uint64_t)) ^ size;
+}
+
+EnsightBufferStore::EnsightBufferStore() : usage_(std::make_shared<Usage>()), purgeSize_(1024)
+{
+}
+
+int64_t EnsightBufferStore::getBytes() const
+{
+    return usage_->bytes;
+}
+
+int64_t EnsightBufferStore::getPeakBytes() const
+{
+    return usage_->peakBytes;
+}
+
+MatxBuffer EnsightBufferStore::intern(const MatxBuffer& buffer)
+{
+    return internImpl(buffer, 0);
+}
+
+MatiBuffer EnsightBufferStore::intern(const MatiBuffer& buffer)
+{
+    return internImpl(buffer, 1);
+}
+
+template <typename Scalar>
+EnsightBuffer<Scalar> EnsightBufferStore::internImpl(const EnsightBuffer<Scalar>& buffer, int typeId)
+{
+    // Adopted and wrapped data belongs to the caller, who may release it at any
+    // time. It is neither deduplicated nor used as the shared copy of other buffers.
+    if (buffer.isEmpty() || !buffer.isOwned())
+        return buffer;
+
+    const size_t size = buffer.rows() * buffer.cols() * sizeof(Scalar);
+    const uint64_t hash = hashBytes(buffer.data(), size);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Look for a live block with identical size and content
+    auto range = entries_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const Entry& entry = it->second;
+        if (entry.typeId != typeId || entry.rows != buffer.rows() || entry.cols != buffer.cols())
+            continue;
+
+        std::shared_ptr<const void> data = entry.data.lock();
+        if (!data)
+            continue;
+
+        if (data.get() == buffer.data() || std::memcmp(data.get(), buffer.data(), size) == 0)
+            return buffer.withSharedData(std::static_pointer_cast<const Scalar>(data));
+    }
+
+    // Remove expired entries once the number of entries doubled
+    if (entries_.size() >= purgeSize_)
+    {
+        for (auto it = entries_.begin(); it != entries_.end();)
+            it = it->second.data.expired() ? entries_.erase(it) : std::next(it);
+        purgeSize_ = std::max<size_t>(1024, 2 * entries_.size());
+    }
+
+    // Count the bytes of the new block until its last reference is released
+    std::shared_ptr<Usage> usage = usage_;
+    std::shared_ptr<const Scalar> original = buffer.sharedData();
+    std::shared_ptr<const Scalar> tracked(original.get(), [usage, original, size](const Scalar*) {
+        usage->bytes -= size;
+    });
+    int64_t bytes = usage->bytes += size;
+    int64_t peakBytes = usage->peakBytes;
+    while (bytes > peakBytes && !usage->peakBytes.compare_exchange_weak(peakBytes, bytes))
+    {
+    }
+
+    Entry entry;
+    entry.data = tracked;
+    entry.typeId = typeId;
+    entry.rows = buffer.rows();
+    entry.cols = buffer.cols();
+    entries_.emplace(hash, entry);
+    return buffer.withSharedData(tracked);
+}
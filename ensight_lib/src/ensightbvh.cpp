@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "../include/ensightbvh.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+
+#include "../include/ensightbarycentriccoordinates.h"
+#include "../include/ensightcell.h"
+#include "../include/ensightmemoryreport.h"
+#include "../include/ensightparallel.h"
+
+namespace
+{
+
+const int numBins = 16;
+
+// Half the surface area of a box, sufficient to compare split costs
+double halfArea(const Bbox& bounds)
+{
+    if (bounds.isEmpty())
+        return 0.0;
+    const Vec3 d = bounds.diagonal();
+    return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+int binIndex(double centroid, double min, double extent)
+{
+    int bin = static_cast<int>(numBins * (centroid - min) / extent);
+    return std::max(0, std::min(numBins - 1, bin));
+}
+
+}
+
+
+EnsightBvh::EnsightBvh(Bbox bounds, int maxCells, bool ignore2dCells)
+    : EnsightSubdivTree(ignore2dCells), bounds_(bounds), layout_(), maxCells_(maxCells)
+{
+}
+
+EnsightBvh::~EnsightBvh() = default;
+
+EnsightCellIdentifier* EnsightBvh::search(const Vec3& pos,
+                                          EnsightBarycentricCoordinates& baryCoordOut) const
+{
+    const Layout& layout = getLayout();
+
+    // Depth-first traversal of all nodes containing pos
+    Index stack[MaxDepth];
+    int stackSize = 0;
+    Index nodeIdx = 0;
+    while (true)
+    {
+        const BvhNode& node = layout.nodes[nodeIdx];
+        if (node.bounds.contains(pos))
+        {
+            if (node.count == InnerNode)
+            {
+                stack[stackSize++] = node.first;
+                nodeIdx++;
+                continue;
+            }
+            Index survivors[EnsightLeafBounds::ChunkSize];
+            const Index end = node.first + node.count;
+            for (Index k = node.first; k < end; k += EnsightLeafBounds::ChunkSize)
+            {
+                const int count = static_cast<int>(std::min<Index>(EnsightLeafBounds::ChunkSize, end - k));
+                const int numSurvivors = layout.leafBounds.filter(k, count, node.bounds, pos,
+                                                                  layout.cells.data() + k, survivors);
+                for (int i = 0; i < numSurvivors; i++)
+                {
+                    if (cells_.contains(survivors[i], pos, baryCoordOut, ignore2dCells_))
+                        return cells_.getIdentifier(survivors[i]);
+                }
+            }
+        }
+        if (stackSize == 0)
+            return nullptr;
+        nodeIdx = stack[--stackSize];
+    }
+}
+
+QList<EnsightCellIdentifier*> EnsightBvh::searchAll(const Vec3& pos) const
+{
+    const Layout& layout = getLayout();
+
+    QList<EnsightCellIdentifier*> results;
+    Index stack[MaxDepth];
+    int stackSize = 0;
+    Index nodeIdx = 0;
+    while (true)
+    {
+        const BvhNode& node = layout.nodes[nodeIdx];
+        if (node.bounds.contains(pos))
+        {
+            if (node.count == InnerNode)
+            {
+                stack[stackSize++] = node.first;
+                nodeIdx++;
+                continue;
+            }
+            Index survivors[EnsightLeafBounds::ChunkSize];
+            const Index end = node.first + node.count;
+            for (Index k = node.first; k < end; k += EnsightLeafBounds::ChunkSize)
+            {
+                const int count = static_cast<int>(std::min<Index>(EnsightLeafBounds::ChunkSize, end - k));
+                const int numSurvivors = layout.leafBounds.filter(k, count, node.bounds, pos,
+                                                                  layout.cells.data() + k, survivors);
+                for (int i = 0; i < numSurvivors; i++)
+                {
+                    if (cells_.boundsContain(survivors[i], pos))
+                        results.push_back(cells_.getIdentifier(survivors[i]));
+                }
+            }
+        }
+        if (stackSize == 0)
+            return results;
+        nodeIdx = stack[--stackSize];
+    }
+}
+
+void EnsightBvh::insert(EnsightPart* part, int timestep, double sizeOffset)
+{
+    cells_.append(part, timestep, sizeOffset);
+    vertexTree_.insert(part, timestep);
+
+    // The hierarchy is rebuilt from all cells by build() or the next query
+    layout_.reset();
+}
+
+void EnsightBvh::build()
+{
+    getLayout();
+}
+
+bool EnsightBvh::refit(const EnsightSubdivTree& base)
+{
+    const EnsightBvh* baseBvh = dynamic_cast<const EnsightBvh*>(&base);
+    if (!baseBvh || baseBvh->cells_.size() != cells_.size())
+        return false;
+
+    const Layout& baseLayout = baseBvh->getLayout();
+    layout_.reset();
+    layout_.get([this, &baseLayout]() { return refitLayout(baseLayout); });
+    return true;
+}
+
+std::shared_ptr<EnsightSubdivTree> EnsightBvh::share(int timestep) const
+{
+    auto tree = std::make_shared<EnsightBvh>(bounds_, maxCells_, ignore2dCells_);
+    tree->cells_.share(cells_, timestep);
+    tree->vertexTree_.share(vertexTree_, timestep);
+    tree->layout_.share(layout_);
+    tree->isShared_ = true;
+    return tree;
+}
+
+bool EnsightBvh::write(std::ostream& out) const
+{
+    // The node bounds are recomputed from the cells when reading
+    const Layout& layout = getLayout();
+    const Vec3& min = bounds_.minCorner();
+    const Vec3& max = bounds_.maxCorner();
+    const double bounds[6] = {min[0], min[1], min[2], max[0], max[1], max[2]};
+    const uint64_t sizes[3] = {static_cast<uint64_t>(maxCells_), cells_.size(), layout.nodes.size()};
+    std::vector<Index> nodes(2 * layout.nodes.size());
+    for (size_t i = 0; i < layout.nodes.size(); i++)
+    {
+        nodes[2 * i] = layout.nodes[i].first;
+        nodes[2 * i + 1] = layout.nodes[i].count;
+    }
+    writeBlock(out, bounds, sizeof(bounds));
+    writeBlock(out, sizes, sizeof(sizes));
+    writeBlock(out, nodes.data(), nodes.size() * sizeof(Index));
+    writeBlock(out, layout.cells.data(), layout.cells.size() * sizeof(Index));
+    return static_cast<bool>(out);
+}
+
+bool EnsightBvh::read(std::istream& in)
+{
+    double bounds[6];
+    uint64_t sizes[3];
+    if (!readBlock(in, bounds, sizeof(bounds)) || !readBlock(in, sizes, sizeof(sizes)))
+        return false;
+    const Vec3& min = bounds_.minCorner();
+    const Vec3& max = bounds_.maxCorner();
+    if (bounds[0] != min[0] || bounds[1] != min[1] || bounds[2] != min[2] ||
+        bounds[3] != max[0] || bounds[4] != max[1] || bounds[5] != max[2])
+        return false;
+    const uint64_t numCells = cells_.size();
+    const uint64_t numNodes = sizes[2];
+    // A binary tree whose leaves hold at least one cell has less than two
+    // nodes per cell
+    if (sizes[0] != static_cast<uint64_t>(maxCells_) || sizes[1] != numCells ||
+        numNodes == 0 || numNodes > std::max<uint64_t>(2 * numCells, 1) ||
+        !hasBlocks(in, {2 * numNodes * sizeof(Index), numCells * sizeof(Index)}))
+        return false;
+
+    Layout base;
+    std::vector<Index> nodes(2 * numNodes);
+    base.cells.resize(numCells);
+    if (!readBlock(in, nodes.data(), nodes.size() * sizeof(Index)) ||
+        !readBlock(in, base.cells.data(), numCells * sizeof(Index)))
+        return false;
+
+    // The left child follows its parent and the right child comes after the
+    // left subtree, so every descent ends in a leaf. The depth is limited by
+    // the traversal stack.
+    base.nodes.resize(numNodes);
+    std::vector<int> depths(numNodes, 0);
+    for (uint64_t i = 0; i < numNodes; i++)
+    {
+        BvhNode& node = base.nodes[i];
+        node.first = nodes[2 * i];
+        node.count = nodes[2 * i + 1];
+        if (node.count == InnerNode)
+        {
+            if (node.first <= i + 1 || node.first >= numNodes || depths[i] + 1 >= MaxDepth)
+                return false;
+            depths[i + 1] = std::max(depths[i + 1], depths[i] + 1);
+            depths[node.first] = std::max(depths[node.first], depths[i] + 1);
+        }
+        else if (uint64_t(node.first) + node.count > numCells)
+            return false;
+    }
+    for (Index cellIdx : base.cells)
+    {
+        if (cellIdx >= numCells)
+            return false;
+    }
+
+    layout_.reset();
+    layout_.get([this, &base]() { return refitLayout(base); });
+    return true;
+}
+
+Bbox EnsightBvh::getBounds() const
+{
+    return bounds_;
+}
+
+void EnsightBvh::addMemoryUsage(EnsightMemoryReport& report) const
+{
+    const Layout& layout = getLayout();
+    int64_t nodeBytes = layout.nodes.capacity() * sizeof(BvhNode);
+    int64_t indexBytes = layout.cells.capacity() * sizeof(Index);
+    int64_t leafBoundsBytes = layout.leafBounds.getBytes();
+
+    int64_t recordBytes = cells_.getRecordBytes();
+    int64_t vertexTreeBytes = vertexTree_.getBytes();
+    int64_t identifierBytes = cells_.getIdentifierBytes();
+    if (isShared_)
+    {
+        // Counted with the tree this one was shared from
+        nodeBytes = indexBytes = leafBoundsBytes = recordBytes = vertexTreeBytes = 0;
+    }
+
+    report.subdivTreeBytes += nodeBytes + indexBytes + leafBoundsBytes + recordBytes + vertexTreeBytes
+            + identifierBytes;
+    report.addEntry(std::string(), -1, "subdivtree", "nodes", nodeBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "leaf indices", indexBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "leaf bounds", leafBoundsBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "cell records", recordBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "vertex tree", vertexTreeBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "cell identifiers", identifierBytes, false);
+}
+
+int EnsightBvh::getNumberOfNodes() const
+{
+    return static_cast<int>(getLayout().nodes.size());
+}
+
+QVector<Bbox> EnsightBvh::getLeafBounds() const
+{
+    QVector<Bbox> leafBounds;
+    for (const BvhNode& node : getLayout().nodes)
+    {
+        if (node.count != InnerNode)
+            leafBounds.push_back(node.bounds);
+    }
+    return leafBounds;
+}
+
+void EnsightBvh::findNearestCell(const Vec3& pos, double& minDistance, Index& nearest) const
+{
+    const Layout& layout = getLayout();
+
+    // Depth-first traversal of the nodes closer than minDistance, the closer
+    // child first. The far child is pushed with its squared distance.
+    struct Entry
+    {
+        Index node;
+        double distSq;
+    };
+    Entry stack[MaxDepth];
+    int stackSize = 0;
+    Index nodeIdx = 0;
+    double nodeDistSq = layout.nodes[0].bounds.squaredDistance(pos);
+    while (true)
+    {
+        if (nodeDistSq <= minDistance * minDistance)
+        {
+            const BvhNode& node = layout.nodes[nodeIdx];
+            if (node.count == InnerNode)
+            {
+                const double leftDistSq = layout.nodes[nodeIdx + 1].bounds.squaredDistance(pos);
+                const double rightDistSq = layout.nodes[node.first].bounds.squaredDistance(pos);
+                if (leftDistSq <= rightDistSq)
+                {
+                    stack[stackSize++] = Entry{node.first, rightDistSq};
+                    nodeIdx++;
+                    nodeDistSq = leftDistSq;
+                }
+                else
+                {
+                    stack[stackSize++] = Entry{nodeIdx + 1, leftDistSq};
+                    nodeIdx = node.first;
+                    nodeDistSq = rightDistSq;
+                }
+                continue;
+            }
+            const Index end = node.first + node.count;
+            for (Index k = node.first; k < end; k++)
+                testNearestCell(layout.cells[k], pos, minDistance, nearest);
+        }
+        if (stackSize == 0)
+            return;
+        stackSize--;
+        nodeIdx = stack[stackSize].node;
+        nodeDistSq = stack[stackSize].distSq;
+    }
+}
+
+const EnsightBvh::Layout& EnsightBvh::getLayout() const
+{
+    return layout_.get([this]() { return buildLayout(); });
+}
+
+EnsightBvh::Layout EnsightBvh::buildLayout() const
+{
+    const Index numCells = cells_.size();
+
+    std::vector<Vec3> centroids(numCells);
+    Ensight::Parallel::parallelFor(0, numCells, 4096, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            centroids[i] = cells_.getBounds(static_cast<Index>(i)).center();
+    });
+
+    std::vector<Index> order(numCells);
+    for (Index i = 0; i < numCells; i++)
+        order[i] = i;
+
+    // Nodes are created in depth-first order. The right child is pushed first,
+    // so that the left child directly follows its parent. When the right
+    // child is created, its index is stored in the parent.
+    struct Task
+    {
+        Index begin;
+        Index end;
+        Index parent;
+        int depth;
+    };
+
+    Layout layout;
+    std::vector<Task> tasks;
+    tasks.push_back(Task{0, numCells, InnerNode, 0});
+    while (!tasks.empty())
+    {
+        const Task task = tasks.back();
+        tasks.pop_back();
+
+        const Index nodeIdx = static_cast<Index>(layout.nodes.size());
+        if (task.parent != InnerNode)
+            layout.nodes[task.parent].first = nodeIdx;
+
+        Bbox bounds;
+        Bbox centroidBounds;
+        for (Index i = task.begin; i < task.end; i++)
+        {
+            bounds.extend(cells_.getBounds(order[i]));
+            centroidBounds.extend(centroids[order[i]]);
+        }
+        layout.nodes.push_back(BvhNode{bounds, task.begin, task.end - task.begin});
+
+        const Index count = task.end - task.begin;
+        if (count <= static_cast<Index>(std::max(maxCells_, 1)))
+            continue;
+
+        // Split at the largest extent of the centroids
+        const Vec3 extent = centroidBounds.diagonal();
+        int axis = 0;
+        if (extent[1] > extent[axis])
+            axis = 1;
+        if (extent[2] > extent[axis])
+            axis = 2;
+        if (!(extent[axis] > 0.0))
+            continue;  // all centroids coincide
+
+        Index mid = task.begin + count / 2;
+        if (task.depth < MaxDepth / 2)
+        {
+            // Binned surface area heuristic over all axes
+            double bestCost = std::numeric_limits<double>::max();
+            int bestAxis = -1;
+            int bestBin = -1;
+            for (int a = 0; a < 3; a++)
+            {
+                if (!(extent[a] > 0.0))
+                    continue;
+
+                std::array<Bbox, numBins> binBounds;
+                std::array<Index, numBins> binCounts;
+                binCounts.fill(0);
+                for (Index i = task.begin; i < task.end; i++)
+                {
+                    const int bin = binIndex(centroids[order[i]][a], centroidBounds.minCorner()[a], extent[a]);
+                    binBounds[bin].extend(cells_.getBounds(order[i]));
+                    binCounts[bin]++;
+                }
+
+                // Costs of the cells right of each split
+                std::array<double, numBins> rightCosts;
+                Bbox rightBounds;
+                Index rightCount = 0;
+                for (int bin = numBins - 1; bin > 0; bin--)
+                {
+                    rightBounds.extend(binBounds[bin]);
+                    rightCount += binCounts[bin];
+                    rightCosts[bin] = rightCount * halfArea(rightBounds);
+                }
+
+                Bbox leftBounds;
+                Index leftCount = 0;
+                for (int bin = 0; bin < numBins - 1; bin++)
+                {
+                    leftBounds.extend(binBounds[bin]);
+                    leftCount += binCounts[bin];
+                    if (leftCount == 0 || leftCount == count)
+                        continue;
+                    const double cost = leftCount * halfArea(leftBounds) + rightCosts[bin + 1];
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = a;
+                        bestBin = bin;
+                    }
+                }
+            }
+
+            if (bestAxis >= 0)
+            {
+                const double min = centroidBounds.minCorner()[bestAxis];
+                const double axisExtent = extent[bestAxis];
+                auto it = std::partition(order.begin() + task.begin, order.begin() + task.end,
+                                         [&](Index cellIdx) {
+                    return binIndex(centroids[cellIdx][bestAxis], min, axisExtent) <= bestBin;
+                });
+                mid = static_cast<Index>(it - order.begin());
+            }
+        }
+        else
+        {
+            // Median split bounds the depth of deep hierarchies
+            std::nth_element(order.begin() + task.begin, order.begin() + mid,
+                             order.begin() + task.end, [&](Index a, Index b) {
+                return centroids[a][axis] < centroids[b][axis];
+            });
+        }
+
+        layout.nodes[nodeIdx].count = InnerNode;
+        tasks.push_back(Task{mid, task.end, nodeIdx, task.depth + 1});
+        tasks.push_back(Task{task.begin, mid, InnerNode, task.depth + 1});
+    }
+
+    layout.cells.swap(order);
+
+    quantizeLeafBounds(layout);
+
+    layout.nodes.shrink_to_fit();
+    return layout;
+}
+
+EnsightBvh::Layout EnsightBvh::refitLayout(const Layout& base) const
+{
+    Layout layout;
+    layout.nodes = base.nodes;
+    layout.cells = base.cells;
+
+    // Leaves in parallel, then the inner nodes. Children follow their parent,
+    // so visiting the nodes backwards updates both children first.
+    Ensight::Parallel::parallelFor(0, layout.nodes.size(), 64, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+        {
+            BvhNode& node = layout.nodes[i];
+            if (node.count == InnerNode)
+                continue;
+            Bbox bounds;
+            for (Index k = node.first; k < node.first + node.count; k++)
+                bounds.extend(cells_.getBounds(layout.cells[k]));
+            node.bounds = bounds;
+        }
+    });
+    for (size_t i = layout.nodes.size(); i-- > 0;)
+    {
+        BvhNode& node = layout.nodes[i];
+        if (node.count == InnerNode)
+        {
+            node.bounds = layout.nodes[i + 1].bounds;
+            node.bounds.extend(layout.nodes[node.first].bounds);
+        }
+    }
+
+    quantizeLeafBounds(layout);
+    return layout;
+}
+
+void EnsightBvh::quantizeLeafBounds(Layout& layout) const
+{
+    // Quantize the cell bounding boxes relative to their leaf
+    layout.leafBounds.resize(cells_.size());
+    Ensight::Parallel::parallelFor(0, layout.nodes.size(), 64, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+        {
+            const BvhNode& node = layout.nodes[i];
+            if (node.count != InnerNode)
+            {
+                layout.leafBounds.set(node.first, static_cast<int>(node.count), node.bounds,
+                                      layout.cells.data() + node.first, cells_);
+            }
+        }
+    });
+}
@@ -23,101 +23,53 @@
 
 #include "../include/ensightcell.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
-#include <QDebug>
-#include <QMultiHash>
-#include <QSet>
+#include <limits>
+#include <mutex>
 
 #include "../include/ensightbarycentriccoordinates.h"
+#include "../include/ensightbufferstore.h"
+#include "../include/ensightfaceconnectivity.h"
+#include "../include/ensightmeshview.h"
 #include "../include/ensightpart.h"
 #include "../include/ensightvariable.h"
 
 
-EnsightCellList::EnsightCellList(Ensight::Cell type, const Mati& values,
+struct EnsightCellList::Topology
+{
+    std::once_flag computed;
+    std::atomic<bool> isComputed{false};
+
+    /**
+     * @brief Face connectivity of the cells of this list only
+     */
+    std::unique_ptr<EnsightFaceConnectivity> connectivity;
+
+    /**
+     * @brief This is a 2xK matrix where K is the number of boundary faces of these cells.
+     * Each column stores first the index of the boundary cell and then the index of the boundary face of this cell
+     */
+    Mati boundary;
+};
+
+EnsightCellList::EnsightCellList(Ensight::Cell type, const MatiBuffer& buffer,
                                  const QString& partName)
 {
     type_ = type;
-    values_ = values;
+    values_ = buffer;
     partName_ = partName;
-
-    // For each cell store for each face its neighboring cell index
-    neighbors_ = Mati::Constant(Ensight::numCellFaces[type], values.cols(), -1);
-
-    QMultiHash<int, QPair<int, int>> faces;
-    for (int i = 0; i < values.cols(); i++)
-    {
-        for (int j = 0; j < Ensight::numCellFaces[type]; j++)
-        {
-            QPair<int, int> newFace(i, j);
-            int hash = getFaceHash(type, newFace);
-
-            bool success = false;
-            if (faces.contains(hash))
-            {
-                // Iter over existing faces with identical hash code
-
-                QMultiHash<int, QPair<int, int>>::iterator iter = faces.find(hash);
-                while (iter != faces.end() && iter.key() == hash)
-                {
-                    QPair<int, int> oldFace = iter.value();
-                    if (doFacesMatch(oldFace, newFace))
-                    {
-                        // Save the neighboring cell at the corresponding entry
-                        neighbors_(oldFace.second, oldFace.first) = newFace.first;
-                        neighbors_(newFace.second, newFace.first) = oldFace.first;
-                        success = true;
-                        faces.remove(hash, oldFace);
-                        break;
-                    }
-                    ++iter;
-                }
-            }
-            if (!success)
-                faces.insert(hash, QPair<int, int>(i, j));
-        }
-    }
-
-    // All faces that are still in the multihash faces have no neighbor, i.e. they are boundary faces
-    // Create a 2xF matrix (F is the count of boundary faces)
-    // first row is the cell index and second row is the face index of the boundary faces
-    boundary_ = Mati(2, faces.count());
-    QList<int> keys = faces.uniqueKeys();
-    QSet<int> nodes;
-    int k = 0;
-    for (int key : keys)
-    {
-        QList<QPair<int, int>> fvalues = faces.values(key);
-        for (const auto& fvalue : fvalues)
-        {
-            int i0 = fvalue.first;
-            int i1 = fvalue.second;
-            boundary_(0, k) = i0;
-            boundary_(1, k) = i1;
-            k++;
-
-            // Detect boundary nodes of this face
-            for (int l = 0; l < 4; l++)
-            {
-                int nodeIndex = Ensight::cellFaces[getType()][i1][l];
-                if (nodeIndex != -1)
-                    nodes.insert(values(nodeIndex, i0));
-            }
-        }
-    }
-    boundaryVertices_ = Mati(1, nodes.size());
-
-    int j = 0;
-    foreach (int node, nodes)
-        boundaryVertices_(0, j++) = node;
+    topology_ = std::make_shared<Topology>();
 
     normals = Matx(0, 0);
     side_normals = Matx(0, 0);
 }
 
-EnsightCellList::EnsightCellList(Ensight::Cell type, const Mati &values,
-                                 const std::string& partName)
+EnsightCellList::EnsightCellList(Ensight::Cell type, const MatiBuffer& values,
+                                 const std::string& partName) :
+    EnsightCellList(type, values, QString::fromStdString(partName))
 {
-    EnsightCellList(type, values, QString::fromStdString(partName));
 }
 
 Ensight::Cell EnsightCellList::getType() const
@@ -125,76 +77,82 @@ Ensight::Cell EnsightCellList::getType() const
     return type_;
 }
 
-const Mati& EnsightCellList::getValues() const
+MatiView EnsightCellList::getValues() const
 {
-    return values_;
+    return values_.view();
 }
 
 
 const Mati& EnsightCellList::getNeighbors() const
 {
-    return neighbors_;
+    return getTopology().connectivity->getNeighbors(0);
 }
 
 const Mati& EnsightCellList::getBoundaryVertices() const
 {
-    return boundaryVertices_;
+    return getTopology().connectivity->getBoundaryVertices();
 }
 
 const Mati& EnsightCellList::getBoundary() const
 {
-    return boundary_;
+    return getTopology().boundary;
 }
 
-const QString& EnsightCellList::getPartName() const
+bool EnsightCellList::shareTopology(const EnsightCellList& other)
 {
-    return partName_;
+    if (topology_ == other.topology_)
+        return true;
+
+    MatiView values = values_.view();
+    MatiView otherValues = other.values_.view();
+    if (type_ != other.type_ || values.rows() != otherValues.rows() ||
+        values.cols() != otherValues.cols())
+        return false;
+
+    // Only lists with equal hashes are compared element-wise
+    if (!values_.sharesDataWith(other.values_) &&
+        (getValuesHash() != other.getValuesHash() ||
+         !std::equal(values.data(), values.data() + values.size(), otherValues.data())))
+        return false;
+
+    topology_ = other.topology_;
+    return true;
 }
 
+bool EnsightCellList::isTopologyComputed() const
+{
+    return topology_->isComputed;
+}
 
-bool EnsightCellList::doFacesMatch(const QPair<int, int>& oldFace, const QPair<int, int>& newFace)
+const EnsightCellList::Topology& EnsightCellList::getTopology() const
 {
-    if (oldFace.first == newFace.first) // same cell
-        return false;
+    Topology& topology = *topology_;
+    std::call_once(topology.computed, [this, &topology]() {
+        computeTopology(topology);
+        topology.isComputed = true;
+    });
+    return topology;
+}
 
-    // a Face has at most 4 nodes
-    for (int i = 0; i < Ensight::maxNumNodesPerFace; i++)
-    {
-        int ii = Ensight::cellFaces[type_][oldFace.second][i];
-        if (ii < 0)
-            continue;
-        int iPointer = values_(ii, oldFace.first);
-        bool success = false;
-        for (int j = 0; j < Ensight::maxNumNodesPerFace; j++)
-        {
-            int jj = Ensight::cellFaces[type_][newFace.second][j];
-            if (jj < 0)
-                continue;
-            int jPointer = values_(jj, newFace.first);
-            if (iPointer == jPointer)
-            {
-                success = true;
-                break;
-            }
-        }
-        if (!success)
-            return false;
-    }
+uint64_t EnsightCellList::getValuesHash() const
+{
+    return valuesHash_.get([this]() {
+        return EnsightBufferStore::hashBytes(values_.data(), values_.rows() * values_.cols() * sizeof(int));
+    });
+}
 
-    return true;
+const QString& EnsightCellList::getPartName() const
+{
+    return partName_;
 }
 
-int EnsightCellList::getFaceHash(const Ensight::Cell& type, const QPair<int, int>& face)
+
+void EnsightCellList::computeTopology(Topology& topology) const
 {
-    int hash = 0;
-    for (int node = 0; node < Ensight::maxNumNodesPerFace; node++)
-    {
-        int pointer = Ensight::cellFaces[type][face.second][node];
-        if (pointer == -1)
-            break;
-        hash += values_(pointer, face.first);
-    }
-    return hash;
+    // The vertex count is not known here, only negative indices are ignored
+    topology.connectivity.reset(new EnsightFaceConnectivity(QList<const EnsightCellList*>() << this,
+                                                            std::numeric_limits<int>::max()));
+    topology.boundary = topology.connectivity->getBoundary().bottomRows(2);
 }
 
 
@@ -216,16 +174,19 @@ Vec3 EnsightCellIdentifier::getVertex(int vertexId) const
     return part_->getVertices(timestep_).col(vertexId);
 }
 
-const Matx& EnsightCellIdentifier::getValues(const QString& name) const
+MatxView EnsightCellIdentifier::getValues(const QString& name) const
 {
-    const Matx& data = part_->getVariable(name, timestep_)->getValues();
-    return data;
+    return part_->getVariable(name, timestep_)->getValues();
 }
 
-const Matx &EnsightCellIdentifier::getValues(const std::string &name) const
+MatxView EnsightCellIdentifier::getValues(const std::string &name) const
 {
-    const Matx& data = part_->getVariable(QString::fromStdString(name), timestep_)->getValues();
-    return data;
+    return part_->getVariable(name, timestep_)->getValues();
+}
+
+MatxView EnsightCellIdentifier::getValues(int handle) const
+{
+    return part_->getVariable(handle, timestep_)->getValues();
 }
 
 Ensight::Cell EnsightCellIdentifier::getType() const
@@ -248,6 +209,11 @@ int EnsightCellIdentifier::getIndex() const
     return index_;
 }
 
+int EnsightCellIdentifier::getTimestep() const
+{
+    return timestep_;
+}
+
 void EnsightCellIdentifier::print(std::ostream& out) const
 {
     bounds_.print(out);
@@ -275,85 +241,7 @@ bool EnsightCellIdentifier::contains(const Vec3& pos,
 
 double EnsightCellIdentifier::computeVolume() const
 {
-    Vec3 P, Q, R;
-
     Veci nodes = getCell();
-    int type = static_cast<int>(getType());
-
-    double volume = 0.0;
-
-    switch (type)
-    {
-    case 0: // Point
-        volume = 0.0;
-        break;
-    case 1: // Bar
-        volume = (getVertex(nodes[1]) - getVertex(nodes[0])).norm();
-        break;
-    case 2: // Triangle
-        P = getVertex(nodes[1]) - getVertex(nodes[0]);
-        Q = getVertex(nodes[2]) - getVertex(nodes[0]);
-
-        volume = (P.cross(Q)).norm() / 2.0;
-
-        break;
-    case 3: // Rectangle
-        P = getVertex(nodes[3]) - getVertex(nodes[0]);
-        Q = getVertex(nodes[1]) - getVertex(nodes[0]);
-
-        volume = (P.cross(Q)).norm();
-
-        break;
-    case 4: // Tetrahedron
-        P = getVertex(nodes[3]) - getVertex(nodes[0]);
-        Q = getVertex(nodes[1]) - getVertex(nodes[0]);
-        R = getVertex(nodes[2]) - getVertex(nodes[0]);
-
-        volume = fabs(P.dot(Q.cross(R))) / 6.0;
-
-        break;
-    case 5: // Pyramid
-        P = getVertex(nodes[4]) - getVertex(nodes[0]);
-        Q = getVertex(nodes[1]) - getVertex(nodes[0]);
-        R = getVertex(nodes[3]) - getVertex(nodes[0]);
-        volume = fabs(P.dot(Q.cross(R))) / 6.0;
-
-        P = getVertex(nodes[4]) - getVertex(nodes[2]);
-        Q = getVertex(nodes[3]) - getVertex(nodes[2]);
-        R = getVertex(nodes[1]) - getVertex(nodes[2]);
-        volume += fabs(P.dot(Q.cross(R))) / 6.0;
-
-        break;
-    case 6: // Wedge
-        P = getVertex(nodes[1]) - getVertex(nodes[0]);
-        Q = getVertex(nodes[2]) - getVertex(nodes[0]);
-        R = getVertex(nodes[3]) - getVertex(nodes[0]);
-        volume = fabs(P.dot(Q.cross(R))) / 6.0;
-
-        P = getVertex(nodes[1]) - getVertex(nodes[5]);
-        Q = getVertex(nodes[3]) - getVertex(nodes[5]);
-        R = getVertex(nodes[2]) - getVertex(nodes[5]);
-        volume += fabs(P.dot(Q.cross(R))) / 6.0;
-
-        P = getVertex(nodes[3]) - getVertex(nodes[4]);
-        Q = getVertex(nodes[5]) - getVertex(nodes[4]);
-        R = getVertex(nodes[1]) - getVertex(nodes[4]);
-        volume += fabs(P.dot(Q.cross(R))) / 6.0;
-
-        break;
-    case 7: // Hexahedron
-        P = getVertex(nodes[4]) - getVertex(nodes[0]);
-        Q = getVertex(nodes[1]) - getVertex(nodes[0]);
-        R = getVertex(nodes[3]) - getVertex(nodes[0]);
-        volume = fabs(P.dot(Q.cross(R)));
-
-        break;
-    default:
-#ifndef NDEBUG
-        qDebug() << "Undefined celltype. Cannot compute volume.";
-#endif
-        assert(false);
-    }
-
-    return volume;
+    return EnsightMeshView::computeVolume(getType(), nodes.data(),
+                                          part_->getVertices(timestep_));
 }
@@ -0,0 +1,490 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "../include/ensightcellrecords.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "../include/ensightbarycentriccoordinates.h"
+#include "../include/ensightcell.h"
+#include "../include/ensightfaceconnectivity.h"
+#include "../include/ensightmeshview.h"
+#include "../include/ensightparallel.h"
+#include "../include/ensightpart.h"
+
+
+namespace
+{
+
+// The largest float not greater than x, and the smallest one not less than x
+float roundDown(double x)
+{
+    const float maxFloat = std::numeric_limits<float>::max();
+    if (x <= -maxFloat)
+        return -std::numeric_limits<float>::infinity();
+    if (x >= maxFloat)
+        return maxFloat;
+    const float f = static_cast<float>(x);
+    return f > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+float roundUp(double x)
+{
+    const float maxFloat = std::numeric_limits<float>::max();
+    if (x >= maxFloat)
+        return std::numeric_limits<float>::infinity();
+    if (x <= -maxFloat)
+        return -maxFloat;
+    const float f = static_cast<float>(x);
+    return f < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+
+// Barycentric coordinates of the point of triangle abc closest to p, see
+// Ericson, Real-Time Collision Detection, 5.1.5. Degenerate triangles with
+// coinciding vertices yield the closest point of the segment or the vertex.
+Vec3 closestOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c)
+{
+    const Vec3 ab = b - a;
+    const Vec3 ac = c - a;
+    const Vec3 ap = p - a;
+    const double d1 = ab.dot(ap);
+    const double d2 = ac.dot(ap);
+    if (d1 <= 0.0 && d2 <= 0.0)
+        return Vec3(1.0, 0.0, 0.0);
+
+    const Vec3 bp = p - b;
+    const double d3 = ab.dot(bp);
+    const double d4 = ac.dot(bp);
+    if (d3 >= 0.0 && d4 <= d3)
+        return Vec3(0.0, 1.0, 0.0);
+
+    const double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+    {
+        const double v = d1 / (d1 - d3);
+        return Vec3(1.0 - v, v, 0.0);
+    }
+
+    const Vec3 cp = p - c;
+    const double d5 = ab.dot(cp);
+    const double d6 = ac.dot(cp);
+    if (d6 >= 0.0 && d5 <= d6)
+        return Vec3(0.0, 0.0, 1.0);
+
+    const double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+    {
+        const double w = d2 / (d2 - d6);
+        return Vec3(1.0 - w, 0.0, w);
+    }
+
+    const double va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+    {
+        const double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return Vec3(0.0, 1.0 - w, w);
+    }
+
+    const double sum = va + vb + vc;
+    if (!(sum > 0.0))
+        return Vec3(1.0, 0.0, 0.0);  // collinear vertices
+    const double v = vb / sum;
+    const double w = vc / sum;
+    return Vec3(1.0 - v - w, v, w);
+}
+
+}
+
+
+EnsightCellRecords::IdentifierBlock::IdentifierBlock()
+{
+    for (auto& cell : cells)
+        cell.store(nullptr, std::memory_order_relaxed);
+}
+
+EnsightCellRecords::IdentifierBlock::~IdentifierBlock()
+{
+    for (auto& cell : cells)
+        delete cell.load(std::memory_order_relaxed);
+}
+
+
+EnsightCellRecords::EnsightCellRecords()
+    : bounds_(std::make_shared<Bounds>()), ranges_(), blocks_(), numBlocks_(0)
+{
+}
+
+EnsightCellRecords::~EnsightCellRecords()
+{
+    for (size_t i = 0; i < numBlocks_; i++)
+        delete blocks_[i].load(std::memory_order_relaxed);
+}
+
+void EnsightCellRecords::append(EnsightPart* part, int timestep, double sizeOffset)
+{
+    QList<EnsightCellList*> cellLists = part->getCells(timestep);
+
+    // Compute the bounds of all cells of the part at once
+    const EnsightMeshView& meshView = part->getMeshView(timestep);
+    Matx allBounds = meshView.computeBounds(part->getVertices(timestep));
+
+    // Bounds shared with the records of another timestep are copied first
+    if (bounds_.use_count() > 1)
+        bounds_ = std::make_shared<Bounds>(*bounds_);
+
+    const Index offset = size();
+    Q_ASSERT((size_t) offset + allBounds.cols() < (size_t) std::numeric_limits<Index>::max());
+    const size_t newSize = offset + static_cast<size_t>(allBounds.cols());
+    for (int d = 0; d < 3; d++)
+    {
+        bounds_->min[d].resize(newSize);
+        bounds_->max[d].resize(newSize);
+    }
+
+    Ensight::Parallel::parallelFor(0, allBounds.cols(), 4096, [&](int64_t first, int64_t last) {
+        for (int64_t k = first; k < last; k++)
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                bounds_->min[d][offset + k] = roundDown(allBounds(d, k) - sizeOffset);
+                bounds_->max[d][offset + k] = roundUp(allBounds(3 + d, k) + sizeOffset);
+            }
+        }
+    });
+
+    for (int i = 0; i < cellLists.size(); i++)
+    {
+        const Index first = offset + static_cast<Index>(meshView.getCellListOffsets()[i]);
+        ranges_.push_back(CellListRange{first, part, cellLists[i], timestep, i});
+    }
+
+    reserveIdentifiers(newSize);
+}
+
+void EnsightCellRecords::share(const EnsightCellRecords& other, int timestep)
+{
+    Q_ASSERT(size() == 0);
+    bounds_ = other.bounds_;
+
+    // The cell lists of the timestep hold the same cells, they are only
+    // looked up for the identifiers
+    ranges_ = other.ranges_;
+    for (CellListRange& range : ranges_)
+    {
+        range.cellList = range.part->getCells(timestep)[range.listIndex];
+        range.timestep = timestep;
+    }
+    reserveIdentifiers(size());
+}
+
+Bbox EnsightCellRecords::getBounds(Index cell) const
+{
+    return Bbox(Vec3(bounds_->min[0][cell], bounds_->min[1][cell], bounds_->min[2][cell]),
+                Vec3(bounds_->max[0][cell], bounds_->max[1][cell], bounds_->max[2][cell]));
+}
+
+bool EnsightCellRecords::contains(Index cell, const Vec3& pos,
+                                  EnsightBarycentricCoordinates& baryCoordOut,
+                                  bool ignore2dCells) const
+{
+    if (!boundsContain(cell, pos))
+        return false;
+
+    // Compute the barycentric coordinates with a temporary identifier, the
+    // persistent one is only created for the cell actually found
+    const CellListRange& range = findRange(cell);
+    EnsightCellIdentifier candidate(range.part, range.cellList, range.timestep,
+                                    static_cast<int>(cell - range.first), getBounds(cell));
+    if (!baryCoordOut.compute(pos, &candidate, ignore2dCells))
+    {
+        baryCoordOut.reset();
+        return false;
+    }
+    baryCoordOut.setCell(getIdentifier(cell));
+    return true;
+}
+
+bool EnsightCellRecords::is2dCell(Index cell) const
+{
+    const Ensight::Cell type = findRange(cell).cellList->getType();
+    return type == Ensight::Triangle || type == Ensight::Quadrangle;
+}
+
+EnsightCellIdentifier* EnsightCellRecords::getIdentifier(Index cell) const
+{
+    Q_ASSERT(cell < size());
+
+    std::atomic<IdentifierBlock*>& blockPtr = blocks_[cell >> BlockBits];
+    IdentifierBlock* block = blockPtr.load(std::memory_order_acquire);
+    if (!block)
+    {
+        IdentifierBlock* newBlock = new IdentifierBlock();
+        if (blockPtr.compare_exchange_strong(block, newBlock, std::memory_order_acq_rel))
+            block = newBlock;
+        else
+            delete newBlock;  // created by another thread, block was updated
+    }
+
+    std::atomic<EnsightCellIdentifier*>& cellPtr = block->cells[cell & (BlockSize - 1)];
+    EnsightCellIdentifier* identifier = cellPtr.load(std::memory_order_acquire);
+    if (!identifier)
+    {
+        const CellListRange& range = findRange(cell);
+        EnsightCellIdentifier* newIdentifier = new EnsightCellIdentifier(
+            range.part, range.cellList, range.timestep, static_cast<int>(cell - range.first),
+            getBounds(cell));
+        if (cellPtr.compare_exchange_strong(identifier, newIdentifier, std::memory_order_acq_rel))
+            identifier = newIdentifier;
+        else
+            delete newIdentifier;
+    }
+    return identifier;
+}
+
+bool EnsightCellRecords::find(const EnsightCellIdentifier* identifier, Index& cell) const
+{
+    for (const CellListRange& range : ranges_)
+    {
+        if (range.cellList == identifier->getCellList()
+                && identifier->getIndex() < range.cellList->getValues().cols())
+        {
+            cell = range.first + static_cast<Index>(identifier->getIndex());
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EnsightCellRecords::find(const EnsightPart* part, int listIndex, int index, Index& cell) const
+{
+    for (const CellListRange& range : ranges_)
+    {
+        if (range.part == part && range.listIndex == listIndex
+                && index >= 0 && index < range.cellList->getValues().cols())
+        {
+            cell = range.first + static_cast<Index>(index);
+            return true;
+        }
+    }
+    return false;
+}
+
+double EnsightCellRecords::project(Index cell, const Vec3& pos,
+                                   EnsightBarycentricCoordinates& baryCoordOut) const
+{
+    Vecx weights;
+    Vec3 closest;
+    const double distSq = computeClosestPoint(cell, pos, weights, closest);
+    baryCoordOut.set(weights, closest, getIdentifier(cell));
+    return std::sqrt(distSq);
+}
+
+double EnsightCellRecords::getDistance(Index cell, const Vec3& pos) const
+{
+    Vecx weights;
+    Vec3 closest;
+    return std::sqrt(computeClosestPoint(cell, pos, weights, closest));
+}
+
+bool EnsightCellRecords::findNeighborTowards(Index cell, const Vec3& pos, Index& neighbor) const
+{
+    const CellListRange& range = findRange(cell);
+    const int index = static_cast<int>(cell - range.first);
+    const Ensight::Cell type = range.cellList->getType();
+    const MatiView values = range.cellList->getValues();
+    const MatxView vertices = range.part->getVertices(range.timestep);
+
+    Vec3 center = Vec3::Zero();
+    for (int i = 0; i < values.rows(); i++)
+        center += vertices.col(values(i, index));
+    center /= values.rows();
+
+    // Find the face with the largest distance of pos outside of its plane.
+    // Faces of 2D cells are edges, their normals lie in the Z=0 plane.
+    int exitFace = -1;
+    double maxDistance = 0.0;
+    for (int face = 0; face < Ensight::numCellFaces[type]; face++)
+    {
+        const int* nodes = Ensight::cellFaces[type][face];
+        int numNodes = 0;
+        Vec3 faceCenter = Vec3::Zero();
+        Vec3 v[Ensight::maxNumNodesPerFace];
+        for (; numNodes < Ensight::maxNumNodesPerFace && nodes[numNodes] >= 0; numNodes++)
+        {
+            v[numNodes] = vertices.col(values(nodes[numNodes], index));
+            faceCenter += v[numNodes];
+        }
+        faceCenter /= numNodes;
+
+        Vec3 normal;
+        if (numNodes == 2)
+            normal = Vec3(v[0][1] - v[1][1], v[1][0] - v[0][0], 0.0);
+        else if (numNodes == 3)
+            normal = (v[1] - v[0]).cross(v[2] - v[0]);
+        else
+            normal = (v[2] - v[0]).cross(v[3] - v[1]);
+
+        // Orient the normal away from the cell center
+        if (normal.dot(center - faceCenter) > 0.0)
+            normal = -normal;
+        const double length = normal.norm();
+        if (!(length > 0.0))
+            continue;
+
+        const double distance = normal.dot(pos - faceCenter) / length;
+        if (distance > maxDistance)
+        {
+            maxDistance = distance;
+            exitFace = face;
+        }
+    }
+    if (exitFace < 0)
+        return false;
+
+    const EnsightFaceConnectivity& connectivity = range.part->getFaceConnectivity(range.timestep);
+    const int neighborIndex = connectivity.getNeighbors(range.listIndex)(exitFace, index);
+    if (neighborIndex < 0)
+        return false;
+    const int neighborList = connectivity.getNeighborList(range.listIndex, exitFace, index);
+
+    // The ranges of the cell lists of a part are stored in the order of the lists
+    const CellListRange& neighborRange = *(&range - range.listIndex + neighborList);
+    neighbor = neighborRange.first + static_cast<Index>(neighborIndex);
+    return true;
+}
+
+int64_t EnsightCellRecords::getRecordBytes() const
+{
+    int64_t bytes = ranges_.capacity() * sizeof(CellListRange);
+    for (int d = 0; d < 3; d++)
+        bytes += (bounds_->min[d].capacity() + bounds_->max[d].capacity()) * sizeof(float);
+    return bytes;
+}
+
+int64_t EnsightCellRecords::getIdentifierBytes() const
+{
+    int64_t bytes = numBlocks_ * sizeof(std::atomic<IdentifierBlock*>);
+    for (size_t i = 0; i < numBlocks_; i++)
+    {
+        const IdentifierBlock* block = blocks_[i].load(std::memory_order_acquire);
+        if (!block)
+            continue;
+        bytes += sizeof(IdentifierBlock);
+        for (const auto& cell : block->cells)
+        {
+            if (cell.load(std::memory_order_acquire))
+                bytes += sizeof(EnsightCellIdentifier);
+        }
+    }
+    return bytes;
+}
+
+void EnsightCellRecords::reserveIdentifiers(size_t numCells)
+{
+    const size_t numBlocks = (numCells + BlockSize - 1) / BlockSize;
+    if (numBlocks > numBlocks_)
+    {
+        std::unique_ptr<std::atomic<IdentifierBlock*>[]> blocks(
+            new std::atomic<IdentifierBlock*>[numBlocks]);
+        for (size_t i = 0; i < numBlocks; i++)
+        {
+            IdentifierBlock* block = i < numBlocks_ ? blocks_[i].load() : nullptr;
+            blocks[i].store(block, std::memory_order_relaxed);
+        }
+        blocks_.swap(blocks);
+        numBlocks_ = numBlocks;
+    }
+}
+
+const EnsightCellRecords::CellListRange& EnsightCellRecords::findRange(Index cell) const
+{
+    // The last range starting at or before cell
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), cell,
+                               [](Index c, const CellListRange& range) {
+        return c < range.first;
+    });
+    Q_ASSERT(it != ranges_.begin());
+    return *(it - 1);
+}
+
+double EnsightCellRecords::computeClosestPoint(Index cell, const Vec3& pos, Vecx& weights,
+                                               Vec3& closest) const
+{
+    const CellListRange& range = findRange(cell);
+    const int index = static_cast<int>(cell - range.first);
+    const Ensight::Cell type = range.cellList->getType();
+    const MatiView values = range.cellList->getValues();
+    const MatxView vertices = range.part->getVertices(range.timestep);
+
+    weights = Vecx::Zero(values.rows());
+    closest = Vec3::Zero();
+    double minDistSq = std::numeric_limits<double>::infinity();
+
+    // Test the triangle of the local nodes a, b and c
+    auto testTriangle = [&](int a, int b, int c) {
+        const Vec3 va = vertices.col(values(a, index));
+        const Vec3 vb = vertices.col(values(b, index));
+        const Vec3 vc = vertices.col(values(c, index));
+        const Vec3 w = closestOnTriangle(pos, va, vb, vc);
+        const Vec3 q = w[0] * va + w[1] * vb + w[2] * vc;
+        const double distSq = (q - pos).squaredNorm();
+        if (distSq < minDistSq)
+        {
+            minDistSq = distSq;
+            closest = q;
+            weights.setZero();
+            weights[a] += w[0];
+            weights[b] += w[1];
+            weights[c] += w[2];
+        }
+    };
+
+    if (type == Ensight::Point)
+        testTriangle(0, 0, 0);
+    else if (type == Ensight::Bar)
+        testTriangle(0, 1, 1);
+    else if (type == Ensight::Triangle)
+        testTriangle(0, 1, 2);
+    else if (type == Ensight::Quadrangle)
+    {
+        testTriangle(0, 1, 2);
+        testTriangle(0, 2, 3);
+    }
+    else
+    {
+        for (int face = 0; face < Ensight::numCellFaces[type]; face++)
+        {
+            const int* nodes = Ensight::cellFaces[type][face];
+            testTriangle(nodes[0], nodes[1], nodes[2]);
+            if (nodes[3] >= 0)
+                testTriangle(nodes[0], nodes[2], nodes[3]);
+        }
+    }
+    return minDistSq;
+}
+
+const int EnsightCellRecords::BlockBits;
+const EnsightCellRecords::Index EnsightCellRecords::BlockSize;
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#include "../include/ensightfaceconnectivity.h"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+#include "../include/ensightcell.h"
+#include "../include/ensightdef.h"
+#include "../include/ensightparallel.h"
+
+
+namespace
+{
+
+/**
+ * @brief Canonical key of a face: its node indices in ascending order.
+ *
+ * Unused entries of faces with less than Ensight::maxNumNodesPerFace nodes are
+ * set to INT_MAX, so the smallest node index is always the first entry and
+ * triangles never match quadrilaterals.
+ */
+typedef std::array<int, Ensight::maxNumNodesPerFace> FaceKey;
+
+FaceKey getFaceKey(const MatiView& values, Ensight::Cell type, int cell, int face)
+{
+    FaceKey key;
+    key.fill(std::numeric_limits<int>::max());
+    for (int node = 0; node < Ensight::maxNumNodesPerFace; node++)
+    {
+        int pointer = Ensight::cellFaces[type][face][node];
+        if (pointer == -1)
+            break;
+        key[node] = values(pointer, cell);
+    }
+
+    // Sorting network for four entries
+    static_assert(Ensight::maxNumNodesPerFace == 4, "Sorting network expects four nodes per face");
+    auto order = [&key](int i, int j) {
+        if (key[j] < key[i])
+            std::swap(key[i], key[j]);
+    };
+    order(0, 1);
+    order(2, 3);
+    order(0, 2);
+    order(1, 3);
+    order(1, 2);
+    return key;
+}
+
+/**
+ * @brief Checks if all nodes of a face are in [0, numVertices).
+ */
+bool isValidFace(const MatiView& values, Ensight::Cell type, int cell, int face, int numVertices)
+{
+    for (int node = 0; node < Ensight::maxNumNodesPerFace; node++)
+    {
+        int pointer = Ensight::cellFaces[type][face][node];
+        if (pointer == -1)
+            break;
+        int vertex = values(pointer, cell);
+        if (vertex < 0 || vertex >= numVertices)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief A face of a cell of one of the cell lists.
+ */
+struct Face
+{
+    int cellList;
+    int cell;
+    int face;
+};
+
+} // namespace
+
+EnsightFaceConnectivity::EnsightFaceConnectivity(const QList<const EnsightCellList*>& cellLists,
+                                                 int numVertices)
+{
+    const int numLists = cellLists.size();
+    const int64_t grainSize = 4096;
+
+    // Faces are identified by faceOffsets[list] + cell * numFaces + face
+    std::vector<MatiView> values;
+    std::vector<Ensight::Cell> types;
+    std::vector<int> numFaces;
+    std::vector<int> faceOffsets(1, 0);
+    for (const EnsightCellList* cellList : cellLists)
+    {
+        values.push_back(cellList->getValues());
+        types.push_back(cellList->getType());
+        numFaces.push_back(Ensight::numCellFaces[types.back()]);
+        faceOffsets.push_back(faceOffsets.back() + numFaces.back() * values.back().cols());
+        neighbors_.push_back(Mati::Constant(numFaces.back(), values.back().cols(), -1));
+    }
+    if (numLists > 1)
+    {
+        for (const Mati& neighbors : neighbors_)
+            neighborLists_.push_back(Mati::Constant(neighbors.rows(), neighbors.cols(), -1));
+    }
+
+    boundary_ = Mati(3, 0);
+    boundaryVertices_ = Mati(1, 0);
+    const int totalFaces = faceOffsets.back();
+    if (totalFaces == 0)
+        return;
+
+    auto getFace = [&](int id) {
+        Face face;
+        face.cellList = 0;
+        while (id >= faceOffsets[face.cellList + 1])
+            face.cellList++;
+        id -= faceOffsets[face.cellList];
+        face.cell = id / numFaces[face.cellList];
+        face.face = id % numFaces[face.cellList];
+        return face;
+    };
+    auto getKey = [&](const Face& face) {
+        return getFaceKey(values[face.cellList], types[face.cellList], face.cell, face.face);
+    };
+
+    // Bucket the faces by their smallest node index with a counting sort,
+    // faces with equal keys always end up in the same bucket. There are at most
+    // as many buckets as faces, so the memory does not depend on the index values.
+    // Faces with invalid nodes are put into an extra last bucket which is skipped.
+    const int numBuckets = std::max(1, std::min(numVertices, totalFaces));
+    std::vector<int> faceBucket(totalFaces);
+    for (int list = 0; list < numLists; list++)
+    {
+        Ensight::Parallel::parallelFor(0, values[list].cols(), grainSize, [&](int64_t first, int64_t last) {
+            for (int64_t cell = first; cell < last; cell++)
+                for (int face = 0; face < numFaces[list]; face++)
+                {
+                    int bucket = numBuckets;
+                    if (isValidFace(values[list], types[list], cell, face, numVertices))
+                        bucket = getFaceKey(values[list], types[list], cell, face)[0] % numBuckets;
+                    faceBucket[faceOffsets[list] + cell * numFaces[list] + face] = bucket;
+                }
+        });
+    }
+
+    std::vector<int> bucketStart(numBuckets + 2, 0);
+    for (int bucket : faceBucket)
+        bucketStart[bucket + 1]++;
+    for (int bucket = 0; bucket <= numBuckets; bucket++)
+        bucketStart[bucket + 1] += bucketStart[bucket];
+
+    std::vector<int> sortedFaces(totalFaces);
+    std::vector<int> bucketFill(bucketStart.begin(), bucketStart.end() - 1);
+    for (int id = 0; id < totalFaces; id++)
+        sortedFaces[bucketFill[faceBucket[id]]++] = id;
+    std::vector<int>().swap(faceBucket);
+    std::vector<int>().swap(bucketFill);
+
+    // Match the faces within each bucket. Each face belongs to exactly one bucket,
+    // so the buckets can be processed independently.
+    Ensight::Parallel::parallelFor(0, numBuckets, grainSize, [&](int64_t first, int64_t last) {
+        std::vector<std::pair<FaceKey, int>> bucket;
+        std::vector<Face> unmatched;
+        for (int64_t node = first; node < last; node++)
+        {
+            if (bucketStart[node + 1] - bucketStart[node] < 2)
+                continue;
+
+            bucket.clear();
+            for (int k = bucketStart[node]; k < bucketStart[node + 1]; k++)
+                bucket.emplace_back(getKey(getFace(sortedFaces[k])), sortedFaces[k]);
+            std::sort(bucket.begin(), bucket.end());
+
+            // Within a group of equal keys a face is paired with the most recent unmatched
+            // face of a different cell
+            for (size_t begin = 0, end = 0; begin < bucket.size(); begin = end)
+            {
+                unmatched.clear();
+                for (end = begin; end < bucket.size() && bucket[end].first == bucket[begin].first; end++)
+                {
+                    Face newFace = getFace(bucket[end].second);
+                    auto match = unmatched.rbegin();
+                    while (match != unmatched.rend() && match->cellList == newFace.cellList &&
+                           match->cell == newFace.cell)
+                        ++match;
+
+                    if (match == unmatched.rend())
+                    {
+                        unmatched.push_back(newFace);
+                        continue;
+                    }
+
+                    // Save the neighboring cell at the corresponding entry
+                    Face oldFace = *match;
+                    neighbors_[oldFace.cellList](oldFace.face, oldFace.cell) = newFace.cell;
+                    neighbors_[newFace.cellList](newFace.face, newFace.cell) = oldFace.cell;
+                    if (numLists > 1)
+                    {
+                        neighborLists_[oldFace.cellList](oldFace.face, oldFace.cell) = newFace.cellList;
+                        neighborLists_[newFace.cellList](newFace.face, newFace.cell) = oldFace.cellList;
+                    }
+                    unmatched.erase(std::next(match).base());
+                }
+            }
+        }
+    });
+
+    // All valid faces without neighbor are boundary faces
+    std::vector<int> boundary;
+    std::vector<int> boundaryNodes;
+    for (int list = 0; list < numLists; list++)
+    {
+        const Mati& neighbors = neighbors_[list];
+        for (int cell = 0; cell < neighbors.cols(); cell++)
+        {
+            for (int face = 0; face < neighbors.rows(); face++)
+            {
+                if (neighbors(face, cell) != -1 ||
+                    !isValidFace(values[list], types[list], cell, face, numVertices))
+                    continue;
+
+                boundary.insert(boundary.end(), {list, cell, face});
+
+                // Collect the boundary nodes of this face
+                for (int l = 0; l < Ensight::maxNumNodesPerFace; l++)
+                {
+                    int nodeIndex = Ensight::cellFaces[types[list]][face][l];
+                    if (nodeIndex != -1)
+                        boundaryNodes.push_back(values[list](nodeIndex, cell));
+                }
+            }
+        }
+    }
+    boundary_ = Eigen::Map<Mati>(boundary.data(), 3, boundary.size() / 3);
+
+    // Boundary vertices in ascending order
+    std::sort(boundaryNodes.begin(), boundaryNodes.end());
+    boundaryNodes.erase(std::unique(boundaryNodes.begin(), boundaryNodes.end()), boundaryNodes.end());
+    boundaryVertices_ = Eigen::Map<Mati>(boundaryNodes.data(), 1, boundaryNodes.size());
+}
+
+int EnsightFaceConnectivity::getNumberOfCellLists() const
+{
+    return static_cast<int>(neighbors_.size());
+}
+
+const Mati& EnsightFaceConnectivity::getNeighbors(int cellList) const
+{
+    return neighbors_[cellList];
+}
+
+int EnsightFaceConnectivity::getNeighborList(int cellList, int face, int cell) const
+{
+    if (neighborLists_.empty())
+        return neighbors_[cellList](face, cell) == -1 ? -1 : cellList;
+    return neighborLists_[cellList](face, cell);
+}
+
+const Mati& EnsightFaceConnectivity::getBoundary() const
+{
+    return boundary_;
+}
+
+const Mati& EnsightFaceConnectivity::getBoundaryVertices() const
+{
+    return boundaryVertices_;
+}
+
+int64_t EnsightFaceConnectivity::getBytes() const
+{
+    int64_t bytes = (boundary_.size() + boundaryVertices_.size()) * sizeof(int);
+    for (const Mati& neighbors : neighbors_)
+        bytes += neighbors.size() * sizeof(int);
+    for (const Mati& neighborLists : neighborLists_)
+        bytes += neighborLists.size() * sizeof(int);
+    return bytes;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#include "../include/ensightincidence.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "../include/ensightcell.h"
+#include "../include/ensightparallel.h"
+
+
+namespace
+{
+
+/**
+ * @brief Calls f(vertex) for every distinct valid vertex of a cell.
+ */
+template <typename Function>
+void forEachVertex(const MatiView& values, int cell, int numVertices, Function f)
+{
+    for (int j = 0; j < values.rows(); j++)
+    {
+        int vertex = values(j, cell);
+        if (vertex < 0 || vertex >= numVertices)
+            continue;
+
+        bool duplicate = false;
+        for (int k = 0; k < j && !duplicate; k++)
+            duplicate = values(k, cell) == vertex;
+        if (!duplicate)
+            f(vertex);
+    }
+}
+
+} // namespace
+
+EnsightVertexIncidence::EnsightVertexIncidence(const QList<EnsightCellList*>& cellLists,
+                                               int numVertices) :
+    cellLists_(cellLists), offsets_(numVertices + 1, 0)
+{
+    const int64_t grainSize = 4096;
+
+    // Count the cells of each vertex
+    std::unique_ptr<std::atomic<int>[]> counts(new std::atomic<int>[numVertices + 1]);
+    for (int i = 0; i <= numVertices; i++)
+        counts[i] = 0;
+
+    for (int list = 0; list < cellLists_.size(); list++)
+    {
+        MatiView values = cellLists_[list]->getValues();
+        Ensight::Parallel::parallelFor(0, values.cols(), grainSize, [&](int64_t first, int64_t last) {
+            for (int64_t cell = first; cell < last; cell++)
+                forEachVertex(values, cell, numVertices, [&counts](int vertex) {
+                    counts[vertex + 1].fetch_add(1, std::memory_order_relaxed);
+                });
+        });
+    }
+
+    for (int i = 0; i < numVertices; i++)
+        offsets_[i + 1] = offsets_[i] + counts[i + 1];
+
+    // Scatter the cells into their rows, using the counters as fill positions
+    for (int i = 0; i < numVertices; i++)
+        counts[i] = offsets_[i];
+
+    entries_.resize(offsets_[numVertices]);
+    for (int list = 0; list < cellLists_.size(); list++)
+    {
+        MatiView values = cellLists_[list]->getValues();
+        Ensight::Parallel::parallelFor(0, values.cols(), grainSize, [&](int64_t first, int64_t last) {
+            for (int64_t cell = first; cell < last; cell++)
+                forEachVertex(values, cell, numVertices, [&](int vertex) {
+                    Entry& entry = entries_[counts[vertex].fetch_add(1, std::memory_order_relaxed)];
+                    entry.cellList = list;
+                    entry.cell = cell;
+                });
+        });
+    }
+
+    // The order within a row depends on the thread scheduling, sort each row
+    Ensight::Parallel::parallelFor(0, numVertices, grainSize, [&](int64_t first, int64_t last) {
+        for (int64_t vertex = first; vertex < last; vertex++)
+            std::sort(entries_.begin() + offsets_[vertex], entries_.begin() + offsets_[vertex + 1],
+                      [](const Entry& a, const Entry& b) {
+                          return a.cellList < b.cellList || (a.cellList == b.cellList && a.cell < b.cell);
+                      });
+    });
+}
+
+int EnsightVertexIncidence::getNumberOfVertices() const
+{
+    return static_cast<int>(offsets_.size()) - 1;
+}
+
+int EnsightVertexIncidence::getCellCount(int vertex) const
+{
+    return offsets_[vertex + 1] - offsets_[vertex];
+}
+
+const EnsightVertexIncidence::Entry* EnsightVertexIncidence::getCells(int vertex) const
+{
+    return entries_.data() + offsets_[vertex];
+}
+
+EnsightCellList* EnsightVertexIncidence::getCellList(int cellList) const
+{
+    return cellLists_[cellList];
+}
+
+const std::vector<int>& EnsightVertexIncidence::getOffsets() const
+{
+    return offsets_;
+}
+
+const std::vector<EnsightVertexIncidence::Entry>& EnsightVertexIncidence::getEntries() const
+{
+    return entries_;
+}
+
+int64_t EnsightVertexIncidence::getBytes() const
+{
+    return offsets_.capacity() * sizeof(int) + entries_.capacity() * sizeof(Entry);
+}
@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "../include/ensightkdtree.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../include/ensightparallel.h"
+#include "../include/ensightpart.h"
+
+
+EnsightKdTree::EnsightKdTree()
+    : sources_(), size_(0), layout_()
+{
+}
+
+void EnsightKdTree::insert(EnsightPart* part, int timestep)
+{
+    const int64_t numVertices = part->getVertices(timestep).cols();
+    Q_ASSERT((size_t) size_ + numVertices < (size_t) InnerNode);
+    sources_.push_back(Source{size_, part, timestep});
+    size_ += static_cast<Index>(numVertices);
+
+    // The tree is rebuilt from all vertices by build() or the next query
+    layout_.reset();
+}
+
+void EnsightKdTree::share(const EnsightKdTree& other, int timestep)
+{
+    Q_ASSERT(size_ == 0);
+    sources_ = other.sources_;
+    for (Source& source : sources_)
+        source.timestep = timestep;
+    size_ = other.size_;
+    layout_.share(other.layout_);
+}
+
+void EnsightKdTree::build()
+{
+    getLayout();
+}
+
+int EnsightKdTree::size() const
+{
+    return static_cast<int>(size_);
+}
+
+QVector<EnsightKdTree::Neighbor> EnsightKdTree::findNearest(const Vec3& pos, int k) const
+{
+    std::vector<Candidate> heap;
+    if (k <= 0)
+        return toNeighbors(heap);
+    heap.reserve(k);
+
+    // Max-heap of the k closest vertices found so far
+    double maxDistSq = std::numeric_limits<double>::infinity();
+    traverse(getLayout(), pos, maxDistSq, [&](double distSq, Index vertex) {
+        const Candidate candidate(distSq, vertex);
+        if (heap.size() < static_cast<size_t>(k))
+        {
+            heap.push_back(candidate);
+            std::push_heap(heap.begin(), heap.end());
+        }
+        else if (candidate < heap.front())
+        {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = candidate;
+            std::push_heap(heap.begin(), heap.end());
+        }
+        if (heap.size() == static_cast<size_t>(k))
+            maxDistSq = heap.front().first;
+    });
+    return toNeighbors(heap);
+}
+
+void EnsightKdTree::findNearest(const Eigen::Ref<const Matx>& positions, int k,
+                                QVector<QVector<Neighbor>>& neighborsOut) const
+{
+    Q_ASSERT(positions.rows() == 3);
+    neighborsOut = QVector<QVector<Neighbor>>(static_cast<int>(positions.cols()));
+    QVector<Neighbor>* neighborData = neighborsOut.data();
+    Ensight::Parallel::parallelFor(0, positions.cols(), 256, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            neighborData[i] = findNearest(Vec3(positions.col(i)), k);
+    });
+}
+
+QVector<EnsightKdTree::Neighbor> EnsightKdTree::findWithinRadius(const Vec3& pos,
+                                                                 double radius) const
+{
+    std::vector<Candidate> candidates;
+    if (!(radius >= 0.0))
+        return toNeighbors(candidates);
+
+    double maxDistSq = radius * radius;
+    traverse(getLayout(), pos, maxDistSq, [&](double distSq, Index vertex) {
+        candidates.push_back(Candidate(distSq, vertex));
+    });
+    return toNeighbors(candidates);
+}
+
+void EnsightKdTree::findWithinRadius(const Eigen::Ref<const Matx>& positions, double radius,
+                                     QVector<QVector<Neighbor>>& neighborsOut) const
+{
+    Q_ASSERT(positions.rows() == 3);
+    neighborsOut = QVector<QVector<Neighbor>>(static_cast<int>(positions.cols()));
+    QVector<Neighbor>* neighborData = neighborsOut.data();
+    Ensight::Parallel::parallelFor(0, positions.cols(), 256, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            neighborData[i] = findWithinRadius(Vec3(positions.col(i)), radius);
+    });
+}
+
+int64_t EnsightKdTree::getBytes() const
+{
+    if (!layout_.isComputed())
+        return 0;
+    const Layout& layout = getLayout();
+    int64_t bytes = layout.nodes.capacity() * sizeof(KdNode);
+    bytes += layout.vertices.capacity() * sizeof(Index);
+    for (int d = 0; d < 3; d++)
+        bytes += layout.coords[d].capacity() * sizeof(double);
+    return bytes;
+}
+
+const EnsightKdTree::Layout& EnsightKdTree::getLayout() const
+{
+    return layout_.get([this]() { return buildLayout(); });
+}
+
+EnsightKdTree::Layout EnsightKdTree::buildLayout() const
+{
+    std::array<std::vector<double>, 3> points;
+    for (int d = 0; d < 3; d++)
+        points[d].resize(size_);
+    for (const Source& source : sources_)
+    {
+        const MatxView vertices = source.part->getVertices(source.timestep);
+        Ensight::Parallel::parallelFor(0, vertices.cols(), 4096, [&](int64_t first, int64_t last) {
+            for (int64_t i = first; i < last; i++)
+            {
+                for (int d = 0; d < 3; d++)
+                    points[d][source.first + i] = vertices(d, i);
+            }
+        });
+    }
+
+    std::vector<Index> order(size_);
+    for (Index i = 0; i < size_; i++)
+        order[i] = i;
+
+    // The nodes are split level by level, the nodes of a level in parallel as
+    // their vertices are disjoint ranges of order. A split node stores the
+    // index of its left child, the right child follows it. Median splits
+    // halve the vertices, so there are less than 32 levels.
+    struct BuildNode
+    {
+        Index begin;
+        Index end;
+        Index left;  // InnerNode for leaves
+        int axis;    // -1 if the node is not split
+        double split;
+    };
+
+    std::vector<BuildNode> buildNodes;
+    buildNodes.push_back(BuildNode{0, size_, InnerNode, -1, 0.0});
+    size_t levelBegin = 0;
+    while (levelBegin < buildNodes.size())
+    {
+        const size_t levelEnd = buildNodes.size();
+        Ensight::Parallel::parallelFor(levelBegin, levelEnd, 1, [&](int64_t first, int64_t last) {
+            for (int64_t n = first; n < last; n++)
+            {
+                BuildNode& node = buildNodes[n];
+                if (node.end - node.begin <= static_cast<Index>(LeafSize))
+                    continue;
+
+                // Split at the median of the largest extent
+                Vec3 min = Vec3::Constant(std::numeric_limits<double>::max());
+                Vec3 max = Vec3::Constant(std::numeric_limits<double>::lowest());
+                for (Index i = node.begin; i < node.end; i++)
+                {
+                    for (int d = 0; d < 3; d++)
+                    {
+                        min[d] = std::min(min[d], points[d][order[i]]);
+                        max[d] = std::max(max[d], points[d][order[i]]);
+                    }
+                }
+                const Vec3 extent = max - min;
+                int axis = 0;
+                if (extent[1] > extent[axis])
+                    axis = 1;
+                if (extent[2] > extent[axis])
+                    axis = 2;
+                if (!(extent[axis] > 0.0))
+                    continue;  // all vertices coincide
+
+                const Index mid = node.begin + (node.end - node.begin) / 2;
+                const std::vector<double>& coords = points[axis];
+                std::nth_element(order.begin() + node.begin, order.begin() + mid,
+                                 order.begin() + node.end, [&](Index a, Index b) {
+                    return coords[a] < coords[b];
+                });
+                node.axis = axis;
+                node.split = coords[order[mid]];
+            }
+        });
+
+        // Append the children of the split nodes as the next level
+        for (size_t n = levelBegin; n < levelEnd; n++)
+        {
+            if (buildNodes[n].axis < 0)
+                continue;
+            const Index begin = buildNodes[n].begin;
+            const Index end = buildNodes[n].end;
+            const Index mid = begin + (end - begin) / 2;
+            buildNodes[n].left = static_cast<Index>(buildNodes.size());
+            buildNodes.push_back(BuildNode{begin, mid, InnerNode, -1, 0.0});
+            buildNodes.push_back(BuildNode{mid, end, InnerNode, -1, 0.0});
+        }
+        levelBegin = levelEnd;
+    }
+
+    // Store the nodes in depth-first order as in EnsightBvh
+    struct Task
+    {
+        Index node;
+        Index parent;
+    };
+
+    Layout layout;
+    layout.nodes.reserve(buildNodes.size());
+    std::vector<Task> tasks;
+    tasks.push_back(Task{0, InnerNode});
+    while (!tasks.empty())
+    {
+        const Task task = tasks.back();
+        tasks.pop_back();
+
+        const Index nodeIdx = static_cast<Index>(layout.nodes.size());
+        if (task.parent != InnerNode)
+            layout.nodes[task.parent].first = nodeIdx;
+
+        const BuildNode& node = buildNodes[task.node];
+        if (node.left == InnerNode)
+        {
+            layout.nodes.push_back(KdNode{0.0, node.begin, node.end - node.begin, 0});
+            continue;
+        }
+        layout.nodes.push_back(KdNode{node.split, 0, InnerNode, node.axis});
+        tasks.push_back(Task{node.left + 1, nodeIdx});
+        tasks.push_back(Task{node.left, InnerNode});
+    }
+
+    // Copy the coordinates in leaf order
+    for (int d = 0; d < 3; d++)
+        layout.coords[d].resize(size_);
+    Ensight::Parallel::parallelFor(0, size_, 4096, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+        {
+            for (int d = 0; d < 3; d++)
+                layout.coords[d][i] = points[d][order[i]];
+        }
+    });
+    layout.vertices.swap(order);
+    return layout;
+}
+
+template <typename Visit>
+void EnsightKdTree::traverse(const Layout& layout, const Vec3& pos, double& maxDistSq,
+                             Visit&& visit) const
+{
+    // Depth-first traversal, the child containing pos first. The far child
+    // is pushed with a lower bound of the squared distance of its vertices.
+    struct Entry
+    {
+        Index node;
+        double distSq;
+    };
+    Entry stack[MaxDepth];
+    int stackSize = 0;
+    Index nodeIdx = 0;
+    double nodeDistSq = 0.0;
+    while (true)
+    {
+        if (nodeDistSq <= maxDistSq)
+        {
+            const KdNode& node = layout.nodes[nodeIdx];
+            if (node.count == InnerNode)
+            {
+                const double diff = pos[node.axis] - node.split;
+                const double farDistSq = std::max(nodeDistSq, diff * diff);
+                if (diff < 0.0)
+                {
+                    stack[stackSize++] = Entry{node.first, farDistSq};
+                    nodeIdx++;
+                }
+                else
+                {
+                    stack[stackSize++] = Entry{nodeIdx + 1, farDistSq};
+                    nodeIdx = node.first;
+                }
+                continue;
+            }
+            const Index end = node.first + node.count;
+            for (Index i = node.first; i < end; i++)
+            {
+                const double dx = layout.coords[0][i] - pos[0];
+                const double dy = layout.coords[1][i] - pos[1];
+                const double dz = layout.coords[2][i] - pos[2];
+                const double distSq = dx * dx + dy * dy + dz * dz;
+                if (distSq <= maxDistSq)
+                    visit(distSq, layout.vertices[i]);
+            }
+        }
+        if (stackSize == 0)
+            return;
+        stackSize--;
+        nodeIdx = stack[stackSize].node;
+        nodeDistSq = stack[stackSize].distSq;
+    }
+}
+
+QVector<EnsightKdTree::Neighbor> EnsightKdTree::toNeighbors(std::vector<Candidate>& candidates) const
+{
+    std::sort(candidates.begin(), candidates.end());
+
+    QVector<Neighbor> neighbors;
+    neighbors.reserve(static_cast<int>(candidates.size()));
+    for (const Candidate& candidate : candidates)
+    {
+        // The last source starting at or before the vertex
+        auto it = std::upper_bound(sources_.begin(), sources_.end(), candidate.second,
+                                   [](Index vertex, const Source& source) {
+            return vertex < source.first;
+        });
+        const Source& source = *(it - 1);
+        neighbors.push_back(Neighbor{source.part, source.timestep,
+                                     static_cast<int>(candidate.second - source.first),
+                                     std::sqrt(candidate.first)});
+    }
+    return neighbors;
+}
+
+const EnsightKdTree::Index EnsightKdTree::InnerNode;
+const int EnsightKdTree::LeafSize;
+const int EnsightKdTree::MaxDepth;
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "../include/ensightleafbounds.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENSIGHT_USE_SSE2
+#endif
+
+
+namespace
+{
+
+// Maps coordinates within bounds to [0, 255]. Both functions are monotonic, so
+// x <= y implies lower(x) <= lower(y) and lower(x) <= upper(y), even for
+// coordinates outside of bounds, which are clamped.
+struct Quantizer
+{
+    explicit Quantizer(const Bbox& bounds)
+        : min(bounds.minCorner())
+    {
+        const Vec3 diagonal = bounds.diagonal();
+        for (int d = 0; d < 3; d++)
+            scale[d] = diagonal[d] > 0.0 ? 255.0 / diagonal[d] : 0.0;
+    }
+
+    uint8_t lower(double x, int d) const
+    {
+        const double v = (x - min[d]) * scale[d];
+        if (!(v > 0.0))
+            return 0;
+        return v < 255.0 ? static_cast<uint8_t>(v) : 255;
+    }
+
+    uint8_t upper(double x, int d) const
+    {
+        const double v = (x - min[d]) * scale[d];
+        if (!(v > 0.0))
+            return 0;
+        if (!(v < 255.0))
+            return 255;
+        const uint8_t truncated = static_cast<uint8_t>(v);
+        return truncated < v ? truncated + 1 : truncated;
+    }
+
+    Vec3 min;
+    Vec3 scale;
+};
+
+}
+
+
+EnsightLeafBounds::EnsightLeafBounds()
+    : size_(0), min_(), max_()
+{
+}
+
+void EnsightLeafBounds::resize(size_t numEntries)
+{
+    size_ = numEntries;
+    for (int d = 0; d < 3; d++)
+    {
+        min_[d].resize(numEntries + GroupSize - 1, 0);
+        max_[d].resize(numEntries + GroupSize - 1, 0);
+    }
+}
+
+void EnsightLeafBounds::squeeze()
+{
+    for (int d = 0; d < 3; d++)
+    {
+        min_[d].shrink_to_fit();
+        max_[d].shrink_to_fit();
+    }
+}
+
+void EnsightLeafBounds::set(size_t first, int count, const Bbox& leafBounds, const Index* cells,
+                            const EnsightCellRecords& records)
+{
+    const Quantizer quantizer(leafBounds);
+    for (int d = 0; d < 3; d++)
+    {
+        // Byte stores may alias anything, so keep the pointers in locals
+        uint8_t* min = min_[d].data() + first;
+        uint8_t* max = max_[d].data() + first;
+        const float* cellMin = records.getMinCoordinates(d);
+        const float* cellMax = records.getMaxCoordinates(d);
+        for (int k = 0; k < count; k++)
+        {
+            min[k] = quantizer.lower(cellMin[cells[k]], d);
+            max[k] = quantizer.upper(cellMax[cells[k]], d);
+        }
+    }
+}
+
+int EnsightLeafBounds::filter(size_t first, int count, const Bbox& leafBounds, const Vec3& pos,
+                              const Index* cells, Index* survivors) const
+{
+    const Quantizer quantizer(leafBounds);
+    uint8_t q[3];
+    for (int d = 0; d < 3; d++)
+        q[d] = quantizer.lower(pos[d], d);
+
+    int numSurvivors = 0;
+#ifdef ENSIGHT_USE_SSE2
+    const __m128i p[3] = {_mm_set1_epi8(static_cast<char>(q[0])),
+                          _mm_set1_epi8(static_cast<char>(q[1])),
+                          _mm_set1_epi8(static_cast<char>(q[2]))};
+    for (int k = 0; k < count; k += GroupSize)
+    {
+        // Unsigned comparisons min <= p <= max via max(min, p) == p and
+        // min(max, p) == p
+        __m128i inside = _mm_set1_epi8(-1);
+        for (int d = 0; d < 3; d++)
+        {
+            const __m128i min = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&min_[d][first + k]));
+            const __m128i max = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&max_[d][first + k]));
+            inside = _mm_and_si128(inside, _mm_cmpeq_epi8(_mm_max_epu8(min, p[d]), p[d]));
+            inside = _mm_and_si128(inside, _mm_cmpeq_epi8(_mm_min_epu8(max, p[d]), p[d]));
+        }
+
+        // Append the selected cells without branching, lanes past the end of
+        // the leaf are ignored
+        const int mask = _mm_movemask_epi8(inside);
+        const int groupCount = std::min(GroupSize, count - k);
+        for (int j = 0; j < groupCount; j++)
+        {
+            survivors[numSurvivors] = cells[k + j];
+            numSurvivors += (mask >> j) & 1;
+        }
+    }
+#else
+    for (int k = 0; k < count; k++)
+    {
+        const size_t entry = first + k;
+        const bool inside = min_[0][entry] <= q[0] && q[0] <= max_[0][entry] &&
+                            min_[1][entry] <= q[1] && q[1] <= max_[1][entry] &&
+                            min_[2][entry] <= q[2] && q[2] <= max_[2][entry];
+        survivors[numSurvivors] = cells[k];
+        numSurvivors += inside ? 1 : 0;
+    }
+#endif
+    return numSurvivors;
+}
+
+int64_t EnsightLeafBounds::getBytes() const
+{
+    int64_t bytes = 0;
+    for (int d = 0; d < 3; d++)
+        bytes += min_[d].capacity() + max_[d].capacity();
+    return bytes;
+}
+
+const int EnsightLeafBounds::ChunkSize;
+const int EnsightLeafBounds::GroupSize;
@@ -39,7 +39,7 @@ bool EnsightLib::writeEnsight(EnsightObj* ensight, const QString& filename,
 {
     if (ensight->inEditMode())
     {
-        EnsightObj::ERROR_STR = "ERROR in [write()] In Edit Mode, call "
+        EnsightObj::errorString() = "ERROR in [write()] In Edit Mode, call "
                                 "endEdit() first to verify data before writing "
                                 "data to disk.";
         return false;
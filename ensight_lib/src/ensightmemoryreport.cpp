@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#include "../include/ensightmemoryreport.h"
+
+#include <fstream>
+#include <iostream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#elif defined(__unix__)
+#include <sys/resource.h>
+#endif
+
+
+int64_t EnsightMemoryReport::getDeduplicatedBytes() const
+{
+    return arrayBytes - storedArrayBytes;
+}
+
+int64_t EnsightMemoryReport::getTotalBytes() const
+{
+    return storedArrayBytes + topologyBytes + subdivTreeBytes;
+}
+
+void EnsightMemoryReport::addEntry(const std::string& part, int timestep,
+                                   const std::string& category, const std::string& name,
+                                   int64_t bytes, bool shared)
+{
+    Entry entry;
+    entry.part = part;
+    entry.timestep = timestep;
+    entry.category = category;
+    entry.name = name;
+    entry.bytes = bytes;
+    entry.shared = shared;
+    entries.push_back(entry);
+}
+
+void EnsightMemoryReport::print(std::ostream& out) const
+{
+    out << "Memory usage:\n";
+    out << "  Total: " << getTotalBytes() << " bytes\n";
+    out << "  Arrays: " << arrayBytes << " bytes\n";
+    out << "  Stored arrays: " << storedArrayBytes << " bytes\n";
+    out << "  Saved by deduplication: " << getDeduplicatedBytes() << " bytes\n";
+    out << "  Peak of stored arrays: " << peakArrayBytes << " bytes\n";
+    out << "  Peak while reading: " << readPeakBytes << " bytes\n";
+    out << "  Topology: " << topologyBytes << " bytes\n";
+    out << "  Subdivision tree: " << subdivTreeBytes << " bytes\n";
+
+    for (const Entry& entry : entries)
+    {
+        out << "    ";
+        if (entry.timestep >= 0)
+            out << entry.part << " [t=" << entry.timestep << "] ";
+        out << entry.category;
+        if (!entry.name.empty())
+            out << " " << entry.name;
+        out << ": " << entry.bytes << " bytes";
+        if (entry.shared)
+            out << " (shared)";
+        out << "\n";
+    }
+}
+
+#if defined(__linux__)
+namespace
+{
+
+/**
+ * @brief Reads a value in kB from /proc/self/status, e.g. "VmRSS:", in bytes.
+ */
+int64_t readProcStatus(const std::string& key)
+{
+    std::ifstream status("/proc/self/status");
+    std::string token;
+    while (status >> token)
+    {
+        if (token == key)
+        {
+            int64_t kiloBytes = 0;
+            status >> kiloBytes;
+            return kiloBytes * 1024;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+#endif
+
+int64_t EnsightMemoryReport::getResidentBytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return static_cast<int64_t>(counters.WorkingSetSize);
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info),
+                  &count) == KERN_SUCCESS)
+        return static_cast<int64_t>(info.resident_size);
+    return 0;
+#elif defined(__linux__)
+    return readProcStatus("VmRSS:");
+#else
+    return 0;
+#endif
+}
+
+int64_t EnsightMemoryReport::getPeakResidentBytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return static_cast<int64_t>(counters.PeakWorkingSetSize);
+    return 0;
+#elif defined(__linux__)
+    return readProcStatus("VmHWM:");
+#elif defined(__APPLE__)
+    // ru_maxrss is in bytes on macOS
+    rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? static_cast<int64_t>(usage.ru_maxrss) : 0;
+#elif defined(__unix__)
+    rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? static_cast<int64_t>(usage.ru_maxrss) * 1024 : 0;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#include "../include/ensightmeshview.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <QDebug>
+
+#include "../include/ensightcell.h"
+#include "../include/ensightparallel.h"
+
+
+EnsightMeshView::EnsightMeshView(const QList<const EnsightCellList*>& cellLists)
+{
+    cellListOffsets_.push_back(0);
+    int64_t connectivitySize = 0;
+    for (const EnsightCellList* cellList : cellLists)
+    {
+        MatiView values = cellList->getValues();
+        cellListOffsets_.push_back(cellListOffsets_.back() + values.cols());
+        connectivitySize += values.size();
+    }
+
+    const int numCells = cellListOffsets_.back();
+    offsets_.resize(numCells + 1);
+    connectivity_.resize(connectivitySize);
+    types_.resize(numCells);
+
+    // Cells of a list are contiguous in the connectivity and column-major in the
+    // list, so each list is copied as one block
+    int64_t connectivityOffset = 0;
+    for (int list = 0; list < cellLists.size(); list++)
+    {
+        MatiView values = cellLists[list]->getValues();
+        const int first = cellListOffsets_[list];
+        const int size = values.rows();
+        std::copy(values.data(), values.data() + values.size(),
+                  connectivity_.begin() + connectivityOffset);
+        std::fill(types_.begin() + first, types_.begin() + first + values.cols(),
+                  static_cast<int8_t>(cellLists[list]->getType()));
+        for (int cell = 0; cell < values.cols(); cell++)
+            offsets_[first + cell] = connectivityOffset + int64_t(cell) * size;
+        connectivityOffset += values.size();
+    }
+    offsets_[numCells] = connectivityOffset;
+}
+
+int EnsightMeshView::getNumberOfCells() const
+{
+    return static_cast<int>(types_.size());
+}
+
+Ensight::Cell EnsightMeshView::getCellType(int cell) const
+{
+    return static_cast<Ensight::Cell>(types_[cell]);
+}
+
+int EnsightMeshView::getCellSize(int cell) const
+{
+    return offsets_[cell + 1] - offsets_[cell];
+}
+
+const int* EnsightMeshView::getCell(int cell) const
+{
+    return connectivity_.data() + offsets_[cell];
+}
+
+const std::vector<int>& EnsightMeshView::getOffsets() const
+{
+    return offsets_;
+}
+
+const std::vector<int>& EnsightMeshView::getConnectivity() const
+{
+    return connectivity_;
+}
+
+const std::vector<int8_t>& EnsightMeshView::getTypes() const
+{
+    return types_;
+}
+
+const std::vector<int>& EnsightMeshView::getCellListOffsets() const
+{
+    return cellListOffsets_;
+}
+
+int64_t EnsightMeshView::getBytes() const
+{
+    return (offsets_.capacity() + connectivity_.capacity() + cellListOffsets_.capacity()) * sizeof(int) +
+            types_.capacity() * sizeof(int8_t);
+}
+
+Matx EnsightMeshView::computeBounds(const MatxView& vertices) const
+{
+    Matx bounds(6, getNumberOfCells());
+    Ensight::Parallel::parallelFor(0, getNumberOfCells(), 4096, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+        {
+            const int* cell = getCell(i);
+            Vec3 min = vertices.col(cell[0]);
+            Vec3 max = min;
+            for (int j = 1; j < getCellSize(i); j++)
+            {
+                min = min.cwiseMin(vertices.col(cell[j]));
+                max = max.cwiseMax(vertices.col(cell[j]));
+            }
+            bounds.block<3, 1>(0, i) = min;
+            bounds.block<3, 1>(3, i) = max;
+        }
+    });
+    return bounds;
+}
+
+Matx EnsightMeshView::computeCentroids(const MatxView& vertices) const
+{
+    Matx centroids(3, getNumberOfCells());
+    Ensight::Parallel::parallelFor(0, getNumberOfCells(), 4096, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+        {
+            const int* cell = getCell(i);
+            Vec3 sum = Vec3::Zero();
+            for (int j = 0; j < getCellSize(i); j++)
+                sum += vertices.col(cell[j]);
+            centroids.col(i) = sum / getCellSize(i);
+        }
+    });
+    return centroids;
+}
+
+Vecx EnsightMeshView::computeVolumes(const MatxView& vertices) const
+{
+    Vecx volumes(getNumberOfCells());
+    Ensight::Parallel::parallelFor(0, getNumberOfCells(), 4096, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            volumes[i] = computeVolume(getCellType(i), getCell(i), vertices);
+    });
+    return volumes;
+}
+
+double EnsightMeshView::computeVolume(Ensight::Cell type, const int* nodes,
+                                      const MatxView& vertices)
+{
+    auto getVertex = [&vertices](int vertexId) -> Vec3 { return vertices.col(vertexId); };
+    Vec3 P, Q, R;
+
+    double volume = 0.0;
+
+    switch (static_cast<int>(type))
+    {
+    case 0: // Point
+        volume = 0.0;
+        break;
+    case 1: // Bar
+        volume = (getVertex(nodes[1]) - getVertex(nodes[0])).norm();
+        break;
+    case 2: // Triangle
+        P = getVertex(nodes[1]) - getVertex(nodes[0]);
+        Q = getVertex(nodes[2]) - getVertex(nodes[0]);
+
+        volume = (P.cross(Q)).norm() / 2.0;
+
+        break;
+    case 3: // Rectangle
+        P = getVertex(nodes[3]) - getVertex(nodes[0]);
+        Q = getVertex(nodes[1]) - getVertex(nodes[0]);
+
+        volume = (P.cross(Q)).norm();
+
+        break;
+    case 4: // Tetrahedron
+        P = getVertex(nodes[3]) - getVertex(nodes[0]);
+        Q = getVertex(nodes[1]) - getVertex(nodes[0]);
+        R = getVertex(nodes[2]) - getVertex(nodes[0]);
+
+        volume = fabs(P.dot(Q.cross(R))) / 6.0;
+
+        break;
+    case 5: // Pyramid
+        P = getVertex(nodes[4]) - getVertex(nodes[0]);
+        Q = getVertex(nodes[1]) - getVertex(nodes[0]);
+        R = getVertex(nodes[3]) - getVertex(nodes[0]);
+        volume = fabs(P.dot(Q.cross(R))) / 6.0;
+
+        P = getVertex(nodes[4]) - getVertex(nodes[2]);
+        Q = getVertex(nodes[3]) - getVertex(nodes[2]);
+        R = getVertex(nodes[1]) - getVertex(nodes[2]);
+        volume += fabs(P.dot(Q.cross(R))) / 6.0;
+
+        break;
+    case 6: // Wedge
+        P = getVertex(nodes[1]) - getVertex(nodes[0]);
+        Q = getVertex(nodes[2]) - getVertex(nodes[0]);
+        R = getVertex(nodes[3]) - getVertex(nodes[0]);
+        volume = fabs(P.dot(Q.cross(R))) / 6.0;
+
+        P = getVertex(nodes[1]) - getVertex(nodes[5]);
+        Q = getVertex(nodes[3]) - getVertex(nodes[5]);
+        R = getVertex(nodes[2]) - getVertex(nodes[5]);
+        volume += fabs(P.dot(Q.cross(R))) / 6.0;
+
+        P = getVertex(nodes[3]) - getVertex(nodes[4]);
+        Q = getVertex(nodes[5]) - getVertex(nodes[4]);
+        R = getVertex(nodes[1]) - getVertex(nodes[4]);
+        volume += fabs(P.dot(Q.cross(R))) / 6.0;
+
+        break;
+    case 7: // Hexahedron
+        P = getVertex(nodes[4]) - getVertex(nodes[0]);
+        Q = getVertex(nodes[1]) - getVertex(nodes[0]);
+        R = getVertex(nodes[3]) - getVertex(nodes[0]);
+        volume = fabs(P.dot(Q.cross(R)));
+
+        break;
+    default:
+#ifndef NDEBUG
+        qDebug() << "Undefined celltype. Cannot compute volume.";
+#endif
+        assert(false);
+    }
+
+    return volume;
+}
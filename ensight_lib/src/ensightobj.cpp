@@ -23,85 +23,160 @@
 
 #include "../include/ensightobj.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <unordered_set>
 #include <QString>
 #include <QStringList>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
 #include "../include/ensightbarycentriccoordinates.h"
+#include "../include/ensightbufferstore.h"
+#include "../include/ensightbvh.h"
 #include "../include/ensightcell.h"
 #include "../include/ensightconstant.h"
+#include "../include/ensightparallel.h"
 #include "../include/ensightsubdivtree.h"
 #include "../include/ensightsubdivtreeimpl.h"
 #include "../include/ensightpart.h"
 #include "../include/ensightvariable.h"
 
 
-QString EnsightObj::ERROR_STR = "";
+QString& EnsightObj::errorString()
+{
+    // A function-local thread_local, unlike a thread_local member, can be used
+    // from a DLL interface
+    static thread_local QString errorString;
+    return errorString;
+}
 
-EnsightObj::EnsightObj() : edit_(false), subdivTree_()
+EnsightObj::EnsightObj() :
+    edit_(false), frozen_(false), variableRegistry_(std::make_shared<EnsightVariableRegistry>()),
+    bufferStore_(std::make_shared<EnsightBufferStore>()), readPeakBytes_(0), subdivTreeParams_(),
+    subdivTrees_()
 {
-    EnsightObj::ERROR_STR.clear();
+    EnsightObj::errorString().clear();
 }
 
 EnsightObj::~EnsightObj() = default;
 
-void EnsightObj::beginEdit()
+bool EnsightObj::beginEdit()
 {
+    if (frozen_)
+    {
+        EnsightObj::errorString() = "In [beginEdit()]; The object is frozen and cannot be edited";
+        return false;
+    }
     edit_ = true;
+    return true;
 }
 
 bool EnsightObj::endEdit()
 {
+    // Only parts and timesteps changed since the last verification are verified
+    std::vector<std::pair<EnsightPart*, int>> modified;
     for (auto& part : parts_)
-    {
-        // Verify if the indices of all cells are correct
         for (int timestep = 0; timestep < getNumberOfTimesteps(); timestep++)
+            if (part->isModified(timestep))
+                modified.emplace_back(part.get(), timestep);
+
+    std::vector<int> variableHandles;
+    for (const auto& variable : variables_)
+        variableHandles.push_back(variableRegistry_->find(variable.getName()));
+
+    // Verify in parallel, each part and timestep stores its own error message
+    std::vector<QString> errors(modified.size());
+    Ensight::Parallel::parallelFor(0, modified.size(), 1, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            errors[i] = verifyTimestep(modified[i].first, modified[i].second, variableHandles);
+    });
+
+    // Report the first error in order of parts and timesteps
+    for (const QString& error : errors)
+    {
+        if (!error.isEmpty())
         {
-            Matx vertices = part->getVertices(timestep);
-            QList<EnsightCellList*> cells = part->getCells(timestep);
-            for (auto cell : cells)
-            {
-                Ensight::Cell type = cell->getType();
-                Mati values = cell->getValues();
-                for (int j = 0; j < values.rows(); j++)
-                {
-                    for (int k = 0; k < values.cols(); k++)
-                    {
-                        if (values(j, k) < 0 || values(j, k) >= vertices.cols())
-                        {
-                            EnsightObj::ERROR_STR = "Referencing vertex with index "
-                                                    + QString::number(values(j, k)) +
-                                                    "in Part <" + part->getName() +
-                                                    "at timestep " + QString::number(timestep) +
-                                                    "for cell " + Ensight::strCell[type];
-                            return false;
-                        }
-                    }
-                }
-            }
+            EnsightObj::errorString() = error;
+            return false;
+        }
+    }
 
-            // Verify if all variables are defined for either all vertices or for none
-            for (int j = 0; j < getNumberOfVariables(); j++)
+    // Refresh the cached variable bounds of the modified timesteps
+    std::vector<int> modifiedTimesteps;
+    for (const auto& entry : modified)
+        modifiedTimesteps.push_back(entry.second);
+    std::sort(modifiedTimesteps.begin(), modifiedTimesteps.end());
+    modifiedTimesteps.erase(std::unique(modifiedTimesteps.begin(), modifiedTimesteps.end()),
+                            modifiedTimesteps.end());
+    if (!modifiedTimesteps.empty() ||
+        variableBounds_.size() != static_cast<size_t>(getNumberOfTimesteps()) + 1)
+    {
+        updateVariableBounds(modifiedTimesteps);
+    }
+
+    for (auto& part : parts_)
+        part->resetModified();
+
+    edit_ = false;
+    return true;
+}
+
+QString EnsightObj::verifyTimestep(EnsightPart* part, int timestep,
+                                   const std::vector<int>& variableHandles) const
+{
+    // Verify if the indices of all cells are correct
+    MatxView vertices = part->getVertices(timestep);
+    QList<EnsightCellList*> cells = part->getCells(timestep);
+    for (auto cell : cells)
+    {
+        MatiView values = cell->getValues();
+        if (values.size() == 0 ||
+            (values.minCoeff() >= 0 && values.maxCoeff() < vertices.cols()))
+            continue;
+
+        // Find the first invalid index for the error message
+        Ensight::Cell type = cell->getType();
+        for (int j = 0; j < values.rows(); j++)
+        {
+            for (int k = 0; k < values.cols(); k++)
             {
-                EnsightVariableIdentifier varIdent = getVariable(j);
-                if (!part->hasVariable(varIdent.getName(), timestep))
-                    continue;
-                Matx varValues = part->getVariableValues(varIdent.getName(), timestep);
-                if (varValues.cols() != vertices.cols() && varValues.cols() != 0)
+                if (values(j, k) < 0 || values(j, k) >= vertices.cols())
                 {
-                    EnsightObj::ERROR_STR = "Error of variable definition of variable <" + varIdent.getName() +
-                                            "> in Part <" + part->getName() +
-                                            "> at timestep " + QString::number(timestep) + ". " +
-                                            QString("Number of Vertices: %0, Defined variables: %1")
-                                                .arg(vertices.cols())
-                                                .arg(varValues.cols());
-                    return false;
+                    return "Referencing vertex with index "
+                           + QString::number(values(j, k)) +
+                           "in Part <" + part->getName() +
+                           "at timestep " + QString::number(timestep) +
+                           "for cell " + Ensight::strCell[type];
                 }
             }
         }
     }
 
-    edit_ = false;
-    return true;
+    // Verify if all variables are defined for either all vertices or for none
+    for (int handle : variableHandles)
+    {
+        const EnsightVariable* var = part->getVariable(handle, timestep);
+        if (!var)
+            continue;
+        MatxView varValues = var->getValues();
+        if (varValues.cols() != vertices.cols() && varValues.cols() != 0)
+        {
+            return "Error of variable definition of variable <" + var->getName() +
+                   "> in Part <" + part->getName() +
+                   "> at timestep " + QString::number(timestep) + ". " +
+                   QString("Number of Vertices: %0, Defined variables: %1")
+                       .arg(vertices.cols())
+                       .arg(varValues.cols());
+        }
+    }
+    return QString();
 }
 
 bool EnsightObj::inEditMode()
@@ -109,22 +184,42 @@ bool EnsightObj::inEditMode()
     return edit_;
 }
 
+bool EnsightObj::freeze()
+{
+    if (edit_)
+    {
+        EnsightObj::errorString() = "In [freeze()]; In Edit Mode, call endEdit() first";
+        return false;
+    }
+    frozen_ = true;
+    return true;
+}
+
+bool EnsightObj::isFrozen() const
+{
+    return frozen_;
+}
+
 
 bool EnsightObj::createVariable(const QString& name, Ensight::VarTypes type)
 {
     if (!edit_)
     {
-        EnsightObj::ERROR_STR = "Not in Edit Mode, call beginEdit() first";
+        EnsightObj::errorString() = "Not in Edit Mode, call beginEdit() first";
         return false;
     }
 
     if (hasVariable(name))
     {
-        EnsightObj::ERROR_STR = "Variable already exists";
+        EnsightObj::errorString() = "Variable already exists";
         return false;
     }
 
     EnsightVariableIdentifier var(name, type);
+    size_t handle = static_cast<size_t>(variableRegistry_->intern(name));
+    if (variableIndices_.size() <= handle)
+        variableIndices_.resize(handle + 1, -1);
+    variableIndices_[handle] = static_cast<int>(variables_.size());
     variables_.push_back(var);
     return true;
 }
@@ -138,23 +233,26 @@ EnsightPart* EnsightObj::createEnsightPart(const QString& name, int id)
 {
     if (!edit_)
     {
-        EnsightObj::ERROR_STR = "Not in Edit Mode, call beginEdit() first";
+        EnsightObj::errorString() = "Not in Edit Mode, call beginEdit() first";
         return nullptr;
     }
     if (getPartByName(name) != nullptr)
     {
-        EnsightObj::ERROR_STR = ("Part with name " + name + " already exists.");
+        EnsightObj::errorString() = ("Part with name " + name + " already exists.");
         return nullptr;
     }
 
     if (getPartById(id) != nullptr)
     {
-        EnsightObj::ERROR_STR = ("Part with id " + QString::number(id) + " already exists.");
+        EnsightObj::errorString() = ("Part with id " + QString::number(id) + " already exists.");
         return nullptr;
     }
-    std::unique_ptr<EnsightPart> newPart(new EnsightPart(name, id, timesteps_.rows()));
+    std::unique_ptr<EnsightPart> newPart(new EnsightPart(name, id, timesteps_.rows(),
+                                                         variableRegistry_, bufferStore_));
     EnsightPart* result = newPart.get();
     parts_.push_back(std::move(newPart));
+    partsByName_.insert(name, result);
+    partsById_.insert(id, result);
     return result;
 }
 
@@ -170,11 +268,7 @@ EnsightPart* EnsightObj::getPart(int i)
 
 EnsightPart* EnsightObj::getPartByName(const QString& name)
 {
-    for (auto& part : parts_)
-        if (part->getName() == name)
-            return part.get();
-
-    return nullptr;
+    return partsByName_.value(name, nullptr);
 }
 
 EnsightPart *EnsightObj::getPartByName(const std::string &name)
@@ -184,11 +278,7 @@ EnsightPart *EnsightObj::getPartByName(const std::string &name)
 
 EnsightPart* EnsightObj::getPartById(int id)
 {
-    for (auto& part : parts_)
-        if (part->getId() == id)
-            return part.get();
-
-    return nullptr;
+    return partsById_.value(id, nullptr);
 }
 
 int EnsightObj::getNumberOfParts() const
@@ -212,11 +302,14 @@ bool EnsightObj::setTransient(const Vecx& values)
 {
     if (!edit_)
     {
-        EnsightObj::ERROR_STR = ("Not in Edit Mode, call beginEdit() first");
+        EnsightObj::errorString() = ("Not in Edit Mode, call beginEdit() first");
         return false;
     }
 
     timesteps_ = values;
+    for (const std::unique_ptr<EnsightPart>& part : parts_)
+        part->setTimeSteps(getNumberOfTimesteps());
+    resizeSubdivTrees();
     return true;
 }
 
@@ -224,11 +317,14 @@ bool EnsightObj::setStatic()
 {
     if (!edit_)
     {
-        EnsightObj::ERROR_STR = ("Not in Edit Mode, call beginEdit() first");
+        EnsightObj::errorString() = ("Not in Edit Mode, call beginEdit() first");
         return false;
     }
 
     timesteps_ = Vecx::Zero(1);
+    for (const std::unique_ptr<EnsightPart>& part : parts_)
+        part->setTimeSteps(1);
+    resizeSubdivTrees();
     return true;
 }
 
@@ -250,36 +346,44 @@ const Vecx& EnsightObj::getTimesteps() const
 
 void EnsightObj::clean(int step)
 {
+    if (frozen_)
+    {
+        EnsightObj::errorString() = "In [clean()]; The object is frozen and cannot be cleaned";
+        return;
+    }
+
     for (auto& part : parts_)
     {
         part->clean(step);
     }
+    if (step >= 0 && step < getNumberOfTimesteps())
+        updateVariableBounds(std::vector<int>(1, step));
 }
 
-bool EnsightObj::setVertices(EnsightPart* part, const Matx& vertices, int timestep)
+bool EnsightObj::setVertices(EnsightPart* part, const MatxBuffer& vertices, int timestep)
 {
     if (!edit_)
     {
-        EnsightObj::ERROR_STR = "In [setVertices()]; Not in Edit Mode, call beginEdit() first";
+        EnsightObj::errorString() = "In [setVertices()]; Not in Edit Mode, call beginEdit() first";
         return false;
     }
 
     // Check if timestep is correct
     if (timestep < 0)
     {
-        EnsightObj::ERROR_STR = "In [setVertices()]; Timestep must be larger or equal to zero. For static data use timestep=0.";
+        EnsightObj::errorString() = "In [setVertices()]; Timestep must be larger or equal to zero. For static data use timestep=0.";
         return false;
     }
 
     if (timestep >= getNumberOfTimesteps())
     {
-        EnsightObj::ERROR_STR = QString("In [setVertices()]; Timestep %0 is not defined for Part %1.").arg(timestep).arg(part->getName());
+        EnsightObj::errorString() = QString("In [setVertices()]; Timestep %0 is not defined for Part %1.").arg(timestep).arg(part->getName());
         return false;
     }
 
     if (vertices.rows() != 3 || vertices.cols() == 0)
     {
-        EnsightObj::ERROR_STR = "In [setVertices()]; The matrix must be a 3xN matrix, N>0";
+        EnsightObj::errorString() = "In [setVertices()]; The matrix must be a 3xN matrix, N>0";
         return false;
     }
 
@@ -287,28 +391,28 @@ bool EnsightObj::setVertices(EnsightPart* part, const Matx& vertices, int timest
     return true;
 }
 
-bool EnsightObj::setCells(EnsightPart* part, const Mati& cells, int timestep, Ensight::Cell e)
+bool EnsightObj::setCells(EnsightPart* part, const MatiBuffer& cells, int timestep, Ensight::Cell e)
 {
     if (!edit_)
     {
-        EnsightObj::ERROR_STR = ("In [setCells()]; Not in Edit Mode, call beginEdit() first");
+        EnsightObj::errorString() = ("In [setCells()]; Not in Edit Mode, call beginEdit() first");
         return false;
     }
     if (timestep < 0)
     {
-        EnsightObj::ERROR_STR = ("In [setCells()]; Timestep must be larger or equal to zero. For static data use timestep=0.");
+        EnsightObj::errorString() = ("In [setCells()]; Timestep must be larger or equal to zero. For static data use timestep=0.");
         return false;
     }
 
     if (timestep >= getNumberOfTimesteps())
     {
-        EnsightObj::ERROR_STR = QString("In [setCells()]; Timestep %0 is not defined for Part %1.").arg(timestep).arg(part->getName());
+        EnsightObj::errorString() = QString("In [setCells()]; Timestep %0 is not defined for Part %1.").arg(timestep).arg(part->getName());
         return false;
     }
 
     if (part->hasCellType(timestep, e))
     {
-        EnsightObj::ERROR_STR = ("In [setCells()]; Part " + part->getName() + " has cell types " + Ensight::strCell[e] +
+        EnsightObj::errorString() = ("In [setCells()]; Part " + part->getName() + " has cell types " + Ensight::strCell[e] +
                                  " already defined for timestep " + QString::number(timestep));
         return false;
     }
@@ -343,44 +447,62 @@ const EnsightVariableIdentifier& EnsightObj::getVariable(int i) const
 
 const EnsightVariableIdentifier& EnsightObj::getVariable(const QString& name) const
 {
-    for (const auto& variable : variables_)
-        if (variable.getName() == name)
-            return variable;
-    assert(false && "Variable not defined");
+    int index = variableIndex(variableRegistry_->find(name));
+    assert(index >= 0 && "Variable not defined");
+    return variables_[index];
 }
 
 const EnsightVariableIdentifier &EnsightObj::getVariable(const std::string &name) const
 {
-    return getVariable(QString::fromStdString(name));
+    int index = variableIndex(variableRegistry_->find(name));
+    assert(index >= 0 && "Variable not defined");
+    return variables_[index];
 }
 
 bool EnsightObj::hasVariable(const QString& name) const
 {
-    for (const auto& variable : variables_)
-        if (variable.getName() == name)
-            return true;
-    return false;
+    return variableIndex(variableRegistry_->find(name)) >= 0;
 }
 
 bool EnsightObj::hasVariable(const std::string &name) const
 {
-    return hasVariable(QString::fromStdString(name));
+    return variableIndex(variableRegistry_->find(name)) >= 0;
+}
+
+int EnsightObj::getVariableHandle(const QString& name) const
+{
+    int handle = variableRegistry_->find(name);
+    return variableIndex(handle) >= 0 ? handle : -1;
+}
+
+int EnsightObj::getVariableHandle(const std::string& name) const
+{
+    int handle = variableRegistry_->find(name);
+    return variableIndex(handle) >= 0 ? handle : -1;
+}
+
+int EnsightObj::variableIndex(int handle) const
+{
+    if (handle < 0 || static_cast<size_t>(handle) >= variableIndices_.size())
+        return -1;
+    return variableIndices_[handle];
 }
 
 bool EnsightObj::addConstant(const QString& name, double value)
 {
     if (!edit_)
     {
-        EnsightObj::ERROR_STR = ("Not in Edit Mode, call beginEdit() first");
+        EnsightObj::errorString() = ("Not in Edit Mode, call beginEdit() first");
         return false;
     }
 
     if (hasConstant(name))
     {
-        EnsightObj::ERROR_STR = ("ERROR in [addConstant()] Constant with name " + name + " already defined.");
+        EnsightObj::errorString() = ("ERROR in [addConstant()] Constant with name " + name + " already defined.");
         return false;
     }
 
+    constantIndices_.insert(name, static_cast<int>(constants_.size()));
     constants_.push_back(EnsightConstant(name, value));
     return true;
 }
@@ -394,19 +516,22 @@ bool EnsightObj::removeConstant(const QString& name)
 {
     if (!edit_)
     {
-        EnsightObj::ERROR_STR = "Not in Edit Mode, call beginEdit() first";
+        EnsightObj::errorString() = "Not in Edit Mode, call beginEdit() first";
         return false;
     }
 
     if (!hasConstant(name))
     {
-        EnsightObj::ERROR_STR = "ERROR in [addConstant()] Constant with name " + name + " not defined.";
+        EnsightObj::errorString() = "ERROR in [addConstant()] Constant with name " + name + " not defined.";
         return false;
     }
 
-    constants_.erase(std::remove_if(constants_.begin(), constants_.end(),
-                                   [&](const EnsightConstant& c) { return c.getName() == name; }),
-                    constants_.end());
+    // Remove the constant and shift the indices of all following constants
+    int index = constantIndices_.value(name);
+    constantIndices_.remove(name);
+    constants_.erase(constants_.begin() + index);
+    for (int i = index; i < static_cast<int>(constants_.size()); i++)
+        constantIndices_.insert(constants_[i].getName(), i);
     return true;
 }
 
@@ -417,11 +542,7 @@ bool EnsightObj::removeConstant(const std::string &name)
 
 bool EnsightObj::hasConstant(const QString& name) const
 {
-    for (const auto& constant : constants_)
-        if (constant.getName() == name)
-            return true;
-
-    return false;
+    return constantIndices_.contains(name);
 }
 
 bool EnsightObj::hasConstant(const std::string &name) const
@@ -431,11 +552,9 @@ bool EnsightObj::hasConstant(const std::string &name) const
 
 const EnsightConstant& EnsightObj::getConstant(const QString& name) const
 {
-    for (const auto& constant : constants_)
-        if (constant.getName() == name)
-            return constant;
-
-    assert(false && "Constant not defined");
+    int index = constantIndices_.value(name, -1);
+    assert(index >= 0 && "Constant not defined");
+    return constants_[index];
 }
 
 const EnsightConstant &EnsightObj::getConstant(const std::string &name) const
@@ -458,93 +577,411 @@ double EnsightObj::getConstantValue(const std::string &name) const
     return getConstant(name).getValue();
 }
 
-Matx EnsightObj::getVariableBounds(const QString& name, int timestep) const
+const Matx& EnsightObj::getVariableBounds(const QString& name, int timestep) const
 {
-    // Calculate the min and max values for this variable over all parts
-    Matx result;
-    for (auto& part : parts_)
+    static const Matx empty;
+    const int handle = variableRegistry_->find(name);
+    const size_t row = timestep < 0 ? 0 : static_cast<size_t>(timestep) + 1;
+    if (handle < 0 || row >= variableBounds_.size() ||
+        static_cast<size_t>(handle) >= variableBounds_[row].size())
+        return empty;
+    return variableBounds_[row][handle];
+}
+
+const Matx& EnsightObj::getVariableBounds(const std::string &name, int timestep) const
+{
+    return getVariableBounds(QString::fromStdString(name), timestep);
+}
+
+void EnsightObj::updateVariableBounds(const std::vector<int>& timesteps)
+{
+    const int numHandles = variableRegistry_->size();
+    variableBounds_.resize(getNumberOfTimesteps() + 1);
+    for (auto& row : variableBounds_)
+        row.resize(numHandles);
+
+    // Bounds of each timestep over all parts
+    for (int timestep : timesteps)
     {
-        // bounds contains the min and max values for the current part for this variable
-        // the minimum value is in the first col, the maximum value is in the second col
-        // See EnsightPart->setVariable and EnsightVariable->setValue
-        if (!part->hasVariable(name, timestep))
-            continue;
-        Matx bounds = part->getVariableBounds(name, timestep);
-        if (result.cols() == 0)
+        std::vector<Matx>& row = variableBounds_[timestep + 1];
+        for (int handle = 0; handle < numHandles; handle++)
         {
-            result = bounds;
-        }
-        else
-        {
-            for (int j = 0; j < bounds.rows(); j++)
-            {
-                result(j, 0) = std::min(result(j, 0), bounds(j, 0));
-                result(j, 1) = std::max(result(j, 1), bounds(j, 1));
-            }
+            row[handle] = Matx();
+            for (const auto& part : parts_)
+                EnsightVariable::mergeBounds(row[handle], part->getVariableBounds(handle, timestep));
         }
     }
-    return result;
+
+    // Bounds over all timesteps
+    for (int handle = 0; handle < numHandles; handle++)
+    {
+        Matx& bounds = variableBounds_[0][handle];
+        bounds = Matx();
+        for (size_t row = 1; row < variableBounds_.size(); row++)
+            EnsightVariable::mergeBounds(bounds, variableBounds_[row][handle]);
+    }
 }
 
-Matx EnsightObj::getVariableBounds(const std::string &name, int timestep) const
+namespace
 {
-    return getVariableBounds(QString::fromStdString(name), timestep);
+
+/**
+ * @brief Header of the files written by EnsightObj::saveSubdivTree()
+ */
+struct SubdivTreeFileHeader
+{
+    char magic[8];
+    uint64_t key;
+};
+
+const char subdivTreeFileMagic[8] = {'E', 'N', 'S', 'T', 'R', 'E', 'E', '1'};
+
+// Replaces the file to by the file from, atomically where supported
+bool replaceFile(const QString& from, const QString& to)
+{
+#if defined(_WIN32)
+    return MoveFileExW(reinterpret_cast<LPCWSTR>(from.utf16()), reinterpret_cast<LPCWSTR>(to.utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.toStdString().c_str(), to.toStdString().c_str()) == 0;
+#endif
+}
+
 }
 
 bool EnsightObj::createSubdivTree(int maxDepth, int maxElements,
                                   const QStringList& partsToExclude,
-                                  double sizeOffset)
+                                  double sizeOffset,
+                                  Ensight::SubdivTreeType type)
+{
+    if (frozen_)
+    {
+        EnsightObj::errorString() = "In [createSubdivTree()]; The object is frozen, create the tree before freeze()";
+        return false;
+    }
+
+    setSubdivTreeParams(maxDepth, maxElements, partsToExclude, sizeOffset, type);
+    subdivTrees_.clear();
+    subdivTrees_.resize(std::max(getNumberOfTimesteps(), 1));
+    getSubdivTree(0)->build();
+
+    return true;
+}
+
+bool EnsightObj::saveSubdivTree(const QString& filename)
+{
+    EnsightSubdivTree* tree = getSubdivTree(0);
+    if (!tree)
+    {
+        EnsightObj::errorString() = "In [saveSubdivTree()]; The SubdivTree doesn't exist, call createSubdivTree() first";
+        return false;
+    }
+
+    // Write to a temporary file next to the target and rename it, so that an
+    // existing file is only replaced by a complete one
+    const QString tempFilename = filename + ".tmp";
+    std::ofstream out(tempFilename.toStdString().c_str(), std::ios::binary);
+    SubdivTreeFileHeader header;
+    std::copy(subdivTreeFileMagic, subdivTreeFileMagic + 8, header.magic);
+    header.key = getSubdivTreeKey(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    bool success = out && tree->write(out);
+    out.close();
+    success = success && !out.fail() && replaceFile(tempFilename, filename);
+    if (!success)
+    {
+        std::remove(tempFilename.toStdString().c_str());
+        EnsightObj::errorString() = QString("In [saveSubdivTree()]; Could not write file <%0>").arg(filename);
+        return false;
+    }
+    return true;
+}
+
+bool EnsightObj::saveSubdivTree(const std::string& filename)
+{
+    return saveSubdivTree(QString::fromStdString(filename));
+}
+
+bool EnsightObj::loadSubdivTree(const QString& filename, int maxDepth, int maxElements,
+                                const QStringList& partsToExclude, double sizeOffset,
+                                Ensight::SubdivTreeType type)
+{
+    if (frozen_)
+    {
+        EnsightObj::errorString() = "In [loadSubdivTree()]; The object is frozen, load the tree before freeze()";
+        return false;
+    }
+
+    std::ifstream in(filename.toStdString().c_str(), std::ios::binary);
+    SubdivTreeFileHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || !std::equal(subdivTreeFileMagic, subdivTreeFileMagic + 8, header.magic))
+    {
+        EnsightObj::errorString() = QString("In [loadSubdivTree()]; Could not read file <%0>").arg(filename);
+        return false;
+    }
+
+    // The tree is only read if the hash of geometry and parameters matches,
+    // the current trees are kept otherwise
+    const SubdivTreeParams previousParams = subdivTreeParams_;
+    setSubdivTreeParams(maxDepth, maxElements, partsToExclude, sizeOffset, type);
+    std::shared_ptr<EnsightSubdivTree> tree;
+    if (header.key == getSubdivTreeKey(0))
+    {
+        tree = createEmptySubdivTree(0);
+        if (!tree->read(in))
+            tree.reset();
+    }
+    if (!tree)
+    {
+        subdivTreeParams_ = previousParams;
+        EnsightObj::errorString() = QString("In [loadSubdivTree()]; File <%0> was written for other "
+                                        "geometry or parameters or is damaged").arg(filename);
+        return false;
+    }
+
+    subdivTrees_.clear();
+    subdivTrees_.resize(std::max(getNumberOfTimesteps(), 1));
+    subdivTrees_[0].get([&tree]() { return tree; });
+    return true;
+}
+
+bool EnsightObj::loadSubdivTree(const std::string& filename, int maxDepth, int maxElements,
+                                const QStringList& partsToExclude, double sizeOffset,
+                                Ensight::SubdivTreeType type)
 {
-    // TODO: for the moment only static data supported
-    // Later one Octree for each timestep !?
-    int timestep = 0;
+    return loadSubdivTree(QString::fromStdString(filename), maxDepth, maxElements,
+                          partsToExclude, sizeOffset, type);
+}
 
+void EnsightObj::setSubdivTreeParams(int maxDepth, int maxElements, const QStringList& partsToExclude,
+                                     double sizeOffset, Ensight::SubdivTreeType type)
+{
+    // The kind of tree is the same for all timesteps
     Bbox bounds = getGeometryBounds(-1, partsToExclude);
     double zlen = fabs(bounds.maxCorner()[2] - bounds.minCorner()[2]);
-    if (zlen <= std::numeric_limits<double>::epsilon())
+    bool is2d = zlen <= std::numeric_limits<double>::epsilon();
+    subdivTreeParams_ = SubdivTreeParams{maxDepth, maxElements, partsToExclude, sizeOffset, type, is2d};
+}
+
+std::shared_ptr<EnsightSubdivTree> EnsightObj::createEmptySubdivTree(int timestep)
+{
+    const SubdivTreeParams& params = subdivTreeParams_;
+    Bbox bounds = getGeometryBounds(timestep, params.partsToExclude);
+    std::shared_ptr<EnsightSubdivTree> tree;
+    if (params.type == Ensight::BoundingVolumeHierarchy)
+        // create bounding volume hierarchy
+        tree = std::make_shared<EnsightBvh>(bounds, params.maxElements, !params.is2d);
+    else if (params.is2d)
         // create quadtree
-        subdivTree_.reset(new EnsightQuadtree(bounds, maxDepth, maxElements));
+        tree = std::make_shared<EnsightQuadtree>(bounds, params.maxDepth, params.maxElements);
     else
         // create octree
-        subdivTree_.reset(new EnsightOctree(bounds, maxDepth, maxElements));
+        tree = std::make_shared<EnsightOctree>(bounds, params.maxDepth, params.maxElements);
     for (int i = 0; i < getNumberOfParts(); i++)
     {
         EnsightPart* part = getPart(i);
-        if (partsToExclude.contains(part->getName()))
+        if (params.partsToExclude.contains(part->getName()))
             continue;
         bool hasTris = part->hasCellType(timestep, Ensight::Triangle);
         bool hasBars = part->hasCellType(timestep, Ensight::Bar);
         bool extendSize = hasTris || hasBars;
-        subdivTree_->insert(part, timestep, extendSize ? sizeOffset : 0.0);
+        tree->insert(part, timestep, extendSize ? params.sizeOffset : 0.0);
     }
+    return tree;
+}
 
+std::shared_ptr<EnsightSubdivTree> EnsightObj::buildSubdivTree(int timestep)
+{
+    // Share the structure of the tree of the first of consecutive timesteps
+    // with identical geometry. The shared tree has its own identifiers, so
+    // that their values are those of this timestep.
+    int first = timestep;
+    while (first > 0 && hasSameSubdivGeometry(first - 1, first, true))
+        first--;
+    if (first < timestep)
+        return subdivTrees_[first].get([this, first]() { return buildSubdivTree(first); })->share(timestep);
+
+    std::shared_ptr<EnsightSubdivTree> tree = createEmptySubdivTree(timestep);
+
+    // The octree assigns cells to fixed regions and is rebuilt when vertices
+    // move, the hierarchy keeps its structure and only updates its bounds
+    if (subdivTreeParams_.type == Ensight::BoundingVolumeHierarchy)
+    {
+        int base = timestep;
+        while (base > 0 && hasSameSubdivGeometry(base - 1, base, false))
+            base--;
+        if (base < timestep)
+        {
+            const std::shared_ptr<EnsightSubdivTree>& baseTree =
+                subdivTrees_[base].get([this, base]() { return buildSubdivTree(base); });
+            if (tree->refit(*baseTree))
+                return tree;
+        }
+    }
+    tree->build();
+    return tree;
+}
+
+void EnsightObj::resizeSubdivTrees()
+{
+    // The trees of the remaining timesteps are kept, those of added timesteps
+    // are built on first access
+    if (!subdivTrees_.empty())
+        subdivTrees_.resize(std::max(getNumberOfTimesteps(), 1));
+}
+
+uint64_t EnsightObj::getSubdivTreeKey(int timestep) const
+{
+    const SubdivTreeParams& params = subdivTreeParams_;
+    auto hashString = [](const QString& str) {
+        const QByteArray bytes = str.toUtf8();
+        return EnsightBufferStore::hashBytes(bytes.constData(), bytes.size());
+    };
+
+    std::vector<uint64_t> words;
+    words.push_back(static_cast<uint64_t>(params.maxDepth));
+    words.push_back(static_cast<uint64_t>(params.maxElements));
+    words.push_back(EnsightBufferStore::hashBytes(&params.sizeOffset, sizeof(double)));
+    words.push_back(static_cast<uint64_t>(params.type));
+    words.push_back(params.is2d ? 1 : 0);
+    QStringList partsToExclude = params.partsToExclude;
+    std::sort(partsToExclude.begin(), partsToExclude.end());
+    for (const QString& name : partsToExclude)
+        words.push_back(hashString(name));
+
+    for (const std::unique_ptr<EnsightPart>& part : parts_)
+    {
+        if (params.partsToExclude.contains(part->getName()))
+            continue;
+        words.push_back(hashString(part->getName()));
+        MatxView vertices = part->getVertices(timestep);
+        words.push_back(EnsightBufferStore::hashBytes(vertices.data(), vertices.size() * sizeof(double)));
+        for (const EnsightCellList* cellList : part->getCells(timestep))
+        {
+            MatiView cells = cellList->getValues();
+            words.push_back(static_cast<uint64_t>(cellList->getType()));
+            words.push_back(EnsightBufferStore::hashBytes(cells.data(), cells.size() * sizeof(MatiView::Scalar)));
+        }
+    }
+    return EnsightBufferStore::hashBytes(words.data(), words.size() * sizeof(uint64_t));
+}
+
+bool EnsightObj::hasSameSubdivGeometry(int timestep, int otherTimestep, bool compareVertices) const
+{
+    for (const std::unique_ptr<EnsightPart>& part : parts_)
+    {
+        if (subdivTreeParams_.partsToExclude.contains(part->getName()))
+            continue;
+        if (compareVertices)
+        {
+            MatxView vertices = part->getVertices(timestep);
+            MatxView otherVertices = part->getVertices(otherTimestep);
+            if (vertices.data() != otherVertices.data() || vertices.cols() != otherVertices.cols())
+                return false;
+        }
+
+        QList<EnsightCellList*> cellLists = part->getCells(timestep);
+        QList<EnsightCellList*> otherCellLists = part->getCells(otherTimestep);
+        if (cellLists.size() != otherCellLists.size())
+            return false;
+        for (int i = 0; i < cellLists.size(); i++)
+        {
+            MatiView cells = cellLists[i]->getValues();
+            MatiView otherCells = otherCellLists[i]->getValues();
+            if (cellLists[i]->getType() != otherCellLists[i]->getType() ||
+                cells.data() != otherCells.data() || cells.cols() != otherCells.cols())
+                return false;
+        }
+    }
     return true;
 }
 
-EnsightSubdivTree *EnsightObj::getSubdivTree()
+EnsightSubdivTree *EnsightObj::getSubdivTree(int timestep)
 {
-    return subdivTree_.get();
+    if (timestep < 0 || timestep >= static_cast<int>(subdivTrees_.size()))
+        return nullptr;
+    return subdivTrees_[timestep].get([this, timestep]() { return buildSubdivTree(timestep); }).get();
 }
 
-EnsightCellIdentifier* EnsightObj::interpolate(const Vec3& pos)
+EnsightCellIdentifier* EnsightObj::interpolate(const Vec3& pos, int timestep)
 {
     EnsightBarycentricCoordinates baryCoord;
-    EnsightCellIdentifier* cell = interpolate(pos, baryCoord);
+    EnsightCellIdentifier* cell = interpolate(pos, baryCoord, timestep);
     return cell;
 }
 
-EnsightCellIdentifier* EnsightObj::interpolate(const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut)
+EnsightCellIdentifier* EnsightObj::interpolate(const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut,
+                                               int timestep)
+{
+    EnsightSubdivTree* subdivTree = getSubdivTree(timestep);
+    if (!subdivTree)
+        return nullptr;
+    return subdivTree->search(pos, baryCoordOut);
+}
+
+EnsightCellIdentifier* EnsightObj::interpolate(const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut,
+                                               const EnsightCellIdentifier* hint, int timestep)
 {
-    if (!subdivTree_)
+    EnsightSubdivTree* subdivTree = getSubdivTree(timestep);
+    if (!subdivTree)
         return nullptr;
-    return subdivTree_->search(pos, baryCoordOut);
+    return subdivTree->search(pos, baryCoordOut, hint);
 }
 
-bool EnsightObj::setVariable(EnsightPart* part, const QString& name, const Matx& values, Ensight::VarTypes type, int timestep)
+QVector<EnsightCellIdentifier*> EnsightObj::interpolate(const Eigen::Ref<const Matx>& positions,
+                                                        QVector<EnsightBarycentricCoordinates>& baryCoordsOut,
+                                                        int timestep)
+{
+    EnsightSubdivTree* subdivTree = getSubdivTree(timestep);
+    if (!subdivTree)
+    {
+        baryCoordsOut = QVector<EnsightBarycentricCoordinates>(static_cast<int>(positions.cols()));
+        return QVector<EnsightCellIdentifier*>(static_cast<int>(positions.cols()), nullptr);
+    }
+    return subdivTree->search(positions, baryCoordsOut);
+}
+
+EnsightCellIdentifier* EnsightObj::findNearestCell(const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut,
+                                                   double& distanceOut, int timestep)
+{
+    EnsightSubdivTree* subdivTree = getSubdivTree(timestep);
+    if (!subdivTree)
+    {
+        distanceOut = std::numeric_limits<double>::infinity();
+        return nullptr;
+    }
+    return subdivTree->searchNearest(pos, baryCoordOut, distanceOut);
+}
+
+QVector<EnsightCellIdentifier*> EnsightObj::findNearestCell(const Eigen::Ref<const Matx>& positions,
+                                                            QVector<EnsightBarycentricCoordinates>& baryCoordsOut,
+                                                            QVector<double>& distancesOut, int timestep)
+{
+    EnsightSubdivTree* subdivTree = getSubdivTree(timestep);
+    if (!subdivTree)
+    {
+        baryCoordsOut = QVector<EnsightBarycentricCoordinates>(static_cast<int>(positions.cols()));
+        distancesOut = QVector<double>(static_cast<int>(positions.cols()),
+                                       std::numeric_limits<double>::infinity());
+        return QVector<EnsightCellIdentifier*>(static_cast<int>(positions.cols()), nullptr);
+    }
+    return subdivTree->searchNearest(positions, baryCoordsOut, distancesOut);
+}
+
+const EnsightKdTree* EnsightObj::getVertexTree(int timestep)
+{
+    EnsightSubdivTree* subdivTree = getSubdivTree(timestep);
+    if (!subdivTree)
+        return nullptr;
+    return &subdivTree->getVertexTree();
+}
+
+bool EnsightObj::setVariable(EnsightPart* part, const QString& name, const MatxBuffer& values, Ensight::VarTypes type, int timestep)
 {
     if (!edit_)
     {
-        EnsightObj::ERROR_STR = ("In [EnsightObj::setVariable()] Not in Edit Mode, call beginEdit() first");
+        EnsightObj::errorString() = ("In [EnsightObj::setVariable()] Not in Edit Mode, call beginEdit() first");
         return false;
     }
 
@@ -554,57 +991,58 @@ bool EnsightObj::setVariable(EnsightPart* part, const QString& name, const Matx&
         EnsightVariableIdentifier var = this->getVariable(name);
         if (var.getType() != type)
         {
-            EnsightObj::ERROR_STR = QString("In [EnsightObj::setVariable()] Variable with name <%0> was defined with different type.").arg(name);
+            EnsightObj::errorString() = QString("In [EnsightObj::setVariable()] Variable with name <%0> was defined with different type.").arg(name);
             return false;
         }
     }
     else
     {
-        EnsightObj::ERROR_STR = QString("In [EnsightObj::setVariable()] Variable with name <%0> is not yet defined. Call EnsightObj::createVariable() first.").arg(name);
+        EnsightObj::errorString() = QString("In [EnsightObj::setVariable()] Variable with name <%0> is not yet defined. Call EnsightObj::createVariable() first.").arg(name);
         return false;
     }
 
 
     if (timestep < 0)
     {
-        EnsightObj::ERROR_STR = ("In [EnsightObj::setVariable()] Timestep must be larger or equal to zero. For static data use timestep=0.");
+        EnsightObj::errorString() = ("In [EnsightObj::setVariable()] Timestep must be larger or equal to zero. For static data use timestep=0.");
         return false;
     }
 
     if (timestep >= timesteps_.rows())
     {
-        EnsightObj::ERROR_STR = QString("In [EnsightObj::setVariable()] Timestep must be smaller %0").arg(timesteps_.rows());
+        EnsightObj::errorString() = QString("In [EnsightObj::setVariable()] Timestep must be smaller %0").arg(timesteps_.rows());
         return false;
     }
 
     if (values.rows() != 1 && type == Ensight::ScalarPerNode)
     {
-        EnsightObj::ERROR_STR = ("For Variables of type ScalarPerNode a 1xN matrix,N>0, must be defined");
+        EnsightObj::errorString() = ("For Variables of type ScalarPerNode a 1xN matrix,N>0, must be defined");
         return false;
     }
 
-    if (values.rows() != 3 && type == Ensight::VectorPerNode)
+    // A 4xN matrix already contains the magnitude in its last row and is stored as is
+    if (values.rows() != 3 && values.rows() != 4 && type == Ensight::VectorPerNode)
     {
-        EnsightObj::ERROR_STR = ("For Variables of type VectorPerNode a 3xN matrix,N>0, must be defined");
+        EnsightObj::errorString() = ("For Variables of type VectorPerNode a 3xN or 4xN matrix,N>0, must be defined");
         return false;
     }
 
     if (part->hasVariable(name, timestep))
     {
-        EnsightObj::ERROR_STR = ("Part " + part->getName() + " already has variable " + name +
+        EnsightObj::errorString() = ("Part " + part->getName() + " already has variable " + name +
                                  " defined for timestep " + QString::number(timestep));
         return false;
     }
 
     if (type == Ensight::VarTypeUnknown)
     {
-        EnsightObj::ERROR_STR = "Cannot add Variable " + name + "to Part " + part->getName();
+        EnsightObj::errorString() = "Cannot add Variable " + name + "to Part " + part->getName();
         return false;
     }
 
-    if (Ensight::varTypeDims[static_cast<int>(type)] != values.rows())
+    if (type != Ensight::VectorPerNode && Ensight::varTypeDims[static_cast<int>(type)] != values.rows())
     {
-        EnsightObj::ERROR_STR = "Cannot add Variable " + name + "to Part " + part->getName() +
+        EnsightObj::errorString() = "Cannot add Variable " + name + "to Part " + part->getName() +
                                 QString(". %0 values per node expected")
                                 .arg(Ensight::varTypeDims[static_cast<int>(type)]);
         return false;
@@ -612,10 +1050,22 @@ bool EnsightObj::setVariable(EnsightPart* part, const QString& name, const Matx&
 
     // Save local at part
     part->setVariable(name, values, type, timestep);
+
+    // New values only extend the cached bounds
+    const int handle = variableRegistry_->find(name);
+    const Matx& bounds = part->getVariableBounds(handle, timestep);
+    variableBounds_.resize(std::max<size_t>(variableBounds_.size(), getNumberOfTimesteps() + 1));
+    const size_t rows[] = {0, static_cast<size_t>(timestep) + 1};
+    for (size_t row : rows)
+    {
+        if (variableBounds_[row].size() <= static_cast<size_t>(handle))
+            variableBounds_[row].resize(handle + 1);
+        EnsightVariable::mergeBounds(variableBounds_[row][handle], bounds);
+    }
     return true;
 }
 
-bool EnsightObj::setVariable(EnsightPart *part, const std::string &name, const Matx &values, Ensight::VarTypes type, int timestep)
+bool EnsightObj::setVariable(EnsightPart *part, const std::string &name, const MatxBuffer &values, Ensight::VarTypes type, int timestep)
 {
     return setVariable(part, QString::fromStdString(name), values, type, timestep);
 }
@@ -660,6 +1110,91 @@ void EnsightObj::print(std::ostream& out) const
     for (const auto& part : parts_)
         part->print(out);
 
+    out << std::endl;
+    out << "---------------------- MEMORY --------------------\n";
+    getMemoryReport().print(out);
+
     out << "--------------------------------------------------\n";
     out << "--------------------------------------------------" << std::endl;
 }
+
+void EnsightObj::setReadPeakBytes(int64_t bytes)
+{
+    readPeakBytes_ = bytes;
+}
+
+EnsightMemoryReport EnsightObj::getMemoryReport() const
+{
+    EnsightMemoryReport report;
+    report.peakArrayBytes = bufferStore_->getPeakBytes();
+    report.readPeakBytes = readPeakBytes_;
+
+    // Shared arrays are counted once in storedArrayBytes and topologyBytes
+    std::unordered_set<const void*> stored;
+    auto addArray = [&](const EnsightPart* part, int timestep, const char* category,
+                        const std::string& name, const void* data, int64_t bytes) {
+        report.arrayBytes += bytes;
+        bool shared = data && !stored.insert(data).second;
+        if (!shared)
+            report.storedArrayBytes += bytes;
+        report.addEntry(part->getName().toStdString(), timestep, category, name, bytes, shared);
+    };
+    auto addTopology = [&](const EnsightPart* part, int timestep, const char* category,
+                           const std::string& name, const Mati& values) {
+        int64_t bytes = values.size() * sizeof(int);
+        bool shared = values.data() && !stored.insert(values.data()).second;
+        if (!shared)
+            report.topologyBytes += bytes;
+        report.addEntry(part->getName().toStdString(), timestep, category, name, bytes, shared);
+    };
+
+    for (const auto& part : parts_)
+    {
+        for (int timestep = 0; timestep < part->getNumberOfTimesteps(); timestep++)
+        {
+            MatxView vertices = part->getVertices(timestep);
+            addArray(part.get(), timestep, "vertices", std::string(),
+                     vertices.data(), vertices.size() * sizeof(double));
+
+            for (EnsightCellList* cellList : part->getCells(timestep))
+            {
+                const std::string type = Ensight::strCell[cellList->getType()];
+                MatiView values = cellList->getValues();
+                addArray(part.get(), timestep, "cells", type,
+                         values.data(), values.size() * sizeof(int));
+
+                // Report the topology only if it was computed, without computing it
+                if (!cellList->isTopologyComputed())
+                    continue;
+                addTopology(part.get(), timestep, "neighbors", type, cellList->getNeighbors());
+                addTopology(part.get(), timestep, "boundary", type, cellList->getBoundary());
+                addTopology(part.get(), timestep, "boundaryVertices", type, cellList->getBoundaryVertices());
+            }
+
+            for (int handle = 0; handle < variableRegistry_->size(); handle++)
+            {
+                const EnsightVariable* variable = part->getVariable(handle, timestep);
+                if (!variable)
+                    continue;
+                MatxView values = variable->getValues();
+                addArray(part.get(), timestep, "variable", variable->getName().toStdString(),
+                         values.data(), values.size() * sizeof(double));
+            }
+
+            part->addMemoryUsage(report, timestep);
+        }
+    }
+
+    // Trees built so far, shared trees are counted once
+    std::unordered_set<const EnsightSubdivTree*> reportedTrees;
+    for (const EnsightLazy<std::shared_ptr<EnsightSubdivTree>>& subdivTree : subdivTrees_)
+    {
+        if (!subdivTree.isComputed())
+            continue;
+        const EnsightSubdivTree* tree = subdivTree.get([]() { return nullptr; }).get();
+        if (reportedTrees.insert(tree).second)
+            tree->addMemoryUsage(report);
+    }
+
+    return report;
+}
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2016 Fraunhofer ITWM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "../include/ensightparallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QString>
+
+#include "../include/ensightobj.h"
+
+namespace Ensight
+{
+namespace Parallel
+{
+
+namespace
+{
+
+/**
+ * @brief One call of parallelFor() shared by the participating threads.
+ *
+ * Each participant owns a range of chunks and takes chunks from its front.
+ * A participant without chunks steals the back half of another range.
+ */
+struct Job
+{
+    struct Range
+    {
+        std::mutex mutex;
+        int64_t first = 0;
+        int64_t last = 0;
+    };
+
+    Job(int64_t begin, int64_t end, int64_t grainSize, int numParticipants,
+        const std::function<void(int64_t, int64_t)>& body) :
+        body(body), begin(begin), end(end), grainSize(grainSize),
+        ranges(new Range[numParticipants]), numRanges(numParticipants)
+    {
+        int64_t chunks = (end - begin + grainSize - 1) / grainSize;
+        for (int i = 0; i < numRanges; i++)
+        {
+            ranges[i].first = chunks * i / numRanges;
+            ranges[i].last = chunks * (i + 1) / numRanges;
+        }
+        pending = chunks;
+        failed = false;
+    }
+
+    bool pop(int self, int64_t& chunk)
+    {
+        Range& range = ranges[self];
+        std::lock_guard<std::mutex> lock(range.mutex);
+        if (range.first >= range.last)
+            return false;
+        chunk = range.first++;
+        return true;
+    }
+
+    bool steal(int self, int64_t& chunk)
+    {
+        for (int i = 1; i < numRanges; i++)
+        {
+            Range& victim = ranges[(self + i) % numRanges];
+            int64_t first, last;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                int64_t count = victim.last - victim.first;
+                if (count <= 0)
+                    continue;
+                last = victim.last;
+                first = last - (count + 1) / 2;
+                victim.last = first;
+            }
+
+            // Keep the first stolen chunk and offer the others in the own range
+            Range& own = ranges[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.first = first + 1;
+            own.last = last;
+            chunk = first;
+            return true;
+        }
+        return false;
+    }
+
+    void run(int self)
+    {
+        // Participant 0 is the calling thread, the workers keep the first
+        // message set by a chunk for it, see EnsightObj::errorString()
+        QString& errorString = EnsightObj::errorString();
+        int64_t chunk;
+        while (pop(self, chunk) || steal(self, chunk))
+        {
+            // After an exception the remaining chunks are only counted
+            if (!failed)
+                process(self, chunk, errorString);
+            if (--pending == 0)
+            {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                done.notify_all();
+            }
+        }
+    }
+
+    void process(int self, int64_t chunk, QString& errorString)
+    {
+        int64_t first = begin + chunk * grainSize;
+        if (self != 0)
+            errorString.clear();
+        try
+        {
+            body(first, std::min(first + grainSize, end));
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!exception)
+                exception = std::current_exception();
+            failed = true;
+        }
+        if (self != 0 && !errorString.isEmpty())
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (error.isEmpty())
+                error = errorString;
+        }
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [this]() { return pending == 0; });
+    }
+
+    const std::function<void(int64_t, int64_t)>& body;
+    const int64_t begin;
+    const int64_t end;
+    const int64_t grainSize;
+    std::unique_ptr<Range[]> ranges;
+    const int numRanges;
+
+    /** Number of chunks not processed yet */
+    std::atomic<int64_t> pending;
+    std::mutex doneMutex;
+    std::condition_variable done;
+
+    /** First error message set on a worker thread */
+    std::mutex errorMutex;
+    QString error;
+
+    /** First exception thrown by body on any thread, rethrown by the caller */
+    std::exception_ptr exception;
+    std::atomic<bool> failed;
+};
+
+/**
+ * @brief Set while a thread processes chunks, nested calls are processed serially.
+ */
+thread_local bool insideParallelFor = false;
+
+int defaultNumThreads()
+{
+    const char* value = std::getenv("ENSIGHT_NUM_THREADS");
+    int numThreads = value ? std::atoi(value) : 0;
+    if (numThreads <= 0)
+        numThreads = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(numThreads, 1);
+}
+
+/**
+ * @brief The worker threads shared by all calls of parallelFor().
+ *
+ * Workers are started on first use and wait for the next job in between.
+ * The pool is never destroyed: joining threads from a static destructor
+ * deadlocks when a DLL is unloaded on Windows, as the loader lock is held.
+ * Workers are stopped explicitly by shutdown() instead.
+ */
+class ThreadPool
+{
+public:
+    static ThreadPool& instance()
+    {
+        static ThreadPool* pool = new ThreadPool();
+        return *pool;
+    }
+
+    int getNumThreads()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return numThreads_;
+    }
+
+    void setNumThreads(int numThreads)
+    {
+        std::lock_guard<std::mutex> busy(busyMutex_);
+        stopWorkers();
+        std::lock_guard<std::mutex> lock(mutex_);
+        numThreads_ = numThreads > 0 ? numThreads : defaultNumThreads();
+    }
+
+    void shutdown()
+    {
+        std::lock_guard<std::mutex> busy(busyMutex_);
+        stopWorkers();
+    }
+
+    /**
+     * @brief Processes the range with all threads, false if the pool is busy.
+     */
+    bool run(int64_t begin, int64_t end, int64_t grainSize,
+             const std::function<void(int64_t, int64_t)>& body)
+    {
+        std::unique_lock<std::mutex> busy(busyMutex_, std::try_to_lock);
+        if (!busy.owns_lock())
+            return false;
+
+        std::shared_ptr<Job> job;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            int64_t chunks = (end - begin + grainSize - 1) / grainSize;
+            int numParticipants = static_cast<int>(std::min<int64_t>(numThreads_, chunks));
+            if (numParticipants <= 1)
+                return false;
+
+            while (static_cast<int>(workers_.size()) < numThreads_ - 1)
+            {
+                int index = static_cast<int>(workers_.size()) + 1;
+                workers_.emplace_back([this, index]() { work(index); });
+            }
+
+            job = std::make_shared<Job>(begin, end, grainSize, numParticipants, body);
+            job_ = job;
+            generation_++;
+        }
+        wake_.notify_all();
+
+        insideParallelFor = true;
+        job->run(0);
+        job->wait();
+        insideParallelFor = false;
+
+        std::unique_lock<std::mutex> errorLock(job->errorMutex);
+        if (!job->error.isEmpty())
+            EnsightObj::errorString() = job->error;
+        std::exception_ptr exception = job->exception;
+        errorLock.unlock();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_.reset();
+        }
+        if (exception)
+            std::rethrow_exception(exception);
+        return true;
+    }
+
+private:
+    ThreadPool() : numThreads_(defaultNumThreads()), generation_(0), stop_(false)
+    {
+    }
+
+    void work(int index)
+    {
+        insideParallelFor = true;
+        uint64_t seen = 0;
+        for (;;)
+        {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+                if (stop_)
+                    return;
+                seen = generation_;
+                job = job_;
+            }
+
+            // Jobs with fewer participants than threads leave some workers idle
+            if (job && index < job->numRanges)
+                job->run(index);
+        }
+    }
+
+    void stopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& worker : workers_)
+            worker.join();
+        workers_.clear();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = false;
+    }
+
+    /** Number of threads including the calling thread */
+    int numThreads_;
+    std::vector<std::thread> workers_;
+
+    /** Held by the thread whose range is processed */
+    std::mutex busyMutex_;
+
+    /** Guards the current job and the worker state */
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::shared_ptr<Job> job_;
+    uint64_t generation_;
+    bool stop_;
+};
+
+} // namespace
+
+void parallelFor(int64_t begin, int64_t end, int64_t grainSize,
+                 const std::function<void(int64_t, int64_t)>& body)
+{
+    if (end <= begin)
+        return;
+
+    grainSize = std::max<int64_t>(grainSize, 1);
+    if (insideParallelFor || end - begin <= grainSize ||
+        !ThreadPool::instance().run(begin, end, grainSize, body))
+    {
+        body(begin, end);
+    }
+}
+
+void setNumThreads(int numThreads)
+{
+    ThreadPool::instance().setNumThreads(numThreads);
+}
+
+int getNumThreads()
+{
+    return ThreadPool::instance().getNumThreads();
+}
+
+void shutdown()
+{
+    ThreadPool::instance().shutdown();
+}
+
+} // namespace Parallel
+} // namespace Ensight
@@ -23,27 +23,43 @@
 
 #include "../include/ensightpart.h"
 
+#include <initializer_list>
 #include <iostream>
 #include <utility>
 #include "../include/bbox.h"
+#include "../include/ensightbufferstore.h"
 #include "../include/ensightcell.h"
+#include "../include/ensightmemoryreport.h"
 #include "../include/ensightvariable.h"
 
 using std::unique_ptr;
 using std::make_pair;
 
-EnsightPart::EnsightPart(const QString& name, int id, int timesteps) :
-    name_(name), id_(id), timesteps_(timesteps)
+EnsightPart::EnsightPart(const QString& name, int id, int timesteps,
+                         std::shared_ptr<EnsightVariableRegistry> registry,
+                         std::shared_ptr<EnsightBufferStore> store) :
+    name_(name), id_(id), timesteps_(timesteps), registry_(std::move(registry)),
+    store_(std::move(store))
 {
+    if (!registry_)
+        registry_ = std::make_shared<EnsightVariableRegistry>();
+    if (!store_)
+        store_ = std::make_shared<EnsightBufferStore>();
+    modified_.fill(true, timesteps);
     vertices_.resize(timesteps);
     bounds_.resize(timesteps);
+    variables_.resize(timesteps);
+    incidence_.resize(timesteps);
+    faceConnectivity_.resize(timesteps);
+    meshView_.resize(timesteps);
 }
 
-EnsightPart::EnsightPart(const std::string& name, int id, int timesteps) :
-    name_(QString::fromStdString(name)), id_(id), timesteps_(timesteps)
+EnsightPart::EnsightPart(const std::string& name, int id, int timesteps,
+                         std::shared_ptr<EnsightVariableRegistry> registry,
+                         std::shared_ptr<EnsightBufferStore> store) :
+    EnsightPart(QString::fromStdString(name), id, timesteps, std::move(registry),
+                std::move(store))
 {
-    vertices_.resize(timesteps);
-    bounds_.resize(timesteps);
 }
 
 EnsightPart::~EnsightPart() = default;
@@ -60,17 +76,36 @@ int EnsightPart::getId() const
 
 void EnsightPart::clean(int step)
 {
+    if (modified_.size() > step)
+        modified_[step] = true;
     if (vertices_.size() > step)
-        vertices_[step].resize(0, 0);
-    variables_.erase(step);
+        vertices_[step] = MatxBuffer();
+    if (static_cast<int>(variables_.size()) > step)
+    {
+        std::vector<unique_ptr<EnsightVariable>> stepVariables = std::move(variables_[step]);
+        variables_[step].clear();
+        for (size_t handle = 0; handle < stepVariables.size(); handle++)
+            if (stepVariables[handle])
+                updateVariableBounds(static_cast<int>(handle));
+    }
     cells_.erase(step);
+    invalidateTopology(step);
 }
 
 void EnsightPart::setTimeSteps(int timesteps)
 {
+    for (int i = modified_.size(); i < timesteps; i++)
+        modified_.push_back(true);
+    modified_.resize(timesteps);
     timesteps_ = timesteps;
     vertices_.resize(timesteps);
     bounds_.resize(timesteps);
+    variables_.resize(timesteps);
+    incidence_.resize(timesteps);
+    faceConnectivity_.resize(timesteps);
+    meshView_.resize(timesteps);
+    for (size_t handle = 0; handle < variableBounds_.size(); handle++)
+        updateVariableBounds(static_cast<int>(handle));
 }
 
 int EnsightPart::getNumberOfTimesteps() const
@@ -78,11 +113,24 @@ int EnsightPart::getNumberOfTimesteps() const
     return timesteps_;
 }
 
-void EnsightPart::setVertices(const Matx& vertices, int timestep)
+bool EnsightPart::isModified(int timestep) const
+{
+    return modified_[timestep];
+}
+
+void EnsightPart::resetModified()
+{
+    modified_.fill(false);
+}
+
+void EnsightPart::setVertices(const MatxBuffer& vertices, int timestep)
 {
-    this->vertices_[timestep] = vertices;
-    this->bounds_[timestep] = Bbox(vertices.rowwise().minCoeff(),
-                                   vertices.rowwise().maxCoeff());
+    this->modified_[timestep] = true;
+    this->vertices_[timestep] = store_->intern(vertices);
+    invalidateTopology(timestep);
+    MatxView view = vertices.view();
+    this->bounds_[timestep] = Bbox(view.rowwise().minCoeff(),
+                                   view.rowwise().maxCoeff());
 }
 
 int EnsightPart::getVertexCount(int timestep) const
@@ -90,9 +138,9 @@ int EnsightPart::getVertexCount(int timestep) const
     return vertices_[timestep].cols();
 }
 
-const Matx& EnsightPart::getVertices(int timestep) const
+MatxView EnsightPart::getVertices(int timestep) const
 {
-    return vertices_[timestep];
+    return vertices_[timestep].view();
 }
 
 bool EnsightPart::hasCellType(int timestep, Ensight::Cell c) const
@@ -106,10 +154,20 @@ bool EnsightPart::hasCellType(int timestep, Ensight::Cell c) const
     return iter != range.second;
 }
 
-void EnsightPart::setCells(const Mati& values, int timestep, Ensight::Cell type)
+void EnsightPart::setCells(const MatiBuffer& values, int timestep, Ensight::Cell type)
 {
-    unique_ptr<EnsightCellList> cl(new EnsightCellList(type, values, name_));
+    modified_[timestep] = true;
+    unique_ptr<EnsightCellList> cl(new EnsightCellList(type, store_->intern(values), name_));
+
+    // Reuse the topology of the adjacent timesteps if the cells did not change
+    for (int step : {timestep - 1, timestep + 1})
+    {
+        EnsightCellList* adjacent = getCells(step, type);
+        if (adjacent && cl->shareTopology(*adjacent))
+            break;
+    }
     cells_.insert(make_pair(timestep, std::move(cl)));
+    invalidateTopology(timestep);
 }
 
 QList<EnsightCellList*> EnsightPart::getCells(int timestep)
@@ -121,6 +179,67 @@ QList<EnsightCellList*> EnsightPart::getCells(int timestep)
     return result;
 }
 
+const EnsightVertexIncidence& EnsightPart::getVertexIncidence(int timestep) const
+{
+    return incidence_[timestep].get([this, timestep]() {
+        QList<EnsightCellList*> cellLists;
+        auto range = cells_.equal_range(timestep);
+        for (auto it = range.first; it != range.second; ++it)
+            cellLists.push_back(it->second.get());
+        return EnsightVertexIncidence(cellLists, getVertexCount(timestep));
+    });
+}
+
+const EnsightFaceConnectivity& EnsightPart::getFaceConnectivity(int timestep) const
+{
+    return faceConnectivity_[timestep].get([this, timestep]() {
+        return EnsightFaceConnectivity(getCellLists(timestep), getVertexCount(timestep));
+    });
+}
+
+const EnsightMeshView& EnsightPart::getMeshView(int timestep) const
+{
+    return meshView_[timestep].get([this, timestep]() {
+        return EnsightMeshView(getCellLists(timestep));
+    });
+}
+
+QList<const EnsightCellList*> EnsightPart::getCellLists(int timestep) const
+{
+    QList<const EnsightCellList*> result;
+    auto range = cells_.equal_range(timestep);
+    for (auto it = range.first; it != range.second; ++it)
+        result.push_back(it->second.get());
+    return result;
+}
+
+void EnsightPart::addMemoryUsage(EnsightMemoryReport& report, int timestep) const
+{
+    const std::string name = name_.toStdString();
+    auto addEntry = [&](const char* category, int64_t bytes) {
+        report.topologyBytes += bytes;
+        report.addEntry(name, timestep, category, std::string(), bytes, false);
+    };
+
+    // Report only what was computed, without computing it
+    if (incidence_[timestep].isComputed())
+        addEntry("incidence", getVertexIncidence(timestep).getBytes());
+    if (faceConnectivity_[timestep].isComputed())
+        addEntry("faceConnectivity", getFaceConnectivity(timestep).getBytes());
+    if (meshView_[timestep].isComputed())
+        addEntry("meshView", getMeshView(timestep).getBytes());
+}
+
+void EnsightPart::invalidateTopology(int timestep)
+{
+    if (static_cast<int>(incidence_.size()) > timestep)
+        incidence_[timestep].reset();
+    if (static_cast<int>(faceConnectivity_.size()) > timestep)
+        faceConnectivity_[timestep].reset();
+    if (static_cast<int>(meshView_.size()) > timestep)
+        meshView_[timestep].reset();
+}
+
 EnsightCellList* EnsightPart::getCells(int timestep, Ensight::Cell type)
 {
     auto range = cells_.equal_range(timestep);
@@ -133,98 +252,160 @@ EnsightCellList* EnsightPart::getCells(int timestep, Ensight::Cell type)
 
 Bbox EnsightPart::getCellBounds(const Veci& cell, int timestep) const
 {
+    MatxView vertices = vertices_[timestep].view();
     Bbox result;
     for (int i = 0; i < cell.rows(); i++)
-        result.extend(vertices_[timestep].col(cell[i]));
+        result.extend(vertices.col(cell[i]));
     return result;
 }
 
 
-void EnsightPart::setVariable(const QString& name, const Matx& values,
+void EnsightPart::setVariable(const QString& name, const MatxBuffer& values,
                               Ensight::VarTypes type, int timestep)
 {
     if (values.cols() > 0)
     {
         unique_ptr<EnsightVariable> variable(new EnsightVariable(name, type));
         variable->setValues(values);
-        variables_.insert(make_pair(timestep, std::move(variable)));
+        variable->shareValues(*store_);
+
+        modified_[timestep] = true;
+        std::vector<unique_ptr<EnsightVariable>>& stepVariables = variables_[timestep];
+        size_t handle = static_cast<size_t>(registry_->intern(name));
+        if (stepVariables.size() <= handle)
+            stepVariables.resize(handle + 1);
+        if (variableBounds_.size() <= handle)
+            variableBounds_.resize(handle + 1);
+
+        // New values only extend the bounds, replaced values may shrink them
+        bool replaced = stepVariables[handle] != nullptr;
+        stepVariables[handle] = std::move(variable);
+        if (replaced)
+            updateVariableBounds(static_cast<int>(handle));
+        else
+            EnsightVariable::mergeBounds(variableBounds_[handle], stepVariables[handle]->getBounds());
     }
 }
 
-void EnsightPart::setVariable(const std::string &name, const Matx &values, Ensight::VarTypes type, int timestep)
+void EnsightPart::setVariable(const std::string &name, const MatxBuffer &values, Ensight::VarTypes type, int timestep)
 {
     setVariable(QString::fromStdString(name), values, type, timestep);
 }
 
-bool EnsightPart::hasVariable(const QString& name, int timestep) const
+int EnsightPart::getVariableHandle(const QString& name) const
 {
-    auto range = timestep >= 0 ? variables_.equal_range(timestep)
-                               : make_pair(variables_.begin(), variables_.end());
+    return registry_->find(name);
+}
 
-    using vt = decltype(variables_)::value_type;
-    auto iter = std::find_if(range.first, range.second, [&](const vt& v) {
-        return v.second->getName() == name; });
-    return iter != range.second;
+int EnsightPart::getVariableHandle(const std::string& name) const
+{
+    return registry_->find(name);
+}
+
+bool EnsightPart::hasVariable(const QString& name, int timestep) const
+{
+    return hasVariable(registry_->find(name), timestep);
 }
 
 bool EnsightPart::hasVariable(const std::string &name, int timestep) const
 {
-    return hasVariable(QString::fromStdString(name), timestep);
+    return hasVariable(registry_->find(name), timestep);
+}
+
+bool EnsightPart::hasVariable(int handle, int timestep) const
+{
+    if (handle < 0)
+        return false;
+
+    if (timestep >= 0)
+        return variableAt(handle, timestep) != nullptr;
+
+    for (int i = 0; i < static_cast<int>(variables_.size()); i++)
+        if (variableAt(handle, i) != nullptr)
+            return true;
+    return false;
+}
+
+MatxView EnsightPart::getVariableValues(const QString& name, int timestep) const
+{
+    return getVariableValues(registry_->find(name), timestep);
+}
+
+MatxView EnsightPart::getVariableValues(const std::string &name, int timestep) const
+{
+    return getVariableValues(registry_->find(name), timestep);
 }
 
-const Matx& EnsightPart::getVariableValues(const QString& name, int timestep)
+MatxView EnsightPart::getVariableValues(int handle, int timestep) const
 {
-    EnsightVariable* var = getVariable(name, timestep);
+    const EnsightVariable* var = getVariable(handle, timestep);
     assert(var != nullptr && "Variable not defined");
 
     return var->getValues();
 }
 
-const Matx &EnsightPart::getVariableValues(const std::string &name, int timestep)
+const EnsightVariable* EnsightPart::getVariable(const QString& name, int timestep) const
 {
-    return getVariableValues(QString::fromStdString(name), timestep);
+    return getVariable(registry_->find(name), timestep);
 }
 
-EnsightVariable* EnsightPart::getVariable(const QString& name, int timestep)
+const EnsightVariable* EnsightPart::getVariable(const std::string &name, int timestep) const
 {
-    using vt = decltype(variables_)::value_type;
-    auto range = variables_.equal_range(timestep);
-    auto iter = std::find_if(range.first, range.second, [&](const vt& v) {
-        return v.second->getName() == name; });
-    return iter != range.second ? iter->second.get() : nullptr;
+    return getVariable(registry_->find(name), timestep);
 }
 
-EnsightVariable *EnsightPart::getVariable(const std::string &name, int timestep)
+const EnsightVariable* EnsightPart::getVariable(int handle, int timestep) const
+{
+    return variableAt(handle, timestep);
+}
+
+EnsightVariable* EnsightPart::variableAt(int handle, int timestep) const
+{
+    if (handle < 0 || timestep < 0 || timestep >= static_cast<int>(variables_.size()))
+        return nullptr;
+
+    const std::vector<unique_ptr<EnsightVariable>>& stepVariables = variables_[timestep];
+    return static_cast<size_t>(handle) < stepVariables.size() ? stepVariables[handle].get()
+                                                              : nullptr;
+}
+
+
+const Matx& EnsightPart::getVariableBounds(const QString& name, int timestep) const
 {
-    return getVariable(QString::fromStdString(name), timestep);
+    return getVariableBounds(registry_->find(name), timestep);
 }
 
+const Matx& EnsightPart::getVariableBounds(const std::string &name, int timestep) const
+{
+    return getVariableBounds(registry_->find(name), timestep);
+}
 
-Matx EnsightPart::getVariableBounds(const QString& name, int timestep)
+const Matx& EnsightPart::getVariableBounds(int handle, int timestep) const
 {
+    static const Matx empty;
     if (timestep >= 0)
     {
         // return bounds for one time step
-        return getVariable(name, timestep)->getBounds();
+        EnsightVariable* variable = variableAt(handle, timestep);
+        return variable ? variable->getBounds() : empty;
     }
 
     // return combined bounds over all time steps
-    Matx result = getVariable(name, 0)->getBounds();
-    for (int i = 1; i < getNumberOfTimesteps(); i++)
-    {
-        Matx temp = getVariable(name, i)->getBounds();
-        for (int j = 0; j < temp.rows(); j++)
-        {
-            result(j, 0) = std::min(result(j, 0), temp(j, 0));
-            result(j, 1) = std::max(result(j, 1), temp(j, 1));
-        }
-    }
-    return result;
+    if (handle < 0 || static_cast<size_t>(handle) >= variableBounds_.size())
+        return empty;
+    return variableBounds_[handle];
 }
 
-Matx EnsightPart::getVariableBounds(const std::string &name, int timestep)
+void EnsightPart::updateVariableBounds(int handle)
 {
-    return getVariableBounds(QString::fromStdString(name), timestep);
+    Matx& bounds = variableBounds_[handle];
+    bounds = Matx();
+    for (int i = 0; i < static_cast<int>(variables_.size()); i++)
+    {
+        EnsightVariable* variable = variableAt(handle, i);
+        if (variable)
+            EnsightVariable::mergeBounds(bounds, variable->getBounds());
+    }
 }
 
 Bbox EnsightPart::getGeometryBounds(int timestep) const
@@ -245,7 +426,7 @@ void EnsightPart::print(std::ostream& out) const
     out << ":::::::::::::::::::: VERTICES ::::::::::::::::::::\n";
     for (int i = 0; i < vertices_.size(); i++)
         out << "::::::::::::::::::::   T=" << i << "    ::::::::::::::::::::\n"
-            << vertices_[i] << "\n";
+            << vertices_[i].view() << "\n";
     out << "::::::::::::::::::::::::::::::::::::::::::::::::::\n";
     out << ":::::::::::::::::::::: CELLS :::::::::::::::::::::\n";
     for (int i = 0; i < getNumberOfTimesteps(); i++)
@@ -258,12 +439,12 @@ void EnsightPart::print(std::ostream& out) const
                 << it->second->getValues() << "\n";
         }
 
-        auto vrange = variables_.equal_range(i);
-        for (auto it = vrange.first; it != vrange.second; ++it)
+        for (const auto& variable : variables_[i])
         {
-            const EnsightVariable& var = *it->second;
-            out << "Variables: " << var.getName().toStdString() << "\n"
-                << var.getValues() << "\n";
+            if (!variable)
+                continue;
+            out << "Variables: " << variable->getName().toStdString() << "\n"
+                << variable->getValues() << "\n";
         }
     }
     out << "::::::::::::::::::::::::::::::::::::::::::::::::::" << std::endl;
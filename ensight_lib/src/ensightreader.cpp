@@ -23,11 +23,13 @@
 
 #include "../include/ensightreader.h"
 
+#include <algorithm>
 #include <memory>
 #include <QFileInfo>
 #include <QTextStream>
 #include "../include/ensightasciireader.h"
 #include "../include/ensightbinaryreader.h"
+#include "../include/ensightmemoryreport.h"
 #include "../include/ensightobj.h"
 
 using namespace Ensight::Reader::detail;
@@ -68,7 +70,7 @@ bool EnsightCase::readCaseFile()
     QFile file(this->masterFileName);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "[EnsightReader::read()] Cannot read from file  " +
             this->masterFileName + ".";
         return false;
@@ -129,9 +131,9 @@ bool EnsightCase::readCaseFile()
                 return false;
             if (filesetSteps != timesetSteps)
             {
-                EnsightObj::ERROR_STR = "[EnsightReader::read()] Number of "
-                                        "steps in file set must be equal to "
-                                        "number of steps in time set.";
+                EnsightObj::errorString() = "[EnsightReader::read()] Number of "
+                                            "steps in file set must be equal to "
+                                            "number of steps in time set.";
                 return false;
             }
             break;
@@ -144,7 +146,7 @@ bool EnsightCase::readCaseFile()
 
     if (modelFilename.isEmpty())
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "[EnsightReader::read()] SECTION GEOMETRY  not found.";
         return false;
     }
@@ -175,6 +177,11 @@ EnsightObj* read(const QString& filename, int readTimeStep)
 
     QString path = QFileInfo(filename).absolutePath();
 
+    // Memory of the process before reading, see EnsightMemoryReport::readPeakBytes
+    const int64_t residentBefore = EnsightMemoryReport::getResidentBytes();
+    const int64_t peakBefore = EnsightMemoryReport::getPeakResidentBytes();
+    int64_t sampledPeak = residentBefore;
+
     // Create Ensight object
     std::unique_ptr<EnsightObj> ensight(new EnsightObj());
     ensight->beginEdit();
@@ -192,7 +199,7 @@ EnsightObj* read(const QString& filename, int readTimeStep)
         (isTransient || readTimeStep > 0))
     {
 
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             QString("In [EnsightReader::read()] requested time step %1 "
                     "(index %2) but file contains only %3 time steps.")
                 .arg(readTimeStep + 1)
@@ -220,7 +227,7 @@ EnsightObj* read(const QString& filename, int readTimeStep)
             int fileNumber = caseFile.getFileNumberForStep(step);
             if (!checkWildcards(geometryFile, fileNumber))
             {
-                EnsightObj::ERROR_STR =
+                EnsightObj::errorString() =
                     "In [EnsightReader::read()] for timestep = " +
                     QString::number(step) + ". Something wrong with the "
                     "wildcards or the corresponding time step for geometry model.";
@@ -241,8 +248,8 @@ EnsightObj* read(const QString& filename, int readTimeStep)
             FileType type = getEnsightFileType(geometryFile);
             if (type == FileType::Fortran_Binary)
             {
-                EnsightObj::ERROR_STR = "In [EnsightReader::read()] Format "
-                                        "\"Fortran Binary\" is not supported.";
+                EnsightObj::errorString() = "In [EnsightReader::read()] Format "
+                                            "\"Fortran Binary\" is not supported.";
                 return nullptr;
             }
             binary = type == FileType::C_Binary;
@@ -260,6 +267,7 @@ EnsightObj* read(const QString& filename, int readTimeStep)
                                     readTimeStep, isTransientSingleFile)))
                 return nullptr;
         }
+        sampledPeak = std::max(sampledPeak, EnsightMemoryReport::getResidentBytes());
     }
 
     // Variables
@@ -275,7 +283,7 @@ EnsightObj* read(const QString& filename, int readTimeStep)
             {
                 if (!ensight->createVariable(varName, varType))
                 {
-                    EnsightObj::ERROR_STR =
+                    EnsightObj::errorString() =
                         "In [EnsightReader::read()] for timestep = " +
                         QString::number(timestep) +
                         ". Cannot create variable with name " + varName;
@@ -291,7 +299,7 @@ EnsightObj* read(const QString& filename, int readTimeStep)
                 int fileNumber = caseFile.getFileNumberForStep(step);
                 if (!checkWildcards(varFile, fileNumber))
                 {
-                    EnsightObj::ERROR_STR =
+                    EnsightObj::errorString() =
                         "In [EnsightReader::read()] for timestep = " +
                         QString::number(step) +
                         ". Something wrong with the wildcards or the "
@@ -324,6 +332,7 @@ EnsightObj* read(const QString& filename, int readTimeStep)
                                         varType, dim)))
                     return nullptr;
             }
+            sampledPeak = std::max(sampledPeak, EnsightMemoryReport::getResidentBytes());
         }
     }
 
@@ -332,6 +341,12 @@ EnsightObj* read(const QString& filename, int readTimeStep)
         return nullptr;
     }
 
+    // The peak of the process is exact if reading raised it, otherwise use the samples
+    const int64_t peakAfter = EnsightMemoryReport::getPeakResidentBytes();
+    sampledPeak = std::max(sampledPeak, EnsightMemoryReport::getResidentBytes());
+    const int64_t peak = peakAfter > peakBefore ? peakAfter : sampledPeak;
+    ensight->setReadPeakBytes(std::max<int64_t>(0, peak - residentBefore));
+
     return ensight.release();
 }
 
@@ -355,7 +370,7 @@ bool readSectionFormat(QStringList& data)
 
     if (!line.startsWith("type"))
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "[EnsightReader::read()] Unknown keyword in FORMAT section <" +
             line + ">.";
         return false;
@@ -366,7 +381,7 @@ bool readSectionFormat(QStringList& data)
 
     if (line != "ensight gold")
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "[EnsightReader::read()] Unknown format in line <" + line +
             ">. Only format <ensight gold> is supported by this libary.";
         return false;
@@ -413,7 +428,7 @@ bool readSectionGeometry(QStringList& data, QString& modelFilename,
     QString line = data.takeFirst();
     if (!line.startsWith("model"))
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "[EnsightReader::read()] Unknown keyword in GEOMETRY section<" +
             line + ">. Only the keyword <model> is supported by this library";
         return false;
@@ -430,7 +445,7 @@ bool readSectionGeometry(QStringList& data, QString& modelFilename,
     // if this is the last token.
     if (modelTokens.size() != 1)
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "[EnsightReader::read()] Unsupported format in GEOMETRY section in "
             "line <" +
             line + ">. (Note that the keyword [change_coords_only] "
@@ -459,7 +474,7 @@ bool readSectionVariables(QStringList& data, QStringList& variableNames,
         Ensight::VarTypes varType = getVarType(line);
         if (varType == Ensight::VarTypeUnknown)
         {
-            EnsightObj::ERROR_STR =
+            EnsightObj::errorString() =
                 "[EnsightReader::read()] In VARIABLE section in line <" + line +
                 ">. Unkown keyword or delimiter <:> not found.";
             return false;
@@ -469,7 +484,7 @@ bool readSectionVariables(QStringList& data, QStringList& variableNames,
         QStringList varSplit = line.split(" ", QString::SkipEmptyParts);
         if (varSplit.size() < 2)
         {
-            EnsightObj::ERROR_STR =
+            EnsightObj::errorString() =
                 "[EnsightReader::read()] In VARIABLE section in line <" + line +
                 ">. At least variable type, name and value expected.";
             return false;
@@ -479,7 +494,7 @@ bool readSectionVariables(QStringList& data, QStringList& variableNames,
         {
             if (varSplit.size() > 2) // transient
             {
-                EnsightObj::ERROR_STR =
+                EnsightObj::errorString() =
                     "[EnsightReader::read()] In VARIABLE section in line <" +
                     line + ">. Transient constants are not supported.";
                 return false;
@@ -496,7 +511,7 @@ bool readSectionVariables(QStringList& data, QStringList& variableNames,
 
             if (varSplit.size() != 2)
             {
-                EnsightObj::ERROR_STR =
+                EnsightObj::errorString() =
                     "[EnsightReader::read()] In VARIABLE section in line <" +
                     line + ">. Expected variable description and file name.";
                 return false;
@@ -539,7 +554,7 @@ bool readSectionTime(QStringList& data, int& timesetId, int& timesetSteps,
             timesetId = first(tokens).toInt(&ok);
             if (timesetId != 1 || !ok)
             {
-                EnsightObj::ERROR_STR =
+                EnsightObj::errorString() =
                     "[EnsightReader::read()] In line <" + line +
                     ">. Only one <time set> is supported, which must have ID 1.";
                 return false;
@@ -550,7 +565,7 @@ bool readSectionTime(QStringList& data, int& timesetId, int& timesetSteps,
             timesetSteps = line.toInt(&ok);
             if (timesetSteps <= 0 || !ok)
             {
-                EnsightObj::ERROR_STR =
+                EnsightObj::errorString() =
                     "[EnsightReader::read()] In line <" + line +
                     ">: Invalid number of time steps";
                 return false;
@@ -561,8 +576,8 @@ bool readSectionTime(QStringList& data, int& timesetId, int& timesetSteps,
             timesetFilenameStart = line.toInt(&ok);
             if (!ok)
             {
-                EnsightObj::ERROR_STR = "[EnsightReader::read()] In line <" +
-                                        line + ">: Invalid number";
+                EnsightObj::errorString() = "[EnsightReader::read()] In line <" +
+                                            line + ">: Invalid number";
                 return false;
             }
         }
@@ -571,8 +586,8 @@ bool readSectionTime(QStringList& data, int& timesetId, int& timesetSteps,
             timesetFilenameIncrement = line.toInt(&ok);
             if (!ok)
             {
-                EnsightObj::ERROR_STR = "[EnsightReader::read()] In line <" +
-                                        line + ">. Invalid <filename increment>.";
+                EnsightObj::errorString() = "[EnsightReader::read()] In line <" +
+                                            line + ">. Invalid <filename increment>.";
                 return false;
             }
         }
@@ -580,9 +595,9 @@ bool readSectionTime(QStringList& data, int& timesetId, int& timesetSteps,
         {
             if (timesetSteps <= 0)
             {
-                EnsightObj::ERROR_STR = "[EnsightReader::read()] In line <" +
-                                        line + ">: Number of time steps must "
-                                        "be declared before time values.";
+                EnsightObj::errorString() = "[EnsightReader::read()] In line <" +
+                                            line + ">: Number of time steps must "
+                                            "be declared before time values.";
                 return false;
             }
 
@@ -595,7 +610,7 @@ bool readSectionTime(QStringList& data, int& timesetId, int& timesetSteps,
                 {
                     if (j >= timesetSteps)
                     {
-                        EnsightObj::ERROR_STR =
+                        EnsightObj::errorString() =
                             "[EnsightReader::read()] Reading TIME SET values "
                             "at line <" +
                             line + ">. " + "More values found than expected";
@@ -606,7 +621,7 @@ bool readSectionTime(QStringList& data, int& timesetId, int& timesetSteps,
                     timesteps[j++] = strValue.toDouble(&ok);
                     if (!ok)
                     {
-                        EnsightObj::ERROR_STR =
+                        EnsightObj::errorString() =
                             "[EnsightReader::read()] Reading time set values "
                             "at line <" +
                             line + ">. Floating point values expected";
@@ -618,10 +633,10 @@ bool readSectionTime(QStringList& data, int& timesetId, int& timesetSteps,
                     break;
                 else if (data.size() == 0)
                 {
-                    EnsightObj::ERROR_STR = "[EnsightReader::read()] Reading "
-                                            "TIME SET. End of CASE file "
-                                            "reached but more floating point "
-                                            "values expected as time steps.";
+                    EnsightObj::errorString() = "[EnsightReader::read()] Reading "
+                                                "TIME SET. End of CASE file "
+                                                "reached but more floating point "
+                                                "values expected as time steps.";
                     return false;
                 }
 
@@ -634,7 +649,7 @@ bool readSectionTime(QStringList& data, int& timesetId, int& timesetSteps,
     // check that required fiels have been read
     if (timesetId <= 0 || timesetSteps <= 0)
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "[EnsightReader::read()]: Section TIME is incomplete.";
         return false;
     }
@@ -664,7 +679,7 @@ bool readSectionFile(QStringList& data, int& filesetId, int &filesetSteps)
             filesetId = first(tokens).toInt(&ok);
             if (filesetId != 1 || !ok)
             {
-                EnsightObj::ERROR_STR =
+                EnsightObj::errorString() =
                     "[EnsightReader::read()] In line <" + line +
                     ">. Only one <file set> is supported, which must have ID 1.";
                 return false;
@@ -675,7 +690,7 @@ bool readSectionFile(QStringList& data, int& filesetId, int &filesetSteps)
             filesetSteps = line.toInt(&ok);
             if (filesetSteps <= 0 || !ok)
             {
-                EnsightObj::ERROR_STR =
+                EnsightObj::errorString() =
                     "[EnsightReader::read()] In line <" + line +
                     ">: Invalid number of time steps in file set.";
                 return false;
@@ -683,8 +698,8 @@ bool readSectionFile(QStringList& data, int& filesetId, int &filesetSteps)
         }
         else if (keyword == "filename index")
         {
-            EnsightObj::ERROR_STR = "[EnsightReader::read()] In line <" +
-                                    line + ">: filename index is not supported";
+            EnsightObj::errorString() = "[EnsightReader::read()] In line <" +
+                                        line + ">: filename index is not supported";
             return false;
         }
     }
@@ -692,7 +707,7 @@ bool readSectionFile(QStringList& data, int& filesetId, int &filesetSteps)
     // check that required fiels have been read
     if (filesetId <= 0 || filesetSteps <= 0)
     {
-        EnsightObj::ERROR_STR =
+        EnsightObj::errorString() =
             "[EnsightReader::read()]: Section FILE is incomplete.";
         return false;
     }
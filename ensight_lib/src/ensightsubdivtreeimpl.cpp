@@ -23,18 +23,88 @@
 
 #include "../include/ensightsubdivtreeimpl.h"
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
 
 #include "../include/ensightbarycentriccoordinates.h"
 #include "../include/ensightcell.h"
+#include "../include/ensightincidence.h"
+#include "../include/ensightmemoryreport.h"
+#include "../include/ensightparallel.h"
 #include "../include/ensightpart.h"
 
 
+namespace
+{
+
+// Number of closest vertices whose cells are candidates in searchNearest()
+const int numNearestVertices = 8;
+
+// Number of cells of a node partitioned into its children by one task while
+// building the tree
+const size_t partitionChunkSize = 16384;
+
+// Spreads the lower 21 bits of x so that there are two zero bits between each
+uint64_t spreadBits(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8) & 0x100f00f00f00f00fULL;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2) & 0x1249249249249249ULL;
+    return x;
+}
+
+}
+
+
 // **** interface class EnsightSubdivTree ****
-EnsightSubdivTree::EnsightSubdivTree() = default;
+EnsightSubdivTree::EnsightSubdivTree(bool ignore2dCells)
+    : cells_(), vertexTree_(), ignore2dCells_(ignore2dCells), isShared_(false)
+{
+}
+
 EnsightSubdivTree::~EnsightSubdivTree() = default;
 
+void EnsightSubdivTree::writeBlock(std::ostream& out, const void* data, size_t bytes)
+{
+    const char padding[8] = {0};
+    out.write(static_cast<const char*>(data), bytes);
+    out.write(padding, (8 - bytes % 8) % 8);
+}
+
+bool EnsightSubdivTree::readBlock(std::istream& in, void* data, size_t bytes)
+{
+    char padding[8];
+    in.read(static_cast<char*>(data), bytes);
+    in.read(padding, (8 - bytes % 8) % 8);
+    return static_cast<bool>(in);
+}
+
+bool EnsightSubdivTree::hasBlocks(std::istream& in, std::initializer_list<uint64_t> sizes)
+{
+    uint64_t bytes = 0;
+    for (uint64_t size : sizes)
+    {
+        if (size > std::numeric_limits<uint64_t>::max() / 2 - bytes)
+            return false;
+        bytes += size + (8 - size % 8) % 8;
+    }
+
+    const std::istream::pos_type pos = in.tellg();
+    if (pos == std::istream::pos_type(-1))
+        return false;
+    in.seekg(0, std::ios::end);
+    const std::istream::pos_type end = in.tellg();
+    in.seekg(pos);
+    return in && end >= pos && static_cast<uint64_t>(end - pos) >= bytes;
+}
+
 
 EnsightCellIdentifier* EnsightSubdivTree::search(const Vec3 &pos) const
 {
@@ -42,259 +112,631 @@ EnsightCellIdentifier* EnsightSubdivTree::search(const Vec3 &pos) const
     return search(pos, baryCoords);
 }
 
+EnsightCellIdentifier* EnsightSubdivTree::search(const Vec3& pos,
+                                                 EnsightBarycentricCoordinates& baryCoordOut,
+                                                 const EnsightCellIdentifier* hint,
+                                                 int maxSteps) const
+{
+    EnsightCellRecords::Index cell;
+    if (hint && cells_.find(hint, cell))
+    {
+        // Walk towards pos, testing one cell per step. Stepping back to the
+        // previous cell means pos lies between the cells.
+        EnsightCellRecords::Index previous = cell;
+        for (int step = 0; step <= maxSteps; step++)
+        {
+            if (cells_.contains(cell, pos, baryCoordOut, ignore2dCells_))
+                return cells_.getIdentifier(cell);
+            EnsightCellRecords::Index next;
+            if (step == maxSteps || !cells_.findNeighborTowards(cell, pos, next) || next == previous)
+                break;
+            previous = cell;
+            cell = next;
+        }
+    }
+    return search(pos, baryCoordOut);
+}
+
+QVector<EnsightCellIdentifier*> EnsightSubdivTree::search(
+    const Eigen::Ref<const Matx>& positions,
+    QVector<EnsightBarycentricCoordinates>& baryCoordsOut) const
+{
+    Q_ASSERT(positions.rows() == 3);
+    const int numPositions = static_cast<int>(positions.cols());
+
+    // Sort the positions by the Morton code of their coordinates relative to
+    // the tree bounds, quantized to 21 bits per axis
+    const Bbox bounds = getBounds();
+    const Vec3 min = bounds.minCorner();
+    Vec3 scale = bounds.diagonal();
+    for (int d = 0; d < 3; d++)
+        scale[d] = scale[d] > 0.0 ? ((1 << 21) - 1) / scale[d] : 0.0;
+
+    std::vector<std::pair<uint64_t, int>> order(numPositions);
+    Ensight::Parallel::parallelFor(0, numPositions, 4096, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+        {
+            uint64_t code = 0;
+            for (int d = 0; d < 3; d++)
+            {
+                double q = (positions(d, i) - min[d]) * scale[d];
+                q = std::max(0.0, std::min(q, double((1 << 21) - 1)));
+                code |= spreadBits(static_cast<uint64_t>(q)) << d;
+            }
+            order[i] = std::make_pair(code, static_cast<int>(i));
+        }
+    });
+    std::sort(order.begin(), order.end());
+
+    QVector<EnsightCellIdentifier*> cells(numPositions);
+    baryCoordsOut = QVector<EnsightBarycentricCoordinates>(numPositions);
+    EnsightCellIdentifier** cellData = cells.data();
+    EnsightBarycentricCoordinates* baryCoordData = baryCoordsOut.data();
+    Ensight::Parallel::parallelFor(0, numPositions, 256, [&](int64_t first, int64_t last) {
+        for (int64_t k = first; k < last; k++)
+        {
+            const int i = order[k].second;
+            cellData[i] = search(Vec3(positions.col(i)), baryCoordData[i]);
+        }
+    });
+    return cells;
+}
+
+EnsightCellIdentifier* EnsightSubdivTree::searchNearest(const Vec3& pos,
+                                                        EnsightBarycentricCoordinates& baryCoordOut,
+                                                        double& distanceOut) const
+{
+    EnsightCellIdentifier* cell = search(pos, baryCoordOut);
+    if (cell)
+    {
+        distanceOut = 0.0;
+        return cell;
+    }
+
+    // The cells of the closest vertices bound the distance, the tree then
+    // finds all closer cells. Then compute the coordinates into baryCoordOut.
+    double minDistance = std::numeric_limits<double>::infinity();
+    EnsightCellRecords::Index nearest = 0;
+    for (const EnsightKdTree::Neighbor& neighbor : vertexTree_.findNearest(pos, numNearestVertices))
+    {
+        const EnsightVertexIncidence& incidence = neighbor.part->getVertexIncidence(neighbor.timestep);
+        const EnsightVertexIncidence::Entry* entries = incidence.getCells(neighbor.vertex);
+        for (int i = 0; i < incidence.getCellCount(neighbor.vertex); i++)
+        {
+            EnsightCellRecords::Index candidate;
+            if (cells_.find(neighbor.part, entries[i].cellList, entries[i].cell, candidate))
+                testNearestCell(candidate, pos, minDistance, nearest);
+        }
+    }
+    findNearestCell(pos, minDistance, nearest);
+    distanceOut = minDistance;
+    if (minDistance == std::numeric_limits<double>::infinity())
+        return nullptr;
+    cells_.project(nearest, pos, baryCoordOut);
+    return cells_.getIdentifier(nearest);
+}
+
+QVector<EnsightCellIdentifier*> EnsightSubdivTree::searchNearest(
+    const Eigen::Ref<const Matx>& positions,
+    QVector<EnsightBarycentricCoordinates>& baryCoordsOut,
+    QVector<double>& distancesOut) const
+{
+    Q_ASSERT(positions.rows() == 3);
+    const int numPositions = static_cast<int>(positions.cols());
+
+    QVector<EnsightCellIdentifier*> cells(numPositions);
+    baryCoordsOut = QVector<EnsightBarycentricCoordinates>(numPositions);
+    distancesOut = QVector<double>(numPositions);
+    EnsightCellIdentifier** cellData = cells.data();
+    EnsightBarycentricCoordinates* baryCoordData = baryCoordsOut.data();
+    double* distanceData = distancesOut.data();
+    Ensight::Parallel::parallelFor(0, numPositions, 256, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            cellData[i] = searchNearest(Vec3(positions.col(i)), baryCoordData[i], distanceData[i]);
+    });
+    return cells;
+}
+
+const EnsightKdTree& EnsightSubdivTree::getVertexTree() const
+{
+    return vertexTree_;
+}
 
+void EnsightSubdivTree::testNearestCell(EnsightCellRecords::Index cell, const Vec3& pos,
+                                        double& minDistance, EnsightCellRecords::Index& nearest) const
+{
+    if (cells_.boundsSquaredDistance(cell, pos) > minDistance * minDistance)
+        return;
+    if (ignore2dCells_ && cells_.is2dCell(cell))
+        return;
+
+    const double distance = cells_.getDistance(cell, pos);
+    if (distance < minDistance)
+    {
+        minDistance = distance;
+        nearest = cell;
+    }
+}
 
 // **** template class SubdivTreeImpl ****
 template <typename Node>
 SubdivTreeImpl<Node>::SubdivTreeImpl(Bbox bounds, int maxLevel, int maxCells)
-    : root_(new Node(bounds)), allCells_(), maxLevel_(maxLevel),
-      maxCells_(maxCells)
+    : EnsightSubdivTree(Node::ignore2dCells), bounds_(bounds), layout_(),
+      maxLevel_(maxLevel), maxCells_(maxCells)
 {
 }
 
 template <typename Node>
-SubdivTreeImpl<Node>::~SubdivTreeImpl()
-{
-    for (auto c : allCells_)
-        delete c;
-}
+SubdivTreeImpl<Node>::~SubdivTreeImpl() = default;
 
 template <typename Node>
 EnsightCellIdentifier* SubdivTreeImpl<Node>::search(
     const Vec3& pos, EnsightBarycentricCoordinates& baryCoordOut) const
 {
-    ptrdiff_t idx = root_->search(pos, baryCoordOut, allCells_);
-    if (idx < 0)
-        return nullptr;
-    return allCells_[idx];
+    const Layout& layout = getLayout();
+
+    // Descend to the leaf containing pos
+    const LinearNode* node = &layout.nodes[0];
+    Bbox bounds = bounds_;
+    while (node->count == InnerNode)
+    {
+        const int child = Node::findChild(pos, bounds.center());
+        bounds = Node::boundsForSubNode(bounds, child);
+        node = &layout.nodes[node->first + child];
+    }
+
+    // Note: the promotion from Index (unsigned 32 bit) to ptrdiff_t
+    // (signed 64 bit) is intentional. The compiler may be able to generate
+    // better code because it can assume that no overflow is allowed.
+    //
+    // The quantized bounding boxes select the candidates, the exact test is
+    // only done for them, in the order of the leaf.
+    const ptrdiff_t end = static_cast<ptrdiff_t>(node->first) + node->count;
+    Index survivors[EnsightLeafBounds::ChunkSize];
+    for (ptrdiff_t k = node->first; k < end; k += EnsightLeafBounds::ChunkSize)
+    {
+        const int count = static_cast<int>(std::min<ptrdiff_t>(EnsightLeafBounds::ChunkSize, end - k));
+        const int numSurvivors = layout.leafBounds.filter(k, count, bounds, pos,
+                                                          layout.leafCells.data() + k, survivors);
+        for (int i = 0; i < numSurvivors; i++)
+        {
+            if (cells_.contains(survivors[i], pos, baryCoordOut, Node::ignore2dCells))
+                return cells_.getIdentifier(survivors[i]);
+        }
+    }
+    return nullptr;
 }
 
 template <typename Node>
 QList<EnsightCellIdentifier*> SubdivTreeImpl<Node>::searchAll(const Vec3& pos) const
 {
-    auto indices = root_->searchAll(pos, allCells_);
-    QList<EnsightCellIdentifier*> results;
-    for (ptrdiff_t idx : indices)
-        results.push_back(allCells_[idx]);
-    return results;
-}
+    const Layout& layout = getLayout();
 
-template <typename Node>
-void SubdivTreeImpl<Node>::insert(EnsightPart* part, int timestep, double sizeOffset)
-{
-    QList<EnsightCellList*> cells = part->getCells(timestep);
+    const LinearNode* node = &layout.nodes[0];
+    Bbox bounds = bounds_;
+    while (node->count == InnerNode)
+    {
+        const int child = Node::findChild(pos, bounds.center());
+        bounds = Node::boundsForSubNode(bounds, child);
+        node = &layout.nodes[node->first + child];
+    }
 
-    for (auto cellList : cells)
+    QList<EnsightCellIdentifier*> results;
+    const ptrdiff_t end = static_cast<ptrdiff_t>(node->first) + node->count;
+    Index survivors[EnsightLeafBounds::ChunkSize];
+    for (ptrdiff_t k = node->first; k < end; k += EnsightLeafBounds::ChunkSize)
     {
-        Mati cellsi = cellList->getValues();
-        for (int k = 0; k < cellsi.cols(); k++)
+        const int count = static_cast<int>(std::min<ptrdiff_t>(EnsightLeafBounds::ChunkSize, end - k));
+        const int numSurvivors = layout.leafBounds.filter(k, count, bounds, pos,
+                                                          layout.leafCells.data() + k, survivors);
+        for (int i = 0; i < numSurvivors; i++)
         {
-            Veci cell = cellsi.col(k);
-            Bbox bounds = part->getCellBounds(cell, timestep);
-            bounds.increaseBy(sizeOffset);
-            auto idx = static_cast<Index>(allCells_.size());
-            Q_ASSERT((size_t) idx < (size_t) std::numeric_limits<Index>::max());
-
-            auto cellId = new EnsightCellIdentifier(part, cellList, timestep, k, bounds);
-            allCells_.push_back(cellId);
-            root_->insert(idx, allCells_, maxLevel_, maxCells_, 0);
+            if (cells_.boundsContain(survivors[i], pos))
+                results.push_back(cells_.getIdentifier(survivors[i]));
         }
     }
+    return results;
 }
 
 template <typename Node>
-Bbox SubdivTreeImpl<Node>::getBounds() const
+void SubdivTreeImpl<Node>::insert(EnsightPart* part, int timestep, double sizeOffset)
 {
-    return root_->getBounds();
+    cells_.append(part, timestep, sizeOffset);
+    vertexTree_.insert(part, timestep);
+
+    // The layout is rebuilt from all cells by build() or the next query
+    layout_.reset();
 }
 
 template <typename Node>
-const Node& SubdivTreeImpl<Node>::getRoot() const
+void SubdivTreeImpl<Node>::build()
 {
-    return *root_;
+    getLayout();
 }
 
-
-
-// **** template class NodeBase ****
-
-template <int N, typename Derived>
-NodeBase<N, Derived>::NodeBase() = default;
-
-template <int N, typename Derived>
-NodeBase<N, Derived>::NodeBase(Bbox bounds) : children_(), cells_(), bounds_(bounds)
+template <typename Node>
+bool SubdivTreeImpl<Node>::refit(const EnsightSubdivTree&)
 {
+    return false;
 }
 
-template <int N, typename Derived>
-const Bbox& NodeBase<N, Derived>::getBounds() const
+template <typename Node>
+std::shared_ptr<EnsightSubdivTree> SubdivTreeImpl<Node>::share(int timestep) const
 {
-    return bounds_;
+    auto tree = std::make_shared<SubdivTreeImpl<Node>>(bounds_, maxLevel_, maxCells_);
+    tree->cells_.share(cells_, timestep);
+    tree->vertexTree_.share(vertexTree_, timestep);
+    tree->layout_.share(layout_);
+    tree->isShared_ = true;
+    return tree;
 }
 
-template <int N, typename Derived>
-void NodeBase<N, Derived>::setBounds(Bbox bounds)
+template <typename Node>
+bool SubdivTreeImpl<Node>::write(std::ostream& out) const
 {
-    bounds_ = bounds;
+    const Layout& layout = getLayout();
+    const Vec3& min = bounds_.minCorner();
+    const Vec3& max = bounds_.maxCorner();
+    const double bounds[6] = {min[0], min[1], min[2], max[0], max[1], max[2]};
+    const uint64_t sizes[5] = {static_cast<uint64_t>(maxLevel_), static_cast<uint64_t>(maxCells_),
+                               cells_.size(), layout.nodes.size(),
+                               static_cast<uint64_t>(layout.leafCells.size())};
+    writeBlock(out, bounds, sizeof(bounds));
+    writeBlock(out, sizes, sizeof(sizes));
+    writeBlock(out, layout.nodes.data(), layout.nodes.size() * sizeof(LinearNode));
+    writeBlock(out, layout.leafCells.data(), layout.leafCells.size() * sizeof(Index));
+    return static_cast<bool>(out);
 }
 
-template <int N, typename Derived>
-bool NodeBase<N, Derived>::hasChildren() const
+template <typename Node>
+bool SubdivTreeImpl<Node>::read(std::istream& in)
 {
-    return children_ != nullptr;
+    double bounds[6];
+    uint64_t sizes[5];
+    if (!readBlock(in, bounds, sizeof(bounds)) || !readBlock(in, sizes, sizeof(sizes)))
+        return false;
+    const Vec3& min = bounds_.minCorner();
+    const Vec3& max = bounds_.maxCorner();
+    if (bounds[0] != min[0] || bounds[1] != min[1] || bounds[2] != min[2] ||
+        bounds[3] != max[0] || bounds[4] != max[1] || bounds[5] != max[2])
+        return false;
+    const uint64_t numCells = cells_.size();
+    const uint64_t numNodes = sizes[3];
+    const uint64_t numLeafCells = sizes[4];
+    if (sizes[0] != static_cast<uint64_t>(maxLevel_) || sizes[1] != static_cast<uint64_t>(maxCells_) ||
+        sizes[2] != numCells || numNodes == 0 || numNodes >= InnerNode || numLeafCells >= InnerNode ||
+        !hasBlocks(in, {numNodes * sizeof(LinearNode), numLeafCells * sizeof(Index)}))
+        return false;
+
+    Layout layout;
+    layout.nodes.resize(numNodes);
+    layout.leafCells.resize(numLeafCells);
+    if (!readBlock(in, layout.nodes.data(), numNodes * sizeof(LinearNode)) ||
+        !readBlock(in, layout.leafCells.data(), numLeafCells * sizeof(Index)))
+        return false;
+
+    // Children follow their parent, so every descent ends in a leaf
+    for (uint64_t i = 0; i < numNodes; i++)
+    {
+        const LinearNode& node = layout.nodes[i];
+        if (node.count == InnerNode ? node.first <= i || uint64_t(node.first) + Node::N > numNodes
+                                    : uint64_t(node.first) + node.count > numLeafCells)
+            return false;
+    }
+    for (Index cellIdx : layout.leafCells)
+    {
+        if (cellIdx >= numCells)
+            return false;
+    }
+
+    quantizeLeafBounds(layout);
+    layout_.reset();
+    layout_.get([&layout]() { return std::move(layout); });
+    return true;
 }
 
-template <int N, typename Derived>
-const typename NodeBase<N, Derived>::Children& NodeBase<N, Derived>::getChildren() const
+template <typename Node>
+Bbox SubdivTreeImpl<Node>::getBounds() const
 {
-    return children_;
+    return bounds_;
 }
 
-template <int N, typename Derived>
-ptrdiff_t NodeBase<N, Derived>::search(const Vec3& pos,
-                                       EnsightBarycentricCoordinates& baryCoordOut,
-                                       const CellContainer& cells) const
+template <typename Node>
+void SubdivTreeImpl<Node>::addMemoryUsage(EnsightMemoryReport& report) const
 {
-    if (!hasChildren())
+    const Layout& layout = getLayout();
+    int64_t nodeBytes = layout.nodes.capacity() * sizeof(LinearNode);
+    int64_t indexBytes = layout.leafCells.capacity() * sizeof(Index);
+    int64_t leafBoundsBytes = layout.leafBounds.getBytes();
+
+    int64_t recordBytes = cells_.getRecordBytes();
+    int64_t vertexTreeBytes = vertexTree_.getBytes();
+    int64_t identifierBytes = cells_.getIdentifierBytes();
+    if (isShared_)
     {
-        // Note: the promotion from Index (unsigned 32 bit) to ptrdiff_t
-        // (signed 64 bit) is intentional. The compiler may be able to generate
-        // better code because it can assume that no overflow is allowed.
-        for (ptrdiff_t idx : cells_)
-        {
-            auto cell = cells[idx];
-            if (cell->contains(pos, baryCoordOut, Derived::ignore2dCells))
-                return idx;
-        }
-        return -1;
+        // Counted with the tree this one was shared from
+        nodeBytes = indexBytes = leafBoundsBytes = recordBytes = vertexTreeBytes = 0;
     }
 
-    auto self = static_cast<const Derived*>(this);
-    return self->findChild(pos, bounds_.center())->search(pos, baryCoordOut, cells);
+    report.subdivTreeBytes += nodeBytes + indexBytes + leafBoundsBytes + recordBytes + vertexTreeBytes
+            + identifierBytes;
+    report.addEntry(std::string(), -1, "subdivtree", "nodes", nodeBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "leaf indices", indexBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "leaf bounds", leafBoundsBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "cell records", recordBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "vertex tree", vertexTreeBytes, false);
+    report.addEntry(std::string(), -1, "subdivtree", "cell identifiers", identifierBytes, false);
 }
 
-template <int N, typename Derived>
-QList<ptrdiff_t> NodeBase<N, Derived>::searchAll(const Vec3& pos,
-                                                 const CellContainer& cells) const
+template <typename Node>
+int SubdivTreeImpl<Node>::getNumberOfNodes() const
 {
-    if (!hasChildren())
+    return static_cast<int>(getLayout().nodes.size());
+}
+
+template <typename Node>
+QVector<Bbox> SubdivTreeImpl<Node>::getLeafBounds() const
+{
+    const Layout& layout = getLayout();
+
+    // Breadth-first traversal, in the order the nodes are stored
+    QVector<Bbox> bounds(static_cast<int>(layout.nodes.size()));
+    QVector<Bbox> leafBounds;
+    bounds[0] = bounds_;
+    for (size_t i = 0; i < layout.nodes.size(); i++)
     {
-        QList<ptrdiff_t> results;
-        for (ptrdiff_t idx : cells_)
+        const LinearNode& node = layout.nodes[i];
+        if (node.count != InnerNode)
         {
-            Q_ASSERT(idx >= 0 && idx < static_cast<ptrdiff_t>(cells.size()));
-            auto id = cells[idx];
-            Q_ASSERT(id != nullptr);
-            if (id->getBounds().contains(pos))
-                results << idx;
+            leafBounds.push_back(bounds[i]);
+            continue;
         }
-        return results;
+        for (int child = 0; child < Node::N; child++)
+            bounds[node.first + child] = Node::boundsForSubNode(bounds[i], child);
     }
-
-    auto self = static_cast<const Derived*>(this);
-    return self->findChild(pos, bounds_.center())->searchAll(pos, cells);
+    return leafBounds;
 }
 
-template <int N, typename Derived>
-void NodeBase<N, Derived>::insert(Index cellIdx, const CellContainer& cells,
-                                   int maxLevel, int maxCells, int level)
+template <typename Node>
+void SubdivTreeImpl<Node>::findNearestCell(const Vec3& pos, double& minDistance, Index& nearest) const
 {
-    if ((cells_.size() < maxCells || level == maxLevel) && !hasChildren())
+    const Layout& layout = getLayout();
+
+    // Depth-first traversal of the nodes closer than minDistance, the closest
+    // child first. A cell is stored in every leaf its bounding box intersects,
+    // so it is found in the leaf containing its closest point.
+    struct Entry
     {
-        cells_.push_back(cellIdx);
-    }
-    else
+        Index node;
+        double distSq;
+        Bbox bounds;
+    };
+    std::vector<Entry> stack;
+    stack.push_back(Entry{0, bounds_.squaredDistance(pos), bounds_});
+    while (!stack.empty())
     {
-        // Split node into N subnodes and distribute the cells into these subnodes
-        if (!hasChildren())
+        const Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.distSq > minDistance * minDistance)
+            continue;
+
+        const LinearNode& node = layout.nodes[entry.node];
+        if (node.count != InnerNode)
         {
-            // allocate children and distribute existing cells
-            allocateChildren();
-            distributeCellsToChildren(cells, maxLevel, maxCells, level);
+            const ptrdiff_t end = static_cast<ptrdiff_t>(node.first) + node.count;
+            for (ptrdiff_t k = node.first; k < end; k++)
+                testNearestCell(layout.leafCells[k], pos, minDistance, nearest);
+            continue;
         }
 
-        // Insert in a child cell
-        auto id = cells[cellIdx];
-        for (auto& child : *children_)
+        std::array<Entry, Node::N> children;
+        for (int child = 0; child < Node::N; child++)
         {
-            if (child.cellIntersects(id))
-            {
-                child.insert(cellIdx, cells, maxLevel, maxCells, level+1);
-            }
+            const Bbox bounds = Node::boundsForSubNode(entry.bounds, child);
+            children[child] = Entry{node.first + child, bounds.squaredDistance(pos), bounds};
         }
+        std::sort(children.begin(), children.end(), [](const Entry& a, const Entry& b) {
+            return a.distSq > b.distSq;
+        });
+        stack.insert(stack.end(), children.begin(), children.end());
     }
 }
 
-template <int N, typename Derived>
-Bbox NodeBase<N, Derived>::boundsForSubNode(int SubNode) const
+template <typename Node>
+const typename SubdivTreeImpl<Node>::Layout& SubdivTreeImpl<Node>::getLayout() const
 {
-    auto self = static_cast<const Derived*>(this);
-    return self->boundsForSubNode(SubNode);
+    return layout_.get([this]() { return buildLayout(); });
 }
 
-template <int N, typename Derived>
-void NodeBase<N, Derived>::allocateChildren()
+template <typename Node>
+typename SubdivTreeImpl<Node>::Layout SubdivTreeImpl<Node>::buildLayout() const
 {
-    assert(!hasChildren());
-    children_.reset(new std::array<Derived, N>());
-    for (int i = 0; i < N; i++)
+    // A node is split if more than maxCells cells intersect it and the
+    // maximum level is not reached. The cells of a node are kept in insertion
+    // order, so the result is the same as inserting the cells one by one.
+    //
+    // The tree is built level by level. The cells of all children of a level
+    // are partitioned in parallel, the node and leaf offsets are then assigned
+    // in breadth-first order, independent of the number of threads.
+    struct Pending
+    {
+        Bbox bounds;
+        IndexContainer cells;
+    };
+
+    Layout layout;
+    layout.nodes.push_back(LinearNode{0, 0});
+
+    std::vector<Pending> level(1);
+    level[0].bounds = bounds_;
+    level[0].cells.resize(cells_.size());
+    std::iota(level[0].cells.begin(), level[0].cells.end(), Index(0));
+
+    Index levelBegin = 0;  // index of the first node of the level
+    for (int depth = 0; !level.empty(); depth++)
     {
-        (*children_)[i].setBounds(boundsForSubNode(i));
+        // Assign the children and leaf cell offsets of the nodes of this level
+        std::vector<size_t> splitNodes;
+        std::vector<int64_t> leafOffsets(level.size(), -1);
+        int64_t numLeafCells = static_cast<int64_t>(layout.leafCells.size());
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            LinearNode& node = layout.nodes[levelBegin + i];
+            if (level[i].cells.size() <= static_cast<size_t>(maxCells_) || depth >= maxLevel_)
+            {
+                leafOffsets[i] = numLeafCells;
+                node.first = static_cast<Index>(numLeafCells);
+                node.count = static_cast<Index>(level[i].cells.size());
+                numLeafCells += static_cast<int64_t>(level[i].cells.size());
+            }
+            else
+            {
+                node.first = static_cast<Index>(layout.nodes.size() + splitNodes.size() * Node::N);
+                node.count = InnerNode;
+                splitNodes.push_back(i);
+            }
+        }
+        Q_ASSERT(layout.nodes.size() + splitNodes.size() * Node::N < (size_t) InnerNode);
+        Q_ASSERT(numLeafCells < (int64_t) InnerNode);
+
+        // Copy the cells of the leaves and their quantized bounding boxes
+        layout.leafCells.resize(numLeafCells);
+        layout.leafBounds.resize(numLeafCells);
+        Index* leafCells = layout.leafCells.data();
+        Ensight::Parallel::parallelFor(0, level.size(), 64, [&](int64_t first, int64_t last) {
+            for (int64_t i = first; i < last; i++)
+            {
+                if (leafOffsets[i] >= 0)
+                {
+                    const IndexContainer& cells = level[i].cells;
+                    std::copy(cells.begin(), cells.end(), leafCells + leafOffsets[i]);
+                    layout.leafBounds.set(leafOffsets[i], static_cast<int>(cells.size()), level[i].bounds,
+                                          cells.data(), cells_);
+                }
+            }
+        });
+
+        // Partition the cells of the split nodes into their children. The cells
+        // of a node are split into chunks which are partitioned in parallel,
+        // so the first levels with only a few nodes use all threads as well.
+        // The chunks of a child are then concatenated in order.
+        std::vector<Pending> next(splitNodes.size() * Node::N);
+        std::vector<size_t> firstChunk(splitNodes.size() + 1, 0);
+        for (size_t s = 0; s < splitNodes.size(); s++)
+        {
+            const Pending& parent = level[splitNodes[s]];
+            for (int child = 0; child < Node::N; child++)
+                next[s * Node::N + child].bounds = Node::boundsForSubNode(parent.bounds, child);
+            const size_t numChunks = (parent.cells.size() + partitionChunkSize - 1) / partitionChunkSize;
+            firstChunk[s + 1] = firstChunk[s] + numChunks;
+        }
+
+        std::vector<IndexContainer> chunkCells(firstChunk.back() * Node::N);
+        Ensight::Parallel::parallelFor(0, firstChunk.back(), 1, [&](int64_t first, int64_t last) {
+            for (int64_t chunk = first; chunk < last; chunk++)
+            {
+                const size_t s = std::upper_bound(firstChunk.begin(), firstChunk.end(), static_cast<size_t>(chunk))
+                        - firstChunk.begin() - 1;
+                const IndexContainer& cells = level[splitNodes[s]].cells;
+                const size_t begin = (chunk - firstChunk[s]) * partitionChunkSize;
+                const size_t end = std::min(begin + partitionChunkSize, cells.size());
+                const Pending* children = &next[s * Node::N];
+                IndexContainer* out = &chunkCells[chunk * Node::N];
+                for (size_t k = begin; k < end; k++)
+                {
+                    for (int child = 0; child < Node::N; child++)
+                    {
+                        if (cellIntersects(cells[k], children[child].bounds))
+                            out[child].push_back(cells[k]);
+                    }
+                }
+            }
+        });
+        level.clear();
+
+        Ensight::Parallel::parallelFor(0, next.size(), 1, [&](int64_t first, int64_t last) {
+            for (int64_t c = first; c < last; c++)
+            {
+                const size_t s = c / Node::N;
+                const int child = c % Node::N;
+                size_t count = 0;
+                for (size_t chunk = firstChunk[s]; chunk < firstChunk[s + 1]; chunk++)
+                    count += chunkCells[chunk * Node::N + child].size();
+                IndexContainer& cells = next[c].cells;
+                cells.reserve(count);
+                for (size_t chunk = firstChunk[s]; chunk < firstChunk[s + 1]; chunk++)
+                {
+                    IndexContainer& part = chunkCells[chunk * Node::N + child];
+                    cells.insert(cells.end(), part.begin(), part.end());
+                    IndexContainer().swap(part);
+                }
+            }
+        });
+
+        levelBegin = static_cast<Index>(layout.nodes.size());
+        layout.nodes.resize(layout.nodes.size() + next.size(), LinearNode{0, 0});
+        level.swap(next);
     }
+
+    layout.nodes.shrink_to_fit();
+    layout.leafCells.shrink_to_fit();
+    layout.leafBounds.squeeze();
+    return layout;
 }
 
-template <int N, typename Derived>
-void NodeBase<N, Derived>::distributeCellsToChildren(const CellContainer& cells,
-                                                     int maxLevel, int maxCells,
-                                                     int level)
+template <typename Node>
+void SubdivTreeImpl<Node>::quantizeLeafBounds(Layout& layout) const
 {
-    assert(hasChildren());
-    for (auto& child : *children_)
+    // The node bounds in the breadth-first order of the nodes
+    std::vector<Bbox> bounds(layout.nodes.size());
+    bounds[0] = bounds_;
+    for (size_t i = 0; i < layout.nodes.size(); i++)
     {
-        // Insert existing cell identifiers
-        for (auto cellIdx : cells_)
+        const LinearNode& node = layout.nodes[i];
+        if (node.count == InnerNode)
         {
-            auto cell = cells[cellIdx];
-            if (child.cellIntersects(cell))
-                child.insert(cellIdx, cells, maxLevel, maxCells, level+1);
+            for (int child = 0; child < Node::N; child++)
+                bounds[node.first + child] = Node::boundsForSubNode(bounds[i], child);
         }
     }
-    cells_.clear();
+
+    layout.leafBounds.resize(layout.leafCells.size());
+    Ensight::Parallel::parallelFor(0, layout.nodes.size(), 64, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+        {
+            const LinearNode& node = layout.nodes[i];
+            if (node.count != InnerNode)
+            {
+                layout.leafBounds.set(node.first, static_cast<int>(node.count), bounds[i],
+                                      layout.leafCells.data() + node.first, cells_);
+            }
+        }
+    });
 }
 
-template <int N, typename Derived>
-bool NodeBase<N, Derived>::cellIntersects(EnsightCellIdentifier* c) const
+template <typename Node>
+bool SubdivTreeImpl<Node>::cellIntersects(Index cellIdx, const Bbox& bounds) const
 {
-    return c->getBounds().intersects(bounds_);
+    return cells_.boundsIntersect(cellIdx, bounds);
 }
 
 
-const QuadtreeNode* QuadtreeNode::findChild(const Vec3& pos, const Vec3& mid) const
+
+// **** Actual Quad-/OctreeNode classes
+int QuadtreeNode::findChild(const Vec3& pos, const Vec3& mid)
 {
     // Find child which contains pos
-    const QuadtreeNode* child;
-    if (pos[0] < mid[0])  // children 01
-    {
-        if (pos[1] < mid[1])
-            child = &(*getChildren())[0];
-        else
-            child = &(*getChildren())[1];
-    }
-    else  // children 23
-    {
-        if (pos[1] < mid[1])
-            child = &(*getChildren())[2];
-        else
-            child = &(*getChildren())[3];
-    }
+    int child = pos[0] < mid[0] ? 0 : 2;  // children 01 or 23
+    if (!(pos[1] < mid[1]))
+        child += 1;
     return child;
 }
 
-Bbox QuadtreeNode::boundsForSubNode(int subNode) const
+Bbox QuadtreeNode::boundsForSubNode(const Bbox& bounds, int subNode)
 {
     // Determine bounds on information of parent bounds and quadrant number
-    Vec3 min = getBounds().minCorner();
-    Vec3 max = getBounds().maxCorner();
+    Vec3 min = bounds.minCorner();
+    Vec3 max = bounds.maxCorner();
     Vec3 len = (max - min) / 2.;
 
     switch (subNode)
@@ -309,52 +751,22 @@ Bbox QuadtreeNode::boundsForSubNode(int subNode) const
 }
 
 
-const OctreeNode* OctreeNode::findChild(const Vec3& pos, const Vec3& mid) const
+int OctreeNode::findChild(const Vec3& pos, const Vec3& mid)
 {
     // Find child which contains pos
-    const OctreeNode* child;
-    if (pos[0] < mid[0])  // children 0123
-    {
-        if (pos[1] < mid[1])  // children 01
-        {
-            if (pos[2] < mid[2])
-                child = &(*getChildren())[0];
-            else
-                child = &(*getChildren())[1];
-        }
-        else  // children 23
-        {
-            if (pos[2] < mid[2])
-                child = &(*getChildren())[2];
-            else
-                child = &(*getChildren())[3];
-        }
-    }
-    else  // children 4567
-    {
-        if (pos[1] < mid[1])  // children 45
-        {
-            if (pos[2] < mid[2])
-                child = &(*getChildren())[4];
-            else
-                child = &(*getChildren())[5];
-        }
-        else  // children 67
-        {
-            if (pos[2] < mid[2])
-                child = &(*getChildren())[6];
-            else
-                child = &(*getChildren())[7];
-        }
-    }
+    int child = pos[0] < mid[0] ? 0 : 4;  // children 0123 or 4567
+    if (!(pos[1] < mid[1]))
+        child += 2;
+    if (!(pos[2] < mid[2]))
+        child += 1;
     return child;
 }
 
-Bbox OctreeNode::boundsForSubNode(int SubNode) const
+Bbox OctreeNode::boundsForSubNode(const Bbox& bounds, int SubNode)
 {
     // Determine bounds on information of parent bounds and octant number
-    Vec3 min = getBounds().minCorner();
-    Vec3 max = getBounds().maxCorner();
+    Vec3 min = bounds.minCorner();
+    Vec3 max = bounds.maxCorner();
     Vec3 len = (max - min) / 2.;
 
     switch(SubNode)
@@ -372,10 +784,10 @@ Bbox OctreeNode::boundsForSubNode(int SubNode) const
     return Bbox(min, max);
 }
 
+const int OctreeNode::N;
+const int QuadtreeNode::N;
 const bool OctreeNode::ignore2dCells;
 const bool QuadtreeNode::ignore2dCells;
 
-template class NodeBase<4, QuadtreeNode>;
-template class NodeBase<8, OctreeNode>;
 template class SubdivTreeImpl<QuadtreeNode>;
 template class SubdivTreeImpl<OctreeNode>;
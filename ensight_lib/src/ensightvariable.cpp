@@ -23,6 +23,13 @@
 
 #include "../include/ensightvariable.h"
 
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "../include/ensightbufferstore.h"
+
 
 EnsightVariableIdentifier::EnsightVariableIdentifier() :
     name_(), varType_(), dim_(0)
@@ -59,37 +66,149 @@ EnsightVariable::EnsightVariable(const std::string &name, Ensight::VarTypes varT
 {
 }
 
-void EnsightVariable::setValues(const Matx& newValues)
+void EnsightVariable::setValues(const MatxBuffer& newValues)
 {
-    if (newValues.rows() == 3)  // 3d variable
-    {
-        values_ = Matx(4, newValues.cols());
-        values_.block(0, 0, 3, newValues.cols()) = newValues;
+    MatxView input = newValues.view();
+    const double inf = std::numeric_limits<double>::infinity();
 
-        // In the 4th row the magnitude is stored
-        for (int i = 0; i < values_.cols(); i++)
-            values_(3, i) = newValues.col(i).norm();
+    if (input.rows() == 4 && dim_ == 3)
+    {
+        // 3d variable already containing the magnitude. The magnitude row is
+        // checked in the same pass as the bounds; if it does not match x,y,z
+        // the values are not adopted but recomputed from the first three rows.
+        Eigen::Array4d minValues = Eigen::Array4d::Constant(inf);
+        Eigen::Array4d maxValues = Eigen::Array4d::Constant(-inf);
+        bool validMagnitude = true;
+        for (Eigen::Index i = 0; i < input.cols() && validMagnitude; i++)
+        {
+            Eigen::Array4d v = input.col(i).array();
+            double norm = v.head<3>().matrix().norm();
+            validMagnitude = std::abs(v[3] - norm) <= 1e-9 * std::max(1.0, norm);
+            minValues = minValues.min(v);
+            maxValues = maxValues.max(v);
+        }
 
-        bounds_ = Matx(4, 2);
-        bounds_.col(0) = values_.rowwise().minCoeff();
-        bounds_.col(1) = values_.rowwise().maxCoeff();
+        if (validMagnitude)
+        {
+            values_ = newValues;
+            bounds_ = Matx(4, 2);
+            bounds_.col(0) = minValues;
+            bounds_.col(1) = maxValues;
+        }
+        else
+        {
+            setVectorValues(input.topRows(3));
+        }
+    }
+    else if (input.rows() == 3)  // 3d variable
+    {
+        setVectorValues(input);
     }
-    else if (newValues.rows() == 1)  // 1d variable
+    else if (input.rows() == 1)  // 1d variable
     {
-        values_ = Matx(1, newValues.cols());
-        values_.block(0, 0, 1, newValues.cols()) = newValues;
+        double minValue = inf;
+        double maxValue = -inf;
+        const double* data = input.data();
+        for (Eigen::Index i = 0; i < input.cols(); i++)
+        {
+            minValue = std::min(minValue, data[i]);
+            maxValue = std::max(maxValue, data[i]);
+        }
+
+        values_ = newValues;
         bounds_ = Matx(1, 2);
-        bounds_.col(0) = values_.rowwise().minCoeff();
-        bounds_.col(1) = values_.rowwise().maxCoeff();
+        bounds_ << minValue, maxValue;
+    }
+}
+
+void EnsightVariable::setVectorValues(const Eigen::Ref<const Matx>& input)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+
+    // Append the magnitude as 4th row and compute the bounds in the same pass
+    Matx values(4, input.cols());
+    Eigen::Array4d minValues = Eigen::Array4d::Constant(inf);
+    Eigen::Array4d maxValues = Eigen::Array4d::Constant(-inf);
+    for (Eigen::Index i = 0; i < input.cols(); i++)
+    {
+        Eigen::Array4d v;
+        v.head<3>() = input.col(i).head<3>();
+        v[3] = v.head<3>().matrix().norm();
+        values.col(i) = v;
+        minValues = minValues.min(v);
+        maxValues = maxValues.max(v);
+    }
+
+    values_ = std::move(values);
+    bounds_ = Matx(4, 2);
+    bounds_.col(0) = minValues;
+    bounds_.col(1) = maxValues;
+}
+
+void EnsightVariable::mergeBounds(Matx& bounds, const Matx& other)
+{
+    if (other.cols() == 0)
+        return;
+    if (bounds.cols() == 0)
+    {
+        bounds = other;
+        return;
     }
+    bounds.col(0) = bounds.col(0).cwiseMin(other.col(0));
+    bounds.col(1) = bounds.col(1).cwiseMax(other.col(1));
 }
 
-const Matx& EnsightVariable::getValues() const
+void EnsightVariable::shareValues(EnsightBufferStore& store)
 {
-    return values_;
+    values_ = store.intern(values_);
+}
+
+MatxView EnsightVariable::getValues() const
+{
+    return values_.view();
 }
 
 const Matx& EnsightVariable::getBounds() const
 {
     return bounds_;
 }
+
+
+int EnsightVariableRegistry::intern(const QString& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    int handle = handles_.value(name, -1);
+    if (handle >= 0)
+        return handle;
+
+    handle = static_cast<int>(names_.size());
+    handles_.insert(name, handle);
+    stdHandles_.emplace(name.toStdString(), handle);
+    names_.push_back(name);
+    return handle;
+}
+
+int EnsightVariableRegistry::find(const QString& name) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return handles_.value(name, -1);
+}
+
+int EnsightVariableRegistry::find(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = stdHandles_.find(name);
+    return iter != stdHandles_.end() ? iter->second : -1;
+}
+
+const QString& EnsightVariableRegistry::getName(int handle) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return names_[handle];
+}
+
+int EnsightVariableRegistry::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int>(names_.size());
+}
@@ -54,7 +54,7 @@ bool write(EnsightObj* ensight, const QString& filename, bool binary, int timest
 
     if (!(dir.exists() || QDir::root().mkdir(path)))
     {
-        EnsightObj::ERROR_STR = ("ERROR IN [write()] Unable to create directory <" + path + ">");
+        EnsightObj::errorString() = ("ERROR IN [write()] Unable to create directory <" + path + ">");
         return false;
     }
     // Case file is only written in if timestep==0 or timestep==-1
@@ -79,7 +79,7 @@ bool writeCase(EnsightObj* ensight, const QString& name, const QString& filename
     QFile file(filename);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
     {
-        EnsightObj::ERROR_STR = "ERROR IN [writeAsciiCase()] Unable to open file <" + file.fileName() + ">";
+        EnsightObj::errorString() = "ERROR IN [writeAsciiCase()] Unable to open file <" + file.fileName() + ">";
         return false;
     }
 
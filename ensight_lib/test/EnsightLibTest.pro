@@ -21,13 +21,23 @@ QMAKE_CXXFLAGS += -std=c++11
 
 SOURCES += \
     bboxtests.cpp \
+    ensightbuffertests.cpp \
+    ensightcelltests.cpp \
     ensightconstanttests.cpp \
+    ensightobjtests.cpp \
+    ensightparalleltests.cpp \
     ensightvariabletests.cpp \
     ensightreadertests.cpp \
+    ensightsubdivtreetests.cpp \
     main.cpp
 
 HEADERS += \
     bboxtests.h \
+    ensightbuffertests.h \
+    ensightcelltests.h \
     ensightconstanttests.h \
+    ensightobjtests.h \
+    ensightparalleltests.h \
     ensightvariabletests.h \
-    ensightreadertests.h
+    ensightreadertests.h \
+    ensightsubdivtreetests.h
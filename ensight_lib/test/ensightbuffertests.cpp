@@ -0,0 +1,379 @@
+#include "ensightbuffertests.h"
+
+#include <utility>
+#include <vector>
+
+#include "ensightbufferstore.h"
+#include "ensightcell.h"
+#include "ensightlib.h"
+#include "ensightmemoryreport.h"
+#include "ensightobj.h"
+#include "ensightparallel.h"
+#include "ensightpart.h"
+#include "ensightvariable.h"
+
+void EnsightBufferTests::DefaultConstructor_StaticValueAssignment_EmptyBuffer()
+{
+    MatxBuffer testBuffer;
+
+    QVERIFY(testBuffer.isEmpty());
+    QCOMPARE(testBuffer.rows(), Eigen::Index(0));
+    QCOMPARE(testBuffer.cols(), Eigen::Index(0));
+    QCOMPARE(testBuffer.view().size(), Eigen::Index(0));
+}
+
+void EnsightBufferTests::CopyConstructor_ParameterValueAssignment_DataCopied()
+{
+    Matx values(2, 3);
+    values << 1, 2, 3,
+              4, 5, 6;
+
+    MatxBuffer testBuffer(values);
+
+    QVERIFY(testBuffer.data() != values.data());
+    QVERIFY(testBuffer.view() == values);
+}
+
+void EnsightBufferTests::MoveConstructor_ParameterValueAssignment_StorageTakenOver()
+{
+    Mati values(2, 2);
+    values << 1, 2,
+              3, 4;
+    Mati expectedValues = values;
+    const int* storage = values.data();
+
+    MatiBuffer testBuffer(std::move(values));
+
+    QCOMPARE(testBuffer.data(), storage);
+    QVERIFY(testBuffer.view() == expectedValues);
+
+    MatiBuffer sharedBuffer = testBuffer;
+    QVERIFY(sharedBuffer.sharesDataWith(testBuffer));
+}
+
+void EnsightBufferTests::AdoptConstructor_ExternalData_DataNotCopiedAndReleased()
+{
+    double* external = new double[6] {1, 2, 3, 4, 5, 6};
+    bool released = false;
+
+    {
+        std::shared_ptr<const double> data(external, [&released](const double* p) {
+            released = true;
+            delete[] p;
+        });
+        MatxBuffer testBuffer(data, 3, 2);
+        data.reset();
+
+        QCOMPARE(testBuffer.data(), static_cast<const double*>(external));
+        QCOMPARE(testBuffer.view()(2, 1), 6.0);
+        QVERIFY(!released);
+    }
+
+    QVERIFY(released);
+}
+
+void EnsightBufferTests::Wrap_ExternalData_DataNotCopied()
+{
+    const double external[3] = {1, 2, 3};
+
+    MatxBuffer testBuffer = MatxBuffer::wrap(external, 1, 3);
+
+    QCOMPARE(testBuffer.data(), static_cast<const double*>(external));
+    QCOMPARE(testBuffer.view()(0, 2), 3.0);
+}
+
+void EnsightBufferTests::PartSetVertices_ExternalBuffer_ViewRefersToExternalData()
+{
+    const double external[6] = {0, 0, 0,
+                                1, 2, 3};
+    EnsightPart testPart(QString("part"), 1, 1);
+
+    testPart.setVertices(MatxBuffer::wrap(external, 3, 2), 0);
+
+    QCOMPARE(testPart.getVertices(0).data(), static_cast<const double*>(external));
+    QCOMPARE(testPart.getVertexCount(0), 2);
+    QCOMPARE(testPart.getGeometryBounds(0).maxCorner(), Vec3(1, 2, 3));
+}
+
+void EnsightBufferTests::PartSetCells_ExternalBuffer_ViewRefersToExternalData()
+{
+    const int external[6] = {0, 1, 2,
+                             1, 3, 2};
+    EnsightPart testPart(QString("part"), 1, 1);
+
+    testPart.setCells(MatiBuffer::wrap(external, 3, 2), 0, Ensight::Triangle);
+
+    EnsightCellList* cells = testPart.getCells(0, Ensight::Triangle);
+    QVERIFY(cells != nullptr);
+    QCOMPARE(cells->getValues().data(), static_cast<const int*>(external));
+    QCOMPARE((cells->getNeighbors().col(1).array() == 0).count(), Eigen::Index(1));
+}
+
+void EnsightBufferTests::VariableSetValues_ScalarBuffer_ViewRefersToExternalData()
+{
+    const double external[3] = {4, 2, 8};
+    EnsightVariable testVariable(QString("scalar"), Ensight::ScalarPerNode);
+
+    testVariable.setValues(MatxBuffer::wrap(external, 1, 3));
+
+    QCOMPARE(testVariable.getValues().data(), static_cast<const double*>(external));
+    QCOMPARE(testVariable.getBounds()(0, 0), 2.0);
+    QCOMPARE(testVariable.getBounds()(0, 1), 8.0);
+}
+
+void EnsightBufferTests::VariableSetValues_4xNVectorBuffer_ViewRefersToExternalData()
+{
+    const double external[8] = {3, 4, 0, 5,
+                                0, 0, 1, 1};
+    EnsightVariable testVariable(QString("vector"), Ensight::VectorPerNode);
+
+    testVariable.setValues(MatxBuffer::wrap(external, 4, 2));
+
+    QCOMPARE(testVariable.getValues().data(), static_cast<const double*>(external));
+    QCOMPARE(testVariable.getBounds()(3, 0), 1.0);
+    QCOMPARE(testVariable.getBounds()(3, 1), 5.0);
+}
+
+void EnsightBufferTests::VariableSetValues_4xNVectorBufferWrongMagnitude_MagnitudeRecomputed()
+{
+    const double external[8] = {3, 4, 0, 1,
+                                0, 0, 1, 7};
+    EnsightVariable testVariable(QString("vector"), Ensight::VectorPerNode);
+
+    testVariable.setValues(MatxBuffer::wrap(external, 4, 2));
+
+    QVERIFY(testVariable.getValues().data() != external);
+    QCOMPARE(testVariable.getValues()(3, 0), 5.0);
+    QCOMPARE(testVariable.getValues()(3, 1), 1.0);
+    QCOMPARE(testVariable.getBounds()(3, 0), 1.0);
+    QCOMPARE(testVariable.getBounds()(3, 1), 5.0);
+}
+
+void EnsightBufferTests::StoreIntern_EqualContent_DataShared()
+{
+    EnsightBufferStore store;
+    Matx values = Matx::Random(3, 100);
+
+    MatxBuffer first = store.intern(MatxBuffer(values));
+    MatxBuffer second = store.intern(MatxBuffer(values));
+
+    QVERIFY(first.sharesDataWith(second));
+    QCOMPARE(Matx(second.view()), values);
+}
+
+void EnsightBufferTests::StoreIntern_DifferentContentOrSize_DataNotShared()
+{
+    EnsightBufferStore store;
+    Mati values(2, 2);
+    values << 1, 2, 3, 4;
+    Mati otherValues = values;
+    otherValues(1, 1) = 5;
+    Mati reshaped(1, 4);
+    reshaped << 1, 3, 2, 4;
+
+    MatiBuffer first = store.intern(MatiBuffer(values));
+    QVERIFY(!store.intern(MatiBuffer(otherValues)).sharesDataWith(first));
+    QVERIFY(!store.intern(MatiBuffer(reshaped)).sharesDataWith(first));
+}
+
+void EnsightBufferTests::StoreIntern_ReleasedBuffer_NotReused()
+{
+    EnsightBufferStore store;
+    Matx values = Matx::Random(1, 10);
+    store.intern(MatxBuffer(values));
+
+    MatxBuffer second(values);
+    QVERIFY(store.intern(second).sharesDataWith(second));
+}
+
+void EnsightBufferTests::StoreIntern_WrappedBuffer_ReturnedUnchangedAndNeverShared()
+{
+    EnsightBufferStore store;
+    const double external[3] = {1, 2, 3};
+    Matx values(1, 3);
+    values << 1, 2, 3;
+
+    MatxBuffer owned = store.intern(MatxBuffer(values));
+    MatxBuffer wrapped = store.intern(MatxBuffer::wrap(external, 1, 3));
+    QCOMPARE(wrapped.data(), static_cast<const double*>(external));
+    QVERIFY(!wrapped.isOwned());
+
+    // The wrapped data must not become the shared copy of later buffers either
+    owned = MatxBuffer();
+    MatxBuffer later = store.intern(MatxBuffer(values));
+    QVERIFY(later.data() != external);
+    QVERIFY(later.isOwned());
+    QCOMPARE(store.getBytes(), int64_t(3 * sizeof(double)));
+}
+
+void EnsightBufferTests::HashBytes_LargeBlock_SameForSerialAndParallel()
+{
+    std::vector<int> values(1000003);
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = static_cast<int>(i * 7919);
+    const size_t size = values.size() * sizeof(int);
+
+    Ensight::Parallel::setNumThreads(1);
+    uint64_t serial = EnsightBufferStore::hashBytes(values.data(), size);
+    Ensight::Parallel::setNumThreads(4);
+    uint64_t parallel = EnsightBufferStore::hashBytes(values.data(), size);
+    Ensight::Parallel::setNumThreads(0);
+    QCOMPARE(parallel, serial);
+
+    values.back()++;
+    QVERIFY(EnsightBufferStore::hashBytes(values.data(), size) != serial);
+}
+
+void EnsightBufferTests::StoreGetPeakBytes_ReleasedBuffer_PeakKept()
+{
+    EnsightBufferStore store;
+    const int64_t bytes = 10 * sizeof(double);
+    {
+        MatxBuffer first = store.intern(MatxBuffer(Matx(Matx::Zero(1, 10))));
+        MatxBuffer second = store.intern(MatxBuffer(Matx(Matx::Ones(1, 10))));
+        MatxBuffer shared = store.intern(MatxBuffer(Matx(Matx::Ones(1, 10))));
+        QCOMPARE(store.getBytes(), 2 * bytes);
+    }
+    QCOMPARE(store.getBytes(), int64_t(0));
+
+    MatxBuffer third = store.intern(MatxBuffer(Matx(Matx::Zero(1, 10))));
+    QCOMPARE(store.getBytes(), bytes);
+    QCOMPARE(store.getPeakBytes(), 2 * bytes);
+}
+
+void EnsightBufferTests::ObjGetMemoryReport_IdenticalTimestepsAndParts_DeduplicatedBytesReported()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setTransient(Vecx::LinSpaced(2, 0, 1));
+    testObj->createVariable(QString("var"), Ensight::ScalarPerNode);
+
+    Matx vertices(3, 4);
+    vertices << 0, 1, 0, 0,
+                0, 0, 1, 0,
+                0, 0, 0, 1;
+    Mati cells(4, 1);
+    cells << 0, 1, 2, 3;
+
+    for (int i = 0; i < 2; i++)
+    {
+        EnsightPart* part = testObj->createEnsightPart(QString("part%0").arg(i), i + 1);
+        for (int t = 0; t < 2; t++)
+        {
+            testObj->setVertices(part, vertices, t);
+            testObj->setCells(part, cells, t, Ensight::Tetradhedron);
+            testObj->setVariable(part, QString("var"), Matx(Matx::Constant(1, 4, t)),
+                                 Ensight::ScalarPerNode, t);
+        }
+    }
+    QVERIFY(testObj->endEdit());
+
+    EnsightPart* first = testObj->getPart(0);
+    EnsightPart* second = testObj->getPart(1);
+    QCOMPARE(first->getVertices(0).data(), second->getVertices(1).data());
+    QCOMPARE(first->getCells(0).front()->getValues().data(),
+             second->getCells(1).front()->getValues().data());
+    QVERIFY(first->getVariableValues(QString("var"), 0).data() !=
+            first->getVariableValues(QString("var"), 1).data());
+
+    EnsightMemoryReport report = testObj->getMemoryReport();
+    const int64_t vertexBytes = 12 * sizeof(double);
+    const int64_t cellBytes = 4 * sizeof(int);
+    const int64_t variableBytes = 4 * sizeof(double);
+    QCOMPARE(report.arrayBytes, 4 * (vertexBytes + cellBytes + variableBytes));
+    QCOMPARE(report.storedArrayBytes, vertexBytes + cellBytes + 2 * variableBytes);
+    QCOMPARE(report.getDeduplicatedBytes(), report.arrayBytes - report.storedArrayBytes);
+}
+
+void EnsightBufferTests::ObjGetMemoryReport_TopologyAndSubdivTree_BreakdownReported()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setStatic();
+
+    Matx vertices(3, 5);
+    vertices << 0, 1, 0, 0, 1,
+                0, 0, 1, 0, 1,
+                0, 0, 0, 1, 1;
+    Mati cells(4, 2);
+    cells << 0, 1,
+             1, 2,
+             2, 3,
+             3, 4;
+    EnsightPart* part = testObj->createEnsightPart(QString("part"), 1);
+    testObj->setVertices(part, vertices, 0);
+    testObj->setCells(part, cells, 0, Ensight::Tetradhedron);
+    QVERIFY(testObj->endEdit());
+
+    EnsightMemoryReport before = testObj->getMemoryReport();
+    QCOMPARE(before.topologyBytes, int64_t(0));
+    QCOMPARE(before.subdivTreeBytes, int64_t(0));
+    QCOMPARE(int(before.entries.size()), 2);
+    QCOMPARE(before.peakArrayBytes, before.storedArrayBytes);
+
+    EnsightCellList* cellList = part->getCells(0).front();
+    cellList->getNeighbors();
+    QVERIFY(testObj->createSubdivTree(4, 1, QStringList()));
+
+    EnsightMemoryReport report = testObj->getMemoryReport();
+    EnsightMemoryReport partReport;
+    part->addMemoryUsage(partReport, 0);
+    const int64_t topologyBytes = (cellList->getNeighbors().size() + cellList->getBoundary().size()
+                                   + cellList->getBoundaryVertices().size()) * sizeof(int)
+            + partReport.topologyBytes;
+    QCOMPARE(report.topologyBytes, topologyBytes);
+    QVERIFY(report.subdivTreeBytes > 0);
+    QCOMPARE(report.getTotalBytes(),
+             report.storedArrayBytes + report.topologyBytes + report.subdivTreeBytes);
+
+    int64_t sum = 0;
+    for (const EnsightMemoryReport::Entry& entry : report.entries)
+    {
+        if (!entry.shared)
+            sum += entry.bytes;
+    }
+    QCOMPARE(sum, report.getTotalBytes());
+    QCOMPARE(report.entries.back().category, std::string("subdivtree"));
+    QCOMPARE(report.entries.back().name, std::string("cell identifiers"));
+}
+
+void EnsightBufferTests::ObjGetMemoryReport_PartTopologyComputed_IncidenceConnectivityAndMeshViewReported()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setStatic();
+
+    Matx vertices = Matx::Zero(3, 5);
+    Mati cells(4, 2);
+    cells << 0, 1,
+             1, 2,
+             2, 3,
+             3, 4;
+    EnsightPart* part = testObj->createEnsightPart(QString("part"), 1);
+    testObj->setVertices(part, vertices, 0);
+    testObj->setCells(part, cells, 0, Ensight::Tetradhedron);
+    QVERIFY(testObj->endEdit());
+    QCOMPARE(testObj->getMemoryReport().topologyBytes, int64_t(0));
+
+    const int64_t bytes = part->getVertexIncidence(0).getBytes() + part->getFaceConnectivity(0).getBytes()
+            + part->getMeshView(0).getBytes();
+    QVERIFY(part->getVertexIncidence(0).getBytes() > 0);
+    QVERIFY(part->getFaceConnectivity(0).getBytes() > 0);
+    QVERIFY(part->getMeshView(0).getBytes() > 0);
+
+    EnsightMemoryReport report = testObj->getMemoryReport();
+    QCOMPARE(report.topologyBytes, bytes);
+    QCOMPARE(int(report.entries.size()), 5);
+    QCOMPARE(report.entries[2].category, std::string("incidence"));
+    QCOMPARE(report.entries[3].category, std::string("faceConnectivity"));
+    QCOMPARE(report.entries[4].category, std::string("meshView"));
+    QCOMPARE(report.entries[4].part, std::string("part"));
+}
+
+void EnsightBufferTests::GetPeakResidentBytes_CurrentProcess_NotBelowResidentBytes()
+{
+    // Both are 0 on platforms without memory statistics
+    int64_t resident = EnsightMemoryReport::getResidentBytes();
+    QVERIFY(resident >= 0);
+    QVERIFY(EnsightMemoryReport::getPeakResidentBytes() >= resident);
+}
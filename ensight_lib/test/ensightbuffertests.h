@@ -0,0 +1,59 @@
+#ifndef ENSIGHTBUFFERTESTS_H
+#define ENSIGHTBUFFERTESTS_H
+
+#include <QtTest/QtTest>
+
+#include "ensightbuffer.h"
+
+
+/*
+    Unit Tests for EnsightLib >> EnsightBuffer
+               and the zero-copy setters of EnsightPart and EnsightVariable
+               and EnsightBufferStore
+*/
+class EnsightBufferTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void DefaultConstructor_StaticValueAssignment_EmptyBuffer();
+
+    void CopyConstructor_ParameterValueAssignment_DataCopied();
+
+    void MoveConstructor_ParameterValueAssignment_StorageTakenOver();
+
+    void AdoptConstructor_ExternalData_DataNotCopiedAndReleased();
+
+    void Wrap_ExternalData_DataNotCopied();
+
+    void PartSetVertices_ExternalBuffer_ViewRefersToExternalData();
+
+    void PartSetCells_ExternalBuffer_ViewRefersToExternalData();
+
+    void VariableSetValues_ScalarBuffer_ViewRefersToExternalData();
+    void VariableSetValues_4xNVectorBuffer_ViewRefersToExternalData();
+    void VariableSetValues_4xNVectorBufferWrongMagnitude_MagnitudeRecomputed();
+
+    void StoreIntern_EqualContent_DataShared();
+
+    void StoreIntern_DifferentContentOrSize_DataNotShared();
+
+    void StoreIntern_ReleasedBuffer_NotReused();
+
+    void StoreIntern_WrappedBuffer_ReturnedUnchangedAndNeverShared();
+
+    void HashBytes_LargeBlock_SameForSerialAndParallel();
+
+    void StoreGetPeakBytes_ReleasedBuffer_PeakKept();
+
+    void ObjGetMemoryReport_IdenticalTimestepsAndParts_DeduplicatedBytesReported();
+
+    void ObjGetMemoryReport_TopologyAndSubdivTree_BreakdownReported();
+
+    void ObjGetMemoryReport_PartTopologyComputed_IncidenceConnectivityAndMeshViewReported();
+
+    void GetPeakResidentBytes_CurrentProcess_NotBelowResidentBytes();
+};
+
+#endif // ENSIGHTBUFFERTESTS_H
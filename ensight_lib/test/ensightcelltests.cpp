@@ -0,0 +1,331 @@
+#include "ensightcelltests.h"
+
+#include <string>
+
+#include "ensightpart.h"
+
+
+void EnsightCellTests::Constructor_TwoHexahedra_SharedFaceMatched()
+{
+    Mati cells(8, 2);
+    cells << 0, 1,
+             1, 2,
+             4, 5,
+             3, 4,
+             6, 7,
+             7, 8,
+             10, 11,
+             9, 10;
+
+    EnsightCellList cellList(Ensight::Hexahedron, cells, std::string("part"));
+
+    const Mati& neighbors = cellList.getNeighbors();
+    QCOMPARE(neighbors.rows(), 6);
+    QCOMPARE(neighbors.cols(), 2);
+    QCOMPARE((neighbors.col(0).array() == 1).count(), 1);
+    QCOMPARE((neighbors.col(1).array() == 0).count(), 1);
+    QCOMPARE((neighbors.array() == -1).count(), 10);
+
+    QCOMPARE(cellList.getBoundary().cols(), 10);
+
+    const Mati& boundaryVertices = cellList.getBoundaryVertices();
+    QCOMPARE(boundaryVertices.cols(), 12);
+    for (int i = 0; i < 12; i++)
+        QCOMPARE(boundaryVertices(0, i), i);
+}
+
+void EnsightCellTests::Constructor_TwoTetrahedra_SharedTriangleMatched()
+{
+    Mati cells(4, 2);
+    cells << 0, 2,
+             1, 1,
+             2, 0,
+             3, 4;
+
+    EnsightCellList cellList(Ensight::Tetradhedron, cells, std::string("part"));
+
+    const Mati& neighbors = cellList.getNeighbors();
+    QCOMPARE((neighbors.col(0).array() == 1).count(), 1);
+    QCOMPARE((neighbors.col(1).array() == 0).count(), 1);
+    QCOMPARE(cellList.getBoundary().cols(), 6);
+    QCOMPARE(cellList.getBoundaryVertices().cols(), 5);
+}
+
+void EnsightCellTests::Constructor_StructuredGrid_NeighborsSymmetricAndBoundaryComplete()
+{
+    const int n = 4;
+    auto index = [](int i, int j, int k) { return i + (n + 1) * (j + (n + 1) * k); };
+
+    Mati cells(8, n * n * n);
+    int c = 0;
+    for (int k = 0; k < n; k++)
+        for (int j = 0; j < n; j++)
+            for (int i = 0; i < n; i++)
+                cells.col(c++) << index(i, j, k), index(i + 1, j, k),
+                                  index(i + 1, j + 1, k), index(i, j + 1, k),
+                                  index(i, j, k + 1), index(i + 1, j, k + 1),
+                                  index(i + 1, j + 1, k + 1), index(i, j + 1, k + 1);
+
+    EnsightCellList cellList(Ensight::Hexahedron, cells, std::string("part"));
+
+    const Mati& neighbors = cellList.getNeighbors();
+    for (int cell = 0; cell < neighbors.cols(); cell++)
+    {
+        for (int face = 0; face < neighbors.rows(); face++)
+        {
+            int neighbor = neighbors(face, cell);
+            if (neighbor != -1)
+                QCOMPARE((neighbors.col(neighbor).array() == cell).count(), 1);
+        }
+    }
+
+    const Mati& boundary = cellList.getBoundary();
+    QCOMPARE(boundary.cols(), 6 * n * n);
+    for (int i = 0; i < boundary.cols(); i++)
+        QCOMPARE(neighbors(boundary(1, i), boundary(0, i)), -1);
+
+    const Mati& boundaryVertices = cellList.getBoundaryVertices();
+    QCOMPARE(boundaryVertices.cols(), (n + 1) * (n + 1) * (n + 1) - (n - 1) * (n - 1) * (n - 1));
+    for (int i = 1; i < boundaryVertices.cols(); i++)
+        QVERIFY(boundaryVertices(0, i - 1) < boundaryVertices(0, i));
+}
+
+void EnsightCellTests::GetNeighbors_LazyEvaluation_ComputedOnFirstAccess()
+{
+    Mati cells(4, 2);
+    cells << 0, 2,
+             1, 1,
+             2, 0,
+             3, 4;
+
+    EnsightCellList cellList(Ensight::Tetradhedron, cells, std::string("part"));
+    QVERIFY(!cellList.isTopologyComputed());
+
+    QCOMPARE(cellList.getBoundary().cols(), 6);
+    QVERIFY(cellList.isTopologyComputed());
+}
+
+void EnsightCellTests::SetCells_IdenticalCellsAtAdjacentTimesteps_TopologyShared()
+{
+    Mati cells(4, 2);
+    cells << 0, 2,
+             1, 1,
+             2, 0,
+             3, 4;
+    Mati otherCells = cells;
+    otherCells(3, 1) = 5;
+
+    EnsightPart part(QString("part"), 1, 3);
+    part.setCells(cells, 0, Ensight::Tetradhedron);
+    part.setCells(Mati(cells), 1, Ensight::Tetradhedron);
+    part.setCells(otherCells, 2, Ensight::Tetradhedron);
+
+    EnsightCellList* first = part.getCells(0, Ensight::Tetradhedron);
+    EnsightCellList* second = part.getCells(1, Ensight::Tetradhedron);
+    EnsightCellList* third = part.getCells(2, Ensight::Tetradhedron);
+
+    QCOMPARE(&first->getNeighbors(), &second->getNeighbors());
+    QVERIFY(!third->isTopologyComputed());
+    QVERIFY(!third->shareTopology(*first));
+    QVERIFY(&first->getNeighbors() != &third->getNeighbors());
+}
+
+void EnsightCellTests::ShareTopology_EqualContentSeparateData_TopologyShared()
+{
+    Mati cells(4, 2);
+    cells << 0, 2,
+             1, 1,
+             2, 0,
+             3, 4;
+    Mati otherCells = cells;
+    otherCells(0, 0) = 5;
+
+    EnsightCellList first(Ensight::Tetradhedron, cells, QString("part"));
+    EnsightCellList second(Ensight::Tetradhedron, Mati(cells), QString("part"));
+    EnsightCellList third(Ensight::Tetradhedron, otherCells, QString("part"));
+    QVERIFY(first.getValues().data() != second.getValues().data());
+
+    QVERIFY(!third.shareTopology(first));
+    QVERIFY(second.shareTopology(first));
+    QCOMPARE(&first.getNeighbors(), &second.getNeighbors());
+}
+
+void EnsightCellTests::GetVertexIncidence_MixedCellTypes_AllCellsOfVertexListed()
+{
+    Matx vertices = Matx::Zero(3, 6);
+    Mati tetrahedra(4, 2);
+    tetrahedra << 0, 2,
+                  1, 1,
+                  2, 0,
+                  3, 4;
+    Mati triangles(3, 1);
+    triangles << 0, 1, 5;
+
+    EnsightPart part(QString("part"), 1, 1);
+    part.setVertices(vertices, 0);
+    part.setCells(tetrahedra, 0, Ensight::Tetradhedron);
+    part.setCells(triangles, 0, Ensight::Triangle);
+
+    const EnsightVertexIncidence& incidence = part.getVertexIncidence(0);
+    QCOMPARE(incidence.getNumberOfVertices(), 6);
+    QCOMPARE(incidence.getCellCount(0), 3);
+    QCOMPARE(incidence.getCellCount(3), 1);
+    QCOMPARE(incidence.getCellCount(5), 1);
+    QCOMPARE(incidence.getOffsets().back(), 11);
+
+    const EnsightVertexIncidence::Entry* cells = incidence.getCells(0);
+    QCOMPARE(incidence.getCellList(cells[0].cellList)->getType(), Ensight::Tetradhedron);
+    QCOMPARE(cells[0].cell, 0);
+    QCOMPARE(cells[1].cellList, cells[0].cellList);
+    QCOMPARE(cells[1].cell, 1);
+    QCOMPARE(incidence.getCellList(cells[2].cellList)->getType(), Ensight::Triangle);
+
+    QCOMPARE(&part.getVertexIncidence(0), &incidence);
+}
+
+void EnsightCellTests::GetVertexIncidence_CellsAdded_IncidenceUpdated()
+{
+    Matx vertices = Matx::Zero(3, 4);
+    Mati tetrahedron(4, 1);
+    tetrahedron << 0, 1, 2, 3;
+    Mati triangle(3, 1);
+    triangle << 3, 2, 1;
+
+    EnsightPart part(QString("part"), 1, 1);
+    part.setVertices(vertices, 0);
+    part.setCells(tetrahedron, 0, Ensight::Tetradhedron);
+    QCOMPARE(part.getVertexIncidence(0).getCellCount(3), 1);
+
+    part.setCells(triangle, 0, Ensight::Triangle);
+    QCOMPARE(part.getVertexIncidence(0).getCellCount(3), 2);
+    QCOMPARE(part.getVertexIncidence(0).getCellCount(0), 1);
+}
+
+void EnsightCellTests::GetFaceConnectivity_HexahedronWedgeTetrahedron_InterfacesMatched()
+{
+    // A hexahedron, a wedge on its top face and a tetrahedron on the triangle face of the wedge
+    Matx vertices = Matx::Zero(3, 11);
+    Mati hexahedron(8, 1);
+    hexahedron << 0, 1, 2, 3, 4, 5, 6, 7;
+    Mati wedge(6, 1);
+    wedge << 4, 8, 7, 6, 5, 9;
+    Mati tetrahedron(4, 1);
+    tetrahedron << 4, 8, 7, 10;
+
+    EnsightPart part(QString("part"), 1, 1);
+    part.setVertices(vertices, 0);
+    part.setCells(hexahedron, 0, Ensight::Hexahedron);
+    part.setCells(wedge, 0, Ensight::Wedge);
+    part.setCells(tetrahedron, 0, Ensight::Tetradhedron);
+
+    const EnsightFaceConnectivity& connectivity = part.getFaceConnectivity(0);
+    QCOMPARE(connectivity.getNumberOfCellLists(), 3);
+
+    // Wedge face 2 (vertices 4, 5, 6, 7) is the top face of the hexahedron
+    QCOMPARE(connectivity.getNeighbors(0)(1, 0), 0);
+    QCOMPARE(connectivity.getNeighborList(0, 1, 0), 1);
+    QCOMPARE(connectivity.getNeighbors(1)(2, 0), 0);
+    QCOMPARE(connectivity.getNeighborList(1, 2, 0), 0);
+
+    // Wedge face 0 (vertices 4, 8, 7) is face 0 of the tetrahedron
+    QCOMPARE(connectivity.getNeighborList(1, 0, 0), 2);
+    QCOMPARE(connectivity.getNeighborList(2, 0, 0), 1);
+    QCOMPARE(connectivity.getNeighborList(2, 1, 0), -1);
+
+    QCOMPARE(connectivity.getBoundary().cols(), 6 + 5 + 4 - 4);
+    QCOMPARE(connectivity.getBoundaryVertices().cols(), 11);
+
+    // Cell lists still only match faces of their own type
+    QCOMPARE(part.getCells(0, Ensight::Hexahedron)->getBoundary().cols(), 6);
+}
+
+void EnsightCellTests::GetFaceConnectivity_IndicesOutOfRange_FacesIgnored()
+{
+    // Two tetrahedra sharing the triangle 0, 1, 2; the second one also uses an index far
+    // beyond the vertex count and the first one a negative index
+    Matx vertices = Matx::Zero(3, 5);
+    Mati tetrahedra(4, 3);
+    tetrahedra << 0, 2, 1,
+                  1, 1, 3,
+                  2, 0, 4,
+                  3, 2000000000, -2000000000;
+
+    EnsightPart part(QString("part"), 1, 1);
+    part.setVertices(vertices, 0);
+    part.setCells(tetrahedra, 0, Ensight::Tetradhedron);
+
+    const EnsightFaceConnectivity& connectivity = part.getFaceConnectivity(0);
+    QCOMPARE(connectivity.getNeighbors(0)(0, 0), 1);
+    QCOMPARE(connectivity.getNeighbors(0)(0, 1), 0);
+
+    // Only the faces without invalid indices are boundary faces: 3 + 0 + 1
+    QCOMPARE(connectivity.getBoundary().cols(), 4);
+    Mati boundaryVertices = connectivity.getBoundaryVertices();
+    QCOMPARE(boundaryVertices.cols(), 5);
+    QCOMPARE(boundaryVertices(0, 0), 0);
+    QCOMPARE(boundaryVertices(0, 4), 4);
+}
+
+void EnsightCellTests::GetMeshView_MixedCellTypes_CellsConcatenated()
+{
+    Matx vertices = Matx::Zero(3, 5);
+    Mati tetrahedra(4, 2);
+    tetrahedra << 0, 2,
+                  1, 1,
+                  2, 0,
+                  3, 4;
+    Mati triangles(3, 1);
+    triangles << 0, 1, 4;
+
+    EnsightPart part(QString("part"), 1, 1);
+    part.setVertices(vertices, 0);
+    part.setCells(tetrahedra, 0, Ensight::Tetradhedron);
+    part.setCells(triangles, 0, Ensight::Triangle);
+
+    const EnsightMeshView& meshView = part.getMeshView(0);
+    QCOMPARE(meshView.getNumberOfCells(), 3);
+    QCOMPARE(meshView.getCellListOffsets(), std::vector<int>({0, 2, 3}));
+    QCOMPARE(meshView.getOffsets(), std::vector<int>({0, 4, 8, 11}));
+    QCOMPARE(meshView.getCellType(1), Ensight::Tetradhedron);
+    QCOMPARE(meshView.getCellType(2), Ensight::Triangle);
+    QCOMPARE(meshView.getCellSize(2), 3);
+    QCOMPARE(meshView.getCell(1)[3], 4);
+    QCOMPARE(meshView.getCell(2)[2], 4);
+
+    part.clean(0);
+    part.setVertices(vertices, 0);
+    part.setCells(triangles, 0, Ensight::Triangle);
+    QCOMPARE(part.getMeshView(0).getNumberOfCells(), 1);
+}
+
+void EnsightCellTests::ComputeVolumes_MixedCellTypes_VolumesOfUnitCells()
+{
+    Matx vertices(3, 9);
+    vertices << 0, 1, 1, 0, 0, 1, 1, 0, 2,
+                0, 0, 1, 1, 0, 0, 1, 1, 0,
+                0, 0, 0, 0, 1, 1, 1, 1, 0;
+    Mati hexahedron(8, 1);
+    hexahedron << 0, 1, 2, 3, 4, 5, 6, 7;
+    Mati tetrahedron(4, 1);
+    tetrahedron << 1, 8, 2, 5;
+
+    EnsightPart part(QString("part"), 1, 1);
+    part.setVertices(vertices, 0);
+    part.setCells(hexahedron, 0, Ensight::Hexahedron);
+    part.setCells(tetrahedron, 0, Ensight::Tetradhedron);
+
+    const EnsightMeshView& meshView = part.getMeshView(0);
+    Vecx volumes = meshView.computeVolumes(part.getVertices(0));
+    QCOMPARE(volumes[0], 1.0);
+    QCOMPARE(volumes[1], 1.0 / 6.0);
+
+    Matx centroids = meshView.computeCentroids(part.getVertices(0));
+    QVERIFY(centroids.col(0).isApprox(Vec3(0.5, 0.5, 0.5)));
+    QVERIFY(centroids.col(1).isApprox(Vec3(1.25, 0.25, 0.25)));
+
+    Matx bounds = meshView.computeBounds(part.getVertices(0));
+    QVERIFY(bounds.col(1).isApprox((Vecx(6) << 1, 0, 0, 2, 1, 1).finished()));
+
+    EnsightCellIdentifier cell(&part, part.getCells(0, Ensight::Tetradhedron), 0, 0, Bbox());
+    QCOMPARE(cell.computeVolume(), volumes[1]);
+}
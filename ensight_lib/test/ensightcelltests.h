@@ -0,0 +1,43 @@
+#ifndef ENSIGHTCELLTESTS_H
+#define ENSIGHTCELLTESTS_H
+
+#include <QtTest/QtTest>
+
+#include "ensightcell.h"
+
+
+/*
+    Unit Tests for EnsightLib >> EnsightCellList
+*/
+class EnsightCellTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void Constructor_TwoHexahedra_SharedFaceMatched();
+
+    void Constructor_TwoTetrahedra_SharedTriangleMatched();
+
+    void Constructor_StructuredGrid_NeighborsSymmetricAndBoundaryComplete();
+
+    void GetNeighbors_LazyEvaluation_ComputedOnFirstAccess();
+
+    void SetCells_IdenticalCellsAtAdjacentTimesteps_TopologyShared();
+
+    void ShareTopology_EqualContentSeparateData_TopologyShared();
+
+    void GetVertexIncidence_MixedCellTypes_AllCellsOfVertexListed();
+
+    void GetVertexIncidence_CellsAdded_IncidenceUpdated();
+
+    void GetFaceConnectivity_HexahedronWedgeTetrahedron_InterfacesMatched();
+
+    void GetFaceConnectivity_IndicesOutOfRange_FacesIgnored();
+
+    void GetMeshView_MixedCellTypes_CellsConcatenated();
+
+    void ComputeVolumes_MixedCellTypes_VolumesOfUnitCells();
+};
+
+#endif // ENSIGHTCELLTESTS_H
@@ -0,0 +1,338 @@
+#include "ensightobjtests.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ensightbarycentriccoordinates.h"
+#include "ensightcell.h"
+#include "ensightconstant.h"
+#include "ensightlib.h"
+#include "ensightpart.h"
+#include "ensightvariable.h"
+
+void EnsightObjTests::CreateEnsightPart_DuplicateNameOrId_ReturnsNull()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setStatic();
+
+    QVERIFY(testObj->createEnsightPart(QString("first"), 1) != nullptr);
+    QVERIFY(testObj->createEnsightPart(QString("first"), 2) == nullptr);
+    QVERIFY(testObj->createEnsightPart(std::string("second"), 1) == nullptr);
+    QVERIFY(testObj->createEnsightPart(std::string("second"), 2) != nullptr);
+    QCOMPARE(testObj->getNumberOfParts(), 2);
+}
+
+void EnsightObjTests::GetPartByNameAndId_ValueObservator_CorrectPartReturned()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setStatic();
+
+    for (int i = 0; i < 100; i++)
+        testObj->createEnsightPart(QString("part%0").arg(i), 1000 - i);
+
+    EnsightPart* part = testObj->getPartByName(QString("part42"));
+    QVERIFY(part != nullptr);
+    QCOMPARE(part->getId(), 958);
+    QCOMPARE(testObj->getPartById(958), part);
+    QCOMPARE(testObj->getPartByName(std::string("part42")), part);
+    QVERIFY(testObj->getPartByName(QString("part100")) == nullptr);
+    QVERIFY(testObj->getPartById(42) == nullptr);
+}
+
+void EnsightObjTests::RemoveConstant_ValueMutator_RemainingConstantsFoundByName()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+
+    testObj->addConstant(QString("a"), 1.0);
+    testObj->addConstant(QString("b"), 2.0);
+    testObj->addConstant(QString("c"), 3.0);
+    QVERIFY(!testObj->addConstant(QString("b"), 4.0));
+
+    QVERIFY(testObj->removeConstant(QString("b")));
+    QVERIFY(!testObj->removeConstant(QString("b")));
+
+    QCOMPARE(testObj->getNumberOfConstants(), 2);
+    QVERIFY(!testObj->hasConstant(QString("b")));
+    QCOMPARE(testObj->getConstantValue(QString("c")), 3.0);
+    QCOMPARE(testObj->getConstant(1).getName(), QString("c"));
+
+    QVERIFY(testObj->addConstant(QString("b"), 5.0));
+    QCOMPARE(testObj->getConstantValue(std::string("b")), 5.0);
+    QCOMPARE(testObj->getConstantValue(QString("a")), 1.0);
+}
+
+void EnsightObjTests::GetVariableHandle_ValueObservator_HandleSharedWithParts()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setStatic();
+    EnsightPart* part = testObj->createEnsightPart(QString("part"), 1);
+
+    Matx vertices = Matx::Zero(3, 2);
+    testObj->setVertices(part, vertices, 0);
+    testObj->createVariable(QString("p"), Ensight::ScalarPerNode);
+    testObj->createVariable(QString("t"), Ensight::ScalarPerNode);
+
+    Matx values(1, 2);
+    values << 7, 8;
+    QVERIFY(testObj->setVariable(part, QString("t"), values, Ensight::ScalarPerNode, 0));
+    QVERIFY(testObj->endEdit());
+
+    int handle = testObj->getVariableHandle(QString("t"));
+    QCOMPARE(handle, 1);
+    QCOMPARE(testObj->getVariableHandle(std::string("t")), handle);
+    QCOMPARE(testObj->getVariableHandle(QString("x")), -1);
+    QCOMPARE(part->getVariableHandle(QString("t")), handle);
+    QCOMPARE(part->getVariableValues(handle, 0)(0, 1), 8.0);
+    QVERIFY(!part->hasVariable(testObj->getVariableHandle(QString("p")), 0));
+}
+
+static void setTetrahedron(EnsightObj* obj, EnsightPart* part, int timestep, int lastIndex)
+{
+    Matx vertices(3, 4);
+    vertices << 0, 1, 0, 0,
+                0, 0, 1, 0,
+                0, 0, 0, 1;
+    Mati cells(4, 1);
+    cells << 0, 1, 2, lastIndex;
+    obj->setVertices(part, vertices, timestep);
+    obj->setCells(part, cells, timestep, Ensight::Tetradhedron);
+}
+
+void EnsightObjTests::EndEdit_InvalidIndex_ReturnsFalse()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setTransient(Vecx::LinSpaced(4, 0, 3));
+
+    for (int i = 0; i < 8; i++)
+    {
+        EnsightPart* part = testObj->createEnsightPart(QString("part%0").arg(i), i + 1);
+        for (int t = 0; t < 4; t++)
+            setTetrahedron(testObj.get(), part, t, (i == 5 && t == 2) ? 4 : 3);
+    }
+
+    QVERIFY(!testObj->endEdit());
+    QVERIFY(testObj->inEditMode());
+    QVERIFY(EnsightObj::errorString().contains("part5"));
+    QVERIFY(EnsightObj::errorString().contains("at timestep 2"));
+
+    testObj->getPart(5)->clean(2);
+    setTetrahedron(testObj.get(), testObj->getPart(5), 2, 3);
+    QVERIFY(testObj->endEdit());
+    QVERIFY(!testObj->inEditMode());
+}
+
+void EnsightObjTests::EndEdit_UnmodifiedTimesteps_NotVerifiedAgain()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setTransient(Vecx::LinSpaced(2, 0, 1));
+
+    EnsightPart* part = testObj->createEnsightPart(QString("part"), 1);
+    setTetrahedron(testObj.get(), part, 0, 3);
+    setTetrahedron(testObj.get(), part, 1, 3);
+    QVERIFY(part->isModified(0));
+    QVERIFY(testObj->endEdit());
+    QVERIFY(!part->isModified(0));
+    QVERIFY(!part->isModified(1));
+
+    testObj->beginEdit();
+    part->clean(1);
+    setTetrahedron(testObj.get(), part, 1, 3);
+    QVERIFY(!part->isModified(0));
+    QVERIFY(part->isModified(1));
+    QVERIFY(testObj->endEdit());
+}
+
+void EnsightObjTests::GetVariableBounds_SetVariableAndClean_CachedBoundsUpdated()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setTransient(Vecx::LinSpaced(2, 0, 1));
+    testObj->createVariable(QString("var"), Ensight::ScalarPerNode);
+
+    EnsightPart* first = testObj->createEnsightPart(QString("first"), 1);
+    EnsightPart* second = testObj->createEnsightPart(QString("second"), 2);
+    for (int t = 0; t < 2; t++)
+    {
+        setTetrahedron(testObj.get(), first, t, 3);
+        setTetrahedron(testObj.get(), second, t, 3);
+        Matx values(1, 4);
+        values << 1, 2, 3, 4;
+        testObj->setVariable(first, QString("var"), Matx(values.array() + t), Ensight::ScalarPerNode, t);
+        testObj->setVariable(second, QString("var"), Matx(values.array() * 10 * (t + 1)),
+                             Ensight::ScalarPerNode, t);
+    }
+
+    Matx expected(1, 2);
+    expected << 1, 40;
+    QCOMPARE(testObj->getVariableBounds(QString("var"), 0), expected);
+    expected << 1, 80;
+    QCOMPARE(testObj->getVariableBounds(QString("var"), -1), expected);
+    expected << 2, 80;
+    QCOMPARE(testObj->getVariableBounds(QString("var"), 1), expected);
+
+    testObj->clean(1);
+    expected << 1, 40;
+    QCOMPARE(testObj->getVariableBounds(QString("var"), -1), expected);
+    QCOMPARE(testObj->getVariableBounds(QString("var"), 1).cols(), Eigen::Index(0));
+    QCOMPARE(testObj->getVariableBounds(QString("unknown"), -1).cols(), Eigen::Index(0));
+
+    // Parts changed directly are taken into account by endEdit()
+    setTetrahedron(testObj.get(), first, 1, 3);
+    setTetrahedron(testObj.get(), second, 1, 3);
+    second->setVariable(QString("var"), Matx(Matx::Constant(1, 4, -5)), Ensight::ScalarPerNode, 1);
+    QVERIFY(testObj->endEdit());
+    expected << -5, 40;
+    QCOMPARE(testObj->getVariableBounds(QString("var"), -1), expected);
+    expected << -5, -5;
+    QCOMPARE(testObj->getVariableBounds(std::string("var"), 1), expected);
+}
+
+void EnsightObjTests::PartGetVariableBounds_ReplacedValues_BoundsShrink()
+{
+    EnsightPart part(QString("part"), 1, 2);
+    Matx values(1, 3);
+    values << 1, 2, 3;
+    part.setVariable(QString("var"), values, Ensight::ScalarPerNode, 0);
+    part.setVariable(QString("var"), Matx(values.array() * 2), Ensight::ScalarPerNode, 1);
+
+    Matx expected(1, 2);
+    expected << 1, 6;
+    QCOMPARE(part.getVariableBounds(QString("var"), -1), expected);
+
+    part.setVariable(QString("var"), Matx(values.array() + 1), Ensight::ScalarPerNode, 1);
+    expected << 1, 4;
+    QCOMPARE(part.getVariableBounds(QString("var"), -1), expected);
+
+    part.clean(0);
+    expected << 2, 4;
+    QCOMPARE(part.getVariableBounds(QString("var"), -1), expected);
+    QCOMPARE(part.getVariableBounds(part.getVariableHandle(QString("var")), 1), expected);
+}
+
+void EnsightObjTests::ErrorStr_ConcurrentThreads_MessageKeptPerThread()
+{
+    std::atomic<int> done(0);
+    std::atomic<int> ready(0);
+    QString messages[2];
+
+    // Only the first thread fails, both wait for each other before reading the message
+    auto run = [&](int i) {
+        std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+        if (i == 1)
+            testObj->beginEdit();
+        testObj->setStatic();
+        done++;
+        while (done < 2)
+            std::this_thread::yield();
+        messages[i] = EnsightObj::errorString();
+        ready++;
+    };
+    std::thread first(run, 0);
+    std::thread second(run, 1);
+    first.join();
+    second.join();
+
+    QCOMPARE(ready.load(), 2);
+    QVERIFY(!messages[0].isEmpty());
+    QVERIFY(messages[1].isEmpty());
+}
+
+void EnsightObjTests::Freeze_EditMode_ReturnsFalseAndEditingRefused()
+{
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setStatic();
+    setTetrahedron(testObj.get(), testObj->createEnsightPart(QString("part"), 1), 0, 3);
+
+    QVERIFY(!testObj->freeze());
+    QVERIFY(!testObj->isFrozen());
+    QVERIFY(testObj->endEdit());
+    QVERIFY(testObj->createSubdivTree(4, 10, QStringList()));
+
+    QVERIFY(testObj->freeze());
+    QVERIFY(testObj->isFrozen());
+    QVERIFY(!testObj->beginEdit());
+    QVERIFY(!testObj->inEditMode());
+    QVERIFY(!testObj->createSubdivTree(4, 10, QStringList()));
+    QVERIFY(testObj->getSubdivTree() != nullptr);
+}
+
+void EnsightObjTests::Interpolate_FrozenExamplesManyThreads_ResultsEqualSerial()
+{
+    const char* files[] = {"../examples/data/write_example.case",
+                           "../examples/data/write_example_binary.case"};
+    for (const char* file : files)
+    {
+        std::unique_ptr<EnsightObj> testObj(EnsightLib::readEnsight(std::string(file)));
+        QVERIFY(testObj != nullptr);
+        QVERIFY(testObj->createSubdivTree(8, 20, QStringList()));
+        QVERIFY(testObj->freeze());
+
+        // Positions on a grid slightly larger than the geometry
+        Bbox bounds = testObj->getGeometryBounds(0, QStringList());
+        std::vector<Vec3> positions;
+        const int n = 40;
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++)
+                positions.push_back(bounds.minCorner() - 0.05 * bounds.diagonal() +
+                                    Vec3((i + 0.3) / n * 1.1 * bounds.diagonal()[0],
+                                         (j + 0.7) / n * 1.1 * bounds.diagonal()[1],
+                                         0.5 * bounds.diagonal()[2]));
+
+        const QString name = testObj->getVariable(0).getName();
+        std::vector<EnsightCellIdentifier*> expectedCells;
+        std::vector<double> expectedValues;
+        for (const Vec3& pos : positions)
+        {
+            EnsightBarycentricCoordinates coords;
+            expectedCells.push_back(testObj->interpolate(pos, coords));
+            expectedValues.push_back(expectedCells.back() ? coords.evaluate(name)[0] : 0.0);
+        }
+
+        // Each thread queries all positions in a different order and computes
+        // the lazily created topology concurrently
+        const int numThreads = 8;
+        std::atomic<int> mismatches(0);
+        std::vector<const Mati*> neighbors(numThreads);
+        std::vector<const EnsightVertexIncidence*> incidence(numThreads);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; t++)
+        {
+            threads.emplace_back([&, t]() {
+                EnsightPart* part = testObj->getPart(0);
+                neighbors[t] = &part->getCells(0).front()->getNeighbors();
+                incidence[t] = &part->getVertexIncidence(0);
+                for (size_t k = 0; k < positions.size(); k++)
+                {
+                    size_t i = (k * (2 * t + 1) + t) % positions.size();
+                    EnsightBarycentricCoordinates coords;
+                    EnsightCellIdentifier* cell = testObj->interpolate(positions[i], coords);
+                    double value = cell ? coords.evaluate(name)[0] : 0.0;
+                    if (cell != expectedCells[i] || value != expectedValues[i])
+                        mismatches++;
+                    testObj->getVariableBounds(name, -1);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        QCOMPARE(mismatches.load(), 0);
+        QVERIFY(std::count(expectedCells.begin(), expectedCells.end(), nullptr) <
+                static_cast<long>(expectedCells.size()));
+        for (int t = 1; t < numThreads; t++)
+        {
+            QCOMPARE(neighbors[t], neighbors[0]);
+            QCOMPARE(incidence[t], incidence[0]);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef ENSIGHTOBJTESTS_H
+#define ENSIGHTOBJTESTS_H
+
+#include <QtTest/QtTest>
+
+#include "ensightobj.h"
+
+/*
+    Unit Tests for EnsightLib >> EnsightObj
+*/
+class EnsightObjTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void CreateEnsightPart_DuplicateNameOrId_ReturnsNull();
+
+    void GetPartByNameAndId_ValueObservator_CorrectPartReturned();
+
+    void RemoveConstant_ValueMutator_RemainingConstantsFoundByName();
+
+    void GetVariableHandle_ValueObservator_HandleSharedWithParts();
+
+    void EndEdit_InvalidIndex_ReturnsFalse();
+
+    void EndEdit_UnmodifiedTimesteps_NotVerifiedAgain();
+
+    void GetVariableBounds_SetVariableAndClean_CachedBoundsUpdated();
+
+    void PartGetVariableBounds_ReplacedValues_BoundsShrink();
+
+    void ErrorStr_ConcurrentThreads_MessageKeptPerThread();
+
+    void Freeze_EditMode_ReturnsFalseAndEditingRefused();
+
+    void Interpolate_FrozenExamplesManyThreads_ResultsEqualSerial();
+};
+
+#endif // ENSIGHTOBJTESTS_H
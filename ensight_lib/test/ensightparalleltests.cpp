@@ -0,0 +1,169 @@
+#include "ensightparalleltests.h"
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "ensightobj.h"
+
+using namespace Ensight::Parallel;
+
+void EnsightParallelTests::ParallelFor_FourThreads_EachIndexProcessedOnce()
+{
+    setNumThreads(4);
+    QCOMPARE(getNumThreads(), 4);
+
+    const int n = 100000;
+    std::vector<std::atomic<int>> counts(n);
+    for (auto& count : counts)
+        count = 0;
+
+    // Uneven work per chunk makes threads steal from each other
+    parallelFor(0, n, 100, [&](int64_t first, int64_t last) {
+        if (first < n / 10)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        for (int64_t i = first; i < last; i++)
+            counts[i]++;
+    });
+
+    for (int i = 0; i < n; i++)
+        QCOMPARE(counts[i].load(), 1);
+}
+
+void EnsightParallelTests::ParallelFor_SerialMode_ProcessedOnCallingThread()
+{
+    setNumThreads(1);
+    QCOMPARE(getNumThreads(), 1);
+
+    std::atomic<int> calls(0);
+    std::atomic<int> otherThreads(0);
+    const std::thread::id caller = std::this_thread::get_id();
+    parallelFor(10, 1000, 10, [&](int64_t first, int64_t last) {
+        calls++;
+        if (std::this_thread::get_id() != caller)
+            otherThreads++;
+        QCOMPARE(first, int64_t(10));
+        QCOMPARE(last, int64_t(1000));
+    });
+
+    QCOMPARE(calls.load(), 1);
+    QCOMPARE(otherThreads.load(), 0);
+}
+
+void EnsightParallelTests::ParallelFor_NestedCall_ProcessedCompletely()
+{
+    setNumThreads(3);
+
+    std::atomic<int64_t> sum(0);
+    parallelFor(0, 64, 1, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+        {
+            parallelFor(0, 100, 10, [&](int64_t innerFirst, int64_t innerLast) {
+                for (int64_t j = innerFirst; j < innerLast; j++)
+                    sum += j;
+            });
+        }
+    });
+
+    QCOMPARE(sum.load(), int64_t(64 * 4950));
+}
+
+void EnsightParallelTests::ParallelFor_ErrorOnWorkerThread_MessagePassedToCaller()
+{
+    setNumThreads(4);
+    EnsightObj::errorString().clear();
+
+    // Only workers report an error, the calling thread waits for one of them
+    std::atomic<bool> workerFailed(false);
+    const std::thread::id caller = std::this_thread::get_id();
+    parallelFor(0, 64, 1, [&](int64_t, int64_t) {
+        if (std::this_thread::get_id() != caller)
+        {
+            EnsightObj::errorString() = "In [worker] failed";
+            workerFailed = true;
+        }
+        for (int i = 0; i < 1000000 && !workerFailed; i++)
+            std::this_thread::yield();
+    });
+
+    QVERIFY(workerFailed.load());
+    QCOMPARE(EnsightObj::errorString(), QString("In [worker] failed"));
+}
+
+void EnsightParallelTests::ParallelFor_ExceptionOnWorkerThread_RethrownOnCaller()
+{
+    setNumThreads(4);
+
+    // Only workers throw, the calling thread waits for one of them
+    std::atomic<bool> workerFailed(false);
+    const std::thread::id caller = std::this_thread::get_id();
+    QString message;
+    try
+    {
+        parallelFor(0, 64, 1, [&](int64_t, int64_t) {
+            if (std::this_thread::get_id() != caller)
+            {
+                workerFailed = true;
+                throw std::runtime_error("worker failed");
+            }
+            for (int i = 0; i < 1000000 && !workerFailed; i++)
+                std::this_thread::yield();
+        });
+    }
+    catch (const std::runtime_error& e)
+    {
+        message = e.what();
+    }
+
+    QVERIFY(workerFailed.load());
+    QCOMPARE(message, QString("worker failed"));
+
+    // The pool processes the next range completely
+    std::atomic<int64_t> sum(0);
+    parallelFor(0, 1000, 10, [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            sum += i;
+    });
+    QCOMPARE(sum.load(), int64_t(499500));
+}
+
+void EnsightParallelTests::ParallelFor_AfterShutdown_WorkersRestarted()
+{
+    setNumThreads(4);
+    std::atomic<int64_t> sum(0);
+    auto body = [&](int64_t first, int64_t last) {
+        for (int64_t i = first; i < last; i++)
+            sum += i;
+    };
+    parallelFor(0, 1000, 10, body);
+
+    shutdown();
+    QCOMPARE(getNumThreads(), 4);
+
+    // Workers are started again on the next call
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    parallelFor(0, 1000, 10, [&](int64_t first, int64_t last) {
+        body(first, last);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+    });
+
+    QCOMPARE(sum.load(), int64_t(2 * 499500));
+    QVERIFY(threads.size() > 1);
+}
+
+void EnsightParallelTests::SetNumThreads_Default_AtLeastOneThread()
+{
+    setNumThreads(0);
+    QVERIFY(getNumThreads() >= 1);
+}
+
+void EnsightParallelTests::cleanup()
+{
+    setNumThreads(0);
+}
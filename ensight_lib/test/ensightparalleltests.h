@@ -0,0 +1,35 @@
+#ifndef ENSIGHTPARALLELTESTS_H
+#define ENSIGHTPARALLELTESTS_H
+
+#include <QtTest/QtTest>
+
+#include "ensightparallel.h"
+
+
+/*
+    Unit Tests for EnsightLib >> Ensight::Parallel
+*/
+class EnsightParallelTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void ParallelFor_FourThreads_EachIndexProcessedOnce();
+
+    void ParallelFor_SerialMode_ProcessedOnCallingThread();
+
+    void ParallelFor_NestedCall_ProcessedCompletely();
+
+    void ParallelFor_ErrorOnWorkerThread_MessagePassedToCaller();
+
+    void ParallelFor_ExceptionOnWorkerThread_RethrownOnCaller();
+
+    void ParallelFor_AfterShutdown_WorkersRestarted();
+
+    void SetNumThreads_Default_AtLeastOneThread();
+
+    void cleanup();
+};
+
+#endif // ENSIGHTPARALLELTESTS_H
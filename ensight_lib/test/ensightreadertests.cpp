@@ -7,7 +7,7 @@
 void EnsightReaderTests::init()
 {
     testEnsightCase = EnsightCase();
-    EnsightObj::ERROR_STR = "";
+    EnsightObj::errorString() = "";
     testEnsightCase.masterFileName = "";
 }
 
@@ -131,7 +131,7 @@ void EnsightReaderTests::ReadCaseFile_BadFilePath_SetsCorrectErrorString()
 
     QVERIFY(!successfulRead);
 
-    QString setErrorString = EnsightObj::ERROR_STR;
+    QString setErrorString = EnsightObj::errorString();
     QString expectedErrorString =
             "[EnsightReader::read()] Cannot read from file  " +
             testEnsightCase.masterFileName + ".";
@@ -181,7 +181,7 @@ void EnsightReaderTests::ReadCaseFile_UnequalTimesteps_SetsCorrectErrorString()
 
     QVERIFY(!successfulRead);
 
-    QString setErrorString = EnsightObj::ERROR_STR;
+    QString setErrorString = EnsightObj::errorString();
     QString expectedErrorString =
             "[EnsightReader::read()] Number of "
             "steps in file set must be equal to "
@@ -230,7 +230,7 @@ void EnsightReaderTests::ReadCaseFile_MissingGeometrySection_SetsCorrectErrorStr
 
     QVERIFY(!successfulRead);
 
-    QString setErrorString = EnsightObj::ERROR_STR;
+    QString setErrorString = EnsightObj::errorString();
     QString expectedErrorString =
             "[EnsightReader::read()] SECTION GEOMETRY  not found.";
 
@@ -466,7 +466,7 @@ void EnsightReaderTests::QStringRead_OutOfBoundsTimestepRequest_SetsCorrectError
 
     QVERIFY(!successfulRead);
 
-    QString setErrorString = EnsightObj::ERROR_STR;
+    QString setErrorString = EnsightObj::errorString();
 
     QString expectedErrorString =
             QString("In [EnsightReader::read()] requested time step %1 "
@@ -531,7 +531,7 @@ void EnsightReaderTests::QStringRead_FaultyWildcards_SetsCorrectErrorString()
     QVERIFY(!successfulRead);
 
 
-    QString setErrorString = EnsightObj::ERROR_STR;
+    QString setErrorString = EnsightObj::errorString();
 
     QString expectedErrorString =
         "In [EnsightReader::read()] for timestep = " +
@@ -592,7 +592,7 @@ void EnsightReaderTests::QStringRead_UnsupportedFortranFormat_SetsCorrectErrorSt
 
     QVERIFY(!successfulRead);
 
-    QString setErrorString = EnsightObj::ERROR_STR;
+    QString setErrorString = EnsightObj::errorString();
 
     QString expectedErrorString =
             "In [EnsightReader::read()] Format "
@@ -683,7 +683,7 @@ void EnsightReaderTests::QStringRead_UnableToCreateVariable_SetsCorrectErrorStri
 
     QVERIFY(!successfulReadPointer);
 
-    QString setErrorString{EnsightObj::ERROR_STR};
+    QString setErrorString{EnsightObj::errorString()};
 
     QString expectedErrorString01
             =   "In [EnsightAsciiReader::readGeometry()] Invalid file header.";
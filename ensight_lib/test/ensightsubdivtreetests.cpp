@@ -0,0 +1,996 @@
+#include "ensightsubdivtreetests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "ensightbarycentriccoordinates.h"
+#include "ensightcell.h"
+#include "ensightkdtree.h"
+#include "ensightleafbounds.h"
+#include "ensightlib.h"
+#include "ensightmemoryreport.h"
+#include "ensightobj.h"
+#include "ensightparallel.h"
+#include "ensightpart.h"
+
+namespace
+{
+
+// Regular grid of n^2 unit quadrangles or n^3 unit hexahedra. With several
+// shifts, the grid is transient and moved by shifts[t] along x at timestep t.
+std::unique_ptr<EnsightObj> createGrid(int n, bool quads, const std::vector<double>& shifts = {0.0})
+{
+    std::unique_ptr<EnsightObj> obj(EnsightLib::createEnsight());
+    obj->beginEdit();
+    if (shifts.size() > 1)
+        obj->setTransient(Vecx::LinSpaced(static_cast<int>(shifts.size()), 0, shifts.size() - 1));
+    else
+        obj->setStatic();
+
+    const int nz = quads ? 1 : n + 1;
+    auto vertexId = [n](int i, int j, int k) { return (k * (n + 1) + j) * (n + 1) + i; };
+
+    Matx vertices(3, (n + 1) * (n + 1) * nz);
+    for (int k = 0; k < nz; k++)
+        for (int j = 0; j <= n; j++)
+            for (int i = 0; i <= n; i++)
+                vertices.col(vertexId(i, j, k)) << i, j, k;
+
+    Mati cells(quads ? 4 : 8, quads ? n * n : n * n * n);
+    int c = 0;
+    for (int k = 0; k < nz - 1 || (quads && k == 0); k++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                cells(0, c) = vertexId(i, j, k);
+                cells(1, c) = vertexId(i + 1, j, k);
+                cells(2, c) = vertexId(i + 1, j + 1, k);
+                cells(3, c) = vertexId(i, j + 1, k);
+                if (!quads)
+                {
+                    cells(4, c) = vertexId(i, j, k + 1);
+                    cells(5, c) = vertexId(i + 1, j, k + 1);
+                    cells(6, c) = vertexId(i + 1, j + 1, k + 1);
+                    cells(7, c) = vertexId(i, j + 1, k + 1);
+                }
+                c++;
+            }
+        }
+    }
+
+    EnsightPart* part = obj->createEnsightPart(QString("grid"), 1);
+    for (size_t t = 0; t < shifts.size(); t++)
+    {
+        Matx shifted = vertices;
+        shifted.row(0).array() += shifts[t];
+        obj->setVertices(part, shifted, static_cast<int>(t));
+        obj->setCells(part, cells, static_cast<int>(t), quads ? Ensight::Quadrangle : Ensight::Hexahedron);
+    }
+    obj->endEdit();
+    return obj;
+}
+
+// Positions inside the grid, never on a cell face
+Matx samplePositions(int n, int count, bool quads)
+{
+    Matx positions(3, count);
+    for (int i = 0; i < count; i++)
+    {
+        positions(0, i) = std::fmod(0.37 + i * 0.618034, 1.0) * n;
+        positions(1, i) = std::fmod(0.11 + i * 0.414214, 1.0) * n;
+        positions(2, i) = quads ? 0.0 : std::fmod(0.23 + i * 0.732051, 1.0) * n;
+        for (int d = 0; d < (quads ? 2 : 3); d++)
+        {
+            if (std::fabs(positions(d, i) - std::round(positions(d, i))) < 1e-6)
+                positions(d, i) += 0.01;
+        }
+    }
+    return positions;
+}
+
+// Positions along a helix through the grid, moving less than a cell per step
+Matx particlePath(int n, int count, bool quads)
+{
+    Matx positions(3, count);
+    for (int i = 0; i < count; i++)
+    {
+        const double t = 0.01 * i;
+        positions(0, i) = 0.5 * n + 0.35 * n * std::cos(t);
+        positions(1, i) = 0.5 * n + 0.35 * n * std::sin(t);
+        positions(2, i) = quads ? 0.0 : 0.1 * n + std::fmod(0.05 * i, 0.8 * n);
+    }
+    return positions;
+}
+
+// True if pos is farther than d from all faces of the unit grid cells
+bool awayFromFaces(const Vec3& pos, double d, bool quads)
+{
+    for (int k = 0; k < (quads ? 2 : 3); k++)
+    {
+        if (std::fabs(pos[k] - std::round(pos[k])) < d)
+            return false;
+    }
+    return true;
+}
+
+// The first vertex of the cell containing pos
+int expectedFirstVertex(const Vec3& pos, int n)
+{
+    const int i = static_cast<int>(pos[0]);
+    const int j = static_cast<int>(pos[1]);
+    const int k = static_cast<int>(pos[2]);
+    return (k * (n + 1) + j) * (n + 1) + i;
+}
+
+// The first vertex of the first cell containing pos found by testing all cells,
+// -1 if no cell contains pos
+int bruteForceFirstVertex(EnsightPart* part, const Vec3& pos)
+{
+    EnsightCellList* cellList = part->getCells(0).front();
+    MatxView vertices = part->getVertices(0);
+    for (int k = 0; k < cellList->getValues().cols(); k++)
+    {
+        Bbox bounds;
+        for (int i = 0; i < cellList->getValues().rows(); i++)
+            bounds.extend(Vec3(vertices.col(cellList->getValues()(i, k))));
+
+        EnsightCellIdentifier cell(part, cellList, 0, k, bounds);
+        if (cell.contains(pos, true))
+            return cellList->getValues()(0, k);
+    }
+    return -1;
+}
+
+// The k vertices closest to pos as (squared distance, vertex) by testing all
+// vertices, ties sorted by index
+std::vector<std::pair<double, int>> bruteForceNearest(const Eigen::Ref<const Matx>& vertices, const Vec3& pos,
+                                                      size_t k, double maxDistance)
+{
+    std::vector<std::pair<double, int>> nearest;
+    for (int i = 0; i < vertices.cols(); i++)
+    {
+        const double dx = vertices(0, i) - pos[0];
+        const double dy = vertices(1, i) - pos[1];
+        const double dz = vertices(2, i) - pos[2];
+        const double distSq = dx * dx + dy * dy + dz * dz;
+        if (distSq <= maxDistance * maxDistance)
+            nearest.push_back(std::make_pair(distSq, i));
+    }
+    std::sort(nearest.begin(), nearest.end());
+    nearest.resize(std::min(k, nearest.size()));
+    return nearest;
+}
+
+}
+
+void EnsightSubdivTreeTests::Search_QuadGrid_CellContainingPositionFound()
+{
+    const int n = 20;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, true);
+    QVERIFY(testObj->createSubdivTree(8, 4, QStringList()));
+
+    auto tree = dynamic_cast<const EnsightQuadtree*>(testObj->getSubdivTree());
+    QVERIFY(tree != nullptr);
+    QVERIFY(tree->getNumberOfNodes() > 1);
+
+    Matx positions = samplePositions(n, 500, true);
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        Vec3 pos = positions.col(i);
+        EnsightCellIdentifier* cell = tree->search(pos);
+        QVERIFY(cell != nullptr);
+        QCOMPARE(cell->getCell()[0], expectedFirstVertex(pos, n));
+    }
+    QVERIFY(tree->search(Vec3(-1, 0.5, 0)) == nullptr);
+}
+
+void EnsightSubdivTreeTests::Search_HexGrid_SameCellAsTestingAllCells()
+{
+    const int n = 10;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    QVERIFY(testObj->createSubdivTree(6, 4, QStringList()));
+
+    auto tree = dynamic_cast<const EnsightOctree*>(testObj->getSubdivTree());
+    QVERIFY(tree != nullptr);
+    QVERIFY(tree->getNumberOfNodes() > 1);
+
+    // The hexahedron test is not exact, compare with testing all cells
+    Matx positions = samplePositions(n, 200, false);
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        Vec3 pos = positions.col(i);
+        EnsightCellIdentifier* cell = tree->search(pos);
+        QCOMPARE(cell ? cell->getCell()[0] : -1, bruteForceFirstVertex(testObj->getPart(0), pos));
+    }
+}
+
+void EnsightSubdivTreeTests::SearchAll_HexGrid_AllCellsWithBoundsContainingPositionFound()
+{
+    const int n = 6;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    QVERIFY(testObj->createSubdivTree(5, 2, QStringList()));
+    EnsightSubdivTree* tree = testObj->getSubdivTree();
+
+    // Inside a cell, on a face, on an edge and on a vertex
+    QCOMPARE(tree->searchAll(Vec3(2.5, 2.5, 2.5)).size(), 1);
+    QCOMPARE(tree->searchAll(Vec3(2.0, 2.5, 2.5)).size(), 2);
+    QCOMPARE(tree->searchAll(Vec3(2.0, 2.0, 2.5)).size(), 4);
+    QCOMPARE(tree->searchAll(Vec3(2.0, 2.0, 2.0)).size(), 8);
+}
+
+void EnsightSubdivTreeTests::GetLeafBounds_Octree_LeavesCoverBounds()
+{
+    std::unique_ptr<EnsightObj> testObj = createGrid(6, false);
+    QVERIFY(testObj->createSubdivTree(4, 8, QStringList()));
+
+    auto tree = dynamic_cast<const EnsightOctree*>(testObj->getSubdivTree());
+    QVERIFY(tree != nullptr);
+
+    QVector<Bbox> leafBounds = tree->getLeafBounds();
+    QCOMPARE((leafBounds.size() - 1) % 7, 0);
+
+    double volume = 0.0;
+    for (const Bbox& bounds : leafBounds)
+    {
+        QVERIFY(tree->getBounds().contains(bounds.center()));
+        volume += bounds.diagonal().prod();
+    }
+    QVERIFY(std::fabs(volume - tree->getBounds().diagonal().prod()) < 1e-9);
+}
+
+void EnsightSubdivTreeTests::Build_FourThreads_SameTreeAsSerial()
+{
+    // Enough cells that the first levels are partitioned in several chunks
+    const int n = 30;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+
+    Ensight::Parallel::setNumThreads(1);
+    QVERIFY(testObj->createSubdivTree(5, 3, QStringList()));
+    auto serialTree = dynamic_cast<const EnsightOctree*>(testObj->getSubdivTree());
+    const int numNodes = serialTree->getNumberOfNodes();
+    QVector<Bbox> leafBounds = serialTree->getLeafBounds();
+    Matx positions = samplePositions(n, 200, false);
+    QVector<int> cells;
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        EnsightCellIdentifier* cell = serialTree->search(Vec3(positions.col(i)));
+        cells.push_back(cell ? cell->getCell()[0] : -1);
+    }
+
+    Ensight::Parallel::setNumThreads(4);
+    QVERIFY(testObj->createSubdivTree(5, 3, QStringList()));
+    Ensight::Parallel::setNumThreads(0);
+    auto tree = dynamic_cast<const EnsightOctree*>(testObj->getSubdivTree());
+
+    QCOMPARE(tree->getNumberOfNodes(), numNodes);
+    QVector<Bbox> parallelLeafBounds = tree->getLeafBounds();
+    QCOMPARE(parallelLeafBounds.size(), leafBounds.size());
+    for (int i = 0; i < leafBounds.size(); i++)
+    {
+        QVERIFY(parallelLeafBounds[i].minCorner() == leafBounds[i].minCorner());
+        QVERIFY(parallelLeafBounds[i].maxCorner() == leafBounds[i].maxCorner());
+    }
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        EnsightCellIdentifier* cell = tree->search(Vec3(positions.col(i)));
+        QCOMPARE(cell ? cell->getCell()[0] : -1, cells[i]);
+    }
+}
+
+void EnsightSubdivTreeTests::Search_HexGrid_Benchmark()
+{
+    // 125k hexahedra, deep enough that the descent from the root matters
+    const int n = 50;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    QVERIFY(testObj->createSubdivTree(8, 4, QStringList()));
+    EnsightSubdivTree* tree = testObj->getSubdivTree();
+
+    Matx positions = samplePositions(n, 10000, false);
+    tree->search(Vec3(positions.col(0)));
+
+    int found = 0;
+    QBENCHMARK
+    {
+        found = 0;
+        for (int i = 0; i < positions.cols(); i++)
+        {
+            if (tree->search(Vec3(positions.col(i))))
+                found++;
+        }
+    }
+    QVERIFY(found > 0);
+}
+
+void EnsightSubdivTreeTests::BvhSearch_HexGrid_SameCellAsOctree()
+{
+    const int n = 10;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    Matx positions = samplePositions(n, 300, false);
+
+    QVERIFY(testObj->createSubdivTree(6, 4, QStringList()));
+    QVector<int> octreeCells;
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        EnsightCellIdentifier* cell = testObj->interpolate(Vec3(positions.col(i)));
+        octreeCells.push_back(cell ? cell->getCell()[0] : -1);
+    }
+
+    QVERIFY(testObj->createSubdivTree(6, 4, QStringList(), 0.0, Ensight::BoundingVolumeHierarchy));
+    auto bvh = dynamic_cast<const EnsightBvh*>(testObj->getSubdivTree());
+    QVERIFY(bvh != nullptr);
+    QVERIFY(bvh->getNumberOfNodes() > 1);
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        EnsightCellIdentifier* cell = testObj->interpolate(Vec3(positions.col(i)));
+        QCOMPARE(cell ? cell->getCell()[0] : -1, octreeCells[i]);
+    }
+    QVERIFY(bvh->search(Vec3(-1, 0.5, 0.5)) == nullptr);
+}
+
+void EnsightSubdivTreeTests::BvhSearchAll_SizeOffset_SameCellsAsOctree()
+{
+    const int n = 8;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, true);
+    EnsightPart* part = testObj->getPart(0);
+    Bbox bounds = testObj->getGeometryBounds(0, QStringList());
+    bounds.increaseBy(0.5);
+
+    EnsightQuadtree quadtree(bounds, 5, 2);
+    quadtree.insert(part, 0, 0.5);
+    EnsightBvh bvh(bounds, 2, false);
+    bvh.insert(part, 0, 0.5);
+
+    // The increased bounds of 3x3 cells contain the center of a cell
+    QCOMPARE(bvh.searchAll(Vec3(2.5, 2.5, 0)).size(), 9);
+
+    Matx positions = samplePositions(n, 100, true);
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        QList<int> expected;
+        for (EnsightCellIdentifier* cell : quadtree.searchAll(Vec3(positions.col(i))))
+            expected.push_back(cell->getCell()[0]);
+        QList<int> found;
+        for (EnsightCellIdentifier* cell : bvh.searchAll(Vec3(positions.col(i))))
+            found.push_back(cell->getCell()[0]);
+
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        QVERIFY(expected == found);
+    }
+}
+
+void EnsightSubdivTreeTests::BvhSearch_HexGrid_Benchmark()
+{
+    const int n = 30;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    QVERIFY(testObj->createSubdivTree(8, 8, QStringList(), 0.0, Ensight::BoundingVolumeHierarchy));
+    EnsightSubdivTree* tree = testObj->getSubdivTree();
+
+    Matx positions = samplePositions(n, 10000, false);
+
+    int found = 0;
+    QBENCHMARK
+    {
+        found = 0;
+        for (int i = 0; i < positions.cols(); i++)
+        {
+            if (tree->search(Vec3(positions.col(i))))
+                found++;
+        }
+    }
+    QVERIFY(found > 0);
+}
+
+void EnsightSubdivTreeTests::SearchBatch_FourThreads_SameAsSinglePositions()
+{
+    const int n = 10;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    Matx positions = samplePositions(n, 1000, false);
+    positions.col(7) << -1, 0.5, 0.5;
+
+    const Ensight::SubdivTreeType types[] = {Ensight::SpatialSubdivision,
+                                             Ensight::BoundingVolumeHierarchy};
+    for (Ensight::SubdivTreeType type : types)
+    {
+        QVERIFY(testObj->createSubdivTree(6, 4, QStringList(), 0.0, type));
+
+        Ensight::Parallel::setNumThreads(4);
+        QVector<EnsightBarycentricCoordinates> baryCoords;
+        QVector<EnsightCellIdentifier*> cells = testObj->interpolate(positions, baryCoords);
+        Ensight::Parallel::setNumThreads(0);
+
+        QCOMPARE(cells.size(), int(positions.cols()));
+        QCOMPARE(baryCoords.size(), int(positions.cols()));
+        QVERIFY(cells[7] == nullptr);
+        for (int i = 0; i < positions.cols(); i++)
+        {
+            EnsightBarycentricCoordinates expectedCoords;
+            EnsightCellIdentifier* expected = testObj->interpolate(Vec3(positions.col(i)), expectedCoords);
+            QVERIFY(cells[i] == expected);
+            if (expected)
+                QVERIFY(baryCoords[i].getCoords() == expectedCoords.getCoords());
+        }
+    }
+}
+
+void EnsightSubdivTreeTests::SearchBatch_HexGrid_Benchmark()
+{
+    const int n = 30;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    QVERIFY(testObj->createSubdivTree(8, 8, QStringList()));
+    EnsightSubdivTree* tree = testObj->getSubdivTree();
+
+    Matx positions = samplePositions(n, 10000, false);
+
+    QVector<EnsightCellIdentifier*> cells;
+    QBENCHMARK
+    {
+        QVector<EnsightBarycentricCoordinates> baryCoords;
+        cells = tree->search(positions, baryCoords);
+    }
+    QCOMPARE(cells.size(), int(positions.cols()));
+}
+
+void EnsightSubdivTreeTests::Search_HexGrid_IdentifiersCreatedForFoundCellsOnly()
+{
+    std::unique_ptr<EnsightObj> testObj = createGrid(10, false);
+    QVERIFY(testObj->createSubdivTree(6, 4, QStringList()));
+    EnsightSubdivTree* tree = testObj->getSubdivTree();
+
+    auto identifierBytes = [&]() {
+        for (const EnsightMemoryReport::Entry& entry : testObj->getMemoryReport().entries)
+        {
+            if (entry.category == "subdivtree" && entry.name == "cell identifiers")
+                return entry.bytes;
+        }
+        return int64_t(-1);
+    };
+    const int64_t emptyBytes = identifierBytes();
+    QVERIFY(emptyBytes >= 0);
+
+    // The identifier of a found cell is created once and kept
+    Matx positions = samplePositions(10, 20, false);
+    EnsightBarycentricCoordinates baryCoords;
+    EnsightCellIdentifier* cell = nullptr;
+    Vec3 pos;
+    for (int i = 0; i < positions.cols() && !cell; i++)
+    {
+        pos = positions.col(i);
+        cell = tree->search(pos, baryCoords);
+    }
+    QVERIFY(cell != nullptr);
+    QVERIFY(baryCoords.isValid());
+    QVERIFY(tree->search(pos) == cell);
+    QVERIFY(identifierBytes() > emptyBytes);
+    QVERIFY(identifierBytes() < emptyBytes + 1000 * int64_t(sizeof(EnsightCellIdentifier)) / 4);
+}
+
+void EnsightSubdivTreeTests::LeafBoundsFilter_HexGrid_AllCellsWithBoundsContainingPositionSelected()
+{
+    const int n = 6;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    EnsightCellRecords records;
+    records.append(testObj->getPart(0), 0, 0.1);
+
+    // All cells in one leaf, in reverse order. The leaf bounds need not
+    // contain the cells or the positions.
+    std::vector<EnsightCellRecords::Index> cells(records.size());
+    for (size_t i = 0; i < cells.size(); i++)
+        cells[i] = static_cast<EnsightCellRecords::Index>(cells.size() - 1 - i);
+    const int count = static_cast<int>(cells.size());
+
+    const Bbox leaves[] = {Bbox(Vec3(0, 0, 0), Vec3(n, n, n)),
+                           Bbox(Vec3(1, 2, 1), Vec3(3, 3, 4)),
+                           Bbox(Vec3(2, 2, 2), Vec3(2, 2, 2))};
+    Matx positions = samplePositions(n, 100, false);
+    positions.col(0) << 2.0, 2.0, 2.0;
+    positions.col(1) << -1.0, 3.0, 3.0;
+    for (const Bbox& leafBounds : leaves)
+    {
+        EnsightLeafBounds leafBoundsFilter;
+        leafBoundsFilter.resize(cells.size());
+        leafBoundsFilter.set(0, count, leafBounds, cells.data(), records);
+
+        std::vector<EnsightCellRecords::Index> survivors(cells.size());
+        for (int i = 0; i < positions.cols(); i++)
+        {
+            const Vec3 pos = positions.col(i);
+            const int numSurvivors = leafBoundsFilter.filter(0, count, leafBounds, pos,
+                                                             cells.data(), survivors.data());
+            std::vector<EnsightCellRecords::Index> expected;
+            for (EnsightCellRecords::Index cell : cells)
+            {
+                if (records.boundsContain(cell, pos))
+                    expected.push_back(cell);
+            }
+
+            // The exact test on the survivors gives the same cells in the same order
+            std::vector<EnsightCellRecords::Index> selected;
+            for (int k = 0; k < numSurvivors; k++)
+            {
+                if (records.boundsContain(survivors[k], pos))
+                    selected.push_back(survivors[k]);
+            }
+            QVERIFY(selected == expected);
+        }
+    }
+}
+
+void EnsightSubdivTreeTests::SearchHint_ParticlePath_SameCellAsTree()
+{
+    const int n = 10;
+    for (bool quads : {true, false})
+    {
+        std::unique_ptr<EnsightObj> testObj = createGrid(n, quads);
+        QVERIFY(testObj->createSubdivTree(6, 4, QStringList()));
+
+        // The hexahedron test is not exact, the hint is kept over positions
+        // no cell is found for
+        Matx positions = particlePath(n, 2000, quads);
+        EnsightCellIdentifier* hint = nullptr;
+        EnsightCellIdentifier* cell = nullptr;
+        for (int i = 0; i < positions.cols(); i++)
+        {
+            const Vec3 pos = positions.col(i);
+            EnsightBarycentricCoordinates baryCoords;
+            hint = cell ? cell : hint;
+            EnsightCellIdentifier* treeCell = testObj->interpolate(pos);
+            cell = testObj->interpolate(pos, baryCoords, hint);
+            QCOMPARE(cell != nullptr, treeCell != nullptr);
+
+            // Close to faces several cells contain pos within the tolerance
+            if (awayFromFaces(pos, 0.1, quads))
+            {
+                QVERIFY(cell == treeCell);
+                if (quads)
+                    QCOMPARE(cell->getCell()[0], expectedFirstVertex(pos, n));
+            }
+        }
+    }
+}
+
+void EnsightSubdivTreeTests::SearchHint_DistantHint_FallsBackToTree()
+{
+    const int n = 10;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, true);
+    QVERIFY(testObj->createSubdivTree(6, 4, QStringList(), 0.0, Ensight::BoundingVolumeHierarchy));
+    EnsightSubdivTree* tree = testObj->getSubdivTree();
+
+    EnsightCellIdentifier* hint = tree->search(Vec3(0.5, 0.5, 0));
+    QVERIFY(hint != nullptr);
+
+    const Vec3 pos(8.5, 7.5, 0);
+    EnsightCellIdentifier* expected = tree->search(pos);
+    QVERIFY(expected != nullptr);
+    QCOMPARE(expected->getCell()[0], expectedFirstVertex(pos, n));
+    EnsightBarycentricCoordinates baryCoords;
+    QVERIFY(tree->search(pos, baryCoords, hint, 2) == expected);
+    QVERIFY(tree->search(pos, baryCoords, hint, 100) == expected);
+
+    // Outside of the grid
+    QVERIFY(tree->search(Vec3(-1, 0.5, 0), baryCoords, hint) == nullptr);
+}
+
+void EnsightSubdivTreeTests::SearchHint_ParticlePath_Benchmark()
+{
+    const int n = 300;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, true);
+    QVERIFY(testObj->createSubdivTree(8, 8, QStringList()));
+
+    Matx positions = particlePath(n, 10000, true);
+
+    EnsightCellIdentifier* cell = nullptr;
+    QBENCHMARK
+    {
+        EnsightBarycentricCoordinates baryCoords;
+        for (int i = 0; i < positions.cols(); i++)
+            cell = testObj->interpolate(Vec3(positions.col(i)), baryCoords, cell);
+    }
+    QVERIFY(cell != nullptr);
+}
+
+void EnsightSubdivTreeTests::GetSubdivTree_MovingGrid_CellsFoundAtEachTimestep()
+{
+    const int n = 8;
+    const std::vector<double> shifts = {0.0, 0.0, 3.0, 0.5};
+    for (Ensight::SubdivTreeType type : {Ensight::SpatialSubdivision, Ensight::BoundingVolumeHierarchy})
+    {
+        std::unique_ptr<EnsightObj> testObj = createGrid(n, true, shifts);
+        QVERIFY(testObj->createSubdivTree(6, 4, QStringList(), 0.0, type));
+        QVERIFY(testObj->getSubdivTree(-1) == nullptr);
+        QVERIFY(testObj->getSubdivTree(4) == nullptr);
+
+        // Identical geometry shares the structure, but not the identifiers
+        QVERIFY(testObj->getSubdivTree(1) != testObj->getSubdivTree(0));
+        QVERIFY(testObj->getSubdivTree(2) != testObj->getSubdivTree(0));
+
+        // A variable changing over time on the static grid of timesteps 0 and 1
+        EnsightPart* part = testObj->getPart(0);
+        testObj->beginEdit();
+        testObj->createVariable(QString("u"), Ensight::ScalarPerNode);
+        for (int t = 0; t < static_cast<int>(shifts.size()); t++)
+        {
+            Matx values = part->getVertices(t).row(0).array() + 100.0 * t;
+            QVERIFY(testObj->setVariable(part, QString("u"), values, Ensight::ScalarPerNode, t));
+        }
+        testObj->endEdit();
+
+        Matx positions = samplePositions(n, 100, true);
+        for (int t = 0; t < static_cast<int>(shifts.size()); t++)
+        {
+            EnsightSubdivTree* tree = testObj->getSubdivTree(t);
+            QCOMPARE(tree->getBounds().minCorner()[0], shifts[t]);
+            for (int i = 0; i < positions.cols(); i++)
+            {
+                const Vec3 pos = positions.col(i);
+                EnsightBarycentricCoordinates baryCoords;
+                EnsightCellIdentifier* cell = testObj->interpolate(pos + Vec3(shifts[t], 0, 0), baryCoords,
+                                                                   nullptr, t);
+                QVERIFY(cell != nullptr);
+                QCOMPARE(cell->getCell()[0], expectedFirstVertex(pos, n));
+                QCOMPARE(cell->getTimestep(), t);
+                QVERIFY(std::fabs(baryCoords.evaluate(QString("u"))[0] - (pos[0] + shifts[t] + 100.0 * t)) < 1e-9);
+                QVERIFY(testObj->interpolate(Vec3(pos + Vec3(shifts[t], 0, 0)), t) == cell);
+            }
+        }
+
+        // The hierarchy of a moved timestep keeps the structure of timestep 0
+        if (type == Ensight::BoundingVolumeHierarchy)
+        {
+            auto tree = dynamic_cast<const EnsightBvh*>(testObj->getSubdivTree(0));
+            auto movedTree = dynamic_cast<const EnsightBvh*>(testObj->getSubdivTree(3));
+            QVERIFY(tree != nullptr && movedTree != nullptr);
+            QCOMPARE(movedTree->getNumberOfNodes(), tree->getNumberOfNodes());
+            QCOMPARE(movedTree->getLeafBounds()[0].minCorner()[0], tree->getLeafBounds()[0].minCorner()[0] + 0.5);
+        }
+    }
+}
+
+void EnsightSubdivTreeTests::GetSubdivTree_TimestepsAddedAfterCreation_TreesBuiltForNewTimesteps()
+{
+    const int n = 8;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, true);
+    QVERIFY(testObj->createSubdivTree(6, 4, QStringList()));
+    EnsightSubdivTree* tree = testObj->getSubdivTree(0);
+    QVERIFY(testObj->getSubdivTree(1) == nullptr);
+
+    // Add a timestep with the grid moved along x
+    EnsightPart* part = testObj->getPart(0);
+    Matx vertices = part->getVertices(0);
+    vertices.row(0).array() += 20.0;
+    Mati cells = part->getCells(0)[0]->getValues();
+    testObj->beginEdit();
+    QVERIFY(testObj->setTransient(Vecx::LinSpaced(2, 0, 1)));
+    QVERIFY(testObj->setVertices(part, vertices, 1));
+    QVERIFY(testObj->setCells(part, cells, 1, Ensight::Quadrangle));
+    testObj->endEdit();
+
+    QVERIFY(testObj->getSubdivTree(0) == tree);
+    QVERIFY(testObj->getSubdivTree(1) != nullptr);
+    Matx positions = samplePositions(n, 50, true);
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        const Vec3 pos = positions.col(i);
+        EnsightBarycentricCoordinates baryCoords;
+        EnsightCellIdentifier* cell = testObj->interpolate(Vec3(pos + Vec3(20.0, 0, 0)), baryCoords, 1);
+        QVERIFY(cell != nullptr);
+        QCOMPARE(cell->getCell()[0], expectedFirstVertex(pos, n));
+        QVERIFY(testObj->interpolate(Vec3(pos + Vec3(20.0, 0, 0)), 0) == nullptr);
+    }
+
+    testObj->beginEdit();
+    QVERIFY(testObj->setStatic());
+    testObj->endEdit();
+    QVERIFY(testObj->getSubdivTree(0) == tree);
+    QVERIFY(testObj->getSubdivTree(1) == nullptr);
+}
+
+void EnsightSubdivTreeTests::LoadSubdivTree_SavedTree_SameCellsAsBuiltTree()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("tree.bin");
+
+    const int n = 8;
+    for (bool quads : {true, false})
+    {
+        for (Ensight::SubdivTreeType type : {Ensight::SpatialSubdivision, Ensight::BoundingVolumeHierarchy})
+        {
+            std::unique_ptr<EnsightObj> builtObj = createGrid(n, quads);
+            QVERIFY(builtObj->createSubdivTree(6, 4, QStringList(), 0.0, type));
+            QVERIFY(builtObj->saveSubdivTree(filename));
+            QVERIFY(!QFile::exists(filename + ".tmp"));
+
+            std::unique_ptr<EnsightObj> loadedObj = createGrid(n, quads);
+            QVERIFY(loadedObj->loadSubdivTree(filename, 6, 4, QStringList(), 0.0, type));
+            EnsightSubdivTree* builtTree = builtObj->getSubdivTree();
+            EnsightSubdivTree* loadedTree = loadedObj->getSubdivTree();
+            QVERIFY(loadedTree != nullptr);
+            QCOMPARE(loadedTree->getBounds().maxCorner(), builtTree->getBounds().maxCorner());
+
+            Matx positions = samplePositions(n, 100, quads);
+            for (int i = 0; i < positions.cols(); i++)
+            {
+                const Vec3 pos = positions.col(i);
+                EnsightCellIdentifier* builtCell = builtTree->search(pos);
+                EnsightCellIdentifier* loadedCell = loadedTree->search(pos);
+                QCOMPARE(loadedCell ? loadedCell->getCell()[0] : -1, builtCell ? builtCell->getCell()[0] : -1);
+                QCOMPARE(loadedTree->searchAll(pos).size(), builtTree->searchAll(pos).size());
+            }
+        }
+    }
+}
+
+void EnsightSubdivTreeTests::LoadSubdivTree_OtherGeometryOrParameters_ReturnsFalse()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("tree.bin");
+
+    const int n = 6;
+    std::unique_ptr<EnsightObj> builtObj = createGrid(n, false);
+    QVERIFY(builtObj->createSubdivTree(5, 4, QStringList()));
+    QVERIFY(builtObj->saveSubdivTree(filename));
+
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    QVERIFY(!testObj->loadSubdivTree(dir.filePath("missing.bin"), 5, 4, QStringList()));
+    QVERIFY(!testObj->loadSubdivTree(filename, 5, 8, QStringList()));
+    QVERIFY(!testObj->loadSubdivTree(filename, 5, 4, QStringList(), 0.1));
+    QVERIFY(!testObj->loadSubdivTree(filename, 5, 4, QStringList(), 0.0, Ensight::BoundingVolumeHierarchy));
+    QVERIFY(!testObj->loadSubdivTree(filename, 5, 4, QStringList() << "grid"));
+    QVERIFY(testObj->getSubdivTree() == nullptr);
+
+    std::unique_ptr<EnsightObj> movedObj = createGrid(n, false, {0.5});
+    QVERIFY(!movedObj->loadSubdivTree(filename, 5, 4, QStringList()));
+
+    // A truncated file keeps the current tree
+    QVERIFY(testObj->createSubdivTree(5, 4, QStringList()));
+    EnsightSubdivTree* tree = testObj->getSubdivTree();
+    QFile file(filename);
+    QVERIFY(file.resize(file.size() - 8));
+    QVERIFY(!testObj->loadSubdivTree(filename, 5, 4, QStringList()));
+    QVERIFY(testObj->getSubdivTree() == tree);
+}
+
+void EnsightSubdivTreeTests::LoadSubdivTree_CorruptSizes_ReturnsFalse()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filename = dir.filePath("tree.bin");
+
+    // Offsets of the sizes after the file header and the tree bounds
+    struct Corruption
+    {
+        Ensight::SubdivTreeType type;
+        std::streamoff offset;
+        uint64_t value;
+    };
+    const std::streamoff sizesOffset = 16 + 6 * sizeof(double);
+    const Corruption corruptions[] = {
+        {Ensight::SpatialSubdivision, sizesOffset + 3 * 8, 0xfffffff0},  // nodes beyond the file
+        {Ensight::SpatialSubdivision, sizesOffset + 4 * 8, 0xfffffff0},  // leaf cells beyond the file
+        {Ensight::BoundingVolumeHierarchy, sizesOffset + 2 * 8, 0xfffffff0},  // nodes beyond the file
+        {Ensight::BoundingVolumeHierarchy, sizesOffset + 2 * 8, 1000},  // more nodes than cells allow
+    };
+
+    const int n = 6;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    for (const Corruption& corruption : corruptions)
+    {
+        std::unique_ptr<EnsightObj> builtObj = createGrid(n, false);
+        QVERIFY(builtObj->createSubdivTree(5, 4, QStringList(), 0.0, corruption.type));
+        QVERIFY(builtObj->saveSubdivTree(filename));
+        QVERIFY(testObj->loadSubdivTree(filename, 5, 4, QStringList(), 0.0, corruption.type));
+
+        std::fstream file(filename.toStdString().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(corruption.offset);
+        file.write(reinterpret_cast<const char*>(&corruption.value), sizeof(uint64_t));
+        file.close();
+        QVERIFY(!testObj->loadSubdivTree(filename, 5, 4, QStringList(), 0.0, corruption.type));
+    }
+}
+
+void EnsightSubdivTreeTests::KdTreeFindNearest_GridVertices_SameAsBruteForce()
+{
+    const int n = 8;
+    std::unique_ptr<EnsightObj> testObj = createGrid(n, false);
+    QVERIFY(testObj->createSubdivTree(5, 4, QStringList()));
+    const EnsightKdTree* tree = testObj->getVertexTree();
+    QVERIFY(tree != nullptr);
+    QCOMPARE(tree->size(), (n + 1) * (n + 1) * (n + 1));
+
+    EnsightPart* part = testObj->getPart(0);
+    const MatxView vertices = part->getVertices(0);
+
+    // Positions inside and around the grid
+    Matx positions = samplePositions(n, 200, false);
+    positions = (1.5 * positions).array() - 0.25 * n;
+    positions.col(0) << 2, 3, 4;
+
+    const double radius = 1.5;
+    QVector<QVector<EnsightKdTree::Neighbor>> nearestBatch, withinBatch;
+    tree->findNearest(positions, 10, nearestBatch);
+    tree->findWithinRadius(positions, radius, withinBatch);
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        const Vec3 pos = positions.col(i);
+        const QVector<EnsightKdTree::Neighbor> nearest = tree->findNearest(pos, 10);
+        auto expected = bruteForceNearest(vertices, pos, 10, std::numeric_limits<double>::infinity());
+        QCOMPARE(nearest.size(), 10);
+        for (int k = 0; k < nearest.size(); k++)
+        {
+            QVERIFY(nearest[k].part == part);
+            QCOMPARE(nearest[k].vertex, expected[k].second);
+            QCOMPARE(nearest[k].distance, std::sqrt(expected[k].first));
+            QCOMPARE(nearestBatch[i][k].vertex, nearest[k].vertex);
+        }
+
+        const QVector<EnsightKdTree::Neighbor> within = tree->findWithinRadius(pos, radius);
+        expected = bruteForceNearest(vertices, pos, vertices.cols(), radius);
+        QCOMPARE(within.size(), static_cast<int>(expected.size()));
+        QCOMPARE(withinBatch[i].size(), within.size());
+        for (int k = 0; k < within.size(); k++)
+        {
+            QCOMPARE(within[k].vertex, expected[k].second);
+            QCOMPARE(withinBatch[i][k].vertex, within[k].vertex);
+        }
+    }
+
+    // The vertex at pos itself
+    QCOMPARE(tree->findNearest(Vec3(2, 3, 4), 1)[0].distance, 0.0);
+    QVERIFY(tree->findNearest(Vec3(2, 3, 4), 0).isEmpty());
+    QVERIFY(tree->findWithinRadius(Vec3(-5, 0, 0), 1.0).isEmpty());
+}
+
+void EnsightSubdivTreeTests::FindNearestCell_OutsidePositions_ClosestPointInterpolated()
+{
+    for (bool quads : {true, false})
+    {
+        const int n = 4;
+        std::unique_ptr<EnsightObj> testObj = createGrid(n, quads);
+        QVERIFY(testObj->createSubdivTree(5, 4, QStringList()));
+        const MatxView vertices = testObj->getPart(0)->getVertices(0);
+
+        // Positions outside of the grid with their closest points
+        Matx positions(3, 4);
+        Matx closest(3, 4);
+        positions.col(0) << -0.5, 1.5, 0.0;
+        closest.col(0) << 0.0, 1.5, 0.0;
+        positions.col(1) << n + 1.0, n + 2.0, 0.0;
+        closest.col(1) << n, n, 0.0;
+        positions.col(2) << 2.5, -3.0, 0.0;
+        closest.col(2) << 2.5, 0.0, 0.0;
+        positions.col(3) << 1.5, 2.5, 0.0;  // inside
+        closest.col(3) << 1.5, 2.5, 0.0;
+        if (!quads)
+        {
+            positions.row(2) << 0.5, 1.5, 2.5, n + 2.0;
+            closest.row(2) << 0.5, 1.5, 2.5, n;
+        }
+
+        QVector<EnsightBarycentricCoordinates> baryCoordsBatch;
+        QVector<double> distancesBatch;
+        const QVector<EnsightCellIdentifier*> cellsBatch =
+            testObj->findNearestCell(positions, baryCoordsBatch, distancesBatch);
+        for (int i = 0; i < positions.cols(); i++)
+        {
+            EnsightBarycentricCoordinates baryCoord;
+            double distance = -1.0;
+            EnsightCellIdentifier* cell = testObj->findNearestCell(positions.col(i), baryCoord, distance);
+            QVERIFY(cell != nullptr);
+            QVERIFY(baryCoord.isValid());
+            QVERIFY(cell->getBounds().contains(closest.col(i)));
+            QVERIFY(std::fabs(distance - (positions.col(i) - closest.col(i)).norm()) < 1e-12);
+            QVERIFY((baryCoord.evaluate(vertices) - closest.col(i)).norm() < 1e-12);
+            QVERIFY(cellsBatch[i] == cell);
+            QCOMPARE(distancesBatch[i], distance);
+        }
+
+        // Inside the grid, the cell containing the position. The hexahedron
+        // test is not exact, such cells are then found by their faces.
+        const Vec3 inside(1.3, 2.6, quads ? 0.0 : 0.2);
+        EnsightBarycentricCoordinates baryCoord;
+        double distance = -1.0;
+        EnsightCellIdentifier* cell = testObj->findNearestCell(inside, baryCoord, distance);
+        QVERIFY(cell != nullptr);
+        QCOMPARE(cell->getCell()[0], expectedFirstVertex(inside, n));
+        if (testObj->interpolate(inside))
+        {
+            QVERIFY(cell == testObj->interpolate(inside));
+            QCOMPARE(distance, 0.0);
+        }
+    }
+}
+
+void EnsightSubdivTreeTests::FindNearestCell_PointCells_NearestPointFound()
+{
+    // Scattered points, e.g. particles or probes
+    const int numPoints = 500;
+    Matx points(3, numPoints);
+    Mati cells(1, numPoints);
+    for (int i = 0; i < numPoints; i++)
+    {
+        points.col(i) << std::fmod(0.37 + i * 0.618034, 1.0),
+                         std::fmod(0.11 + i * 0.414214, 1.0),
+                         std::fmod(0.23 + i * 0.732051, 1.0);
+        cells(0, i) = i;
+    }
+    Matx values = points.row(0) + 2.0 * points.row(1);
+
+    std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+    testObj->beginEdit();
+    testObj->setStatic();
+    EnsightPart* part = testObj->createEnsightPart(QString("points"), 1);
+    testObj->setVertices(part, points, 0);
+    testObj->setCells(part, cells, 0, Ensight::Point);
+    testObj->createVariable(QString("u"), Ensight::ScalarPerNode);
+    QVERIFY(testObj->setVariable(part, QString("u"), values, Ensight::ScalarPerNode, 0));
+    testObj->endEdit();
+    QVERIFY(testObj->createSubdivTree(5, 8, QStringList()));
+
+    Matx positions = 1.2 * samplePositions(1, 100, false);
+    for (int i = 0; i < positions.cols(); i++)
+    {
+        const Vec3 pos = positions.col(i);
+        const auto expected = bruteForceNearest(points, pos, 1, std::numeric_limits<double>::infinity());
+
+        EnsightBarycentricCoordinates baryCoord;
+        double distance = -1.0;
+        EnsightCellIdentifier* cell = testObj->findNearestCell(pos, baryCoord, distance);
+        QVERIFY(cell != nullptr);
+        QCOMPARE(cell->getIndex(), expected[0].second);
+        QCOMPARE(distance, std::sqrt(expected[0].first));
+        QCOMPARE(baryCoord.evaluate(QString("u"))[0], values(0, expected[0].second));
+    }
+}
+
+void EnsightSubdivTreeTests::FindNearestCell_CoarseFace_ClosestCellFound()
+{
+    // A strip of fine quadrangles below one large quadrangle. Between them,
+    // the closest vertices belong to the strip but the large cell is closer.
+    const int n = 100;
+    Matx vertices(3, 2 * (n + 1) + 4);
+    Mati cells(4, n + 1);
+    for (int i = 0; i <= n; i++)
+    {
+        vertices.col(2 * i) << 0.1 * i, 0.0, 0.0;
+        vertices.col(2 * i + 1) << 0.1 * i, 1.0, 0.0;
+        if (i < n)
+            cells.col(i) << 2 * i, 2 * i + 2, 2 * i + 3, 2 * i + 1;
+    }
+    const int c = 2 * (n + 1);
+    vertices.col(c) << -50.0, 1.5, 0.0;
+    vertices.col(c + 1) << 50.0, 1.5, 0.0;
+    vertices.col(c + 2) << 50.0, 100.0, 0.0;
+    vertices.col(c + 3) << -50.0, 100.0, 0.0;
+    cells.col(n) << c, c + 1, c + 2, c + 3;
+
+    for (Ensight::SubdivTreeType type : {Ensight::SpatialSubdivision, Ensight::BoundingVolumeHierarchy})
+    {
+        std::unique_ptr<EnsightObj> testObj(EnsightLib::createEnsight());
+        testObj->beginEdit();
+        testObj->setStatic();
+        EnsightPart* part = testObj->createEnsightPart(QString("strip"), 1);
+        testObj->setVertices(part, vertices, 0);
+        testObj->setCells(part, cells, 0, Ensight::Quadrangle);
+        testObj->endEdit();
+        QVERIFY(testObj->createSubdivTree(6, 4, QStringList(), 0.0, type));
+
+        const Vec3 pos(5.05, 1.3, 0.0);
+        EnsightBarycentricCoordinates baryCoord;
+        double distance = -1.0;
+        EnsightCellIdentifier* cell = testObj->findNearestCell(pos, baryCoord, distance);
+        QVERIFY(cell != nullptr);
+        QCOMPARE(cell->getIndex(), n);
+        QVERIFY(std::fabs(distance - 0.2) < 1e-12);
+        QVERIFY((baryCoord.evaluate(vertices) - Vec3(5.05, 1.5, 0.0)).norm() < 1e-12);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ENSIGHTSUBDIVTREETESTS_H
+#define ENSIGHTSUBDIVTREETESTS_H
+
+#include <QtTest/QtTest>
+
+#include "ensightbvh.h"
+#include "ensightsubdivtreeimpl.h"
+
+
+/*
+    Unit Tests for EnsightLib >> EnsightQuadtree
+               and EnsightOctree
+               and EnsightBvh
+               and EnsightKdTree
+*/
+class EnsightSubdivTreeTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void Search_QuadGrid_CellContainingPositionFound();
+
+    void Search_HexGrid_SameCellAsTestingAllCells();
+
+    void SearchAll_HexGrid_AllCellsWithBoundsContainingPositionFound();
+
+    void GetLeafBounds_Octree_LeavesCoverBounds();
+
+    void Build_FourThreads_SameTreeAsSerial();
+
+    void Search_HexGrid_Benchmark();
+
+    void BvhSearch_HexGrid_SameCellAsOctree();
+
+    void BvhSearchAll_SizeOffset_SameCellsAsOctree();
+
+    void BvhSearch_HexGrid_Benchmark();
+
+    void SearchBatch_FourThreads_SameAsSinglePositions();
+
+    void SearchBatch_HexGrid_Benchmark();
+
+    void Search_HexGrid_IdentifiersCreatedForFoundCellsOnly();
+
+    void LeafBoundsFilter_HexGrid_AllCellsWithBoundsContainingPositionSelected();
+
+    void SearchHint_ParticlePath_SameCellAsTree();
+
+    void SearchHint_DistantHint_FallsBackToTree();
+
+    void SearchHint_ParticlePath_Benchmark();
+
+    void GetSubdivTree_MovingGrid_CellsFoundAtEachTimestep();
+
+    void GetSubdivTree_TimestepsAddedAfterCreation_TreesBuiltForNewTimesteps();
+
+    void LoadSubdivTree_SavedTree_SameCellsAsBuiltTree();
+
+    void LoadSubdivTree_OtherGeometryOrParameters_ReturnsFalse();
+
+    void LoadSubdivTree_CorruptSizes_ReturnsFalse();
+
+    void KdTreeFindNearest_GridVertices_SameAsBruteForce();
+
+    void FindNearestCell_OutsidePositions_ClosestPointInterpolated();
+
+    void FindNearestCell_PointCells_NearestPointFound();
+
+    void FindNearestCell_CoarseFace_ClosestCellFound();
+};
+
+#endif // ENSIGHTSUBDIVTREETESTS_H
@@ -1,5 +1,10 @@
 #include "ensightvariabletests.h"
 
+#include <memory>
+#include <thread>
+
+#include "ensightpart.h"
+
 void EnsightVariableTests::EnsightVariableIdentifierDefaultConstructor_StaticValueAssignment_CorrectValuesAssigned()
 {
     auto testEnsightVariableId = EnsightVariableIdentifier();
@@ -251,3 +256,80 @@ void EnsightVariableTests::EnsightVariableGetBounds_ValueObservator_CorrectMatri
 
 
 }
+
+void EnsightVariableTests::EnsightVariableRegistryIntern_ValueMutator_DenseHandlesAssigned()
+{
+    EnsightVariableRegistry testRegistry;
+
+    QCOMPARE(testRegistry.intern(QString("pressure")), 0);
+    QCOMPARE(testRegistry.intern(QString("velocity")), 1);
+    QCOMPARE(testRegistry.intern(QString("pressure")), 0);
+
+    QCOMPARE(testRegistry.size(), 2);
+    QCOMPARE(testRegistry.getName(1), QString("velocity"));
+}
+
+void EnsightVariableTests::EnsightVariableRegistryFind_ValueObservator_CorrectHandleReturned()
+{
+    EnsightVariableRegistry testRegistry;
+    testRegistry.intern(QString("pressure"));
+    testRegistry.intern(QString("velocity"));
+
+    QCOMPARE(testRegistry.find(QString("velocity")), 1);
+    QCOMPARE(testRegistry.find(std::string("velocity")), 1);
+    QCOMPARE(testRegistry.find(QString("temperature")), -1);
+    QCOMPARE(testRegistry.find(std::string("temperature")), -1);
+}
+
+void EnsightVariableTests::EnsightPartGetVariable_SharedRegistry_SameHandleInAllParts()
+{
+    auto registry = std::make_shared<EnsightVariableRegistry>();
+    EnsightPart firstPart(QString("first"), 1, 2, registry);
+    EnsightPart secondPart(QString("second"), 2, 2, registry);
+
+    Matx values(1, 2);
+    values << 1, 2;
+    firstPart.setVariable(QString("a"), values, Ensight::ScalarPerNode, 0);
+    secondPart.setVariable(QString("b"), values, Ensight::ScalarPerNode, 1);
+    secondPart.setVariable(QString("a"), values, Ensight::ScalarPerNode, 1);
+
+    int handle = firstPart.getVariableHandle(QString("a"));
+    QCOMPARE(secondPart.getVariableHandle(std::string("a")), handle);
+
+    QVERIFY(firstPart.hasVariable(handle, 0));
+    QVERIFY(!firstPart.hasVariable(handle, 1));
+    QVERIFY(secondPart.hasVariable(handle, -1));
+    QVERIFY(secondPart.getVariable(handle, 0) == nullptr);
+    QCOMPARE(secondPart.getVariable(handle, 1)->getName(), QString("a"));
+    QVERIFY(secondPart.getVariable(QString("c"), 1) == nullptr);
+}
+
+void EnsightVariableTests::EnsightPartSetVariable_PartsFilledConcurrently_SameHandleInAllParts()
+{
+    auto registry = std::make_shared<EnsightVariableRegistry>();
+    EnsightPart firstPart(QString("first"), 1, 1, registry);
+    EnsightPart secondPart(QString("second"), 2, 1, registry);
+
+    // Both parts intern the same names at the same time, in opposite order
+    const int numVariables = 200;
+    Matx values(1, 2);
+    values << 1, 2;
+    std::thread thread([&]() {
+        for (int i = 0; i < numVariables; i++)
+            firstPart.setVariable(QString("v%1").arg(i), values, Ensight::ScalarPerNode, 0);
+    });
+    for (int i = numVariables - 1; i >= 0; i--)
+        secondPart.setVariable(QString("v%1").arg(i), values, Ensight::ScalarPerNode, 0);
+    thread.join();
+
+    QCOMPARE(registry->size(), numVariables);
+    for (int i = 0; i < numVariables; i++)
+    {
+        const QString name = QString("v%1").arg(i);
+        const int handle = registry->find(name);
+        QVERIFY(handle >= 0);
+        QCOMPARE(registry->getName(handle), name);
+        QCOMPARE(firstPart.getVariable(handle, 0)->getName(), name);
+        QCOMPARE(secondPart.getVariable(handle, 0)->getName(), name);
+    }
+}
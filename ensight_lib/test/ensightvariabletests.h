@@ -14,6 +14,7 @@ Q_DECLARE_METATYPE(Ensight::VarTypes)
 /*
     Unit Tests for EnsightLib >> EnsightVariableIdentifier
                and EnsightLib >> EnsightVariable
+               and EnsightLib >> EnsightVariableRegistry
 
     (Share one source file)
 */
@@ -52,6 +53,17 @@ private slots:
     void EnsightVariableGetValues_ValueObservator_CorrectMatrixReturned();
 
     void EnsightVariableGetBounds_ValueObservator_CorrectMatrixReturned();
+
+
+    //EnsightVariableRegistry
+
+    void EnsightVariableRegistryIntern_ValueMutator_DenseHandlesAssigned();
+
+    void EnsightVariableRegistryFind_ValueObservator_CorrectHandleReturned();
+
+    void EnsightPartGetVariable_SharedRegistry_SameHandleInAllParts();
+
+    void EnsightPartSetVariable_PartsFilledConcurrently_SameHandleInAllParts();
 };
 
 #endif // ENSIGHTVARIABLETESTS_H
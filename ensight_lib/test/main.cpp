@@ -1,8 +1,13 @@
 #include <QTest>
 
 #include "bboxtests.h"
+#include "ensightbuffertests.h"
+#include "ensightcelltests.h"
 #include "ensightconstanttests.h"
+#include "ensightobjtests.h"
+#include "ensightparalleltests.h"
 #include "ensightreadertests.h"
+#include "ensightsubdivtreetests.h"
 #include "ensightvariabletests.h"
 
 int main(int argc, char** argv)
@@ -16,8 +21,13 @@ int main(int argc, char** argv)
                 };
 
     runTest(BboxTests());
+    runTest(EnsightBufferTests());
+    runTest(EnsightCellTests());
     runTest(EnsightConstantTests());
+    runTest(EnsightObjTests());
+    runTest(EnsightParallelTests());
     runTest(EnsightReaderTests());
+    runTest(EnsightSubdivTreeTests());
     runTest(EnsightVariableTests());
 
     return returnStatus;